@@ -169,6 +169,15 @@ ifeq (true,$(GFXSTREAM)) # Vulkan libs
     include $(GOLDFISH_OPENGL_PATH)/system/vulkan/Android.mk
 endif
 
+# Encoder and android-emu microbenchmarks, run on the build machine
+ifeq (true,$(GOLDFISH_OPENGL_BUILD_FOR_HOST))
+    include $(GOLDFISH_OPENGL_PATH)/tests/encoder_benchmark/Android.mk
+    include $(GOLDFISH_OPENGL_PATH)/tests/android_emu_benchmark/Android.mk
+ifeq (true,$(GFXSTREAM))
+    include $(GOLDFISH_OPENGL_PATH)/tests/vulkan_encoder_benchmark/Android.mk
+endif
+endif
+
 ifeq ($(shell test $(PLATFORM_SDK_VERSION) -gt 28 -o $(IS_AT_LEAST_QPR1) = true && echo isApi29OrHigher),isApi29OrHigher)
     # HWC2 enabled after P
     include $(GOLDFISH_OPENGL_PATH)/system/hwc2/Android.mk
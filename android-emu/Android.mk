@@ -19,12 +19,14 @@ LOCAL_SRC_FILES := \
     android/base/Pool.cpp \
     android/base/StringFormat.cpp \
     android/base/AndroidSubAllocator.cpp \
+    android/base/synchronization/AndroidFenceFdWaiter.cpp \
     android/base/synchronization/AndroidMessageChannel.cpp \
     android/base/threads/AndroidFunctorThread.cpp \
     android/base/threads/AndroidThreadStore.cpp \
     android/base/threads/AndroidThread_pthread.cpp \
     android/base/threads/AndroidWorkPool.cpp \
     android/base/Tracing.cpp \
+    android/base/TraceFlightRecorder.cpp \
     android/utils/debug.c \
 
 $(call emugl-end-module)
@@ -35,5 +37,15 @@ $(call emugl-export,C_INCLUDES,$(LOCAL_PATH))
 LOCAL_SRC_FILES := \
     android/base/ring_buffer.c \
 
+$(call emugl-end-module)
+
+$(call emugl-begin-test,androidemu_unittests)
+$(call emugl-import,libandroidemu)
+
+LOCAL_CFLAGS += -DLOG_TAG=\"androidemu_unittests\"
+
+LOCAL_SRC_FILES := \
+    androidemu_unittests.cpp \
+
 $(call emugl-end-module)
 endif
@@ -13,12 +13,14 @@
 // limitations under the License.
 #include "android/base/AndroidSubAllocator.h"
 
-#include "android/base/address_space.h"
 #include "android/base/files/Stream.h"
 
+#include <algorithm>
 #include <iomanip>
 #include <sstream>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <log/log.h>
 
@@ -26,6 +28,22 @@ namespace android {
 namespace base {
 namespace guest {
 
+namespace {
+
+// Old snapshots stored each block's size and availability bit the way
+// address_space.h's bit-field lays them out.
+constexpr uint64_t kAvailableBit = 1ULL << 63;
+
+uint32_t log2Floor(uint64_t x) {
+    return 63 - __builtin_clzll(x);
+}
+
+} // namespace
+
+// TLSF over whole pages. A free block of |pages| pages lives in list
+// (fl, sl): fl is its power-of-two range and sl one of kSlCount linear
+// subdivisions of it, with sizes below kSlCount pages mapped one to one.
+// Bitmaps of non-empty lists find a large-enough block with two bit scans.
 class SubAllocator::Impl {
 public:
     Impl(
@@ -37,44 +55,47 @@ public:
         pageSize(_pageSize),
         startAddr((uintptr_t)buffer),
         endAddr(startAddr + totalSize) {
-
-        address_space_allocator_init(
-            &addr_alloc,
-            totalSize,
-            32);
+        clear();
     }
 
-    ~Impl() {
-        address_space_allocator_destroy_nocleanup(&addr_alloc);
+    void clear() {
+        reset();
+        firstBlock = newBlock(0, totalSize);
+        insertFree(firstBlock);
     }
 
-    void clear() {
-        address_space_allocator_destroy_nocleanup(&addr_alloc);
-        address_space_allocator_init(
-            &addr_alloc,
-            totalSize,
-            32);
+    // Forgets every block, leaving no free space at all.
+    void reset() {
+        blocks.clear();
+        unusedBlocks.clear();
+        allocated.clear();
+        flBitmap = 0;
+        memset(slBitmap, 0, sizeof(slBitmap));
+        for (auto& heads : freeHeads) {
+            for (auto& head : heads) head = kNil;
+        }
+        allocCount = 0;
+        allocatedBytes = 0;
+        freeBlockCount = 0;
+        firstBlock = kNil;
     }
 
+    // The snapshot format is the one address_space_allocator_run() produced,
+    // so snapshots taken before and after the switch to TLSF load either way.
     bool save(Stream* stream) {
-        address_space_allocator_iter_func_t allocatorSaver =
-            [](void* context, struct address_space_allocator* allocator) {
-                Stream* stream = reinterpret_cast<Stream*>(context);
-                stream->putBe32(allocator->size);
-                stream->putBe32(allocator->capacity);
-                stream->putBe64(allocator->total_bytes);
-            };
-        address_block_iter_func_t allocatorBlockSaver =
-            [](void* context, struct address_block* block) {
-                Stream* stream = reinterpret_cast<Stream*>(context);
-                stream->putBe64(block->offset);
-                stream->putBe64(block->size_available);
-            };
-        address_space_allocator_run(
-            &addr_alloc,
-            (void*)stream,
-            allocatorSaver,
-            allocatorBlockSaver);
+        uint32_t count = 0;
+        for (uint32_t i = firstBlock; i != kNil; i = blocks[i].nextPhys) ++count;
+        uint32_t capacity = 32;
+        while (capacity < count) capacity *= 2;
+
+        stream->putBe32(count);
+        stream->putBe32(capacity);
+        stream->putBe64(totalSize);
+        for (uint32_t i = firstBlock; i != kNil; i = blocks[i].nextPhys) {
+            const Block& block = blocks[i];
+            stream->putBe64(block.offset);
+            stream->putBe64(block.size | (block.free ? kAvailableBit : 0));
+        }
 
         stream->putBe64(pageSize);
         stream->putBe64(totalSize);
@@ -84,29 +105,69 @@ public:
     }
 
     bool load(Stream* stream) {
-        clear();
-        address_space_allocator_iter_func_t allocatorLoader =
-            [](void* context, struct address_space_allocator* allocator) {
-                Stream* stream = reinterpret_cast<Stream*>(context);
-                allocator->size = stream->getBe32();
-                allocator->capacity = stream->getBe32();
-                allocator->total_bytes = stream->getBe64();
-            };
-        address_block_iter_func_t allocatorBlockLoader =
-            [](void* context, struct address_block* block) {
-                Stream* stream = reinterpret_cast<Stream*>(context);
-                block->offset = stream->getBe64();
-                block->size_available = stream->getBe64();
-            };
-        address_space_allocator_run(
-            &addr_alloc,
-            (void*)stream,
-            allocatorLoader,
-            allocatorBlockLoader);
+        uint32_t count = stream->getBe32();
+        stream->getBe32(); // capacity
+        stream->getBe64(); // total bytes
+        std::vector<std::pair<uint64_t, uint64_t>> saved(count);
+        for (auto& block : saved) {
+            block.first = stream->getBe64();
+            block.second = stream->getBe64();
+        }
 
         pageSize = stream->getBe64();
         totalSize = stream->getBe64();
-        allocCount = stream->getBe32();
+        stream->getBe32(); // alloc count, recomputed below
+        endAddr = startAddr + totalSize;
+
+        reset();
+        uint64_t expectedOffset = 0;
+        uint32_t prev = kNil;
+        for (const auto& savedBlock : saved) {
+            uint64_t offset = savedBlock.first;
+            uint64_t size = savedBlock.second & ~kAvailableBit;
+            bool free = savedBlock.second & kAvailableBit;
+            if (offset != expectedOffset || !size) {
+                ALOGE("%s: corrupt snapshot: block at 0x%llx, expected 0x%llx\n",
+                      __func__, (unsigned long long)offset,
+                      (unsigned long long)expectedOffset);
+                clear();
+                return false;
+            }
+            expectedOffset += size;
+
+            // Coalesce, in case the saved blocks were not.
+            if (free && prev != kNil && blocks[prev].free) {
+                blocks[prev].size += size;
+                continue;
+            }
+
+            uint32_t index = newBlock(offset, size);
+            blocks[index].prevPhys = prev;
+            if (prev != kNil) {
+                blocks[prev].nextPhys = index;
+            } else {
+                firstBlock = index;
+            }
+            blocks[index].free = free;
+            if (!free) {
+                allocated[offset] = index;
+                ++allocCount;
+                allocatedBytes += size;
+            }
+            prev = index;
+        }
+
+        if (expectedOffset != totalSize) {
+            ALOGE("%s: corrupt snapshot: blocks cover 0x%llx of 0x%llx bytes\n",
+                  __func__, (unsigned long long)expectedOffset,
+                  (unsigned long long)totalSize);
+            clear();
+            return false;
+        }
+
+        for (uint32_t i = firstBlock; i != kNil; i = blocks[i].nextPhys) {
+            if (blocks[i].free) insertFree(i);
+        }
 
         return true;
     }
@@ -115,6 +176,7 @@ public:
         buffer = postLoadBuffer;
         startAddr =
             (uint64_t)(uintptr_t)postLoadBuffer;
+        endAddr = startAddr + totalSize;
         return true;
     }
 
@@ -142,53 +204,235 @@ public:
         if (!ptr) return false;
 
         rangeCheck("free", ptr);
-        if (EINVAL == address_space_allocator_deallocate(
-            &addr_alloc, getOffset(ptr))) {
+        auto it = allocated.find(getOffset(ptr));
+        if (it == allocated.end()) {
             return false;
         }
 
+        uint32_t index = it->second;
+        allocated.erase(it);
         --allocCount;
+        allocatedBytes -= blocks[index].size;
+        blocks[index].free = true;
+
+        uint32_t next = blocks[index].nextPhys;
+        if (next != kNil && blocks[next].free) {
+            removeFree(next);
+            absorbNext(index);
+        }
+
+        uint32_t prev = blocks[index].prevPhys;
+        if (prev != kNil && blocks[prev].free) {
+            removeFree(prev);
+            absorbNext(prev);
+            index = prev;
+        }
+
+        insertFree(index);
         return true;
     }
 
     void freeAll() {
-        address_space_allocator_reset(&addr_alloc);
-        allocCount = 0;
+        clear();
     }
 
     void* alloc(size_t wantedSize) {
         if (wantedSize == 0) return nullptr;
+        if ((uint64_t)wantedSize > totalSize) return nullptr;
 
-        uint64_t wantedSize64 =
-            (uint64_t)wantedSize;
-
-        size_t toPageSize =
-            pageSize *
-            ((wantedSize + pageSize - 1) / pageSize);
-
-        uint64_t offset =
-            address_space_allocator_allocate(
-                &addr_alloc, toPageSize);
+        uint64_t pages = (wantedSize + pageSize - 1) / pageSize;
+        uint64_t toPageSize = pages * pageSize;
 
-        if (offset == ANDROID_EMU_ADDRESS_SPACE_BAD_OFFSET) {
+        uint32_t index = findFree(pages);
+        if (index == kNil) {
             return nullptr;
         }
 
+        removeFree(index);
+        if (blocks[index].size > toPageSize) {
+            uint32_t rest = newBlock(blocks[index].offset + toPageSize,
+                                     blocks[index].size - toPageSize);
+            blocks[index].size = toPageSize;
+            blocks[rest].free = true;
+            blocks[rest].prevPhys = index;
+            blocks[rest].nextPhys = blocks[index].nextPhys;
+            if (blocks[rest].nextPhys != kNil) {
+                blocks[blocks[rest].nextPhys].prevPhys = rest;
+            }
+            blocks[index].nextPhys = rest;
+            insertFree(rest);
+        }
+
+        blocks[index].free = false;
+        allocated[blocks[index].offset] = index;
         ++allocCount;
-        return (void*)(uintptr_t)(startAddr + offset);
+        allocatedBytes += toPageSize;
+        return (void*)(uintptr_t)(startAddr + blocks[index].offset);
     }
 
     bool empty() const {
         return allocCount == 0;
     }
 
+    Stats getStats() const {
+        Stats stats;
+        stats.totalBytes = totalSize;
+        stats.allocatedBytes = allocatedBytes;
+        stats.freeBytes = totalSize - allocatedBytes;
+        stats.allocCount = allocCount;
+        stats.freeBlockCount = freeBlockCount;
+        // The largest usable block is in the highest non-empty list. A tail
+        // smaller than a page is never listed.
+        if (flBitmap) {
+            uint32_t fl = log2Floor(flBitmap);
+            uint32_t sl = log2Floor(slBitmap[fl]);
+            for (uint32_t i = freeHeads[fl][sl]; i != kNil; i = blocks[i].nextFree) {
+                stats.largestFreeBlock = std::max(stats.largestFreeBlock, blocks[i].size);
+            }
+        }
+        return stats;
+    }
+
     void* buffer;
     uint64_t totalSize;
     uint64_t pageSize;
     uint64_t startAddr;
     uint64_t endAddr;
-    struct address_space_allocator addr_alloc;
     uint32_t allocCount = 0;
+
+private:
+    static constexpr uint32_t kNil = ~0U;
+    static constexpr uint32_t kSlBits = 4;
+    static constexpr uint32_t kSlCount = 1 << kSlBits;
+    static constexpr uint32_t kFlCount = 64 - kSlBits + 1;
+
+    struct Block {
+        uint64_t offset;
+        uint64_t size;
+        uint32_t prevPhys = kNil;
+        uint32_t nextPhys = kNil;
+        uint32_t prevFree = kNil;
+        uint32_t nextFree = kNil;
+        bool free = false;
+    };
+
+    static void mapping(uint64_t pages, uint32_t* fl, uint32_t* sl) {
+        if (pages < kSlCount) {
+            *fl = 0;
+            *sl = (uint32_t)pages;
+        } else {
+            uint32_t log = log2Floor(pages);
+            *fl = log - kSlBits + 1;
+            *sl = (uint32_t)(pages >> (log - kSlBits)) - kSlCount;
+        }
+    }
+
+    uint32_t newBlock(uint64_t offset, uint64_t size) {
+        uint32_t index;
+        if (unusedBlocks.empty()) {
+            index = (uint32_t)blocks.size();
+            blocks.emplace_back();
+        } else {
+            index = unusedBlocks.back();
+            unusedBlocks.pop_back();
+            blocks[index] = Block();
+        }
+        blocks[index].offset = offset;
+        blocks[index].size = size;
+        blocks[index].free = true;
+        return index;
+    }
+
+    // Merges the block physically after |index| into it.
+    void absorbNext(uint32_t index) {
+        uint32_t next = blocks[index].nextPhys;
+        blocks[index].size += blocks[next].size;
+        blocks[index].nextPhys = blocks[next].nextPhys;
+        if (blocks[index].nextPhys != kNil) {
+            blocks[blocks[index].nextPhys].prevPhys = index;
+        }
+        unusedBlocks.push_back(next);
+    }
+
+    void insertFree(uint32_t index) {
+        uint64_t pages = blocks[index].size / pageSize;
+        if (!pages) return;
+        uint32_t fl, sl;
+        mapping(pages, &fl, &sl);
+        uint32_t head = freeHeads[fl][sl];
+        blocks[index].prevFree = kNil;
+        blocks[index].nextFree = head;
+        if (head != kNil) blocks[head].prevFree = index;
+        freeHeads[fl][sl] = index;
+        slBitmap[fl] |= 1U << sl;
+        flBitmap |= 1ULL << fl;
+        ++freeBlockCount;
+    }
+
+    void removeFree(uint32_t index) {
+        uint64_t pages = blocks[index].size / pageSize;
+        if (!pages) return;
+        uint32_t fl, sl;
+        mapping(pages, &fl, &sl);
+        uint32_t prev = blocks[index].prevFree;
+        uint32_t next = blocks[index].nextFree;
+        if (prev != kNil) {
+            blocks[prev].nextFree = next;
+        } else {
+            freeHeads[fl][sl] = next;
+            if (next == kNil) {
+                slBitmap[fl] &= ~(1U << sl);
+                if (!slBitmap[fl]) flBitmap &= ~(1ULL << fl);
+            }
+        }
+        if (next != kNil) blocks[next].prevFree = prev;
+        --freeBlockCount;
+    }
+
+    uint32_t findFree(uint64_t pages) {
+        // Round up to the next list boundary so that any block in the first
+        // non-empty list at or above it is large enough.
+        uint64_t rounded = pages;
+        if (pages >= kSlCount) {
+            rounded += (1ULL << (log2Floor(pages) - kSlBits)) - 1;
+        }
+        uint32_t fl, sl;
+        mapping(rounded, &fl, &sl);
+
+        uint32_t slMap = fl < kFlCount ? slBitmap[fl] & (~0U << sl) : 0;
+        if (!slMap) {
+            uint64_t flMap = fl + 1 < kFlCount ? flBitmap & (~0ULL << (fl + 1)) : 0;
+            if (flMap) {
+                fl = __builtin_ctzll(flMap);
+                slMap = slBitmap[fl];
+            }
+        }
+        if (slMap) {
+            return freeHeads[fl][__builtin_ctz(slMap)];
+        }
+
+        // Nothing in a larger list, but |pages|' own list may still hold a
+        // block that fits; check it so a nearly full buffer fails no
+        // allocation that best fit would have satisfied.
+        mapping(pages, &fl, &sl);
+        for (uint32_t i = freeHeads[fl][sl]; i != kNil; i = blocks[i].nextFree) {
+            if (blocks[i].size / pageSize >= pages) return i;
+        }
+        return kNil;
+    }
+
+    std::vector<Block> blocks;
+    std::vector<uint32_t> unusedBlocks;
+    // Offset of each allocation to its block, to free by pointer.
+    std::unordered_map<uint64_t, uint32_t> allocated;
+    uint32_t firstBlock = kNil;
+
+    uint64_t flBitmap = 0;
+    uint32_t slBitmap[kFlCount];
+    uint32_t freeHeads[kFlCount][kSlCount];
+
+    uint64_t allocatedBytes = 0;
+    uint32_t freeBlockCount = 0;
 };
 
 SubAllocator::SubAllocator(
@@ -235,6 +479,10 @@ bool SubAllocator::empty() const {
     return mImpl->empty();
 }
 
+SubAllocator::Stats SubAllocator::getStats() const {
+    return mImpl->getStats();
+}
+
 } // namespace guest
 } // namespace base
 } // namespace android
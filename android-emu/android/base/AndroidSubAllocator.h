@@ -33,8 +33,27 @@ namespace guest {
 // Class to create sub-allocations in an existing buffer. Similar interface to
 // Pool, but underlying mechanism is different as it's difficult to combine
 // same-size heaps in Pool with a preallocated buffer.
+//
+// Free ranges are kept in two-level segregated fit (TLSF) lists, so alloc()
+// and free() take constant time regardless of how fragmented the buffer is.
+// Bookkeeping lives outside the buffer, which may be device memory.
 class SubAllocator {
 public:
+    struct Stats {
+        uint64_t totalBytes = 0;
+        uint64_t allocatedBytes = 0;
+        uint64_t freeBytes = 0;
+        uint64_t largestFreeBlock = 0;
+        uint32_t allocCount = 0;
+        uint32_t freeBlockCount = 0;
+
+        // 0 when all free space is one block, approaching 1 as it is split
+        // into more and smaller pieces.
+        double fragmentation() const {
+            return freeBytes ? 1.0 - (double)largestFreeBlock / (double)freeBytes : 0.0;
+        }
+    };
+
     // |pageSize| determines both the alignment of pointers returned
     // and the multiples of space occupied.
     SubAllocator(
@@ -60,6 +79,8 @@ public:
 
     bool empty() const;
 
+    Stats getStats() const;
+
     // Convenience function to allocate an array
     // of objects of type T.
     template <class T>
@@ -13,65 +13,218 @@
 // limitations under the License.
 #pragma once
 
-#include "android/base/AlignedBuf.h"
 #include "android/base/Allocator.h"
 
-#include <vector>
-#include <unordered_set>
-
 #include <inttypes.h>
+#include <stdint.h>
+#include <stdlib.h>
 
 namespace android {
 namespace base {
 
 // Class to make it easier to set up memory regions where it is fast
-// to allocate buffers AND we don't care about freeing individual pieces,
-// BUT it's necessary to preserve previous pointer values in between the first
-// alloc() after a freeAll(), and the freeAll() itself, allowing some sloppy use of
-// malloc in the first pass while we find out how much data was needed.
+// to allocate buffers AND we don't care about freeing individual pieces.
+// Pointers stay valid until the next freeAll().
+//
+// Memory comes from a chain of chunks. When the current chunk is full, a
+// chunk at least twice its size is appended; nothing is copied. At
+// freeAll(), a chain that grew past its first chunk is replaced with one
+// chunk big enough for the whole generation, so the next one is served from
+// a single chunk again, and a chunk that stays much bigger than what the
+// recent generations used is shrunk. Allocations of |hugeAllocBytes| or more
+// get a malloc of their own so that one large copy does not make the chunk
+// grow; the largest one is kept for reuse until a while goes by without any.
 class BumpPool : public Allocator {
 public:
-    BumpPool(size_t startingBytes = 4096) : mStorage(startingBytes / sizeof(uint64_t))  { }
+    static constexpr size_t kDefaultHugeAllocBytes = 256 * 1024;
+    static constexpr size_t kNoHugeAllocs = SIZE_MAX;
+
+    struct Stats {
+        // Most bytes allocated between two freeAll() calls, huge
+        // allocations included.
+        size_t highWaterBytes = 0;
+        // Bytes held right now, the kept huge allocation included.
+        size_t capacityBytes = 0;
+        uint64_t chunkMallocs = 0;
+        uint64_t hugeAllocs = 0;
+    };
+
+    BumpPool(size_t startingBytes = 4096, size_t hugeAllocBytes = kDefaultHugeAllocBytes)
+        : mStartingBytes(roundUp(startingBytes ? startingBytes : sizeof(uint64_t))),
+          mHugeAllocBytes(hugeAllocBytes) {
+        mFirst = mCurrent = newChunk(mStartingBytes);
+    }
+
     // All memory allocated by this pool
     // is automatically deleted when the pool
     // is deconstructed.
-    ~BumpPool() { }
+    ~BumpPool() {
+        free(mSpareHuge);
+        freeChain(mHuge);
+        freeChain(mFirst);
+    }
 
     void* alloc(size_t wantedSize) override {
-        size_t wantedSizeRoundedUp =
-            sizeof(uint64_t) * ((wantedSize + sizeof(uint64_t) - 1) / (sizeof(uint64_t)));
-
-        mTotalWantedThisGeneration += wantedSizeRoundedUp;
-        if (mAllocPos + wantedSizeRoundedUp > mStorage.size() * sizeof(uint64_t)) {
-            mNeedRealloc = true;
-            void* fallbackPtr = malloc(wantedSizeRoundedUp);
-            mFallbackPtrs.insert(fallbackPtr);
-            return fallbackPtr;
+        size_t wantedSizeRoundedUp = roundUp(wantedSize);
+        if (wantedSizeRoundedUp > mCurrent->size - mAllocPos) {
+            return allocSlow(wantedSizeRoundedUp);
         }
-        size_t avail = mStorage.size() * sizeof(uint64_t) - mAllocPos;
-        void* allocPtr = (void*)(((unsigned char*)mStorage.data()) + mAllocPos);
+        void* allocPtr = mCurrent->data() + mAllocPos;
         mAllocPos += wantedSizeRoundedUp;
         return allocPtr;
     }
 
     void freeAll() {
-        mAllocPos = 0;
-        if (mNeedRealloc) {
-            mStorage.resize((mTotalWantedThisGeneration * 2) / sizeof(uint64_t));
-            mNeedRealloc = false;
-            for (auto ptr : mFallbackPtrs) {
-                free(ptr);
+        size_t used = mFilledBytes + mAllocPos;
+        if (used + mHugeBytes > mStats.highWaterBytes) {
+            mStats.highWaterBytes = used + mHugeBytes;
+        }
+        if (used > mRecentPeakBytes) mRecentPeakBytes = used;
+
+        if (mHuge) {
+            keepLargestHuge();
+            mHugeUsedRecently = true;
+        }
+
+        if (mFirst->next) {
+            replaceChunks(used * 2);
+        }
+        if (++mGenerations >= kShrinkCheckGenerations) {
+            if (mFirst->size > mStartingBytes && mFirst->size / kShrinkRatio > mRecentPeakBytes) {
+                replaceChunks(mRecentPeakBytes * 2);
+            }
+            if (!mHugeUsedRecently) {
+                free(mSpareHuge);
+                mSpareHuge = nullptr;
             }
-            mFallbackPtrs.clear();
+            mGenerations = 0;
+            mRecentPeakBytes = 0;
+            mHugeUsedRecently = false;
         }
-        mTotalWantedThisGeneration = 0;
+
+        mCurrent = mFirst;
+        mAllocPos = 0;
+        mFilledBytes = 0;
     }
+
+    Stats stats() const {
+        Stats res = mStats;
+        for (const Chunk* chunk = mFirst; chunk; chunk = chunk->next) {
+            res.capacityBytes += chunk->size;
+        }
+        if (mSpareHuge) res.capacityBytes += mSpareHuge->size;
+        return res;
+    }
+
 private:
-    AlignedBuf<uint64_t, 8> mStorage;
-    std::unordered_set<void*> mFallbackPtrs;
+    // Chunk data follows the header.
+    struct Chunk {
+        Chunk* next;
+        size_t size;
+
+        unsigned char* data() { return reinterpret_cast<unsigned char*>(this + 1); }
+    };
+    static_assert(sizeof(Chunk) % sizeof(uint64_t) == 0, "chunk data must stay 8-byte aligned");
+
+    // Every this many generations, shrink the chunk if it is this many times
+    // bigger than the largest of them, and drop the kept huge allocation if
+    // none of them needed one.
+    static constexpr uint32_t kShrinkCheckGenerations = 256;
+    static constexpr size_t kShrinkRatio = 4;
+
+    static size_t roundUp(size_t size) {
+        return sizeof(uint64_t) * ((size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    }
+
+    static Chunk* mallocChunk(size_t size) {
+        Chunk* chunk = static_cast<Chunk*>(malloc(sizeof(Chunk) + size));
+        if (!chunk) abort();
+        chunk->next = nullptr;
+        chunk->size = size;
+        return chunk;
+    }
+
+    static void freeChain(Chunk* chunk) {
+        while (chunk) {
+            Chunk* next = chunk->next;
+            free(chunk);
+            chunk = next;
+        }
+    }
+
+    Chunk* newChunk(size_t size) {
+        ++mStats.chunkMallocs;
+        return mallocChunk(size);
+    }
+
+    void* allocSlow(size_t size) {
+        if (size >= mHugeAllocBytes) {
+            Chunk* huge = mSpareHuge;
+            if (huge && huge->size >= size) {
+                mSpareHuge = nullptr;
+            } else {
+                huge = mallocChunk(size);
+            }
+            huge->next = mHuge;
+            mHuge = huge;
+            mHugeBytes += size;
+            ++mStats.hugeAllocs;
+            return huge->data();
+        }
+
+        size_t chunkSize = mCurrent->size * 2;
+        if (chunkSize < size) chunkSize = size;
+        Chunk* chunk = newChunk(chunkSize);
+        mCurrent->next = chunk;
+        mCurrent = chunk;
+        mFilledBytes += mAllocPos;
+        mAllocPos = size;
+        return chunk->data();
+    }
+
+    void replaceChunks(size_t size) {
+        size = roundUp(size);
+        if (size < mStartingBytes) size = mStartingBytes;
+        freeChain(mFirst);
+        mFirst = newChunk(size);
+    }
+
+    void keepLargestHuge() {
+        Chunk* largest = mSpareHuge;
+        Chunk* huge = mHuge;
+        while (huge) {
+            Chunk* next = huge->next;
+            if (!largest || huge->size > largest->size) {
+                free(largest);
+                largest = huge;
+            } else {
+                free(huge);
+            }
+            huge = next;
+        }
+        if (largest) largest->next = nullptr;
+        mSpareHuge = largest;
+        mHuge = nullptr;
+        mHugeBytes = 0;
+    }
+
+    const size_t mStartingBytes;
+    const size_t mHugeAllocBytes;
+
+    Chunk* mFirst = nullptr;
+    Chunk* mCurrent = nullptr;
     size_t mAllocPos = 0;
-    size_t mTotalWantedThisGeneration = 0;
-    bool mNeedRealloc = false;
+    // Bytes allocated from the chunks before |mCurrent| this generation.
+    size_t mFilledBytes = 0;
+
+    Chunk* mHuge = nullptr;
+    size_t mHugeBytes = 0;
+    Chunk* mSpareHuge = nullptr;
+
+    size_t mRecentPeakBytes = 0;
+    uint32_t mGenerations = 0;
+    bool mHugeUsedRecently = false;
+    Stats mStats;
 };
 
 } // namespace base
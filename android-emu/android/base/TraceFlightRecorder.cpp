@@ -0,0 +1,341 @@
+// Copyright (C) 2022 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "android/base/TraceFlightRecorder.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__ANDROID__) || defined(HOST_BUILD)
+#include <cutils/properties.h>
+#endif
+
+namespace android {
+namespace base {
+
+namespace {
+
+constexpr uint32_t kDefaultWindowMs = 5000;
+
+uint64_t readConfig(const char* propertyName, const char* envName, uint64_t defaultValue) {
+#if defined(__ANDROID__) || defined(HOST_BUILD)
+    (void)envName;
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get(propertyName, value, "") > 0) {
+        return strtoull(value, nullptr, 0);
+    }
+#else
+    (void)propertyName;
+    const char* value = getenv(envName);
+    if (value && *value) {
+        return strtoull(value, nullptr, 0);
+    }
+#endif
+    return defaultValue;
+}
+
+uint64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000ULL + uint64_t(ts.tv_nsec);
+}
+
+uint32_t currentTid() {
+#ifdef __linux__
+    return static_cast<uint32_t>(syscall(__NR_gettid));
+#else
+    return static_cast<uint32_t>(
+        std::hash<std::thread::id>()(std::this_thread::get_id()));
+#endif
+}
+
+// Event fields are individually atomic so that a concurrent dump never races
+// with the owning thread in the language sense. All accesses are relaxed;
+// ordering is carried by ThreadRing::head.
+struct Event {
+    std::atomic<uint64_t> timestampNs;
+    std::atomic<const char*> name;
+    std::atomic<uint64_t> payload;
+    std::atomic<uint32_t> phase;
+};
+
+struct ThreadRing {
+    // Total number of events ever written to this ring. Only the owning
+    // thread stores to it.
+    std::atomic<uint64_t> head{0};
+    // Events below this index belong to a previous owner of the ring.
+    std::atomic<uint64_t> firstValid{0};
+    std::atomic<uint32_t> tid{0};
+    bool inUse = false;
+    Event events[kTraceFlightRecorderEventsPerThread];
+};
+
+// Rings are never freed: a dump may be reading one while its thread exits.
+// Rings of exited threads are handed to new threads instead, which bounds
+// memory by the peak number of live tracing threads.
+class RingRegistry {
+public:
+    ThreadRing* acquire() {
+        std::lock_guard<std::mutex> lock(mLock);
+        ThreadRing* ring = nullptr;
+        for (auto r : mRings) {
+            if (!r->inUse) {
+                ring = r;
+                break;
+            }
+        }
+        if (!ring) {
+            ring = new ThreadRing;
+            mRings.push_back(ring);
+        }
+        ring->inUse = true;
+        ring->firstValid.store(ring->head.load(std::memory_order_relaxed),
+                               std::memory_order_relaxed);
+        ring->tid.store(currentTid(), std::memory_order_relaxed);
+        return ring;
+    }
+
+    void release(ThreadRing* ring) {
+        std::lock_guard<std::mutex> lock(mLock);
+        ring->inUse = false;
+    }
+
+    std::vector<ThreadRing*> snapshot() {
+        std::lock_guard<std::mutex> lock(mLock);
+        return mRings;
+    }
+
+private:
+    std::mutex mLock;
+    std::vector<ThreadRing*> mRings;
+};
+
+RingRegistry* sRegistry() {
+    static RingRegistry* registry = new RingRegistry;
+    return registry;
+}
+
+struct ThreadRingHolder {
+    ~ThreadRingHolder() {
+        if (ring) sRegistry()->release(ring);
+    }
+    ThreadRing* ring = nullptr;
+};
+
+ThreadRing* currentRing() {
+    static thread_local ThreadRingHolder holder;
+    if (!holder.ring) holder.ring = sRegistry()->acquire();
+    return holder.ring;
+}
+
+void appendJsonString(std::string* out, const char* str) {
+    out->push_back('"');
+    for (const char* c = str; *c; ++c) {
+        switch (*c) {
+            case '"': out->append("\\\""); break;
+            case '\\': out->append("\\\\"); break;
+            case '\n': out->append("\\n"); break;
+            default:
+                if (static_cast<unsigned char>(*c) >= 0x20) out->push_back(*c);
+                break;
+        }
+    }
+    out->push_back('"');
+}
+
+bool writeAll(int fd, const std::string& data) {
+    const char* p = data.data();
+    size_t remaining = data.size();
+    while (remaining) {
+        ssize_t written = write(fd, p, remaining);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += written;
+        remaining -= written;
+    }
+    return true;
+}
+
+int sSignalPipe[2] = {-1, -1};
+
+void onDumpSignal(int) {
+    int savedErrno = errno;
+    char c = 0;
+    (void)!write(sSignalPipe[1], &c, 1);
+    errno = savedErrno;
+}
+
+} // namespace
+
+std::atomic<bool> gTraceFlightRecorderEnabled(
+    readConfig("debug.aemu.trace.flightrecorder",
+               "DEBUG_AEMU_TRACE_FLIGHTRECORDER", 0) != 0);
+
+void setTraceFlightRecorderEnabled(bool enabled) {
+    gTraceFlightRecorderEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+void traceFlightRecorderRecord(const char* name,
+                               TraceEventPhase phase,
+                               uint64_t payload) {
+    ThreadRing* ring = currentRing();
+    uint64_t index = ring->head.load(std::memory_order_relaxed);
+    Event& event = ring->events[index % kTraceFlightRecorderEventsPerThread];
+    event.timestampNs.store(nowNs(), std::memory_order_relaxed);
+    event.name.store(name, std::memory_order_relaxed);
+    event.payload.store(payload, std::memory_order_relaxed);
+    event.phase.store(static_cast<uint32_t>(phase), std::memory_order_relaxed);
+    ring->head.store(index + 1, std::memory_order_release);
+}
+
+bool dumpTraceFlightRecorder(const char* path, uint32_t windowMs) {
+    static const uint32_t sDefaultWindowMs = static_cast<uint32_t>(
+        readConfig("debug.aemu.trace.flightrecorder.window_ms",
+                   "DEBUG_AEMU_TRACE_FLIGHTRECORDER_WINDOW_MS", kDefaultWindowMs));
+    if (!windowMs) windowMs = sDefaultWindowMs;
+
+    const uint64_t now = nowNs();
+    const uint64_t windowNs = uint64_t(windowMs) * 1000000ULL;
+    const uint64_t cutoffNs = now > windowNs ? now - windowNs : 0;
+    const uint32_t pid = static_cast<uint32_t>(getpid());
+
+    std::string out = "{\"traceEvents\":[";
+    bool first = true;
+    char buf[128];
+
+    for (ThreadRing* ring : sRegistry()->snapshot()) {
+        const uint64_t head = ring->head.load(std::memory_order_acquire);
+        const uint64_t firstValid = ring->firstValid.load(std::memory_order_relaxed);
+        const uint32_t tid = ring->tid.load(std::memory_order_relaxed);
+        // The oldest slot of a full ring is the next one its thread
+        // overwrites, so it is never safe to read.
+        uint64_t begin = head >= kTraceFlightRecorderEventsPerThread
+                             ? head - kTraceFlightRecorderEventsPerThread + 1
+                             : 0;
+        if (begin < firstValid) begin = firstValid;
+
+        for (uint64_t i = begin; i < head; ++i) {
+            const Event& event = ring->events[i % kTraceFlightRecorderEventsPerThread];
+            const uint64_t ts = event.timestampNs.load(std::memory_order_relaxed);
+            const char* name = event.name.load(std::memory_order_relaxed);
+            const uint64_t payload = event.payload.load(std::memory_order_relaxed);
+            const uint32_t phase = event.phase.load(std::memory_order_relaxed);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            // The owner may have lapped us while we were reading; anything
+            // at or below the new tail may be torn.
+            const uint64_t newHead = ring->head.load(std::memory_order_relaxed);
+            if (i + kTraceFlightRecorderEventsPerThread <= newHead) continue;
+            if (ts < cutoffNs || !name) continue;
+
+            const char* ph = phase == static_cast<uint32_t>(TraceEventPhase::Begin) ? "B"
+                           : phase == static_cast<uint32_t>(TraceEventPhase::End) ? "E"
+                           : "i";
+
+            if (!first) out.push_back(',');
+            first = false;
+            out.append("{\"name\":");
+            appendJsonString(&out, name);
+            snprintf(buf, sizeof(buf),
+                     ",\"cat\":\"gfx\",\"ph\":\"%s\",\"ts\":%llu.%03llu,\"pid\":%u,\"tid\":%u",
+                     ph, (unsigned long long)(ts / 1000), (unsigned long long)(ts % 1000),
+                     pid, tid);
+            out.append(buf);
+            if (phase == static_cast<uint32_t>(TraceEventPhase::Instant)) {
+                out.append(",\"s\":\"t\"");
+            }
+            if (payload) {
+                snprintf(buf, sizeof(buf), ",\"args\":{\"bytes\":%llu}",
+                         (unsigned long long)payload);
+                out.append(buf);
+            }
+            out.push_back('}');
+        }
+    }
+    out.append("],\"displayTimeUnit\":\"ms\"}\n");
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    bool ok = writeAll(fd, out);
+    close(fd);
+    return ok;
+}
+
+bool installTraceFlightRecorderSignalHandler(int signo, const char* directory) {
+    if (sSignalPipe[0] != -1) return false;
+    if (pipe(sSignalPipe)) return false;
+    fcntl(sSignalPipe[0], F_SETFD, FD_CLOEXEC);
+    fcntl(sSignalPipe[1], F_SETFD, FD_CLOEXEC);
+    fcntl(sSignalPipe[1], F_SETFL, O_NONBLOCK);
+
+    std::string dir = directory;
+    std::thread([dir] {
+        uint32_t dumpCount = 0;
+        char c;
+        while (true) {
+            ssize_t n = read(sSignalPipe[0], &c, 1);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return;
+            char path[512];
+            snprintf(path, sizeof(path), "%s/aemu-trace-%d-%u.json",
+                     dir.c_str(), getpid(), dumpCount++);
+            dumpTraceFlightRecorder(path);
+        }
+    }).detach();
+
+    struct sigaction action = {};
+    action.sa_handler = onDumpSignal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    return sigaction(signo, &action, nullptr) == 0;
+}
+
+namespace {
+
+// Opt-in automatic signal hookup so a dump can be pulled from a running
+// process without code changes, e.g. "kill -USR2 <pid>".
+struct AutoSignalInstaller {
+    AutoSignalInstaller() {
+        int signo = static_cast<int>(
+            readConfig("debug.aemu.trace.flightrecorder.signal",
+                       "DEBUG_AEMU_TRACE_FLIGHTRECORDER_SIGNAL", 0));
+        if (!signo) return;
+#ifdef __ANDROID__
+        installTraceFlightRecorderSignalHandler(signo, "/data/local/tmp");
+#else
+        installTraceFlightRecorderSignalHandler(signo, "/tmp");
+#endif
+    }
+};
+
+AutoSignalInstaller sAutoSignalInstaller;
+
+} // namespace
+
+} // namespace base
+} // namespace android
@@ -0,0 +1,77 @@
+// Copyright (C) 2022 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+// In-process flight recorder for guest trace events.
+//
+// When enabled, every scoped trace is appended to a fixed-size ring owned by
+// the calling thread, whether or not atrace/perfetto is collecting. Appending
+// is a handful of relaxed stores with no locks. On request, the most recent
+// events of all threads are written out in the Chrome JSON trace format,
+// which the perfetto UI and trace_processor load directly.
+//
+// Recording is off by default; a disabled recorder costs one relaxed load per
+// scoped trace.
+//
+// Runtime configuration (Android properties; environment variables of the
+// same name in upper case with '.' replaced by '_' elsewhere):
+//   debug.aemu.trace.flightrecorder            1 enables recording.
+//   debug.aemu.trace.flightrecorder.window_ms  default dump window.
+//   debug.aemu.trace.flightrecorder.signal     if set, a signal number that
+//                                              dumps to /data/local/tmp (or
+//                                              /tmp off Android).
+
+namespace android {
+namespace base {
+
+enum class TraceEventPhase : uint32_t {
+    Begin = 0,
+    End = 1,
+    Instant = 2,
+};
+
+// Size of each thread's ring. A dump includes at most this many events minus
+// one per thread, since the oldest slot of a full ring may be mid-rewrite.
+static constexpr uint32_t kTraceFlightRecorderEventsPerThread = 4096;
+
+extern std::atomic<bool> gTraceFlightRecorderEnabled;
+
+inline bool isTraceFlightRecorderEnabled() {
+    return gTraceFlightRecorderEnabled.load(std::memory_order_relaxed);
+}
+
+void setTraceFlightRecorderEnabled(bool enabled);
+
+// Appends an event to the calling thread's ring. |name| must outlive the
+// recorder; in practice it is always a string literal. |payload| is free-form
+// (typically a byte count) and is omitted from the dump when zero.
+void traceFlightRecorderRecord(const char* name,
+                               TraceEventPhase phase,
+                               uint64_t payload = 0);
+
+// Writes events newer than |windowMs| milliseconds to |path|. A |windowMs| of
+// zero uses the configured default window. Returns false if the file could
+// not be written.
+bool dumpTraceFlightRecorder(const char* path, uint32_t windowMs = 0);
+
+// Dumps to |directory|/aemu-trace-<pid>-<n>.json each time |signo| is
+// delivered to the process. The dump itself runs on a helper thread; the
+// signal handler only wakes it up. Only one signal may be installed.
+bool installTraceFlightRecorderSignalHandler(int signo, const char* directory);
+
+} // namespace base
+} // namespace android
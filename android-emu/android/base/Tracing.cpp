@@ -14,8 +14,13 @@
 // limitations under the License.
 #include "android/base/Tracing.h"
 
+#include "android/base/TraceFlightRecorder.h"
+
+#include <stdlib.h>
+
 #if defined(__ANDROID__) || defined(HOST_BUILD)
 
+#include <cutils/properties.h>
 #include <cutils/trace.h>
 #define TRACE_TAG ATRACE_TAG_GRAPHICS
 
@@ -30,6 +35,31 @@
 namespace android {
 namespace base {
 
+static uint32_t readInitialTraceCategoryMask() {
+#if defined(__ANDROID__) || defined(HOST_BUILD)
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("debug.aemu.trace.categories", value, "") > 0) {
+        return static_cast<uint32_t>(strtoul(value, nullptr, 0));
+    }
+#else
+    const char* value = getenv("AEMU_TRACE_CATEGORIES");
+    if (value && *value) {
+        return static_cast<uint32_t>(strtoul(value, nullptr, 0));
+    }
+#endif
+    return ~0u;
+}
+
+std::atomic<uint32_t> gTraceCategoryMask(readInitialTraceCategoryMask());
+
+void setTraceCategoryMask(uint32_t mask) {
+    gTraceCategoryMask.store(mask, std::memory_order_relaxed);
+}
+
+uint32_t getTraceCategoryMask() {
+    return gTraceCategoryMask.load(std::memory_order_relaxed);
+}
+
 bool isTracingEnabled() {
 #if defined(__ANDROID__) || defined(HOST_BUILD)
     return atrace_is_tag_enabled(TRACE_TAG);
@@ -40,6 +70,13 @@ bool isTracingEnabled() {
 }
 
 void ScopedTraceGuest::beginTraceImpl(const char* name) {
+    beginTraceImpl(name, 0);
+}
+
+void ScopedTraceGuest::beginTraceImpl(const char* name, uint64_t payload) {
+    if (isTraceFlightRecorderEnabled()) {
+        traceFlightRecorderRecord(name, TraceEventPhase::Begin, payload);
+    }
 #if defined(__ANDROID__) || defined(HOST_BUILD)
     atrace_begin(TRACE_TAG, name);
 #elif defined(__Fuchsia__) && !defined(FUCHSIA_NO_TRACE)
@@ -50,6 +87,9 @@ void ScopedTraceGuest::beginTraceImpl(const char* name) {
 }
 
 void ScopedTraceGuest::endTraceImpl(const char* name) {
+    if (isTraceFlightRecorderEnabled()) {
+        traceFlightRecorderRecord(name, TraceEventPhase::End);
+    }
 #if defined(__ANDROID__) || defined(HOST_BUILD)
     atrace_end(TRACE_TAG);
 #elif defined(__Fuchsia__) && !defined(FUCHSIA_NO_TRACE)
@@ -17,6 +17,26 @@
 // Library to perform tracing. Talks to platform-specific
 // tracing libraries.
 
+#include <atomic>
+#include <optional>
+#include <stdint.h>
+
+// Bitmask of the trace categories that are compiled in. Categories whose bit
+// is clear here are stripped at compile time: their scoped traces fold away
+// to nothing. Override from the build, e.g.
+// -DAEMU_TRACE_COMPILED_CATEGORIES=0 to remove all guest tracing.
+#ifndef AEMU_TRACE_COMPILED_CATEGORIES
+#define AEMU_TRACE_COMPILED_CATEGORIES 0xffffffffu
+#endif
+
+// Category of the uncategorized AEMU_SCOPED_TRACE calls that generated code
+// makes. A module sets it from its build, e.g. the Vulkan encoder with
+// -DAEMU_TRACE_DEFAULT_CATEGORY=Vulkan, so that its generated entry points
+// are filtered with the rest of the module.
+#ifndef AEMU_TRACE_DEFAULT_CATEGORY
+#define AEMU_TRACE_DEFAULT_CATEGORY Encode
+#endif
+
 namespace android {
 namespace base {
 
@@ -44,6 +64,37 @@ public:
 
 bool isTracingEnabled();
 
+enum class TraceCategory : uint32_t {
+    Encode = 0,
+    Transport = 1,
+    Sync = 2,
+    Vulkan = 3,
+    Gralloc = 4,
+};
+
+constexpr uint32_t traceCategoryBit(TraceCategory category) {
+    return 1u << static_cast<uint32_t>(category);
+}
+
+constexpr bool isTraceCategoryCompiled(TraceCategory category) {
+    return (AEMU_TRACE_COMPILED_CATEGORIES & traceCategoryBit(category)) != 0;
+}
+
+// Runtime mask of enabled categories. Initialized from the
+// debug.aemu.trace.categories property (Android) or the
+// AEMU_TRACE_CATEGORIES environment variable (elsewhere), as a hex or
+// decimal bitmask; all categories are enabled when unset.
+extern std::atomic<uint32_t> gTraceCategoryMask;
+
+void setTraceCategoryMask(uint32_t mask);
+uint32_t getTraceCategoryMask();
+
+inline bool isTraceCategoryEnabled(TraceCategory category) {
+    return isTraceCategoryCompiled(category) &&
+           (gTraceCategoryMask.load(std::memory_order_relaxed) &
+            traceCategoryBit(category));
+}
+
 class ScopedTraceGuest {
 public:
     ScopedTraceGuest(const char* name) : name_(name) {
@@ -53,13 +104,52 @@ public:
     ~ScopedTraceGuest() {
         endTraceImpl(name_);
     }
+
+    static void beginTraceImpl(const char* name);
+    // |payload| is kept by the flight recorder only (see TraceFlightRecorder.h).
+    static void beginTraceImpl(const char* name, uint64_t payload);
+    static void endTraceImpl(const char* name);
+
 private:
-    void beginTraceImpl(const char* name);
-    void endTraceImpl(const char* name);
+    const char* const name_;
+};
 
+// Category-filtered variant of ScopedTraceGuest. The enabled check is a
+// single relaxed load, and compiled-out categories reduce to nothing.
+template <TraceCategory category>
+class ScopedTraceGuestCategory {
+public:
+    ScopedTraceGuestCategory(const char* name, uint64_t payload = 0)
+        : name_(isTraceCategoryEnabled(category) ? name : nullptr) {
+        if (isTraceCategoryCompiled(category) && name_) {
+            ScopedTraceGuest::beginTraceImpl(name_, payload);
+        }
+    }
+
+    ~ScopedTraceGuestCategory() {
+        if (isTraceCategoryCompiled(category) && name_) {
+            ScopedTraceGuest::endTraceImpl(name_);
+        }
+    }
+
+private:
     const char* const name_;
 };
 
+#ifdef HOST_BUILD
+// The host's ScopedTrace, constructed only while |category| is enabled.
+template <TraceCategory category>
+class ScopedTraceCategory {
+public:
+    ScopedTraceCategory(const char* name) {
+        if (isTraceCategoryEnabled(category)) trace_.emplace(name);
+    }
+
+private:
+    std::optional<ScopedTrace> trace_;
+};
+#endif
+
 } // namespace base
 } // namespace android
 
@@ -67,8 +157,28 @@ private:
 #define __AEMU_GENSYM1(x,y) __AEMU_GENSYM2(x,y)
 #define AEMU_GENSYM(x) __AEMU_GENSYM1(x,__COUNTER__)
 
+// |category| is one of the TraceCategory enumerators, e.g.
+// AEMU_SCOPED_TRACE_CATEGORY(Transport, "writeFully").
 #ifdef HOST_BUILD
-#define AEMU_SCOPED_TRACE(tag) __attribute__ ((unused)) android::base::ScopedTrace AEMU_GENSYM(aemuScopedTrace_)(tag)
+#define AEMU_SCOPED_TRACE_CATEGORY(category, tag) \
+    __attribute__ ((unused)) \
+    android::base::ScopedTraceCategory<android::base::TraceCategory::category> \
+    AEMU_GENSYM(aemuScopedTrace_)(tag)
+// The host's tracer has no payloads.
+#define AEMU_SCOPED_TRACE_PAYLOAD(category, tag, payload) \
+    AEMU_SCOPED_TRACE_CATEGORY(category, tag)
 #else
-#define AEMU_SCOPED_TRACE(tag) __attribute__ ((unused)) android::base::ScopedTraceGuest AEMU_GENSYM(aemuScopedTrace_)(tag)
+#define AEMU_SCOPED_TRACE_CATEGORY(category, tag) \
+    __attribute__ ((unused)) \
+    android::base::ScopedTraceGuestCategory<android::base::TraceCategory::category> \
+    AEMU_GENSYM(aemuScopedTrace_)(tag)
+// Same, also attaching |payload| (e.g. a byte count) to the begin event.
+#define AEMU_SCOPED_TRACE_PAYLOAD(category, tag, payload) \
+    __attribute__ ((unused)) \
+    android::base::ScopedTraceGuestCategory<android::base::TraceCategory::category> \
+    AEMU_GENSYM(aemuScopedTrace_)(tag, payload)
 #endif
+
+// Uncategorized traces come from generated code; see
+// AEMU_TRACE_DEFAULT_CATEGORY.
+#define AEMU_SCOPED_TRACE(tag) AEMU_SCOPED_TRACE_CATEGORY(AEMU_TRACE_DEFAULT_CATEGORY, tag)
@@ -0,0 +1,123 @@
+// Copyright (C) 2022 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include "android/base/Compiler.h"
+#include "android/base/synchronization/AndroidLock.h"
+
+#include <functional>
+#include <unordered_map>
+#include <utility>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+namespace base {
+
+// ShardedMap: a thread-safe hash map split into |shardCount| independently
+// locked std::unordered_maps, for tables that many threads insert into and
+// erase from concurrently (e.g. the Vulkan handles of a multithreaded app).
+// Threads touching different keys usually take different locks.
+//
+// Values are never handed out by pointer or reference: a lookup runs a
+// callback on the value while its shard is locked, so a concurrent erase
+// cannot free it underneath the caller. Callbacks must not reenter the map.
+template <class Key, class T, size_t shardCount = 16>
+class ShardedMap {
+public:
+    static_assert(shardCount && !(shardCount & (shardCount - 1)),
+                  "shardCount must be a power of two");
+
+    ShardedMap() = default;
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(ShardedMap);
+
+    // Replaces any existing value.
+    void set(const Key& key, T value = T()) {
+        Shard& shard = shardFor(key);
+        guest::AutoLock<guest::Lock> lock(shard.lock);
+        shard.map[key] = std::move(value);
+    }
+
+    // Default-constructs the value if absent, then calls func(T&).
+    template <class Func>
+    void update(const Key& key, Func&& func) {
+        Shard& shard = shardFor(key);
+        guest::AutoLock<guest::Lock> lock(shard.lock);
+        func(shard.map[key]);
+    }
+
+    // Calls func(T&) if |key| is present. Returns whether it was.
+    template <class Func>
+    bool find(const Key& key, Func&& func) {
+        Shard& shard = shardFor(key);
+        guest::AutoLock<guest::Lock> lock(shard.lock);
+        auto it = shard.map.find(key);
+        if (it == shard.map.end()) return false;
+        func(it->second);
+        return true;
+    }
+
+    bool contains(const Key& key) {
+        Shard& shard = shardFor(key);
+        guest::AutoLock<guest::Lock> lock(shard.lock);
+        return shard.map.count(key) != 0;
+    }
+
+    size_t erase(const Key& key) {
+        Shard& shard = shardFor(key);
+        guest::AutoLock<guest::Lock> lock(shard.lock);
+        return shard.map.erase(key);
+    }
+
+    // Not a snapshot: shards are counted one at a time.
+    size_t size() {
+        size_t total = 0;
+        for (auto& shard : mShards) {
+            guest::AutoLock<guest::Lock> lock(shard.lock);
+            total += shard.map.size();
+        }
+        return total;
+    }
+
+    void clear() {
+        for (auto& shard : mShards) {
+            guest::AutoLock<guest::Lock> lock(shard.lock);
+            shard.map.clear();
+        }
+    }
+
+private:
+    // Cache-line aligned so neighboring shards' locks do not false-share.
+    struct alignas(64) Shard {
+        guest::Lock lock;
+        std::unordered_map<Key, T> map;
+    };
+
+    // Handles are mostly aligned pointers; a Fibonacci multiply spreads the
+    // high-entropy middle bits into the top bits used as the shard index.
+    static size_t shardIndex(const Key& key) {
+        uint64_t h = (uint64_t)std::hash<Key>()(key);
+        h *= 0x9E3779B97F4A7C15ULL;
+        return (size_t)(h >> 32) & (shardCount - 1);
+    }
+
+    Shard& shardFor(const Key& key) { return mShards[shardIndex(key)]; }
+
+    Shard mShards[shardCount];
+};
+
+} // namespace base
+} // namespace android
@@ -0,0 +1,238 @@
+// Copyright (C) 2022 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include "android/base/Compiler.h"
+
+#include <map>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include <inttypes.h>
+#include <stddef.h>
+
+namespace android {
+namespace base {
+
+// SlotTable: a map from small integer keys (GL object names and the like) to
+// values, stored in fixed-size pages indexed directly by key.
+//
+// Lookup of a key below |maxDenseKey| is a bounds check plus two loads; larger
+// keys spill over into a std::map. Pages are allocated on first insert into
+// their key range and are never moved, so pointers to values stay valid until
+// the value is erased (unlike HybridComponentManager, whose backing vector
+// reallocates).
+//
+// Every slot carries a generation counter that is bumped on both insert and
+// erase; odd generations are live. handleOf() packs key and generation so a
+// holder can later detect that the name was deleted and reused.
+//
+// Iteration visits keys in ascending order, same as std::map.
+template <class Key,
+          class T,
+          size_t pageBits = 6,
+          size_t maxDenseKey = (1 << 20)>
+class SlotTable {
+public:
+    using Handle = uint64_t;
+
+    static constexpr size_t kPageSize = 1 << pageBits;
+    static constexpr size_t kPageMask = kPageSize - 1;
+
+    SlotTable() = default;
+    ~SlotTable() { clear(); }
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(SlotTable);
+
+    T* get(Key key) {
+        uint64_t k = (uint64_t)key;
+        if (k < maxDenseKey) {
+            Slot* slot = denseSlot(k);
+            return (slot && slot->live()) ? slot->value() : nullptr;
+        }
+        auto it = mSparse.find(key);
+        return it == mSparse.end() ? nullptr : &it->second;
+    }
+
+    const T* get_const(Key key) const {
+        return const_cast<SlotTable*>(this)->get(key);
+    }
+
+    bool contains(Key key) const { return get_const(key) != nullptr; }
+
+    // Returns the value for |key| only if it is the same incarnation that
+    // |handle| was taken from.
+    T* getByHandle(Handle handle) {
+        Key key = (Key)(handle & 0xffffffffULL);
+        if (generation(key) != (uint32_t)(handle >> 32)) return nullptr;
+        return get(key);
+    }
+
+    Handle handleOf(Key key) const {
+        return ((uint64_t)generation(key) << 32) | ((uint64_t)key & 0xffffffffULL);
+    }
+
+    // Spilled keys have no slot and always report generation 1 while live.
+    uint32_t generation(Key key) const {
+        uint64_t k = (uint64_t)key;
+        if (k < maxDenseKey) {
+            const Slot* slot = const_cast<SlotTable*>(this)->denseSlot(k);
+            return slot ? slot->generation : 0;
+        }
+        return mSparse.count(key) ? 1 : 0;
+    }
+
+    // Replaces any existing value.
+    template <class... Args>
+    T& emplace(Key key, Args&&... args) {
+        uint64_t k = (uint64_t)key;
+        if (k < maxDenseKey) {
+            Slot* slot = allocDenseSlot(k);
+            const bool wasLive = slot->live();
+            if (wasLive) {
+                slot->value()->~T();
+            } else {
+                ++mSize;
+            }
+            new (slot->storage) T(std::forward<Args>(args)...);
+            slot->generation += wasLive ? 2 : 1;
+            return *slot->value();
+        }
+        auto it = mSparse.find(key);
+        if (it != mSparse.end()) {
+            it->second = T(std::forward<Args>(args)...);
+            return it->second;
+        }
+        ++mSize;
+        return mSparse.emplace(key, T(std::forward<Args>(args)...)).first->second;
+    }
+
+    // Default-constructs the value if absent, like std::map::operator[].
+    T& operator[](Key key) {
+        if (T* existing = get(key)) return *existing;
+        return emplace(key);
+    }
+
+    size_t erase(Key key) {
+        uint64_t k = (uint64_t)key;
+        if (k < maxDenseKey) {
+            Slot* slot = denseSlot(k);
+            if (!slot || !slot->live()) return 0;
+            slot->value()->~T();
+            ++slot->generation;
+            --mSize;
+            return 1;
+        }
+        size_t erased = mSparse.erase(key);
+        mSize -= erased;
+        return erased;
+    }
+
+    // Keeps allocated pages around; they are cheap and names get reused.
+    void clear() {
+        for (auto& page : mPages) {
+            if (!page) continue;
+            for (auto& slot : page->slots) {
+                if (slot.live()) {
+                    slot.value()->~T();
+                    ++slot.generation;
+                }
+            }
+        }
+        mSparse.clear();
+        mSize = 0;
+    }
+
+    size_t size() const { return mSize; }
+    bool empty() const { return mSize == 0; }
+
+    // |func| is called as func(Key, T&) for every live entry.
+    template <class Func>
+    void forEach(Func&& func) {
+        for (size_t p = 0; p < mPages.size(); ++p) {
+            Page* page = mPages[p].get();
+            if (!page) continue;
+            for (size_t i = 0; i < kPageSize; ++i) {
+                Slot& slot = page->slots[i];
+                if (slot.live()) func((Key)((p << pageBits) | i), *slot.value());
+            }
+        }
+        for (auto& it : mSparse) {
+            func(it.first, it.second);
+        }
+    }
+
+    // Returns the first value, in key order, for which pred(Key, const T&)
+    // holds, or nullptr.
+    template <class Pred>
+    T* findIf(Pred&& pred) {
+        for (size_t p = 0; p < mPages.size(); ++p) {
+            Page* page = mPages[p].get();
+            if (!page) continue;
+            for (size_t i = 0; i < kPageSize; ++i) {
+                Slot& slot = page->slots[i];
+                if (slot.live() &&
+                    pred((Key)((p << pageBits) | i), (const T&)*slot.value())) {
+                    return slot.value();
+                }
+            }
+        }
+        for (auto& it : mSparse) {
+            if (pred(it.first, (const T&)it.second)) return &it.second;
+        }
+        return nullptr;
+    }
+
+    template <class Func>
+    void forEach_const(Func&& func) const {
+        const_cast<SlotTable*>(this)->forEach(
+            [&func](Key key, T& value) { func(key, (const T&)value); });
+    }
+
+private:
+    struct Slot {
+        uint32_t generation = 0;
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        bool live() const { return generation & 1; }
+        T* value() { return reinterpret_cast<T*>(storage); }
+    };
+
+    struct Page {
+        Slot slots[kPageSize];
+    };
+
+    Slot* denseSlot(uint64_t k) {
+        size_t pageIndex = (size_t)(k >> pageBits);
+        if (pageIndex >= mPages.size()) return nullptr;
+        Page* page = mPages[pageIndex].get();
+        return page ? &page->slots[k & kPageMask] : nullptr;
+    }
+
+    Slot* allocDenseSlot(uint64_t k) {
+        size_t pageIndex = (size_t)(k >> pageBits);
+        if (pageIndex >= mPages.size()) mPages.resize(pageIndex + 1);
+        if (!mPages[pageIndex]) mPages[pageIndex].reset(new Page);
+        return &mPages[pageIndex]->slots[k & kPageMask];
+    }
+
+    std::vector<std::unique_ptr<Page>> mPages;
+    std::map<Key, T> mSparse;
+    size_t mSize = 0;
+};
+
+} // namespace base
+} // namespace android
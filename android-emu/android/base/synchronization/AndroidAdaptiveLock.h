@@ -0,0 +1,206 @@
+// Copyright (C) 2022 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include "android/base/Compiler.h"
+
+#include <atomic>
+#include <thread>
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__Fuchsia__)
+#include <zircon/syscalls.h>
+#elif defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace android {
+namespace base {
+namespace guest {
+
+// A non-recursive mutex for short critical sections that are usually
+// uncontended, such as encoding one command into a stream.
+//
+// An uncontended lock()/unlock() pair is one compare-and-swap and one
+// exchange. A contended lock() spins for a bounded number of iterations with
+// a CPU relax hint, then sleeps on a futex until the holder wakes it, so
+// waiters stop burning cores that the holder may need on an oversubscribed
+// VM. The spin-only and sleep-only behaviors are kept for comparison.
+//
+// Contention counters are updated only by the lock holder and are cheap
+// enough to leave on.
+class AdaptiveLock {
+public:
+    enum class Mode {
+        Adaptive,  // Spin up to the spin limit, then sleep.
+        Spin,      // Spin forever; the behavior of a plain spinlock.
+        Sleep,     // Sleep as soon as the lock is found taken.
+    };
+
+    static constexpr uint32_t kDefaultSpinLimit = 128;
+
+    struct Stats {
+        uint64_t acquisitions;  // successful lock() and tryLock() calls
+        uint64_t contended;     // lock() calls that found the lock taken
+        uint64_t spinAcquired;  // contended calls that got it while spinning
+        uint64_t sleeps;        // futex waits
+    };
+
+    AdaptiveLock() = default;
+    explicit AdaptiveLock(Mode mode, uint32_t spinLimit = kDefaultSpinLimit)
+        : mMode(mode), mSpinLimit(spinLimit) {}
+
+    // Parses "adaptive", "spin" or "sleep"; anything else is Adaptive.
+    static Mode modeFromString(const char* str) {
+        if (str && !strcmp(str, "spin")) return Mode::Spin;
+        if (str && !strcmp(str, "sleep")) return Mode::Sleep;
+        return Mode::Adaptive;
+    }
+
+    Mode mode() const { return mMode; }
+
+    void lock() {
+        uint32_t state = kUnlocked;
+        if (!mState.compare_exchange_strong(state, kLocked,
+                                            std::memory_order_acquire,
+                                            std::memory_order_relaxed)) {
+            lockSlow();
+        }
+        bump(mAcquisitions);
+    }
+
+    bool tryLock() {
+        uint32_t state = kUnlocked;
+        if (!mState.compare_exchange_strong(state, kLocked,
+                                            std::memory_order_acquire,
+                                            std::memory_order_relaxed)) {
+            return false;
+        }
+        bump(mAcquisitions);
+        return true;
+    }
+
+    void unlock() {
+        if (mState.exchange(kUnlocked, std::memory_order_release) == kLockedWithWaiters) {
+            futexWake();
+        }
+    }
+
+    // May be called from any thread; the values are approximate while the
+    // lock is in use.
+    Stats stats() const {
+        return {
+            mAcquisitions.load(std::memory_order_relaxed),
+            mContended.load(std::memory_order_relaxed),
+            mSpinAcquired.load(std::memory_order_relaxed),
+            mSleeps.load(std::memory_order_relaxed),
+        };
+    }
+
+private:
+    enum : uint32_t {
+        kUnlocked = 0,
+        kLocked = 1,
+        kLockedWithWaiters = 2,
+    };
+
+    static void cpuRelax() {
+#if defined(__i386__) || defined(__x86_64__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+        asm volatile("yield" ::: "memory");
+#endif
+    }
+
+    // Only the lock holder writes the counters, so no read-modify-write.
+    static void bump(std::atomic<uint64_t>& counter) {
+        counter.store(counter.load(std::memory_order_relaxed) + 1,
+                      std::memory_order_relaxed);
+    }
+
+    void lockSlow() {
+        uint64_t sleeps = 0;
+        bool spun = false;
+
+        if (mMode != Mode::Sleep) {
+            for (uint32_t i = 0; mMode == Mode::Spin || i < mSpinLimit; ++i) {
+                cpuRelax();
+                uint32_t state = mState.load(std::memory_order_relaxed);
+                if (state == kUnlocked &&
+                    mState.compare_exchange_weak(state, kLocked,
+                                                 std::memory_order_acquire,
+                                                 std::memory_order_relaxed)) {
+                    spun = true;
+                    break;
+                }
+            }
+        }
+
+        if (!spun) {
+            // Mark the lock as having waiters so that unlock() wakes us.
+            while (mState.exchange(kLockedWithWaiters, std::memory_order_acquire) !=
+                   kUnlocked) {
+                futexWait(kLockedWithWaiters);
+                ++sleeps;
+            }
+        }
+
+        bump(mContended);
+        if (spun) bump(mSpinAcquired);
+        mSleeps.store(mSleeps.load(std::memory_order_relaxed) + sleeps,
+                      std::memory_order_relaxed);
+    }
+
+    void futexWait(uint32_t expected) {
+#if defined(__Fuchsia__)
+        zx_futex_wait(reinterpret_cast<const zx_futex_t*>(&mState), expected,
+                      ZX_HANDLE_INVALID, ZX_TIME_INFINITE);
+#elif defined(__linux__)
+        syscall(__NR_futex, &mState, FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+#else
+        (void)expected;
+        std::this_thread::yield();
+#endif
+    }
+
+    void futexWake() {
+#if defined(__Fuchsia__)
+        zx_futex_wake(reinterpret_cast<const zx_futex_t*>(&mState), 1);
+#elif defined(__linux__)
+        syscall(__NR_futex, &mState, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#endif
+    }
+
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+                  "futex word must be a plain 32-bit integer");
+
+    std::atomic<uint32_t> mState{kUnlocked};
+    const Mode mMode = Mode::Adaptive;
+    const uint32_t mSpinLimit = kDefaultSpinLimit;
+
+    std::atomic<uint64_t> mAcquisitions{0};
+    std::atomic<uint64_t> mContended{0};
+    std::atomic<uint64_t> mSpinAcquired{0};
+    std::atomic<uint64_t> mSleeps{0};
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(AdaptiveLock);
+};
+
+}  // namespace guest
+}  // namespace base
+}  // namespace android
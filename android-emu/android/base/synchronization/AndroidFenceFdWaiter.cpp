@@ -0,0 +1,202 @@
+// Copyright (C) 2022 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "android/base/synchronization/AndroidFenceFdWaiter.h"
+
+#include "android/base/synchronization/AndroidConditionVariable.h"
+
+#include <vector>
+
+#include <log/log.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace android {
+namespace base {
+namespace guest {
+
+namespace {
+
+uint64_t nowNs(clockid_t clock) {
+    timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Anything but "not yet" ends the wait, including POLLERR and POLLNVAL.
+bool pollSignaled(short revents) {
+    return revents != 0;
+}
+
+}  // namespace
+
+struct FenceFdWaiter::Waiter {
+    uint64_t id;
+    std::vector<int> fds;
+    std::vector<bool> signaled;
+    size_t remaining;
+    bool waitAll;
+    bool done = false;
+    uint64_t doneNs = 0;
+    ConditionVariable cv;
+};
+
+// static
+FenceFdWaiter* FenceFdWaiter::get() {
+    static FenceFdWaiter* sWaiter = new FenceFdWaiter;
+    return sWaiter;
+}
+
+FenceFdWaiter::FenceFdWaiter() : mThread([this] { run(); }) {
+    if (pipe(mWakeFds)) {
+        ALOGE("%s: cannot create wake pipe: %d", __func__, errno);
+        abort();
+    }
+    fcntl(mWakeFds[0], F_SETFL, O_NONBLOCK);
+    fcntl(mWakeFds[1], F_SETFL, O_NONBLOCK);
+}
+
+bool FenceFdWaiter::wait(const int* fds, size_t count, bool waitAll, uint64_t timeoutNs) {
+    Waiter waiter;
+    waiter.waitAll = waitAll;
+
+    // Check without the thread first; most fences waited on have already
+    // signaled.
+    std::vector<pollfd> pfds;
+    for (size_t i = 0; i < count; ++i) {
+        if (fds[i] >= 0) pfds.push_back({ fds[i], POLLIN, 0 });
+    }
+    if (pfds.empty()) return true;
+    while (poll(pfds.data(), pfds.size(), 0) < 0 && errno == EINTR) {
+    }
+    for (const auto& pfd : pfds) {
+        if (pollSignaled(pfd.revents)) {
+            if (!waitAll) return true;
+        } else {
+            waiter.fds.push_back(pfd.fd);
+        }
+    }
+    if (waiter.fds.empty()) return true;
+    if (!timeoutNs) return false;
+
+    waiter.signaled.resize(waiter.fds.size(), false);
+    waiter.remaining = waiter.fds.size();
+
+    const bool forever = timeoutNs == kForever;
+    const uint64_t deadlineNs = forever ? 0 : nowNs(CLOCK_REALTIME) + timeoutNs;
+    timespec deadline;
+    deadline.tv_sec = deadlineNs / 1000000000ULL;
+    deadline.tv_nsec = deadlineNs % 1000000000ULL;
+
+    AutoLock<Lock> lock(mLock);
+    if (!mThreadStarted) {
+        mThread.start();
+        mThreadStarted = true;
+    }
+    ++mStats.waits;
+    waiter.id = mNextWaiterId++;
+    mWaiters[waiter.id] = &waiter;
+    wakeThreadLocked();
+
+    while (!waiter.done) {
+        if (forever) {
+            waiter.cv.wait(&mLock);
+        } else if (!waiter.cv.timedWait(&mLock, deadline) && !waiter.done) {
+            mWaiters.erase(waiter.id);
+            wakeThreadLocked();
+            ++mStats.timeouts;
+            return false;
+        }
+    }
+
+    uint64_t wakeupNs = nowNs(CLOCK_MONOTONIC) - waiter.doneNs;
+    mStats.totalWakeupNs += wakeupNs;
+    if (wakeupNs > mStats.maxWakeupNs) mStats.maxWakeupNs = wakeupNs;
+    return true;
+}
+
+FenceFdWaiter::Stats FenceFdWaiter::stats() {
+    AutoLock<Lock> lock(mLock);
+    return mStats;
+}
+
+void FenceFdWaiter::wakeThreadLocked() {
+    char c = 0;
+    // A full pipe already wakes the thread up.
+    while (write(mWakeFds[1], &c, 1) < 0 && errno == EINTR) {
+    }
+}
+
+void FenceFdWaiter::run() {
+    // Which waiter and which of its fds each pollfd after the first is for.
+    struct Entry {
+        uint64_t waiterId;
+        size_t index;
+    };
+    std::vector<pollfd> pfds;
+    std::vector<Entry> entries;
+
+    for (;;) {
+        pfds.clear();
+        entries.clear();
+        pfds.push_back({ mWakeFds[0], POLLIN, 0 });
+        {
+            AutoLock<Lock> lock(mLock);
+            for (const auto& it : mWaiters) {
+                const Waiter* waiter = it.second;
+                for (size_t i = 0; i < waiter->fds.size(); ++i) {
+                    if (waiter->signaled[i]) continue;
+                    pfds.push_back({ waiter->fds[i], POLLIN, 0 });
+                    entries.push_back({ it.first, i });
+                }
+            }
+        }
+
+        if (poll(pfds.data(), pfds.size(), -1) < 0) continue;
+        uint64_t now = nowNs(CLOCK_MONOTONIC);
+
+        if (pfds[0].revents) {
+            char buf[64];
+            while (read(mWakeFds[0], buf, sizeof(buf)) > 0) {
+            }
+        }
+
+        AutoLock<Lock> lock(mLock);
+        for (size_t i = 1; i < pfds.size(); ++i) {
+            if (!pollSignaled(pfds[i].revents)) continue;
+
+            // The waiter may have timed out since; ids are never reused.
+            const Entry& entry = entries[i - 1];
+            auto it = mWaiters.find(entry.waiterId);
+            if (it == mWaiters.end()) continue;
+            Waiter* waiter = it->second;
+
+            waiter->signaled[entry.index] = true;
+            if (waiter->waitAll && --waiter->remaining) continue;
+
+            waiter->done = true;
+            waiter->doneNs = now;
+            waiter->cv.signal();
+            mWaiters.erase(it);
+        }
+    }
+}
+
+}  // namespace guest
+}  // namespace base
+}  // namespace android
@@ -0,0 +1,78 @@
+// Copyright (C) 2022 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include "android/base/Compiler.h"
+#include "android/base/synchronization/AndroidLock.h"
+#include "android/base/threads/AndroidFunctorThread.h"
+
+#include <unordered_map>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+namespace base {
+namespace guest {
+
+// FenceFdWaiter waits on sync fence fds (sync_file, goldfish sync) for any
+// number of callers from a single thread that poll()s all of them, instead of
+// blocking one thread per fd in sync_wait().
+class FenceFdWaiter {
+public:
+    static constexpr uint64_t kForever = ~0ULL;
+
+    struct Stats {
+        uint64_t waits = 0;          // wait() calls that had to block.
+        uint64_t timeouts = 0;
+        // Time from the waiter thread seeing the fences signaled to the
+        // caller of wait() running again.
+        uint64_t totalWakeupNs = 0;
+        uint64_t maxWakeupNs = 0;
+    };
+
+    static FenceFdWaiter* get();
+
+    // Waits until all of |fds| (or any of them, if |waitAll| is false) have
+    // signaled, for at most |timeoutNs|. Negative fds count as signaled, and
+    // so do fds in an error state, as with sync_wait(). Returns false on
+    // timeout.
+    bool wait(const int* fds, size_t count, bool waitAll, uint64_t timeoutNs);
+
+    Stats stats();
+
+private:
+    struct Waiter;
+
+    FenceFdWaiter();
+    ~FenceFdWaiter() = delete;
+
+    void wakeThreadLocked();
+    void run();
+
+    Lock mLock;
+    std::unordered_map<uint64_t, Waiter*> mWaiters;
+    uint64_t mNextWaiterId = 0;
+    Stats mStats;
+    int mWakeFds[2] = { -1, -1 };
+    // Started by the first wait() that has to block.
+    bool mThreadStarted = false;
+    FunctorThread mThread;
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(FenceFdWaiter);
+};
+
+}  // namespace guest
+}  // namespace base
+}  // namespace android
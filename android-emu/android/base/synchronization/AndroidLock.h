@@ -208,8 +208,10 @@ public:
     constexpr ReadWriteLock() = default;
     ~ReadWriteLock() = default;
     void lockRead() { ::AcquireSRWLockShared(&mLock); }
+    bool tryLockRead() { return ::TryAcquireSRWLockShared(&mLock); }
     void unlockRead() { ::ReleaseSRWLockShared(&mLock); }
     void lockWrite() { ::AcquireSRWLockExclusive(&mLock); }
+    bool tryLockWrite() { return ::TryAcquireSRWLockExclusive(&mLock); }
     void unlockWrite() { ::ReleaseSRWLockExclusive(&mLock); }
 
 private:
@@ -218,8 +220,10 @@ private:
     ReadWriteLock() { ::pthread_rwlock_init(&mLock, NULL); }
     ~ReadWriteLock() { ::pthread_rwlock_destroy(&mLock); }
     void lockRead() { ::pthread_rwlock_rdlock(&mLock); }
+    bool tryLockRead() { return ::pthread_rwlock_tryrdlock(&mLock) == 0; }
     void unlockRead() { ::pthread_rwlock_unlock(&mLock); }
     void lockWrite() { ::pthread_rwlock_wrlock(&mLock); }
+    bool tryLockWrite() { return ::pthread_rwlock_trywrlock(&mLock) == 0; }
     void unlockWrite() { ::pthread_rwlock_unlock(&mLock); }
 
 private:
@@ -0,0 +1,719 @@
+// Copyright (C) 2022 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <gtest/gtest.h>
+
+#include "android/base/AndroidSubAllocator.h"
+#include "android/base/BumpPool.h"
+#include "android/base/TraceFlightRecorder.h"
+#include "android/base/address_space.h"
+#include "android/base/containers/ShardedMap.h"
+#include "android/base/containers/SlotTable.h"
+#include "android/base/files/MemStream.h"
+#include "android/base/synchronization/AndroidAdaptiveLock.h"
+#include "android/base/synchronization/AndroidFenceFdWaiter.h"
+
+#include <atomic>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+namespace android {
+namespace base {
+namespace guest {
+
+// Pipes stand in for fence fds: the read end polls as signaled once written.
+struct TestFence {
+    TestFence() { EXPECT_EQ(0, pipe(fds)); }
+    ~TestFence() { close(fds[0]); close(fds[1]); }
+    void signal() { EXPECT_EQ(1, write(fds[1], "x", 1)); }
+    int fd() const { return fds[0]; }
+    int fds[2];
+};
+
+TEST(FenceFdWaiter, Signaled) {
+    FenceFdWaiter* waiter = FenceFdWaiter::get();
+    TestFence a, b;
+    int fds[] = { a.fd(), -1, b.fd() };
+
+    EXPECT_TRUE(waiter->wait(fds, 0, true, 0));
+    EXPECT_FALSE(waiter->wait(fds, 3, false, 0));
+    a.signal();
+    EXPECT_TRUE(waiter->wait(fds, 3, false, 0));
+    EXPECT_FALSE(waiter->wait(fds, 3, true, 1000000));
+    b.signal();
+    EXPECT_TRUE(waiter->wait(fds, 3, true, 0));
+}
+
+TEST(FenceFdWaiter, WaitAllWaitAny) {
+    FenceFdWaiter* waiter = FenceFdWaiter::get();
+    TestFence a, b;
+    int fds[] = { a.fd(), b.fd() };
+
+    std::thread signaler([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        a.signal();
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        b.signal();
+    });
+
+    EXPECT_TRUE(waiter->wait(fds, 2, false, FenceFdWaiter::kForever));
+    EXPECT_TRUE(waiter->wait(fds, 2, true, 5000000000ULL));
+    signaler.join();
+}
+
+// Tests that many waiters on the same and on different fences, some of
+// which time out, are all woken up correctly.
+TEST(FenceFdWaiter, Concurrent) {
+    const int kFences = 16;
+    const int kThreadsPerFence = 4;
+    FenceFdWaiter* waiter = FenceFdWaiter::get();
+    FenceFdWaiter::Stats before = waiter->stats();
+    std::vector<TestFence> fences(kFences);
+    std::atomic<int> signaled { 0 };
+    std::atomic<int> timedOut { 0 };
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kFences; ++i) {
+        for (int j = 0; j < kThreadsPerFence; ++j) {
+            threads.emplace_back([&, i, j] {
+                int fd = fences[i].fd();
+                // Odd fences are never signaled.
+                uint64_t timeout = (i % 2) ? 1000000ULL * (j + 1) : FenceFdWaiter::kForever;
+                if (waiter->wait(&fd, 1, true, timeout)) {
+                    ++signaled;
+                } else {
+                    ++timedOut;
+                }
+            });
+        }
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    for (int i = 0; i < kFences; i += 2) fences[i].signal();
+    for (auto& t : threads) t.join();
+
+    EXPECT_EQ(kFences / 2 * kThreadsPerFence, signaled.load());
+    EXPECT_EQ(kFences / 2 * kThreadsPerFence, timedOut.load());
+    FenceFdWaiter::Stats after = waiter->stats();
+    EXPECT_EQ(before.timeouts + kFences / 2 * kThreadsPerFence, after.timeouts);
+}
+
+// Tests that an uncontended lock takes the fast path.
+TEST(AdaptiveLock, Uncontended) {
+    AdaptiveLock lock;
+    for (int i = 0; i < 10; ++i) {
+        lock.lock();
+        lock.unlock();
+    }
+    AdaptiveLock::Stats stats = lock.stats();
+    EXPECT_EQ(10u, stats.acquisitions);
+    EXPECT_EQ(0u, stats.contended);
+    EXPECT_EQ(0u, stats.sleeps);
+}
+
+// Tests tryLock() against a held lock.
+TEST(AdaptiveLock, TryLock) {
+    AdaptiveLock lock;
+    EXPECT_TRUE(lock.tryLock());
+    EXPECT_FALSE(lock.tryLock());
+    lock.unlock();
+    EXPECT_TRUE(lock.tryLock());
+    lock.unlock();
+    EXPECT_EQ(2u, lock.stats().acquisitions);
+}
+
+TEST(AdaptiveLock, ModeFromString) {
+    EXPECT_EQ(AdaptiveLock::Mode::Spin, AdaptiveLock::modeFromString("spin"));
+    EXPECT_EQ(AdaptiveLock::Mode::Sleep, AdaptiveLock::modeFromString("sleep"));
+    EXPECT_EQ(AdaptiveLock::Mode::Adaptive, AdaptiveLock::modeFromString("adaptive"));
+    EXPECT_EQ(AdaptiveLock::Mode::Adaptive, AdaptiveLock::modeFromString("bogus"));
+    EXPECT_EQ(AdaptiveLock::Mode::Adaptive, AdaptiveLock::modeFromString(nullptr));
+}
+
+// Tests mutual exclusion with several threads in each mode.
+static void testMutualExclusion(AdaptiveLock::Mode mode) {
+    constexpr int kThreads = 4;
+    constexpr int kIterations = 20000;
+
+    AdaptiveLock lock(mode);
+    int counter = 0;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&lock, &counter] {
+            for (int i = 0; i < kIterations; ++i) {
+                lock.lock();
+                ++counter;
+                lock.unlock();
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+
+    EXPECT_EQ(kThreads * kIterations, counter);
+
+    AdaptiveLock::Stats stats = lock.stats();
+    EXPECT_EQ((uint64_t)kThreads * kIterations, stats.acquisitions);
+    EXPECT_LE(stats.spinAcquired, stats.contended);
+    if (mode == AdaptiveLock::Mode::Spin) {
+        EXPECT_EQ(0u, stats.sleeps);
+        EXPECT_EQ(stats.contended, stats.spinAcquired);
+    }
+    if (mode == AdaptiveLock::Mode::Sleep) {
+        EXPECT_EQ(0u, stats.spinAcquired);
+    }
+}
+
+TEST(AdaptiveLock, MutualExclusionAdaptive) {
+    testMutualExclusion(AdaptiveLock::Mode::Adaptive);
+}
+
+TEST(AdaptiveLock, MutualExclusionSpin) {
+    testMutualExclusion(AdaptiveLock::Mode::Spin);
+}
+
+TEST(AdaptiveLock, MutualExclusionSleep) {
+    testMutualExclusion(AdaptiveLock::Mode::Sleep);
+}
+
+// Tests ShardedMap lookups, updates and erases.
+TEST(ShardedMap, Basic) {
+    ShardedMap<uint64_t, int> map;
+    EXPECT_FALSE(map.contains(1));
+    map.set(1, 10);
+    map.set(2);
+    EXPECT_TRUE(map.contains(1));
+    EXPECT_EQ(2u, map.size());
+
+    int value = -1;
+    EXPECT_TRUE(map.find(1, [&value](int& v) { value = v; }));
+    EXPECT_EQ(10, value);
+    EXPECT_FALSE(map.find(3, [&value](int& v) { value = v; }));
+
+    map.update(3, [](int& v) { v += 5; });
+    map.update(3, [](int& v) { v += 5; });
+    EXPECT_TRUE(map.find(3, [&value](int& v) { value = v; }));
+    EXPECT_EQ(10, value);
+
+    EXPECT_EQ(1u, map.erase(1));
+    EXPECT_EQ(0u, map.erase(1));
+    EXPECT_FALSE(map.contains(1));
+    map.clear();
+    EXPECT_EQ(0u, map.size());
+}
+
+// Tests concurrent inserts and erases of disjoint and shared keys.
+TEST(ShardedMap, Concurrent) {
+    constexpr int kThreads = 4;
+    constexpr uint64_t kKeys = 4096;
+
+    ShardedMap<uint64_t, uint64_t> map;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&map, t] {
+            for (uint64_t k = 0; k < kKeys; ++k) {
+                uint64_t key = ((uint64_t)(t + 1) << 32) | (k * 64);
+                map.set(key, k);
+                map.update(0, [](uint64_t& v) { ++v; });
+                if (k & 1) map.erase(key);
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+
+    EXPECT_EQ(kThreads * kKeys / 2 + 1, map.size());
+    uint64_t shared = 0;
+    EXPECT_TRUE(map.find(0, [&shared](uint64_t& v) { shared = v; }));
+    EXPECT_EQ(kThreads * kKeys, shared);
+}
+
+// Small pages and a low dense limit, so tests cross pages and spill.
+using SmallSlotTable = SlotTable<uint32_t, int, 2, 16>;
+
+// Tests SlotTable inserts, lookups and erases, dense and spilled.
+TEST(SlotTable, Basic) {
+    SmallSlotTable table;
+    EXPECT_TRUE(table.empty());
+    EXPECT_EQ(nullptr, table.get(3));
+    EXPECT_EQ(0u, table.erase(3));
+
+    table.emplace(3, 30);
+    table.emplace(100, 1000);
+    table[7] += 7;
+    EXPECT_EQ(3u, table.size());
+    ASSERT_NE(nullptr, table.get(3));
+    EXPECT_EQ(30, *table.get(3));
+    EXPECT_EQ(1000, *table.get(100));
+    EXPECT_EQ(7, *table.get_const(7));
+    EXPECT_TRUE(table.contains(100));
+    EXPECT_FALSE(table.contains(4));
+
+    // emplace() replaces, in both the pages and the spill map.
+    table.emplace(3, 31);
+    table.emplace(100, 1001);
+    EXPECT_EQ(3u, table.size());
+    EXPECT_EQ(31, *table.get(3));
+    EXPECT_EQ(1001, *table.get(100));
+
+    EXPECT_EQ(1u, table.erase(3));
+    EXPECT_EQ(0u, table.erase(3));
+    EXPECT_EQ(1u, table.erase(100));
+    EXPECT_EQ(nullptr, table.get(3));
+    EXPECT_EQ(nullptr, table.get(100));
+    EXPECT_EQ(1u, table.size());
+}
+
+// Tests that handles tell a reused name from the one they were taken from.
+TEST(SlotTable, Generations) {
+    SmallSlotTable table;
+    EXPECT_EQ(0u, table.generation(5));
+    table.emplace(5, 50);
+    SmallSlotTable::Handle handle = table.handleOf(5);
+    ASSERT_NE(nullptr, table.getByHandle(handle));
+    EXPECT_EQ(50, *table.getByHandle(handle));
+
+    // Replacing the value makes a new incarnation too.
+    table.emplace(5, 51);
+    EXPECT_EQ(nullptr, table.getByHandle(handle));
+    handle = table.handleOf(5);
+    EXPECT_EQ(51, *table.getByHandle(handle));
+
+    table.erase(5);
+    EXPECT_EQ(nullptr, table.getByHandle(handle));
+    EXPECT_EQ(0u, table.generation(5) & 1);
+    table.emplace(5, 52);
+    EXPECT_EQ(nullptr, table.getByHandle(handle));
+    EXPECT_EQ(52, *table.getByHandle(table.handleOf(5)));
+
+    // Spilled keys only know live or not.
+    table.emplace(40, 400);
+    handle = table.handleOf(40);
+    EXPECT_EQ(1u, table.generation(40));
+    EXPECT_EQ(400, *table.getByHandle(handle));
+    table.erase(40);
+    EXPECT_EQ(0u, table.generation(40));
+    EXPECT_EQ(nullptr, table.getByHandle(handle));
+}
+
+// Tests that iteration is in key order across pages and the spill map, and
+// that findIf() stops at the first match.
+TEST(SlotTable, Iteration) {
+    SmallSlotTable table;
+    const std::vector<uint32_t> keys = { 1, 2, 6, 13, 15, 16, 20, 1000 };
+    for (auto it = keys.rbegin(); it != keys.rend(); ++it) {
+        table.emplace(*it, (int)*it * 10);
+    }
+    table.erase(6);
+
+    std::vector<uint32_t> visited;
+    table.forEach([&visited](uint32_t key, int& value) {
+        EXPECT_EQ((int)key * 10, value);
+        visited.push_back(key);
+    });
+    EXPECT_EQ(std::vector<uint32_t>({ 1, 2, 13, 15, 16, 20, 1000 }), visited);
+
+    int* found = table.findIf([](uint32_t key, const int&) { return key > 14; });
+    ASSERT_NE(nullptr, found);
+    EXPECT_EQ(150, *found);
+    found = table.findIf([](uint32_t, const int& value) { return value > 180; });
+    ASSERT_NE(nullptr, found);
+    EXPECT_EQ(200, *found);
+    EXPECT_EQ(nullptr, table.findIf([](uint32_t, const int&) { return false; }));
+}
+
+// Tests that values are destroyed on erase, clear and destruction, that
+// pointers survive growth, and that names can be reused after clear().
+TEST(SlotTable, ClearAndReuse) {
+    auto counter = std::make_shared<int>(0);
+    {
+        SlotTable<uint32_t, std::shared_ptr<int>, 2, 16> table;
+        table.emplace(1, counter);
+        std::shared_ptr<int>* first = table.get(1);
+        for (uint32_t key = 2; key < 32; ++key) table.emplace(key, counter);
+        EXPECT_EQ(first, table.get(1));
+        EXPECT_EQ(32, counter.use_count());
+
+        table.erase(2);
+        EXPECT_EQ(31, counter.use_count());
+        uint32_t generation = table.generation(1);
+        table.clear();
+        EXPECT_EQ(1, counter.use_count());
+        EXPECT_TRUE(table.empty());
+        EXPECT_EQ(nullptr, table.get(1));
+        EXPECT_EQ(nullptr, table.get(20));
+        EXPECT_EQ(generation + 1, table.generation(1));
+
+        table.emplace(1, counter);
+        table.emplace(20, counter);
+        EXPECT_EQ(2u, table.size());
+        EXPECT_EQ(3, counter.use_count());
+    }
+    EXPECT_EQ(1, counter.use_count());
+}
+
+// Tests that a pool that outgrows its chunk keeps earlier allocations
+// valid, and serves the next generation from one chunk again.
+TEST(BumpPool, Growth) {
+    BumpPool pool(64, BumpPool::kNoHugeAllocs);
+    std::vector<uint64_t*> ptrs;
+    for (uint64_t i = 0; i < 100; ++i) {
+        uint64_t* p = (uint64_t*)pool.alloc(sizeof(uint64_t) * 3);
+        EXPECT_EQ(0u, (uintptr_t)p % sizeof(uint64_t));
+        p[0] = p[1] = p[2] = i;
+        ptrs.push_back(p);
+    }
+    for (uint64_t i = 0; i < ptrs.size(); ++i) {
+        EXPECT_EQ(i, ptrs[i][0]);
+        EXPECT_EQ(i, ptrs[i][2]);
+    }
+
+    BumpPool::Stats stats = pool.stats();
+    EXPECT_GT(stats.chunkMallocs, 1u);
+    EXPECT_GE(stats.capacityBytes, 2400u);
+    EXPECT_EQ(0u, stats.highWaterBytes);
+
+    pool.freeAll();
+    stats = pool.stats();
+    EXPECT_EQ(2400u, stats.highWaterBytes);
+    uint64_t chunkMallocs = stats.chunkMallocs;
+    for (int gen = 0; gen < 10; ++gen) {
+        for (int i = 0; i < 100; ++i) pool.alloc(sizeof(uint64_t) * 3);
+        pool.freeAll();
+    }
+    EXPECT_EQ(chunkMallocs, pool.stats().chunkMallocs);
+    EXPECT_EQ(2400u, pool.stats().highWaterBytes);
+}
+
+// Tests that huge allocations bypass the chunks and are counted in the high
+// water mark, and that the last one is reused until it goes unused for a
+// while.
+TEST(BumpPool, HugeAllocs) {
+    BumpPool pool(4096, 8192);
+    uint8_t* small = (uint8_t*)pool.alloc(100);
+    uint8_t* huge = (uint8_t*)pool.alloc(8192);
+    memset(huge, 0xab, 8192);
+    uint8_t* small2 = (uint8_t*)pool.alloc(100);
+    EXPECT_EQ(small + 104, small2);
+
+    BumpPool::Stats stats = pool.stats();
+    EXPECT_EQ(1u, stats.hugeAllocs);
+    EXPECT_EQ(1u, stats.chunkMallocs);
+    EXPECT_EQ(4096u, stats.capacityBytes);
+
+    pool.freeAll();
+    stats = pool.stats();
+    EXPECT_EQ(208u + 8192u, stats.highWaterBytes);
+    EXPECT_EQ(4096u + 8192u, stats.capacityBytes);
+
+    EXPECT_EQ(huge, pool.alloc(8192));
+    pool.freeAll();
+    for (int gen = 0; gen < 1000; ++gen) {
+        pool.alloc(16);
+        pool.freeAll();
+    }
+    stats = pool.stats();
+    EXPECT_EQ(2u, stats.hugeAllocs);
+    EXPECT_EQ(4096u, stats.capacityBytes);
+}
+
+// Tests that a chunk grown for one big generation is given back after many
+// small ones, but not below the starting size.
+TEST(BumpPool, Shrink) {
+    BumpPool pool(4096, BumpPool::kNoHugeAllocs);
+    pool.alloc(1 << 20);
+    pool.freeAll();
+    EXPECT_GE(pool.stats().capacityBytes, 1u << 20);
+
+    for (int gen = 0; gen < 1000; ++gen) {
+        pool.alloc(16);
+        pool.freeAll();
+    }
+    EXPECT_EQ(4096u, pool.stats().capacityBytes);
+}
+
+// Tests that allocations are page-aligned, disjoint and coalesce when freed.
+TEST(SubAllocator, Basic) {
+    constexpr uint64_t kPage = 4096;
+    constexpr uint64_t kPages = 64;
+    std::vector<uint8_t> buffer(kPages * kPage);
+    SubAllocator subAlloc(buffer.data(), buffer.size(), kPage);
+    EXPECT_TRUE(subAlloc.empty());
+
+    void* a = subAlloc.alloc(1);
+    void* b = subAlloc.alloc(kPage + 1);
+    void* c = subAlloc.alloc(kPage);
+    ASSERT_NE(nullptr, a);
+    ASSERT_NE(nullptr, b);
+    ASSERT_NE(nullptr, c);
+    EXPECT_EQ(0u, subAlloc.getOffset(a) % kPage);
+    EXPECT_EQ(0u, subAlloc.getOffset(b) % kPage);
+    EXPECT_EQ(0u, subAlloc.getOffset(c) % kPage);
+    EXPECT_FALSE(subAlloc.empty());
+
+    SubAllocator::Stats stats = subAlloc.getStats();
+    EXPECT_EQ(4 * kPage, stats.allocatedBytes);
+    EXPECT_EQ(3u, stats.allocCount);
+    EXPECT_EQ((kPages - 4) * kPage, stats.freeBytes);
+
+    EXPECT_TRUE(subAlloc.free(b));
+    EXPECT_FALSE(subAlloc.free(b));
+    EXPECT_TRUE(subAlloc.free(a));
+    EXPECT_TRUE(subAlloc.free(c));
+    EXPECT_TRUE(subAlloc.empty());
+
+    stats = subAlloc.getStats();
+    EXPECT_EQ(1u, stats.freeBlockCount);
+    EXPECT_EQ(kPages * kPage, stats.largestFreeBlock);
+    EXPECT_EQ(0.0, stats.fragmentation());
+
+    EXPECT_EQ(nullptr, subAlloc.alloc(0));
+    EXPECT_EQ(nullptr, subAlloc.alloc(kPages * kPage + 1));
+    void* all = subAlloc.alloc(kPages * kPage);
+    EXPECT_EQ(buffer.data(), all);
+    EXPECT_EQ(nullptr, subAlloc.alloc(1));
+    subAlloc.freeAll();
+    EXPECT_TRUE(subAlloc.empty());
+    EXPECT_NE(nullptr, subAlloc.alloc(kPages * kPage));
+}
+
+// Tests that holes are reported as fragmentation and that any hole large
+// enough is found, even when it shares a size class with the request.
+TEST(SubAllocator, Fragmentation) {
+    constexpr uint64_t kPage = 65536;
+    constexpr uint64_t kPages = 1024;
+    std::vector<uint8_t> buffer(kPages * kPage);
+    SubAllocator subAlloc(buffer.data(), buffer.size(), kPage);
+
+    std::vector<void*> ptrs;
+    while (void* ptr = subAlloc.alloc(kPage)) ptrs.push_back(ptr);
+    ASSERT_EQ(kPages, ptrs.size());
+
+    for (size_t i = 0; i < ptrs.size(); i += 2) EXPECT_TRUE(subAlloc.free(ptrs[i]));
+    SubAllocator::Stats stats = subAlloc.getStats();
+    EXPECT_EQ(kPages / 2, stats.freeBlockCount);
+    EXPECT_EQ(kPage, stats.largestFreeBlock);
+    EXPECT_GT(stats.fragmentation(), 0.99);
+    EXPECT_EQ(nullptr, subAlloc.alloc(2 * kPage));
+
+    // Frees pages 100-800: 690 pages round up past the hole's size class.
+    for (size_t i = 101; i < 800; i += 2) EXPECT_TRUE(subAlloc.free(ptrs[i]));
+    void* big = subAlloc.alloc(690 * kPage);
+    EXPECT_EQ(ptrs[100], big);
+}
+
+// Tests random alloc/free sequences for overlap and leaks.
+TEST(SubAllocator, Random) {
+    constexpr uint64_t kPage = 4096;
+    constexpr uint64_t kPages = 4096;
+    std::vector<uint8_t> buffer(kPages * kPage);
+    SubAllocator subAlloc(buffer.data(), buffer.size(), kPage);
+
+    std::mt19937 rng(1234);
+    std::vector<std::pair<uint64_t, uint64_t>> live;
+    std::vector<bool> used(kPages);
+    for (int i = 0; i < 20000; ++i) {
+        if (live.empty() || rng() % 3) {
+            uint64_t size = 1 + rng() % (rng() % 8 ? 4 * kPage : 64 * kPage);
+            void* ptr = subAlloc.alloc(size);
+            if (!ptr) continue;
+            uint64_t first = subAlloc.getOffset(ptr) / kPage;
+            uint64_t pages = (size + kPage - 1) / kPage;
+            ASSERT_LE(first + pages, kPages);
+            for (uint64_t p = first; p < first + pages; ++p) {
+                ASSERT_FALSE(used[p]);
+                used[p] = true;
+            }
+            live.emplace_back(first, pages);
+        } else {
+            size_t victim = rng() % live.size();
+            auto block = live[victim];
+            live[victim] = live.back();
+            live.pop_back();
+            ASSERT_TRUE(subAlloc.free(buffer.data() + block.first * kPage));
+            for (uint64_t p = block.first; p < block.first + block.second; ++p) used[p] = false;
+        }
+    }
+
+    for (auto block : live) EXPECT_TRUE(subAlloc.free(buffer.data() + block.first * kPage));
+    EXPECT_TRUE(subAlloc.empty());
+    EXPECT_EQ(kPages * kPage, subAlloc.getStats().largestFreeBlock);
+}
+
+// Tests that a snapshot restores the same allocations into a new buffer.
+TEST(SubAllocator, Snapshot) {
+    constexpr uint64_t kPage = 4096;
+    constexpr uint64_t kPages = 32;
+    std::vector<uint8_t> buffer(kPages * kPage);
+    SubAllocator subAlloc(buffer.data(), buffer.size(), kPage);
+    void* a = subAlloc.alloc(kPage);
+    void* b = subAlloc.alloc(3 * kPage);
+    void* c = subAlloc.alloc(kPage);
+    ASSERT_TRUE(subAlloc.free(a));
+
+    android::base::MemStream stream;
+    ASSERT_TRUE(subAlloc.save(&stream));
+
+    std::vector<uint8_t> newBuffer(kPages * kPage);
+    SubAllocator loaded(nullptr, 0, 1);
+    ASSERT_TRUE(loaded.load(&stream));
+    ASSERT_TRUE(loaded.postLoad(newBuffer.data()));
+
+    SubAllocator::Stats stats = loaded.getStats();
+    EXPECT_EQ(2u, stats.allocCount);
+    EXPECT_EQ(4 * kPage, stats.allocatedBytes);
+    EXPECT_TRUE(loaded.free(newBuffer.data() + subAlloc.getOffset(b)));
+    EXPECT_TRUE(loaded.free(newBuffer.data() + subAlloc.getOffset(c)));
+    EXPECT_TRUE(loaded.empty());
+    EXPECT_EQ(kPages * kPage, loaded.getStats().largestFreeBlock);
+}
+
+// Tests loading a snapshot in the format the address_space.h based
+// SubAllocator wrote.
+TEST(SubAllocator, SnapshotCompatibility) {
+    constexpr uint64_t kPage = 4096;
+    constexpr uint64_t kPages = 32;
+    address_space_allocator old;
+    address_space_allocator_init(&old, kPages * kPage, 32);
+    uint64_t a = address_space_allocator_allocate(&old, 2 * kPage);
+    uint64_t b = address_space_allocator_allocate(&old, kPage);
+    uint64_t c = address_space_allocator_allocate(&old, 5 * kPage);
+    address_space_allocator_deallocate(&old, b);
+
+    android::base::MemStream stream;
+    stream.putBe32(old.size);
+    stream.putBe32(old.capacity);
+    stream.putBe64(old.total_bytes);
+    for (int i = 0; i < old.size; ++i) {
+        stream.putBe64(old.blocks[i].offset);
+        stream.putBe64(old.blocks[i].size_available);
+    }
+    stream.putBe64(kPage);
+    stream.putBe64(kPages * kPage);
+    stream.putBe32(2);
+    address_space_allocator_destroy_nocleanup(&old);
+
+    std::vector<uint8_t> buffer(kPages * kPage);
+    SubAllocator loaded(nullptr, 0, 1);
+    ASSERT_TRUE(loaded.load(&stream));
+    ASSERT_TRUE(loaded.postLoad(buffer.data()));
+    EXPECT_EQ(2u, loaded.getStats().allocCount);
+    EXPECT_FALSE(loaded.free(buffer.data() + b));
+    EXPECT_TRUE(loaded.free(buffer.data() + a));
+    EXPECT_TRUE(loaded.free(buffer.data() + c));
+    EXPECT_TRUE(loaded.empty());
+
+    // And the other way around.
+    void* d = loaded.alloc(3 * kPage);
+    ASSERT_NE(nullptr, d);
+    android::base::MemStream saved;
+    ASSERT_TRUE(loaded.save(&saved));
+    EXPECT_EQ(2u, saved.getBe32());
+    saved.getBe32();
+    EXPECT_EQ(kPages * kPage, saved.getBe64());
+    address_block block;
+    block.offset = saved.getBe64();
+    block.size_available = saved.getBe64();
+    EXPECT_EQ((uint64_t)((uint8_t*)d - buffer.data()), block.offset);
+    EXPECT_EQ(3 * kPage, block.size);
+    EXPECT_EQ(0u, block.available);
+    block.offset = saved.getBe64();
+    block.size_available = saved.getBe64();
+    EXPECT_EQ(29 * kPage, block.size);
+    EXPECT_EQ(1u, block.available);
+}
+
+// Dumps the flight recorder with |windowMs| and returns the file contents.
+static std::string dumpFlightRecorder(uint32_t windowMs) {
+    char path[] = "/tmp/aemu_flight_recorder_XXXXXX";
+    int fd = mkstemp(path);
+    EXPECT_LE(0, fd);
+    close(fd);
+    EXPECT_TRUE(dumpTraceFlightRecorder(path, windowMs));
+
+    std::string contents;
+    FILE* file = fopen(path, "r");
+    EXPECT_NE(nullptr, file);
+    char buf[4096];
+    size_t n;
+    while (file && (n = fread(buf, 1, sizeof(buf), file)) > 0) {
+        contents.append(buf, n);
+    }
+    if (file) fclose(file);
+    unlink(path);
+    return contents;
+}
+
+static size_t countEvents(const std::string& dump, const char* name) {
+    std::string needle = std::string("{\"name\":\"") + name + "\"";
+    size_t count = 0;
+    for (size_t pos = dump.find(needle); pos != std::string::npos;
+         pos = dump.find(needle, pos + 1)) {
+        ++count;
+    }
+    return count;
+}
+
+// Tests that recording is opt-in.
+TEST(TraceFlightRecorder, DisabledByDefault) {
+    EXPECT_FALSE(isTraceFlightRecorderEnabled());
+}
+
+// Tests that a ring that wraps dumps exactly its newest events.
+TEST(TraceFlightRecorder, RingWrap) {
+    constexpr uint32_t kOverflow = 100;
+    // A fresh thread, so the ring holds only this test's events.
+    std::thread([] {
+        for (uint32_t i = 0; i < kOverflow; ++i) {
+            traceFlightRecorderRecord("flight_recorder_wrapped", TraceEventPhase::Instant);
+        }
+        for (uint32_t i = 0; i < kTraceFlightRecorderEventsPerThread; ++i) {
+            traceFlightRecorderRecord("flight_recorder_kept", TraceEventPhase::Instant, i + 1);
+        }
+    }).join();
+
+    // The oldest slot of a full ring is never dumped.
+    std::string dump = dumpFlightRecorder(60000);
+    EXPECT_EQ(0u, countEvents(dump, "flight_recorder_wrapped"));
+    EXPECT_EQ(kTraceFlightRecorderEventsPerThread - 1, countEvents(dump, "flight_recorder_kept"));
+    EXPECT_EQ(std::string::npos, dump.find("\"args\":{\"bytes\":1}"));
+    EXPECT_NE(std::string::npos, dump.find("\"args\":{\"bytes\":2}"));
+    EXPECT_NE(std::string::npos,
+              dump.find("\"args\":{\"bytes\":" +
+                        std::to_string(kTraceFlightRecorderEventsPerThread) + "}"));
+}
+
+// Tests that a dump only includes events inside its window.
+TEST(TraceFlightRecorder, DumpWindow) {
+    traceFlightRecorderRecord("flight_recorder_old", TraceEventPhase::Begin);
+    traceFlightRecorderRecord("flight_recorder_old", TraceEventPhase::End);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    traceFlightRecorderRecord("flight_recorder_new", TraceEventPhase::Begin);
+    traceFlightRecorderRecord("flight_recorder_new", TraceEventPhase::End);
+
+    std::string recent = dumpFlightRecorder(100);
+    EXPECT_EQ(0u, countEvents(recent, "flight_recorder_old"));
+    EXPECT_EQ(2u, countEvents(recent, "flight_recorder_new"));
+
+    std::string all = dumpFlightRecorder(60000);
+    EXPECT_EQ(2u, countEvents(all, "flight_recorder_old"));
+    EXPECT_EQ(2u, countEvents(all, "flight_recorder_new"));
+}
+
+} // namespace android
+} // namespace base
+} // namespace guest
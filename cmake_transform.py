@@ -100,6 +100,16 @@ def generate_module(module):
                 name, " ".join(module["src"])
             )
         )
+    elif module["type"] == "EXECUTABLE":
+        make.append(
+            "android_add_executable(TARGET {} LICENSE Apache-2.0 SRC {})".format(
+                name, " ".join(module["src"])
+            )
+        )
+    elif module["type"] == "NATIVE_TEST":
+        make.append(
+            "android_add_test(TARGET {} SRC {})".format(name, " ".join(module["src"]))
+        )
     else:
         raise ValueError("Unexpected module type: %s" % module["type"])
 
@@ -117,6 +127,8 @@ def generate_module(module):
 
     # Make sure we remove the lib prefix from all our dependencies.
     libs = [remove_lib_prefix(l) for l in module.get("libs", [])]
+    if module["type"] == "NATIVE_TEST":
+        libs.append("gtest_main")
     staticlibs = [
         remove_lib_prefix(l)
         for l in module.get("staticlibs", [])
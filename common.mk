@@ -22,6 +22,8 @@
 #
 emugl-begin-static-library = $(call emugl-begin-module,$1,STATIC_LIBRARY)
 emugl-begin-shared-library = $(call emugl-begin-module,$1,SHARED_LIBRARY)
+emugl-begin-executable = $(call emugl-begin-module,$1,EXECUTABLE)
+emugl-begin-test = $(call emugl-begin-module,$1,NATIVE_TEST)
 
 # Internal list of all declared modules (used for sanity checking)
 _emugl_modules :=
@@ -31,7 +33,7 @@ _emugl_HOST_modules :=
 emugl-begin-module = \
     $(eval include $(CLEAR_VARS)) \
     $(eval LOCAL_MODULE := $1) \
-    $(eval LOCAL_MODULE_CLASS := $(patsubst HOST_%,%,$(patsubst %EXECUTABLE,%EXECUTABLES,$(patsubst %LIBRARY,%LIBRARIES,$2)))) \
+    $(eval LOCAL_MODULE_CLASS := $(patsubst HOST_%,%,$(patsubst %TEST,%TESTS,$(patsubst %EXECUTABLE,%EXECUTABLES,$(patsubst %LIBRARY,%LIBRARIES,$2))))) \
     $(eval LOCAL_IS_HOST_MODULE := $(if $3,true,))\
     $(eval LOCAL_C_INCLUDES := $(EMUGL_COMMON_INCLUDES)) \
     $(eval LOCAL_CFLAGS := $(EMUGL_COMMON_CFLAGS)) \
@@ -167,7 +169,7 @@ _emugl-module-import = \
         $(foreach _type,$(EMUGL_EXPORT_TYPES),\
             $(eval LOCAL_$(_type) := $(_emugl.$1.export.$(_type)) $(LOCAL_$(_type)))\
         )\
-        $(if $(filter EXECUTABLE SHARED_LIBRARY,$(_emugl.$(_emugl_MODULE).type)),\
+        $(if $(filter EXECUTABLE NATIVE_TEST SHARED_LIBRARY,$(_emugl.$(_emugl_MODULE).type)),\
             $(if $(filter STATIC_LIBRARY,$(_emugl.$1.type)),\
                 $(eval LOCAL_STATIC_LIBRARIES := $(1:HOST_%=%) $(LOCAL_STATIC_LIBRARIES))\
             )\
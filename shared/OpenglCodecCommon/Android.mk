@@ -56,3 +56,16 @@ endif
 
 $(call emugl-export,C_INCLUDES,$(LOCAL_PATH))
 $(call emugl-end-module)
+
+ifeq (true,$(GOLDFISH_OPENGL_BUILD_FOR_HOST))
+### CodecCommon unit tests ##########################################
+$(call emugl-begin-test,OpenglCodecCommon_unittests)
+$(call emugl-import,libOpenglCodecCommon$(GOLDFISH_OPENGL_LIB_SUFFIX))
+
+LOCAL_CFLAGS += -DLOG_TAG=\"eglCodecCommon\"
+
+LOCAL_SRC_FILES := \
+    OpenglCodecCommon_unittests.cpp \
+
+$(call emugl-end-module)
+endif
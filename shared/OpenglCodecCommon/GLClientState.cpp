@@ -242,19 +242,15 @@ void GLClientState::removeVertexArrayObjects(GLsizei n, const GLuint* arrays) {
 }
 
 void GLClientState::addVertexArrayObject(GLuint name) {
-    if (m_vaoMap.find(name) !=
-        m_vaoMap.end()) {
+    if (m_vaoMap.contains(name)) {
         ALOGE("%s: ERROR: %u already part of current VAO state!",
               __FUNCTION__, name);
         return;
     }
 
-    m_vaoMap.insert(
-            VAOStateMap::value_type(
-                name,
-                VAOState(0, CODEC_MAX_VERTEX_ATTRIBUTES, CODEC_MAX_VERTEX_ATTRIBUTES)));
-    VertexAttribStateVector& attribState =
-        m_vaoMap.find(name)->second.attribState;
+    VAOState& vaoState = m_vaoMap.emplace(
+            name, 0, CODEC_MAX_VERTEX_ATTRIBUTES, CODEC_MAX_VERTEX_ATTRIBUTES);
+    VertexAttribStateVector& attribState = vaoState.attribState;
     for (int i = 0; i < CODEC_MAX_VERTEX_ATTRIBUTES; i++) {
         attribState[i].enabled = 0;
         attribState[i].enableDirty = false;
@@ -266,8 +262,7 @@ void GLClientState::addVertexArrayObject(GLuint name) {
         attribState[i].type = GL_FLOAT; // GL_FLOAT is the default type
     }
 
-    VertexAttribBindingVector& bindingState =
-        m_vaoMap.find(name)->second.bindingState;
+    VertexAttribBindingVector& bindingState = vaoState.bindingState;
     for (int i = 0; i < bindingState.size(); i++) {
         bindingState[i].effectiveStride = 16;
     }
@@ -279,8 +274,7 @@ void GLClientState::removeVertexArrayObject(GLuint name) {
               __FUNCTION__);
         return;
     }
-    if (m_vaoMap.find(name) ==
-        m_vaoMap.end()) {
+    if (!m_vaoMap.contains(name)) {
         ALOGE("%s: ERROR: %u not found in VAO state!",
               __FUNCTION__, name);
         return;
@@ -289,8 +283,8 @@ void GLClientState::removeVertexArrayObject(GLuint name) {
 }
 
 void GLClientState::setVertexArrayObject(GLuint name) {
-    if (m_vaoMap.find(name) ==
-        m_vaoMap.end()) {
+    VAOState* vaoState = m_vaoMap.get(name);
+    if (!vaoState) {
         ALOGE("%s: ERROR: %u not found in VAO state!",
               __FUNCTION__, name);
         return;
@@ -302,12 +296,11 @@ void GLClientState::setVertexArrayObject(GLuint name) {
         return;
     }
 
-    m_currVaoState =
-        VAOStateRef(m_vaoMap.find(name));
+    m_currVaoState = VAOStateRef(name, vaoState);
 }
 
 bool GLClientState::isVertexArrayObject(GLuint vao) const {
-    return m_vaoMap.find(vao) != m_vaoMap.end();
+    return m_vaoMap.contains(vao);
 }
 
 void GLClientState::getVBOUsage(bool* hasClientArrays, bool* hasVBOs) {
@@ -1322,38 +1315,27 @@ void GLClientState::getUnpackingOffsets3D(GLsizei width, GLsizei height, GLsizei
 }
 
 void GLClientState::setNumActiveUniformsInUniformBlock(GLuint program, GLuint uniformBlockIndex, GLint numActiveUniforms) {
-    UniformBlockInfoKey key;
-    key.program = program;
-    key.uniformBlockIndex = uniformBlockIndex;
-
     UniformBlockUniformInfo info;
     info.numActiveUniforms = (size_t)numActiveUniforms;
 
-    m_uniformBlockInfoMap[key] = info;
+    std::vector<UniformBlockUniformInfo>& blocks = m_uniformBlockInfoMap[program];
+    if (uniformBlockIndex >= blocks.size()) {
+        blocks.resize(uniformBlockIndex + 1, UniformBlockUniformInfo{0});
+    }
+    blocks[uniformBlockIndex] = info;
 }
 
 size_t GLClientState::numActiveUniformsInUniformBlock(GLuint program, GLuint uniformBlockIndex) const {
-    UniformBlockInfoKey key;
-    key.program = program;
-    key.uniformBlockIndex = uniformBlockIndex;
-    UniformBlockInfoMap::const_iterator it =
-        m_uniformBlockInfoMap.find(key);
-    if (it == m_uniformBlockInfoMap.end()) return 0;
-    return it->second.numActiveUniforms;
+    const std::vector<UniformBlockUniformInfo>* blocks =
+        m_uniformBlockInfoMap.get_const(program);
+    if (!blocks || uniformBlockIndex >= blocks->size()) return 0;
+    return (*blocks)[uniformBlockIndex].numActiveUniforms;
 }
 
 void GLClientState::associateProgramWithPipeline(GLuint program, GLuint pipeline) {
     m_programPipelines[program] = pipeline;
 }
 
-GLClientState::ProgramPipelineIterator GLClientState::programPipelineBegin() {
-    return m_programPipelines.begin();
-}
-
-GLClientState::ProgramPipelineIterator GLClientState::programPipelineEnd() {
-    return m_programPipelines.end();
-}
-
 GLenum GLClientState::setActiveTextureUnit(GLenum texture)
 {
     GLuint unit = texture - GL_TEXTURE0;
@@ -1508,12 +1490,15 @@ TextureRec* GLClientState::addTextureRec(GLuint id, GLenum target)
     TextureRec* tex = new TextureRec;
     tex->id = id;
     tex->target = target;
-    tex->format = -1;
+    tex->packedInternalFormat = TEXTURE_FORMAT_UNSET;
+    tex->packedFormat = TEXTURE_FORMAT_UNSET;
+    tex->packedType = TEXTURE_FORMAT_UNSET;
     tex->multisamples = 0;
     tex->immutable = false;
     tex->boundEGLImage = false;
     tex->hasStorage = false;
-    tex->dims = new TextureDims[6];
+    tex->dims.clear();
+    tex->cubeFaceDims = NULL;
     tex->hasCubeNegX = false;
     tex->hasCubePosX = false;
     tex->hasCubeNegY = false;
@@ -1526,33 +1511,32 @@ TextureRec* GLClientState::addTextureRec(GLuint id, GLenum target)
 }
 
 TextureRec* GLClientState::getTextureRec(GLuint id) const {
-    SharedTextureDataMap::const_iterator it =
-        m_tex.textureRecs->find(id);
-    if (it == m_tex.textureRecs->end()) {
+    TextureRec* const* rec = m_tex.textureRecs->get_const(id);
+    if (!rec) {
         return NULL;
     }
-    return it->second;
+    return *rec;
 }
 
 void GLClientState::setBoundTextureInternalFormat(GLenum target, GLint internalformat) {
     GLuint texture = getBoundTexture(target);
     TextureRec* texrec = getTextureRec(texture);
     if (!texrec) return;
-    texrec->internalformat = internalformat;
+    texrec->setInternalformat(internalformat);
 }
 
 void GLClientState::setBoundTextureFormat(GLenum target, GLenum format) {
     GLuint texture = getBoundTexture(target);
     TextureRec* texrec = getTextureRec(texture);
     if (!texrec) return;
-    texrec->format = format;
+    texrec->setFormat(format);
 }
 
 void GLClientState::setBoundTextureType(GLenum target, GLenum type) {
     GLuint texture = getBoundTexture(target);
     TextureRec* texrec = getTextureRec(texture);
     if (!texrec) return;
-    texrec->type = type;
+    texrec->setType(type);
 }
 
 static size_t textureDimArrayOfCubeTarget(GLenum cubetarget) {
@@ -1598,6 +1582,8 @@ void GLClientState::setBoundTextureDims(GLenum target, GLenum cubetarget, GLsize
     }
 
 
+    TextureDims& dims = texrec->dimsForFace(indexToSet);
+
     if (level == -1) {
         GLsizei curr_width = width;
         GLsizei curr_height = height;
@@ -1605,9 +1591,9 @@ void GLClientState::setBoundTextureDims(GLenum target, GLenum cubetarget, GLsize
         GLsizei curr_level = 0;
 
         while (true) {
-            texrec->dims[indexToSet].widths[curr_level] = curr_width;
-            texrec->dims[indexToSet].heights[curr_level] = curr_height;
-            texrec->dims[indexToSet].depths[curr_level] = curr_depth;
+            if (!dims.setLevel(curr_level, curr_width, curr_height, curr_depth)) {
+                break;
+            }
             if (curr_width >> 1 == 0 &&
                 curr_height >> 1 == 0 &&
                 ((target == GL_TEXTURE_3D && curr_depth == 0) ||
@@ -1623,9 +1609,7 @@ void GLClientState::setBoundTextureDims(GLenum target, GLenum cubetarget, GLsize
         }
 
     } else {
-        texrec->dims[indexToSet].widths[level] = width;
-        texrec->dims[indexToSet].heights[level] = height;
-        texrec->dims[indexToSet].depths[level] = depth;
+        dims.setLevel(level, width, height, depth);
     }
 
     setFboCompletenessDirtyForTexture(texture);
@@ -1635,7 +1619,7 @@ void GLClientState::setBoundTextureSamples(GLenum target, GLsizei samples) {
     GLuint texture = getBoundTexture(target);
     TextureRec* texrec = getTextureRec(texture);
     if (!texrec) return;
-    texrec->multisamples = samples;
+    texrec->setMultisamples(samples);
 }
 
 void GLClientState::addTextureCubeMapImage(GLenum stateTarget, GLenum cubeTarget) {
@@ -1691,7 +1675,7 @@ bool GLClientState::isBoundTextureImmutableFormat(GLenum target) const {
 
 bool GLClientState::isBoundTextureComplete(GLenum target) const {
     GLuint texture = getBoundTexture(target);
-    TextureRec* texrec = getTextureRec(texture);
+    const TextureRec* texrec = getTextureRec(texture);
     if (!texrec) return false;
 
     if (texrec->immutable) return true;
@@ -1705,13 +1689,14 @@ bool GLClientState::isBoundTextureComplete(GLenum target) const {
              texrec->hasCubeNegZ &&
              texrec->hasCubePosZ)) return false;
 
-        size_t currBaseLevel = texrec->dims[0].widths.begin()->first;
-        size_t currWidth = texrec->dims[0].widths.begin()->second;
-        size_t currHeight = texrec->dims[0].heights.begin()->second;
+        GLsizei currBaseLevel = texrec->dims.baseLevel();
+        GLsizei currWidth = texrec->dims.width(currBaseLevel);
+        GLsizei currHeight = texrec->dims.height(currBaseLevel);
         for (size_t i = 1; i < 6; ++i) {
-            size_t nextLevel = texrec->dims[i].widths.begin()->first;
-            size_t nextWidth = texrec->dims[i].widths.begin()->second;
-            size_t nextHeight = texrec->dims[i].heights.begin()->second;
+            const TextureDims& faceDims = texrec->dimsForFace(i);
+            GLsizei nextLevel = faceDims.baseLevel();
+            GLsizei nextWidth = faceDims.width(nextLevel);
+            GLsizei nextHeight = faceDims.height(nextLevel);
             if (currBaseLevel != nextLevel) return false;
             if (currWidth != nextWidth) return false;
             if (currHeight != nextHeight) return false;
@@ -2043,8 +2028,8 @@ void GLClientState::deleteTextures(GLsizei n, const GLuint* textures)
     TextureRec* texrec;
     for (const GLuint* texture = textures; texture != textures + n; texture++) {
         texrec = getTextureRec(*texture);
-        if (texrec && texrec->dims) {
-            delete [] texrec->dims;
+        if (texrec && texrec->cubeFaceDims) {
+            delete [] texrec->cubeFaceDims;
         }
         if (texrec) {
             m_tex.textureRecs->erase(*texture);
@@ -2203,7 +2188,7 @@ bool GLClientState::queryRboEGLImageBacked(GLuint rbo_name) const {
 GLint GLClientState::queryTexInternalFormat(GLuint tex_name) const {
     TextureRec* texrec = getTextureRec(tex_name);
     if (!texrec) return -1;
-    return texrec->internalformat;
+    return texrec->internalformat();
 }
 
 GLsizei GLClientState::queryTexWidth(GLsizei level, GLuint tex_name) const {
@@ -2211,19 +2196,19 @@ GLsizei GLClientState::queryTexWidth(GLsizei level, GLuint tex_name) const {
     if (!texrec) {
         return 0;
     }
-    return texrec->dims->widths[level];
+    return texrec->dims.width(level);
 }
 
 GLsizei GLClientState::queryTexHeight(GLsizei level, GLuint tex_name) const {
     TextureRec* texrec = getTextureRec(tex_name);
     if (!texrec) return 0;
-    return texrec->dims->heights[level];
+    return texrec->dims.height(level);
 }
 
 GLsizei GLClientState::queryTexDepth(GLsizei level, GLuint tex_name) const {
     TextureRec* texrec = getTextureRec(tex_name);
     if (!texrec) return 0;
-    return texrec->dims->depths[level];
+    return texrec->dims.depth(level);
 }
 
 bool GLClientState::queryTexEGLImageBacked(GLuint tex_name) const {
@@ -2235,13 +2220,13 @@ bool GLClientState::queryTexEGLImageBacked(GLuint tex_name) const {
 GLenum GLClientState::queryTexFormat(GLuint tex_name) const {
     TextureRec* texrec = getTextureRec(tex_name);
     if (!texrec) return -1;
-    return texrec->format;
+    return texrec->format();
 }
 
 GLenum GLClientState::queryTexType(GLuint tex_name) const {
     TextureRec* texrec = getTextureRec(tex_name);
     if (!texrec) return -1;
-    return texrec->type;
+    return texrec->type();
 }
 
 GLsizei GLClientState::queryTexSamples(GLuint tex_name) const {
@@ -2397,7 +2382,7 @@ int GLClientState::getMaxDrawBuffers() const {
     return m_hostDriverCaps.max_draw_buffers;
 }
 
-#define UNIFORM_VALIDATION_ERR_COND(cond, code) if (cond) { *err = code; return; }
+#define UNIFORM_VALIDATION_ERR_COND(cond, code) if (cond) { *err = code; return false; }
 
 #define UNIFORM_VALIDATION_INFO_VAR_NAME info
 
@@ -2412,9 +2397,9 @@ int GLClientState::getMaxDrawBuffers() const {
 
 #define UNIFORM_VALIDATION_INLINING
 
-void GLClientState::validateUniform(bool isFloat, bool isUnsigned, GLint columns, GLint rows, GLint location, GLsizei count, GLenum* err) {
+bool GLClientState::validateUniform(bool isFloat, bool isUnsigned, GLint columns, GLint rows, GLint location, GLsizei count, GLenum* err) {
     UNIFORM_VALIDATION_ERR_COND(!m_currentProgram && !m_currentShaderProgram, GL_INVALID_OPERATION);
-    if (-1 == location) return; \
+    if (-1 == location) return true; \
     auto info = currentUniformValidationInfo.get_const(location); \
     UNIFORM_VALIDATION_ERR_COND(!info || !info->valid, GL_INVALID_OPERATION); \
     UNIFORM_VALIDATION_ERR_COND(columns != info->columns || rows != info->rows, GL_INVALID_OPERATION); \
@@ -2428,6 +2413,7 @@ void GLClientState::validateUniform(bool isFloat, bool isUnsigned, GLint columns
             UNIFORM_VALIDATION_ERR_COND(UNIFORM_VALIDATION_TYPE_VIOLATION_FOR_INTS, GL_INVALID_OPERATION);
         }
     }
+    return true;
 }
 
 bool GLClientState::isAttribIndexUsedByProgram(int index) {
@@ -2499,7 +2485,7 @@ void GLClientState::removeFramebuffers(GLsizei n, const GLuint* framebuffers) {
 }
 
 bool GLClientState::usedFramebufferName(GLuint name) const {
-    return mFboState.fboData.find(name) != mFboState.fboData.end();
+    return mFboState.fboData.contains(name);
 }
 
 FboProps& GLClientState::boundFboProps(GLenum target) {
@@ -2517,13 +2503,13 @@ FboProps& GLClientState::boundFboProps(GLenum target) {
 const FboProps& GLClientState::boundFboProps_const(GLenum target) const {
     switch (target) {
     case GL_DRAW_FRAMEBUFFER:
-        return mFboState.fboData.find(mFboState.boundDrawFramebuffer)->second;
+        return *mFboState.fboData.get_const(mFboState.boundDrawFramebuffer);
     case GL_READ_FRAMEBUFFER:
-        return mFboState.fboData.find(mFboState.boundReadFramebuffer)->second;
+        return *mFboState.fboData.get_const(mFboState.boundReadFramebuffer);
     case GL_FRAMEBUFFER:
-        return mFboState.fboData.find(mFboState.boundDrawFramebuffer)->second;
+        return *mFboState.fboData.get_const(mFboState.boundDrawFramebuffer);
     }
-    return mFboState.fboData.find(mFboState.boundDrawFramebuffer)->second;
+    return *mFboState.fboData.get_const(mFboState.boundDrawFramebuffer);
 }
 
 void GLClientState::bindFramebuffer(GLenum target, GLuint name) {
@@ -2787,77 +2773,71 @@ GLuint GLClientState::getFboAttachmentRboId(GLenum target, GLenum attachment) co
 }
 
 void GLClientState::setFboCompletenessDirtyForTexture(GLuint texture) {
-    std::map<GLuint, FboProps>::iterator it = mFboState.fboData.begin();
-    while (it != mFboState.fboData.end()) {
-        FboProps& props = it->second;
+    FboProps* props = mFboState.fboData.findIf(
+        [this, texture](GLuint, const FboProps& props) {
         for (int i = 0; i < m_hostDriverCaps.max_color_attachments; ++i) {
             if (props.colorAttachmenti_hasTex[i]) {
                 if (texture == props.colorAttachmenti_textures[i]) {
-                    props.completenessDirty = true;
-                    return;
+                    return true;
                 }
             }
         }
 
         if (props.depthAttachment_hasTexObj) {
             if (texture == props.depthAttachment_texture) {
-                    props.completenessDirty = true;
-                    return;
+                return true;
             }
         }
 
         if (props.stencilAttachment_hasTexObj) {
             if (texture == props.stencilAttachment_texture) {
-                props.completenessDirty = true;
-                return;
+                return true;
             }
         }
 
         if (props.depthstencilAttachment_hasTexObj) {
             if (texture == props.depthstencilAttachment_texture) {
-                props.completenessDirty = true;
-                return;
+                return true;
             }
         }
-        ++it;
-    }
+        return false;
+    });
+
+    if (props) props->completenessDirty = true;
 }
 
 void GLClientState::setFboCompletenessDirtyForRbo(GLuint rbo) {
-    std::map<GLuint, FboProps>::iterator it = mFboState.fboData.begin();
-    while (it != mFboState.fboData.end()) {
-        FboProps& props = it->second;
+    FboProps* props = mFboState.fboData.findIf(
+        [this, rbo](GLuint, const FboProps& props) {
         for (int i = 0; i < m_hostDriverCaps.max_color_attachments; ++i) {
             if (props.colorAttachmenti_hasTex[i]) {
                 if (rbo == props.colorAttachmenti_rbos[i]) {
-                    props.completenessDirty = true;
-                    return;
+                    return true;
                 }
             }
         }
 
         if (props.depthAttachment_hasTexObj) {
             if (rbo == props.depthAttachment_rbo) {
-                    props.completenessDirty = true;
-                    return;
+                return true;
             }
         }
 
         if (props.stencilAttachment_hasTexObj) {
             if (rbo == props.stencilAttachment_rbo) {
-                props.completenessDirty = true;
-                return;
+                return true;
             }
         }
 
         if (props.depthstencilAttachment_hasRbo) {
             if (rbo == props.depthstencilAttachment_rbo) {
-                props.completenessDirty = true;
-                return;
+                return true;
             }
         }
-        ++it;
-    }
+        return false;
+    });
+
+    if (props) props->completenessDirty = true;
 }
 
 bool GLClientState::attachmentHasObject(GLenum target, GLenum attachment) const {
@@ -3021,7 +3001,7 @@ bool GLClientState::compressedTexImageSizeCompatible(GLenum internalformat, GLsi
 }
 
 void GLClientState::fromMakeCurrent() {
-    if (mFboState.fboData.find(0) == mFboState.fboData.end()) {
+    if (!mFboState.fboData.contains(0)) {
         addFreshFramebuffer(0);
     }
 
@@ -27,6 +27,7 @@
 #endif
 
 #include "TextureSharedData.h"
+#include "android/base/containers/SlotTable.h"
 
 #include <GLES/gl.h>
 #include <GLES/glext.h>
@@ -209,20 +210,22 @@ public:
         int numAttributesNeedingUpdateForDraw;
     };
 
-    typedef std::map<GLuint, VAOState> VAOStateMap;
+    // VAOState addresses are stable in the slot table, so the current VAO
+    // can be held by pointer.
+    typedef android::base::SlotTable<GLuint, VAOState> VAOStateMap;
     struct VAOStateRef {
-        VAOStateRef() { }
-        VAOStateRef(
-                VAOStateMap::iterator iter) : it(iter) { }
-        VAOState& vaoState() { return it->second; }
-        VertexAttribState& operator[](size_t k) { return it->second.attribState[k]; }
-        BufferBinding& bufferBinding(size_t k) { return it->second.bindingState[k]; }
-        VertexAttribBindingVector& bufferBindings() { return it->second.bindingState; }
-        const VertexAttribBindingVector& bufferBindings_const() const { return it->second.bindingState; }
-        GLuint vaoId() const { return it->first; }
-        GLuint& iboId() { return it->second.element_array_buffer_binding; }
-        GLuint& iboIdLastEncode() { return it->second.element_array_buffer_binding_lastEncode; }
-        VAOStateMap::iterator it;
+        VAOStateRef() : id(0), state(nullptr) { }
+        VAOStateRef(GLuint vaoId, VAOState* vaoState) : id(vaoId), state(vaoState) { }
+        VAOState& vaoState() { return *state; }
+        VertexAttribState& operator[](size_t k) { return state->attribState[k]; }
+        BufferBinding& bufferBinding(size_t k) { return state->bindingState[k]; }
+        VertexAttribBindingVector& bufferBindings() { return state->bindingState; }
+        const VertexAttribBindingVector& bufferBindings_const() const { return state->bindingState; }
+        GLuint vaoId() const { return id; }
+        GLuint& iboId() { return state->element_array_buffer_binding; }
+        GLuint& iboIdLastEncode() { return state->element_array_buffer_binding_lastEncode; }
+        GLuint id;
+        VAOState* state;
     };
 
     typedef struct {
@@ -342,33 +345,26 @@ public:
     GLint currentProgram() const { return m_currentProgram; }
     GLint currentShaderProgram() const { return m_currentShaderProgram; }
 
-    struct UniformBlockInfoKey {
-        GLuint program;
-        GLuint uniformBlockIndex;
-    };
-    struct UniformBlockInfoKeyCompare {
-        bool operator() (const UniformBlockInfoKey& a,
-                         const UniformBlockInfoKey& b) const {
-            if (a.program != b.program) return a.program < b.program;
-            if (a.uniformBlockIndex != b.uniformBlockIndex) return a.uniformBlockIndex < b.uniformBlockIndex;
-            return false;
-        }
-    };
     struct UniformBlockUniformInfo {
         size_t numActiveUniforms;
     };
 
-    typedef std::map<UniformBlockInfoKey, UniformBlockUniformInfo, UniformBlockInfoKeyCompare> UniformBlockInfoMap;
+    // Per program, indexed by uniform block index.
+    typedef android::base::SlotTable<GLuint, std::vector<UniformBlockUniformInfo> > UniformBlockInfoMap;
     UniformBlockInfoMap m_uniformBlockInfoMap;
 
     void setNumActiveUniformsInUniformBlock(GLuint program, GLuint uniformBlockIndex, GLint numActiveUniforms);
     size_t numActiveUniformsInUniformBlock(GLuint program, GLuint uniformBlockIndex) const;
 
-    typedef std::map<GLuint, GLuint> ProgramPipelineMap;
-    typedef ProgramPipelineMap::iterator ProgramPipelineIterator;
+    typedef android::base::SlotTable<GLuint, GLuint> ProgramPipelineMap;
     void associateProgramWithPipeline(GLuint program, GLuint pipeline);
-    ProgramPipelineIterator programPipelineBegin();
-    ProgramPipelineIterator programPipelineEnd();
+    // Calls |func(program)| for each program associated with |pipeline|.
+    template <class Func>
+    void forEachProgramInPipeline(GLuint pipeline, Func&& func) {
+        m_programPipelines.forEach([pipeline, &func](GLuint program, GLuint& p) {
+            if (p == pipeline) func(program);
+        });
+    }
 
     /* OES_EGL_image_external
      *
@@ -555,7 +551,8 @@ public:
     AttribValidationInfo currentAttribValidationInfo;;
 
     // Uniform validation api
-    void validateUniform(bool isFloat, bool isUnsigned, GLint columns, GLint rows, GLint location, GLsizei count, GLenum* err);
+    // Returns false, and sets *err, if the call would fail on the host.
+    bool validateUniform(bool isFloat, bool isUnsigned, GLint columns, GLint rows, GLint location, GLsizei count, GLenum* err);
     // Attrib validation
     bool isAttribIndexUsedByProgram(int attribIndex);
 
@@ -724,7 +721,7 @@ private:
         GLuint boundDrawFramebuffer;
         GLuint boundReadFramebuffer;
         size_t boundFramebufferIndex;
-        std::map<GLuint, FboProps> fboData;
+        android::base::SlotTable<GLuint, FboProps> fboData;
         GLenum drawFboCheckStatus;
         GLenum readFboCheckStatus;
     };
@@ -19,6 +19,11 @@
 #include "KeyedVectorUtils.h"
 #include "glUtils.h"
 
+#include <algorithm>
+
+#include <string.h>
+#include <time.h>
+
 /**** BufferData ****/
 
 BufferData::BufferData() : m_size(0), m_usage(0), m_mapped(false) {};
@@ -57,6 +62,8 @@ void ProgramData::initProgramData(GLuint numIndexes, GLuint numAttributes) {
 
     m_Indexes = new IndexInfo[numIndexes];
     m_attribIndexes = new AttribInfo[m_numAttributes];
+
+    m_uniformShadow.clear();
 }
 
 bool ProgramData::isInitialized() {
@@ -135,6 +142,75 @@ bool ProgramData::isValidUniformLocation(GLint location) {
     return false;
 }
 
+uint32_t ProgramData::uniformShadowKind(GLenum baseType, GLint columns, GLint rows,
+                                        GLboolean transpose) {
+    uint32_t base = baseType == GL_FLOAT ? 0 : baseType == GL_INT ? 1 : 2;
+    return base | (uint32_t(columns) << 2) | (uint32_t(rows) << 5) |
+           (transpose ? (1u << 8) : 0);
+}
+
+bool ProgramData::updateUniformShadow(GLint location, GLsizei count, uint32_t kind,
+                                      const void* data, uint32_t epoch) {
+    if (location < 0 || count <= 0 || !m_Indexes || m_linkStatus != GL_TRUE) return false;
+
+    GLuint index = m_numIndexes;
+    for (GLuint i = 0; i < m_numIndexes; ++i) {
+        if (location >= m_Indexes[i].base &&
+            location < m_Indexes[i].base + m_Indexes[i].size) {
+            index = i;
+            break;
+        }
+    }
+    if (index == m_numIndexes) return false;
+
+    // Mirror GLClientState::validateUniform; glProgramUniform* is not
+    // validated guest-side.
+    const IndexInfo& info = m_Indexes[index];
+    const uint32_t base = kind & 0x3;
+    const GLint columns = (kind >> 2) & 0x7;
+    const GLint rows = (kind >> 5) & 0x7;
+    if (columns != (GLint)getColumnsOfType(info.type) ||
+        rows != (GLint)getRowsOfType(info.type)) {
+        return false;
+    }
+    if (!isBoolType(info.type)) {
+        const bool isInt = isIntegerType(info.type) || isSamplerType(info.type);
+        const bool isUnsigned = isUnsignedIntType(info.type);
+        if ((base == 0 && isInt) ||
+            (base == 1 && (!isInt || isUnsigned)) ||
+            (base == 2 && !isUnsigned)) {
+            return false;
+        }
+    }
+    if (count > 1 && info.size == 1) return false;
+
+    // Elements past the end of the array are ignored by GL.
+    const GLsizei elements = std::min<GLsizei>(count, info.base + info.size - location);
+    const size_t wordsPerElement = columns * rows;
+    const uint32_t* words = (const uint32_t*)data;
+
+    AutoLock<Lock> lock(m_uniformShadowLock);
+    if (m_uniformShadowEpoch != epoch) {
+        m_uniformShadow.clear();
+        m_uniformShadowEpoch = epoch;
+    }
+
+    bool unchanged = true;
+    for (GLsizei i = 0; i < elements; ++i) {
+        const uint32_t* element = words + i * wordsPerElement;
+        auto it = m_uniformShadow.find(location + i);
+        if (it != m_uniformShadow.end() && it->second.kind == kind &&
+            !memcmp(it->second.words, element, wordsPerElement * sizeof(uint32_t))) {
+            continue;
+        }
+        unchanged = false;
+        UniformShadowValue& value = m_uniformShadow[location + i];
+        value.kind = kind;
+        memcpy(value.words, element, wordsPerElement * sizeof(uint32_t));
+    }
+    return unchanged;
+}
+
 GLint ProgramData::getNextSamplerUniform(
     GLint index, GLint* val, GLenum* target) {
 
@@ -265,6 +341,71 @@ AttribValidationInfo ProgramData::compileAttribValidationInfo(bool* error) const
 }
 /***** GLSharedGroup ****/
 
+static uint64_t lockStatsNowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000ULL + uint64_t(ts.tv_nsec);
+}
+
+// Takes m_lock shared (|exclusive| false) or exclusive, updating the lock
+// counters when they are enabled. With stats off this is just the rwlock.
+template <bool exclusive>
+class GLSharedGroup::ScopedLock {
+public:
+    explicit ScopedLock(GLSharedGroup* group)
+        : m_group(group),
+          m_stats(group->m_lockStatsEnabled.load(std::memory_order_relaxed)) {
+        if (!m_stats) {
+            lock();
+            return;
+        }
+
+        LockCounters& counters = m_group->m_lockCounters;
+        (exclusive ? counters.writeAcquires : counters.readAcquires)
+            .fetch_add(1, std::memory_order_relaxed);
+        if (!tryLock()) {
+            (exclusive ? counters.contendedWriteAcquires : counters.contendedReadAcquires)
+                .fetch_add(1, std::memory_order_relaxed);
+            uint64_t waitStart = lockStatsNowNs();
+            lock();
+            m_acquiredNs = lockStatsNowNs();
+            counters.waitNs.fetch_add(m_acquiredNs - waitStart, std::memory_order_relaxed);
+        } else {
+            m_acquiredNs = lockStatsNowNs();
+        }
+    }
+
+    ~ScopedLock() {
+        if (m_stats) {
+            LockCounters& counters = m_group->m_lockCounters;
+            (exclusive ? counters.writeHoldNs : counters.readHoldNs)
+                .fetch_add(lockStatsNowNs() - m_acquiredNs, std::memory_order_relaxed);
+        }
+        if (exclusive) {
+            m_group->m_lock.unlockWrite();
+        } else {
+            m_group->m_lock.unlockRead();
+        }
+    }
+
+private:
+    void lock() {
+        if (exclusive) {
+            m_group->m_lock.lockWrite();
+        } else {
+            m_group->m_lock.lockRead();
+        }
+    }
+
+    bool tryLock() {
+        return exclusive ? m_group->m_lock.tryLockWrite() : m_group->m_lock.tryLockRead();
+    }
+
+    GLSharedGroup* const m_group;
+    const bool m_stats;
+    uint64_t m_acquiredNs = 0;
+};
+
 GLSharedGroup::GLSharedGroup() { }
 
 GLSharedGroup::~GLSharedGroup() {
@@ -276,18 +417,44 @@ GLSharedGroup::~GLSharedGroup() {
     clearObjectMap(m_shaderPrograms);
 }
 
+void GLSharedGroup::setLockStatsEnabled(bool enabled) {
+    m_lockStatsEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+GLSharedGroupLockStats GLSharedGroup::getLockStats() const {
+    GLSharedGroupLockStats stats;
+    stats.readAcquires = m_lockCounters.readAcquires.load(std::memory_order_relaxed);
+    stats.writeAcquires = m_lockCounters.writeAcquires.load(std::memory_order_relaxed);
+    stats.contendedReadAcquires = m_lockCounters.contendedReadAcquires.load(std::memory_order_relaxed);
+    stats.contendedWriteAcquires = m_lockCounters.contendedWriteAcquires.load(std::memory_order_relaxed);
+    stats.waitNs = m_lockCounters.waitNs.load(std::memory_order_relaxed);
+    stats.readHoldNs = m_lockCounters.readHoldNs.load(std::memory_order_relaxed);
+    stats.writeHoldNs = m_lockCounters.writeHoldNs.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void GLSharedGroup::resetLockStats() {
+    m_lockCounters.readAcquires.store(0, std::memory_order_relaxed);
+    m_lockCounters.writeAcquires.store(0, std::memory_order_relaxed);
+    m_lockCounters.contendedReadAcquires.store(0, std::memory_order_relaxed);
+    m_lockCounters.contendedWriteAcquires.store(0, std::memory_order_relaxed);
+    m_lockCounters.waitNs.store(0, std::memory_order_relaxed);
+    m_lockCounters.readHoldNs.store(0, std::memory_order_relaxed);
+    m_lockCounters.writeHoldNs.store(0, std::memory_order_relaxed);
+}
+
 bool GLSharedGroup::isShaderOrProgramObject(GLuint obj) {
 
-    AutoLock<Lock> _lock(m_lock);
+    ReadLock _lock(this);
 
     return (findObjectOrDefault(m_shaders, obj) ||
             findObjectOrDefault(m_programs, obj) ||
-            findObjectOrDefault(m_shaderPrograms, m_shaderProgramIdMap[obj]));
+            getShaderProgramDataLocked(obj));
 }
 
 BufferData* GLSharedGroup::getBufferData(GLuint bufferId) {
 
-    AutoLock<Lock> _lock(m_lock);
+    ReadLock _lock(this);
 
     return findObjectOrDefault(m_buffers, bufferId);
 }
@@ -306,14 +473,14 @@ SamplerInfo* GLSharedGroup::getSamplerInfo() {
 
 void GLSharedGroup::addBufferData(GLuint bufferId, GLsizeiptr size, const void* data) {
 
-    AutoLock<Lock> _lock(m_lock);
+    WriteLock _lock(this);
 
     m_buffers[bufferId] = new BufferData(size, data);
 }
 
 void GLSharedGroup::updateBufferData(GLuint bufferId, GLsizeiptr size, const void* data) {
 
-    AutoLock<Lock> _lock(m_lock);
+    WriteLock _lock(this);
 
     BufferData* currentBuffer = findObjectOrDefault(m_buffers, bufferId);
 
@@ -324,7 +491,7 @@ void GLSharedGroup::updateBufferData(GLuint bufferId, GLsizeiptr size, const voi
 
 void GLSharedGroup::setBufferUsage(GLuint bufferId, GLenum usage) {
 
-    AutoLock<Lock> _lock(m_lock);
+    WriteLock _lock(this);
 
     BufferData* data = findObjectOrDefault(m_buffers, bufferId);
 
@@ -357,7 +524,7 @@ bool GLSharedGroup::isBufferMapped(GLuint bufferId) {
 
 GLenum GLSharedGroup::subUpdateBufferData(GLuint bufferId, GLintptr offset, GLsizeiptr size, const void* data) {
 
-    AutoLock<Lock> _lock(m_lock);
+    WriteLock _lock(this);
 
     BufferData* buf = findObjectOrDefault(m_buffers, bufferId);
 
@@ -373,7 +540,7 @@ GLenum GLSharedGroup::subUpdateBufferData(GLuint bufferId, GLintptr offset, GLsi
 
 void GLSharedGroup::deleteBufferData(GLuint bufferId) {
 
-    AutoLock<Lock> _lock(m_lock);
+    WriteLock _lock(this);
 
     BufferData* buf = findObjectOrDefault(m_buffers, bufferId);
     if (buf) {
@@ -384,7 +551,7 @@ void GLSharedGroup::deleteBufferData(GLuint bufferId) {
 
 void GLSharedGroup::addProgramData(GLuint program) {
 
-    AutoLock<Lock> _lock(m_lock);
+    WriteLock _lock(this);
 
     ProgramData* pData = findObjectOrDefault(m_programs, program);
     if (pData) {
@@ -396,7 +563,7 @@ void GLSharedGroup::addProgramData(GLuint program) {
 
 void GLSharedGroup::initProgramData(GLuint program, GLuint numIndexes, GLuint numAttributes) {
 
-    AutoLock<Lock> _lock(m_lock);
+    WriteLock _lock(this);
 
     ProgramData* pData = findObjectOrDefault(m_programs, program);
     if (pData) {
@@ -405,7 +572,7 @@ void GLSharedGroup::initProgramData(GLuint program, GLuint numIndexes, GLuint nu
 }
 
 void GLSharedGroup::refProgramData(GLuint program) {
-    AutoLock<Lock> _lock(m_lock);
+    WriteLock _lock(this);
     ProgramData* pData = findObjectOrDefault(m_programs, program);
     if (!pData) return;
     pData->incRef();
@@ -414,7 +581,7 @@ void GLSharedGroup::refProgramData(GLuint program) {
 void GLSharedGroup::onUseProgram(GLuint previous, GLuint next) {
     if (previous == next) return;
 
-    AutoLock<Lock> _lock(m_lock);
+    WriteLock _lock(this);
 
     if (previous) {
         deleteProgramDataLocked(previous);
@@ -427,7 +594,7 @@ void GLSharedGroup::onUseProgram(GLuint previous, GLuint next) {
 
 bool GLSharedGroup::isProgramInitialized(GLuint program) {
 
-    AutoLock<Lock> _lock(m_lock);
+    ReadLock _lock(this);
 
     ProgramData* pData = findObjectOrDefault(m_programs, program);
 
@@ -435,12 +602,7 @@ bool GLSharedGroup::isProgramInitialized(GLuint program) {
         return pData->isInitialized();
     }
 
-    if (m_shaderProgramIdMap.find(program) == m_shaderProgramIdMap.end()) {
-        return false;
-    }
-
-    ShaderProgramData* shaderProgramData =
-        findObjectOrDefault(m_shaderPrograms, m_shaderProgramIdMap[program]);
+    ShaderProgramData* shaderProgramData = getShaderProgramDataLocked(program);
 
     if (shaderProgramData) {
         return shaderProgramData->programData.isInitialized();
@@ -450,7 +612,7 @@ bool GLSharedGroup::isProgramInitialized(GLuint program) {
 }
 
 void GLSharedGroup::deleteProgramData(GLuint program) {
-    AutoLock<Lock> _lock(m_lock);
+    WriteLock _lock(this);
     deleteProgramDataLocked(program);
 }
 
@@ -468,22 +630,20 @@ void GLSharedGroup::deleteProgramDataLocked(GLuint program) {
         m_programs.erase(program);
     }
 
-    if (m_shaderProgramIdMap.find(program) ==
-        m_shaderProgramIdMap.end()) return;
+    const uint32_t* spId = m_shaderProgramIdMap.get_const(program);
+    if (!spId) return;
 
-    ShaderProgramData* spData =
-        findObjectOrDefault(
-            m_shaderPrograms, m_shaderProgramIdMap[program]);
+    ShaderProgramData* spData = findObjectOrDefault(m_shaderPrograms, *spId);
 
     if (spData) delete spData;
 
-    m_shaderPrograms.erase(m_shaderProgramIdMap[program]);
+    m_shaderPrograms.erase(*spId);
     m_shaderProgramIdMap.erase(program);
 }
 
 // No such thing for separable shader programs.
 bool GLSharedGroup::attachShader(GLuint program, GLuint shader) {
-    AutoLock<Lock> _lock(m_lock);
+    WriteLock _lock(this);
 
     ProgramData* pData = findObjectOrDefault(m_programs, program);
     ShaderData* sData = findObjectOrDefault(m_shaders, shader);
@@ -501,7 +661,7 @@ bool GLSharedGroup::attachShader(GLuint program, GLuint shader) {
 }
 
 bool GLSharedGroup::detachShader(GLuint program, GLuint shader) {
-    AutoLock<Lock> _lock(m_lock);
+    WriteLock _lock(this);
     return detachShaderLocked(program, shader);
 }
 
@@ -526,7 +686,7 @@ void GLSharedGroup::setProgramIndexInfo(
     GLuint program, GLuint index, GLint base,
     GLint size, GLenum type, const char* name) {
 
-    AutoLock<Lock> _lock(m_lock);
+    WriteLock _lock(this);
 
     ProgramData* pData = findObjectOrDefault(m_programs, program);
 
@@ -560,7 +720,7 @@ void GLSharedGroup::setProgramAttribInfo(
     GLuint program, GLuint index, GLint attribLoc,
     GLint size, GLenum type, const char* name) {
 
-    AutoLock<Lock> _lock(m_lock);
+    WriteLock _lock(this);
 
     ProgramData* pData = getProgramDataLocked(program);
 
@@ -571,7 +731,7 @@ void GLSharedGroup::setProgramAttribInfo(
 
 GLenum GLSharedGroup::getProgramUniformType(GLuint program, GLint location) {
 
-    AutoLock<Lock> _lock(m_lock);
+    ReadLock _lock(this);
 
     ProgramData* pData = findObjectOrDefault(m_programs, program);
     GLenum type = 0;
@@ -580,12 +740,7 @@ GLenum GLSharedGroup::getProgramUniformType(GLuint program, GLint location) {
         type = pData->getTypeForLocation(location);
     }
 
-    if (m_shaderProgramIdMap.find(program) ==
-        m_shaderProgramIdMap.end()) return type;
-
-    ShaderProgramData* spData =
-        findObjectOrDefault(
-            m_shaderPrograms, m_shaderProgramIdMap[program]);
+    ShaderProgramData* spData = getShaderProgramDataLocked(program);
 
     if (spData) {
         type = spData->programData.getTypeForLocation(location);
@@ -596,17 +751,13 @@ GLenum GLSharedGroup::getProgramUniformType(GLuint program, GLint location) {
 
 bool GLSharedGroup::isProgram(GLuint program) {
 
-    AutoLock<Lock> _lock(m_lock);
+    ReadLock _lock(this);
 
     ProgramData* pData = findObjectOrDefault(m_programs, program);
 
     if (pData) return true;
 
-    if (m_shaderProgramIdMap.find(program) ==
-        m_shaderProgramIdMap.end()) return false;
-
-    ShaderProgramData* spData =
-        findObjectOrDefault(m_shaderPrograms, m_shaderProgramIdMap[program]);
+    ShaderProgramData* spData = getShaderProgramDataLocked(program);
 
     if (spData) return true;
 
@@ -616,19 +767,13 @@ bool GLSharedGroup::isProgram(GLuint program) {
 GLint GLSharedGroup::getNextSamplerUniform(
     GLuint program, GLint index, GLint* val, GLenum* target) {
 
-    AutoLock<Lock> _lock(m_lock);
+    ReadLock _lock(this);
 
     ProgramData* pData = findObjectOrDefault(m_programs, program);
 
     if (pData) return pData->getNextSamplerUniform(index, val, target);
 
-    if (m_shaderProgramIdMap.find(program) ==
-        m_shaderProgramIdMap.end()) return -1;
-
-    ShaderProgramData* spData =
-        findObjectOrDefault(
-            m_shaderPrograms,
-            findObjectOrDefault(m_shaderProgramIdMap, program));
+    ShaderProgramData* spData = getShaderProgramDataLocked(program);
 
     if (spData) return spData->programData.getNextSamplerUniform(index, val, target);
 
@@ -638,18 +783,14 @@ GLint GLSharedGroup::getNextSamplerUniform(
 bool GLSharedGroup::setSamplerUniform(
     GLuint program, GLint appLoc, GLint val, GLenum* target) {
 
-    AutoLock<Lock> _lock(m_lock);
+    WriteLock _lock(this);
 
     ProgramData* pData =
         findObjectOrDefault(m_programs, program);
 
     if (pData) return pData->setSamplerUniform(appLoc, val, target);
 
-    if (m_shaderProgramIdMap.find(program) ==
-        m_shaderProgramIdMap.end()) return false;
-
-    ShaderProgramData* spData =
-        findObjectOrDefault(m_shaderPrograms, m_shaderProgramIdMap[program]);
+    ShaderProgramData* spData = getShaderProgramDataLocked(program);
 
     if (spData) return spData->programData.setSamplerUniform(appLoc, val, target);
 
@@ -659,7 +800,7 @@ bool GLSharedGroup::setSamplerUniform(
 bool GLSharedGroup::isProgramUniformLocationValid(GLuint program, GLint location) {
     if (location < 0) return false;
 
-    AutoLock<Lock> _lock(m_lock);
+    ReadLock _lock(this);
 
     ProgramData* pData =
         findObjectOrDefault(m_programs, program);
@@ -671,7 +812,7 @@ bool GLSharedGroup::isProgramUniformLocationValid(GLuint program, GLint location
 
 bool GLSharedGroup::isShader(GLuint shader) {
 
-    AutoLock<Lock> _lock(m_lock);
+    ReadLock _lock(this);
 
     ShaderData* pData = findObjectOrDefault(m_shaders, shader);
 
@@ -680,7 +821,7 @@ bool GLSharedGroup::isShader(GLuint shader) {
 
 bool GLSharedGroup::addShaderData(GLuint shader, GLenum shaderType) {
 
-    AutoLock<Lock> _lock(m_lock);
+    WriteLock _lock(this);
 
     ShaderData* data = new ShaderData;
 
@@ -695,14 +836,14 @@ bool GLSharedGroup::addShaderData(GLuint shader, GLenum shaderType) {
 
 ShaderData* GLSharedGroup::getShaderData(GLuint shader) {
 
-    AutoLock<Lock> _lock(m_lock);
+    ReadLock _lock(this);
 
     return findObjectOrDefault(m_shaders, shader);
 }
 
 void GLSharedGroup::unrefShaderData(GLuint shader) {
 
-    AutoLock<Lock> _lock(m_lock);
+    WriteLock _lock(this);
 
     unrefShaderDataLocked(shader);
 }
@@ -729,18 +870,20 @@ ProgramData* GLSharedGroup::getProgramDataLocked(GLuint program) {
 
     if (pData) return pData;
 
-    std::map<GLuint, uint32_t>::const_iterator it =
-        m_shaderProgramIdMap.find(program);
-    if (it == m_shaderProgramIdMap.end()) return NULL;
-
-    ShaderProgramData* spData = findObjectOrDefault(m_shaderPrograms, it->second);
+    ShaderProgramData* spData = getShaderProgramDataLocked(program);
     if (!spData) return NULL;
     return &spData->programData;
 }
 
+ShaderProgramData* GLSharedGroup::getShaderProgramDataLocked(GLuint shaderProgramName) {
+    const uint32_t* id = m_shaderProgramIdMap.get_const(shaderProgramName);
+    if (!id) return NULL;
+    return findObjectOrDefault(m_shaderPrograms, *id);
+}
+
 uint32_t GLSharedGroup::addNewShaderProgramData() {
 
-    AutoLock<Lock> _lock(m_lock);
+    WriteLock _lock(this);
 
     ShaderProgramData* data = new ShaderProgramData;
     uint32_t currId = m_shaderProgramId;
@@ -753,14 +896,14 @@ uint32_t GLSharedGroup::addNewShaderProgramData() {
 void GLSharedGroup::associateGLShaderProgram(
     GLuint shaderProgramName, uint32_t shaderProgramId) {
 
-    AutoLock<Lock> _lock(m_lock);
+    WriteLock _lock(this);
 
     m_shaderProgramIdMap[shaderProgramName] = shaderProgramId;
 }
 
 ShaderProgramData* GLSharedGroup::getShaderProgramDataById(uint32_t id) {
 
-    AutoLock<Lock> _lock(m_lock);
+    ReadLock _lock(this);
 
     ShaderProgramData* res = findObjectOrDefault(m_shaderPrograms, id);
 
@@ -770,15 +913,14 @@ ShaderProgramData* GLSharedGroup::getShaderProgramDataById(uint32_t id) {
 ShaderProgramData* GLSharedGroup::getShaderProgramData(
     GLuint shaderProgramName) {
 
-    AutoLock<Lock> _lock(m_lock);
+    ReadLock _lock(this);
 
-    return findObjectOrDefault(m_shaderPrograms,
-                               m_shaderProgramIdMap[shaderProgramName]);
+    return getShaderProgramDataLocked(shaderProgramName);
 }
 
 void GLSharedGroup::deleteShaderProgramDataById(uint32_t id) {
 
-    AutoLock<Lock> _lock(m_lock);
+    WriteLock _lock(this);
 
     ShaderProgramData* data =
         findObjectOrDefault(m_shaderPrograms, id);
@@ -791,9 +933,9 @@ void GLSharedGroup::deleteShaderProgramDataById(uint32_t id) {
 
 void GLSharedGroup::deleteShaderProgramData(GLuint shaderProgramName) {
 
-    AutoLock<Lock> _lock(m_lock);
+    WriteLock _lock(this);
 
-    uint32_t id = m_shaderProgramIdMap[shaderProgramName];
+    uint32_t id = findObjectOrDefault(m_shaderProgramIdMap, shaderProgramName);
     ShaderProgramData* data = findObjectOrDefault(m_shaderPrograms, id);
 
     delete data;
@@ -838,7 +980,7 @@ void GLSharedGroup::setShaderProgramIndexInfo(
 UniformValidationInfo GLSharedGroup::getUniformValidationInfo(GLuint program) {
     UniformValidationInfo res;
 
-    AutoLock<Lock> _lock(m_lock);
+    ReadLock _lock(this);
 
     ProgramData* pData =
         getProgramDataLocked(program);
@@ -852,7 +994,7 @@ UniformValidationInfo GLSharedGroup::getUniformValidationInfo(GLuint program) {
 AttribValidationInfo GLSharedGroup::getAttribValidationInfo(GLuint program) {
     AttribValidationInfo res;
 
-    AutoLock<Lock> _lock(m_lock);
+    ReadLock _lock(this);
 
     ProgramData* pData =
         getProgramDataLocked(program);
@@ -863,8 +1005,29 @@ AttribValidationInfo GLSharedGroup::getAttribValidationInfo(GLuint program) {
     return pData->compileAttribValidationInfo(&error);
 }
 
+bool GLSharedGroup::updateProgramUniformShadow(
+    GLuint program, GLint location, GLsizei count, uint32_t kind, const void* data) {
+    // Shared: the program's own lock serializes writers to its shadow.
+    ReadLock _lock(this);
+    ProgramData* pData = getProgramDataLocked(program);
+    if (!pData) return false;
+    return pData->updateUniformShadow(location, count, kind, data,
+                                      m_uniformShadowEpoch.load(std::memory_order_acquire));
+}
+
+void GLSharedGroup::clearProgramUniformShadow(GLuint program) {
+    ReadLock _lock(this);
+    ProgramData* pData = getProgramDataLocked(program);
+    if (!pData) return;
+    pData->clearUniformShadow();
+}
+
+void GLSharedGroup::clearAllUniformShadows() {
+    m_uniformShadowEpoch.fetch_add(1, std::memory_order_acq_rel);
+}
+
 void GLSharedGroup::setProgramLinkStatus(GLuint program, GLint linkStatus) {
-    AutoLock<Lock> _lock(m_lock);
+    WriteLock _lock(this);
     ProgramData* pData =
         getProgramDataLocked(program);
     if (!pData) return;
@@ -872,14 +1035,14 @@ void GLSharedGroup::setProgramLinkStatus(GLuint program, GLint linkStatus) {
 }
 
 GLint GLSharedGroup::getProgramLinkStatus(GLuint program) {
-    AutoLock<Lock> _lock(m_lock);
+    ReadLock _lock(this);
     ProgramData* pData = getProgramDataLocked(program);
     if (!pData) return 0;
     return pData->getLinkStatus();
 }
 
 void GLSharedGroup::setActiveUniformBlockCountForProgram(GLuint program, GLint count) {
-    AutoLock<Lock> _lock(m_lock);
+    WriteLock _lock(this);
     ProgramData* pData =
         getProgramDataLocked(program);
 
@@ -889,7 +1052,7 @@ void GLSharedGroup::setActiveUniformBlockCountForProgram(GLuint program, GLint c
 }
 
 GLint GLSharedGroup::getActiveUniformBlockCount(GLuint program) {
-    AutoLock<Lock> _lock(m_lock);
+    ReadLock _lock(this);
     ProgramData* pData =
         getProgramDataLocked(program);
 
@@ -899,21 +1062,21 @@ GLint GLSharedGroup::getActiveUniformBlockCount(GLuint program) {
 }
 
 void GLSharedGroup::setTransformFeedbackVaryingsCountForProgram(GLuint program, GLint count) {
-    AutoLock<Lock> _lock(m_lock);
+    WriteLock _lock(this);
     ProgramData* pData = getProgramDataLocked(program);
     if (!pData) return;
     pData->setTransformFeedbackVaryingsCount(count);
 }
 
 GLint GLSharedGroup::getTransformFeedbackVaryingsCountForProgram(GLuint program) {
-    AutoLock<Lock> _lock(m_lock);
+    ReadLock _lock(this);
     ProgramData* pData = getProgramDataLocked(program);
     if (!pData) return 0;
     return pData->getTransformFeedbackVaryingsCount();
 }
 
 int GLSharedGroup::getActiveUniformsCountForProgram(GLuint program) {
-    AutoLock<Lock> _lock(m_lock);
+    ReadLock _lock(this);
     ProgramData* pData =
         getProgramDataLocked(program);
 
@@ -923,7 +1086,7 @@ int GLSharedGroup::getActiveUniformsCountForProgram(GLuint program) {
 }
 
 int GLSharedGroup::getActiveAttributesCountForProgram(GLuint program) {
-    AutoLock<Lock> _lock(m_lock);
+    ReadLock _lock(this);
     ProgramData* pData =
         getProgramDataLocked(program);
 
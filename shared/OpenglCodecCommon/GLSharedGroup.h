@@ -29,9 +29,11 @@
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
 
+#include <atomic>
 #include <map>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <stdio.h>
@@ -40,9 +42,11 @@
 #include "auto_goldfish_dma_context.h"
 #include "IndexRangeCache.h"
 #include "StateTrackingSupport.h"
+#include "android/base/containers/SlotTable.h"
 
 using android::base::guest::AutoLock;
 using android::base::guest::Lock;
+using android::base::guest::ReadWriteLock;
 
 struct BufferData {
     BufferData();
@@ -99,11 +103,28 @@ private:
     uint32_t m_activeUniformBlockCount;
     uint32_t m_transformFeedbackVaryingsCount;;
 
+    // Last uniform values sent to the host, one entry per location (array
+    // elements have consecutive locations). |kind| records the entry point
+    // that wrote the value, see uniformShadowKind().
+    typedef struct _UniformShadowValue {
+        uint32_t kind;
+        uint32_t words[16];
+    } UniformShadowValue;
+    // glUniform* only holds the share group lock shared, so the shadow and
+    // its epoch are guarded by their own per-program lock.
+    Lock m_uniformShadowLock;
+    std::unordered_map<GLint, UniformShadowValue> m_uniformShadow;
+    uint32_t m_uniformShadowEpoch = 0;
+
 public:
     enum {
         INDEX_FLAG_SAMPLER_EXTERNAL = 0x00000001,
     };
 
+    // |baseType| is GL_FLOAT, GL_INT or GL_UNSIGNED_INT.
+    static uint32_t uniformShadowKind(GLenum baseType, GLint columns, GLint rows,
+                                      GLboolean transpose);
+
     ProgramData();
     void initProgramData(GLuint numIndexes, GLuint numAttributes);
     bool isInitialized();
@@ -118,6 +139,17 @@ public:
     GLint getNextSamplerUniform(GLint index, GLint* val, GLenum* target);
     bool setSamplerUniform(GLint appLoc, GLint val, GLenum* target);
 
+    // Returns true if |count| elements starting at |location| already hold
+    // |data|, written by the same kind of call. Otherwise records |data| and
+    // returns false. Calls the host would reject are never recorded. The
+    // shadow is dropped first if it predates the share group's |epoch|.
+    bool updateUniformShadow(GLint location, GLsizei count, uint32_t kind,
+                             const void* data, uint32_t epoch);
+    void clearUniformShadow() {
+        AutoLock<Lock> lock(m_uniformShadowLock);
+        m_uniformShadow.clear();
+    }
+
     bool attachShader(GLuint shader, GLenum shaderType);
     bool detachShader(GLuint shader);
     size_t getNumShaders() const { return m_shaders.size(); }
@@ -173,28 +205,65 @@ public:
     ProgramData programData;
 };
 
+// Counters for the GLSharedGroup object lock. Only collected while enabled
+// with GLSharedGroup::setLockStatsEnabled(); times are in nanoseconds.
+struct GLSharedGroupLockStats {
+    uint64_t readAcquires;
+    uint64_t writeAcquires;
+    uint64_t contendedReadAcquires;
+    uint64_t contendedWriteAcquires;
+    uint64_t waitNs;
+    uint64_t readHoldNs;
+    uint64_t writeHoldNs;
+};
+
 class GLSharedGroup {
 private:
     SharedTextureDataMap m_textureRecs;
-    std::map<GLuint, BufferData*> m_buffers;
-    std::map<GLuint, ProgramData*> m_programs;
-    std::map<GLuint, ShaderData*> m_shaders;
-    std::map<uint32_t, ShaderProgramData*> m_shaderPrograms;
-    std::map<GLuint, uint32_t> m_shaderProgramIdMap;
+    android::base::SlotTable<GLuint, BufferData*> m_buffers;
+    android::base::SlotTable<GLuint, ProgramData*> m_programs;
+    android::base::SlotTable<GLuint, ShaderData*> m_shaders;
+    android::base::SlotTable<uint32_t, ShaderProgramData*> m_shaderPrograms;
+    android::base::SlotTable<GLuint, uint32_t> m_shaderProgramIdMap;
     RenderbufferInfo m_renderbufferInfo;
     SamplerInfo m_samplerInfo;
 
-    Lock m_lock;
+    // Queries that only read the object tables take |m_lock| shared, so
+    // contexts drawing on different threads don't serialize on each other.
+    ReadWriteLock m_lock;
+
+    template <bool exclusive> class ScopedLock;
+    typedef ScopedLock<false> ReadLock;
+    typedef ScopedLock<true> WriteLock;
+    struct LockCounters {
+        std::atomic<uint64_t> readAcquires{0};
+        std::atomic<uint64_t> writeAcquires{0};
+        std::atomic<uint64_t> contendedReadAcquires{0};
+        std::atomic<uint64_t> contendedWriteAcquires{0};
+        std::atomic<uint64_t> waitNs{0};
+        std::atomic<uint64_t> readHoldNs{0};
+        std::atomic<uint64_t> writeHoldNs{0};
+    };
+    std::atomic<bool> m_lockStatsEnabled{false};
+    LockCounters m_lockCounters;
 
     void refShaderDataLocked(GLuint shader);
     void unrefShaderDataLocked(GLuint shader);
 
     uint32_t m_shaderProgramId;
+    // Bumped to invalidate every program's uniform shadow at once.
+    std::atomic<uint32_t> m_uniformShadowEpoch{0};
 
     ProgramData* getProgramDataLocked(GLuint program);
+    ShaderProgramData* getShaderProgramDataLocked(GLuint shaderProgramName);
 public:
     GLSharedGroup();
     ~GLSharedGroup();
+
+    void setLockStatsEnabled(bool enabled);
+    GLSharedGroupLockStats getLockStats() const;
+    void resetLockStats();
+
     bool isShaderOrProgramObject(GLuint obj);
     BufferData * getBufferData(GLuint bufferId);
     SharedTextureDataMap* getTextureData();
@@ -222,6 +291,10 @@ public:
     void    deleteProgramDataLocked(GLuint program);
     void    setProgramIndexInfo(GLuint program, GLuint index, GLint base, GLint size, GLenum type, const char* name);
     void    setProgramAttribInfo(GLuint program, GLuint index, GLint attribLoc, GLint size, GLenum type, const char* name);
+    bool    updateProgramUniformShadow(GLuint program, GLint location, GLsizei count, uint32_t kind, const void* data);
+    void    clearProgramUniformShadow(GLuint program);
+    // For uniform writes whose target program is not known to the guest.
+    void    clearAllUniformShadows();
     GLenum  getProgramUniformType(GLuint program, GLint location);
     GLint   getNextSamplerUniform(GLuint program, GLint index, GLint* val, GLenum* target);
     bool    setSamplerUniform(GLuint program, GLint appLoc, GLint val, GLenum* target);
@@ -15,6 +15,8 @@
 */
 #pragma once
 
+#include "android/base/containers/SlotTable.h"
+
 #include <map>
 
 template <typename T>
@@ -36,3 +38,21 @@ V findObjectOrDefault(const std::map<K, V>& m, K key, V defaultValue = 0) {
 
     return it->second;
 }
+
+template <typename T, size_t pageBits, size_t maxDenseKey>
+void clearObjectMap(android::base::SlotTable<GLuint, T, pageBits, maxDenseKey>& v) {
+    v.forEach([](GLuint, T& obj) { delete obj; });
+    v.clear();
+}
+
+template <typename K, typename V, size_t pageBits, size_t maxDenseKey>
+V findObjectOrDefault(const android::base::SlotTable<K, V, pageBits, maxDenseKey>& m,
+                      K key, V defaultValue = 0) {
+    const V* res = m.get_const(key);
+
+    if (!res) {
+        return defaultValue;
+    }
+
+    return *res;
+}
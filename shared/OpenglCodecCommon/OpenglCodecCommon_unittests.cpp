@@ -0,0 +1,75 @@
+// Copyright (C) 2022 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <gtest/gtest.h>
+
+#include "GLClientState.h"
+
+namespace android {
+namespace base {
+namespace guest {
+
+// Tests that a texture record that was not created as a cube map (here the
+// default texture 0, first bound as GL_TEXTURE_2D) can be bound and specified
+// as one.
+TEST(GLClientState, CubeFacesOfNonCubeTexture) {
+    SharedTextureDataMap texData;
+    GLClientState state(3, 0);
+    state.setTextureData(&texData);
+
+    EXPECT_EQ((GLenum)GL_NO_ERROR, state.bindTexture(GL_TEXTURE_2D, 0, nullptr));
+    EXPECT_EQ((GLenum)GL_NO_ERROR, state.bindTexture(GL_TEXTURE_CUBE_MAP, 0, nullptr));
+
+    state.setBoundTextureDims(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_CUBE_MAP_NEGATIVE_X, 0, 4, 4, 1);
+    state.addTextureCubeMapImage(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_CUBE_MAP_NEGATIVE_X);
+    state.addTextureCubeMapImage(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_CUBE_MAP_POSITIVE_X);
+    state.addTextureCubeMapImage(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_CUBE_MAP_NEGATIVE_Y);
+    state.addTextureCubeMapImage(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_CUBE_MAP_POSITIVE_Y);
+    state.addTextureCubeMapImage(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_CUBE_MAP_NEGATIVE_Z);
+    state.addTextureCubeMapImage(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_CUBE_MAP_POSITIVE_Z);
+    // Only the -X face has levels; the others have never been written.
+    EXPECT_FALSE(state.isBoundTextureComplete(GL_TEXTURE_CUBE_MAP));
+
+    state.setBoundTextureDims(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, 4, 4, 1);
+    EXPECT_FALSE(state.isBoundTextureComplete(GL_TEXTURE_CUBE_MAP));
+
+    state.setBoundTextureDims(GL_TEXTURE_CUBE_MAP, -1, 0, 4, 4, 1);
+    EXPECT_TRUE(state.isBoundTextureComplete(GL_TEXTURE_CUBE_MAP));
+
+    GLuint tex = 0;
+    state.deleteTextures(1, &tex);
+}
+
+// Tests that packed texture format info reads back as specified, and as -1
+// before it is specified.
+TEST(GLClientState, TextureFormatInfo) {
+    SharedTextureDataMap texData;
+    GLClientState state(3, 0);
+    state.setTextureData(&texData);
+
+    GLuint tex = 1;
+    EXPECT_EQ((GLenum)GL_NO_ERROR, state.bindTexture(GL_TEXTURE_2D, tex, nullptr));
+    EXPECT_EQ(-1, state.queryTexInternalFormat(tex));
+    EXPECT_EQ((GLenum)-1, state.queryTexFormat(tex));
+
+    state.setBoundTextureInternalFormat(GL_TEXTURE_2D, GL_COMPRESSED_RGBA_ASTC_12x12_KHR);
+    state.setBoundTextureFormat(GL_TEXTURE_2D, GL_RGBA);
+    EXPECT_EQ(GL_COMPRESSED_RGBA_ASTC_12x12_KHR, state.queryTexInternalFormat(tex));
+    EXPECT_EQ((GLenum)GL_RGBA, state.queryTexFormat(tex));
+
+    state.deleteTextures(1, &tex);
+}
+
+} // namespace android
+} // namespace base
+} // namespace guest
@@ -17,33 +17,127 @@
 #define _GL_TEXTURE_SHARED_DATA_H_
 
 #include <GLES/gl.h>
-#include <map>
+#include <stdint.h>
+#include <string.h>
 
+#include "android/base/containers/SlotTable.h"
+
+// Mip chains are at most log2(GL_MAX_TEXTURE_SIZE) + 1 levels long; 16 levels
+// covers every size up to 32768, beyond what any host reports.
+#define TEXTURE_DIMS_MAX_LEVELS 16
+
+// Per-level dimensions of one texture image (or one cube map face), stored
+// inline. Sizes are bounded by the host's max texture size / layer count, so
+// 16 bits per dimension is enough; anything larger saturates.
 struct TextureDims {
-    std::map<GLsizei, GLsizei> widths;
-    std::map<GLsizei, GLsizei> heights;
-    std::map<GLsizei, GLsizei> depths;
+    uint16_t definedLevels;  // bit i is set once level i has been specified
+    uint16_t widths[TEXTURE_DIMS_MAX_LEVELS];
+    uint16_t heights[TEXTURE_DIMS_MAX_LEVELS];
+    uint16_t depths[TEXTURE_DIMS_MAX_LEVELS];
+
+    void clear() { memset(this, 0, sizeof(*this)); }
+
+    // Returns false if |level| is beyond the supported mip chain.
+    bool setLevel(GLsizei level, GLsizei width, GLsizei height, GLsizei depth) {
+        if (level < 0 || level >= TEXTURE_DIMS_MAX_LEVELS) return false;
+        widths[level] = clampDim(width);
+        heights[level] = clampDim(height);
+        depths[level] = clampDim(depth);
+        definedLevels |= (uint16_t)(1u << level);
+        return true;
+    }
+
+    bool hasLevel(GLsizei level) const {
+        return level >= 0 && level < TEXTURE_DIMS_MAX_LEVELS &&
+               (definedLevels & (1u << level));
+    }
+
+    // Undefined levels read as 0.
+    GLsizei width(GLsizei level) const { return hasLevel(level) ? widths[level] : 0; }
+    GLsizei height(GLsizei level) const { return hasLevel(level) ? heights[level] : 0; }
+    GLsizei depth(GLsizei level) const { return hasLevel(level) ? depths[level] : 0; }
+
+    // Lowest specified level, or -1 if none.
+    GLsizei baseLevel() const {
+        return definedLevels ? (GLsizei)__builtin_ctz(definedLevels) : -1;
+    }
+
+    static uint16_t clampDim(GLsizei dim) {
+        return dim <= 0 ? 0 : (dim > 0xffff ? 0xffff : (uint16_t)dim);
+    }
 };
 
+// Sentinel for a format/internalformat/type that has not been specified yet;
+// reads back as -1, which is what the queries report for unknown textures.
+#define TEXTURE_FORMAT_UNSET 0xffff
+
 struct TextureRec {
     GLuint id;
     GLenum target;
-    GLint internalformat;
-    GLenum format;
-    GLenum type;
-    GLsizei multisamples;
-    TextureDims* dims;
-    bool immutable;
-    bool boundEGLImage;
-    bool hasStorage;
-    bool hasCubeNegX;
-    bool hasCubePosX;
-    bool hasCubeNegY;
-    bool hasCubePosY;
-    bool hasCubeNegZ;
-    bool hasCubePosZ;
+    // Format info packed into 16 bits each: every GL/GLES internalformat,
+    // format and type enum is below 0x10000, and sample counts are bounded by
+    // GL_MAX_SAMPLES. Use the accessors below, which map TEXTURE_FORMAT_UNSET
+    // back to -1.
+    uint16_t packedInternalFormat;
+    uint16_t packedFormat;
+    uint16_t packedType;
+    uint16_t multisamples;
+    bool immutable : 1;
+    bool boundEGLImage : 1;
+    bool hasStorage : 1;
+    bool hasCubeNegX : 1;
+    bool hasCubePosX : 1;
+    bool hasCubeNegY : 1;
+    bool hasCubePosY : 1;
+    bool hasCubeNegZ : 1;
+    bool hasCubePosZ : 1;
+    // Level 0..n dimensions of the texture, or of the -X face of a cube map.
+    TextureDims dims;
+    // Remaining five cube faces, in GL_TEXTURE_CUBE_MAP_POSITIVE_X.. order.
+    // Allocated on first write to one of them; any record can end up bound
+    // as a cube map (texture 0, EXTERNAL_OES recs), not just ones created
+    // as GL_TEXTURE_CUBE_MAP.
+    TextureDims* cubeFaceDims;
+
+    GLint internalformat() const { return unpackFormat(packedInternalFormat); }
+    GLenum format() const { return unpackFormat(packedFormat); }
+    GLenum type() const { return unpackFormat(packedType); }
+    void setInternalformat(GLint v) { packedInternalFormat = packFormat(v); }
+    void setFormat(GLenum v) { packedFormat = packFormat(v); }
+    void setType(GLenum v) { packedType = packFormat(v); }
+    void setMultisamples(GLsizei samples) {
+        multisamples = TextureDims::clampDim(samples);
+    }
+
+    // |face| is 0 for non-cube textures and 0..5 for cube map faces.
+    TextureDims& dimsForFace(size_t face) {
+        if (!face) return dims;
+        if (!cubeFaceDims) {
+            cubeFaceDims = new TextureDims[5];
+            for (int i = 0; i < 5; ++i) {
+                cubeFaceDims[i].clear();
+            }
+        }
+        return cubeFaceDims[face - 1];
+    }
+
+    // Faces that were never written read as having no levels defined.
+    const TextureDims& dimsForFace(size_t face) const {
+        static const TextureDims kNoLevels = TextureDims();
+        if (!face) return dims;
+        return cubeFaceDims ? cubeFaceDims[face - 1] : kNoLevels;
+    }
+
+    static uint16_t packFormat(GLint v) {
+        return (v < 0 || v >= TEXTURE_FORMAT_UNSET) ? TEXTURE_FORMAT_UNSET
+                                                    : (uint16_t)v;
+    }
+
+    static GLint unpackFormat(uint16_t v) {
+        return v == TEXTURE_FORMAT_UNSET ? -1 : (GLint)v;
+    }
 };
 
-typedef std::map<GLuint, TextureRec*> SharedTextureDataMap;
+typedef android::base::SlotTable<GLuint, TextureRec*> SharedTextureDataMap;
 
 #endif
@@ -17,6 +17,7 @@
 #include "glUtils.h"
 #include <log/log.h>
 #include <assert.h>
+#include <string.h>
 #include <vector>
 
 #ifndef MIN
@@ -394,10 +395,155 @@ void GLEncoder::s_glDeleteBuffers(void * self, GLsizei n, const GLuint * buffers
     }
 }
 
+// FNV-1a over 64-bit words; only used to pick a candidate cache entry, which
+// is then compared byte for byte.
+static uint64_t hashVertexData(const char* data, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 0x100000001b3ULL;
+    }
+    for (; i < size; ++i) {
+        hash = (hash ^ (unsigned char)data[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+GLuint GLEncoder::uploadInterleavedVertexData()
+{
+    const size_t size = m_interleavedVertexData.size();
+    const uint64_t hash = hashVertexData(m_interleavedVertexData.data(), size);
+    ++m_vertexUploadTick;
+
+    VertexUploadCacheEntry* victim = &m_vertexUploadCache[0];
+    for (size_t i = 0; i < kVertexUploadCacheSize; ++i) {
+        VertexUploadCacheEntry& entry = m_vertexUploadCache[i];
+        if (entry.buffer && entry.hash == hash && entry.data == m_interleavedVertexData) {
+            entry.lastUse = m_vertexUploadTick;
+            m_glBindBuffer_enc(this, GL_ARRAY_BUFFER, entry.buffer);
+            m_vertexUploadStats.bytesDeduplicated += size;
+            return entry.buffer;
+        }
+        if (entry.lastUse < victim->lastUse) victim = &entry;
+    }
+
+    if (!victim->buffer) {
+        this->glGenBuffers(this, 1, &victim->buffer);
+        if (!victim->buffer) return 0;
+    }
+    victim->hash = hash;
+    victim->lastUse = m_vertexUploadTick;
+    victim->data = m_interleavedVertexData;
+
+    m_glBindBuffer_enc(this, GL_ARRAY_BUFFER, victim->buffer);
+    m_glBufferData_enc(this, GL_ARRAY_BUFFER, size, victim->data.data(), GL_STREAM_DRAW);
+    m_vertexUploadStats.bytesUploaded += size;
+    return victim->buffer;
+}
+
+void GLEncoder::releaseVertexUploadCache()
+{
+    for (size_t i = 0; i < kVertexUploadCacheSize; ++i) {
+        VertexUploadCacheEntry& entry = m_vertexUploadCache[i];
+        if (entry.buffer) {
+            m_glDeleteBuffers_enc(this, 1, &entry.buffer);
+        }
+    }
+    forgetVertexUploadCache();
+}
+
+void GLEncoder::forgetVertexUploadCache()
+{
+    for (size_t i = 0; i < kVertexUploadCacheSize; ++i) {
+        m_vertexUploadCache[i] = VertexUploadCacheEntry();
+    }
+}
+
+void GLEncoder::sendVertexAttribOffset(int location, const GLClientState::VertexAttribState& state,
+                                       GLsizei stride, uintptr_t offset)
+{
+    switch(location) {
+    case GLClientState::VERTEX_LOCATION:
+        this->glVertexPointerOffset(this, state.size, state.type, stride, offset);
+        break;
+    case GLClientState::NORMAL_LOCATION:
+        this->glNormalPointerOffset(this, state.type, stride, offset);
+        break;
+    case GLClientState::POINTSIZE_LOCATION:
+        this->glPointSizePointerOffset(this, state.type, stride, offset);
+        break;
+    case GLClientState::COLOR_LOCATION:
+        this->glColorPointerOffset(this, state.size, state.type, stride, offset);
+        break;
+    case GLClientState::TEXCOORD0_LOCATION:
+    case GLClientState::TEXCOORD1_LOCATION:
+    case GLClientState::TEXCOORD2_LOCATION:
+    case GLClientState::TEXCOORD3_LOCATION:
+    case GLClientState::TEXCOORD4_LOCATION:
+    case GLClientState::TEXCOORD5_LOCATION:
+    case GLClientState::TEXCOORD6_LOCATION:
+    case GLClientState::TEXCOORD7_LOCATION:
+        this->glTexCoordPointerOffset(this, state.size, state.type, stride, offset);
+        break;
+    case GLClientState::WEIGHT_LOCATION:
+        this->glWeightPointerOffset(this, state.size, state.type, stride, offset);
+        break;
+    case GLClientState::MATRIXINDEX_LOCATION:
+        this->glMatrixIndexPointerOffset(this, state.size, state.type, stride, offset);
+        break;
+    }
+}
+
 void GLEncoder::sendVertexData(unsigned int first, unsigned int count)
 {
     assert(m_state != NULL);
     GLenum prevActiveTexUnit = m_state->getActiveTextureUnit();
+
+    // All arrays that live in client memory are packed, vertex by vertex, into
+    // one interleaved payload that is uploaded once into an encoder-owned
+    // buffer object; each array then points into it by offset. Payloads
+    // identical to a recent upload reuse that buffer without resending.
+    bool interleaved[GLClientState::LAST_LOCATION] = {};
+    GLuint interleavedOffset[GLClientState::LAST_LOCATION] = {};
+    GLsizei interleavedStride = 0;
+    for (int i = 0; i < GLClientState::LAST_LOCATION; i++) {
+        const GLClientState::VertexAttribState& state = m_state->getState(i);
+        if (!state.enabled || state.bufferObject != 0 || !state.data) continue;
+        if (i >= GLClientState::TEXCOORD0_LOCATION &&
+            i <= GLClientState::TEXCOORD7_LOCATION) {
+            m_state->setActiveTextureUnit(i - GLClientState::TEXCOORD0_LOCATION + GL_TEXTURE0);
+            if (m_state->getPriorityEnabledTarget(GL_INVALID_ENUM) == GL_INVALID_ENUM) continue;
+        }
+        interleaved[i] = true;
+        interleavedOffset[i] = interleavedStride;
+        // Keep every attribute 4-byte aligned for the host driver.
+        interleavedStride += (state.elementSize + 3) & ~3u;
+    }
+    m_state->setActiveTextureUnit(prevActiveTexUnit);
+
+    GLuint interleavedBuffer = 0;
+    if (interleavedStride && count) {
+        m_interleavedVertexData.assign((size_t)interleavedStride * count, 0);
+        for (int i = 0; i < GLClientState::LAST_LOCATION; i++) {
+            if (!interleaved[i]) continue;
+            const GLClientState::VertexAttribState& state = m_state->getState(i);
+            int stride = state.stride ? state.stride : state.elementSize;
+            const char* src = (const char*)state.data + stride * first;
+            char* dst = m_interleavedVertexData.data() + interleavedOffset[i];
+            for (unsigned int v = 0; v < count; ++v) {
+                memcpy(dst, src, state.elementSize);
+                src += stride;
+                dst += interleavedStride;
+            }
+            ++m_vertexUploadStats.arraysInterleaved;
+        }
+        interleavedBuffer = uploadInterleavedVertexData();
+        ++m_vertexUploadStats.draws;
+    }
+
     for (int i = 0; i < GLClientState::LAST_LOCATION; i++) {
         bool enableDirty;
         const GLClientState::VertexAttribState& state = m_state->getStateAndEnableDirty(i, &enableDirty);
@@ -419,8 +565,11 @@ void GLEncoder::sendVertexData(unsigned int first, unsigned int count)
             if (stride == 0) stride = state.elementSize;
             int firstIndex = stride * first;
 
-            this->m_glBindBuffer_enc(this, GL_ARRAY_BUFFER, state.bufferObject);
-            if (state.bufferObject == 0) {
+            if (interleaved[i] && interleavedBuffer) {
+                this->m_glBindBuffer_enc(this, GL_ARRAY_BUFFER, interleavedBuffer);
+                sendVertexAttribOffset(i, state, interleavedStride, interleavedOffset[i]);
+            } else if (state.bufferObject == 0) {
+                this->m_glBindBuffer_enc(this, GL_ARRAY_BUFFER, 0);
 
                 switch(i) {
                 case GLClientState::VERTEX_LOCATION:
@@ -463,44 +612,9 @@ void GLEncoder::sendVertexData(unsigned int first, unsigned int count)
                     break;
                 }
             } else {
-
-                switch(i) {
-                case GLClientState::VERTEX_LOCATION:
-                    this->glVertexPointerOffset(this, state.size, state.type, state.stride,
-                                                (uintptr_t)state.data + firstIndex);
-                    break;
-                case GLClientState::NORMAL_LOCATION:
-                    this->glNormalPointerOffset(this, state.type, state.stride,
-                                                (uintptr_t)state.data + firstIndex);
-                    break;
-                case GLClientState::POINTSIZE_LOCATION:
-                    this->glPointSizePointerOffset(this, state.type, state.stride,
-                                                   (uintptr_t)state.data + firstIndex);
-                    break;
-                case GLClientState::COLOR_LOCATION:
-                    this->glColorPointerOffset(this, state.size, state.type, state.stride,
-                                               (uintptr_t)state.data + firstIndex);
-                    break;
-                case GLClientState::TEXCOORD0_LOCATION:
-                case GLClientState::TEXCOORD1_LOCATION:
-                case GLClientState::TEXCOORD2_LOCATION:
-                case GLClientState::TEXCOORD3_LOCATION:
-                case GLClientState::TEXCOORD4_LOCATION:
-                case GLClientState::TEXCOORD5_LOCATION:
-                case GLClientState::TEXCOORD6_LOCATION:
-                case GLClientState::TEXCOORD7_LOCATION:
-                    this->glTexCoordPointerOffset(this, state.size, state.type, state.stride,
-                                                  (uintptr_t)state.data + firstIndex);
-                    break;
-                case GLClientState::WEIGHT_LOCATION:
-                    this->glWeightPointerOffset(this,state.size,state.type,state.stride,
-                                                (uintptr_t)state.data+firstIndex);
-                    break;
-                case GLClientState::MATRIXINDEX_LOCATION:
-                    this->glMatrixIndexPointerOffset(this,state.size,state.type,state.stride,
-                                              (uintptr_t)state.data+firstIndex);
-                    break;
-                }
+                this->m_glBindBuffer_enc(this, GL_ARRAY_BUFFER, state.bufferObject);
+                sendVertexAttribOffset(i, state, state.stride,
+                                       (uintptr_t)state.data + firstIndex);
             }
             this->m_glBindBuffer_enc(this, GL_ARRAY_BUFFER, m_state->currentArrayVbo());
         } else {
@@ -1028,6 +1142,8 @@ GLEncoder::GLEncoder(IOStream *stream, ChecksumCalculator *protocol)
     m_error = GL_NO_ERROR;
     m_num_compressedTextureFormats = 0;
     m_compressedTextureFormats = NULL;
+    m_vertexUploadTick = 0;
+    memset(&m_vertexUploadStats, 0, sizeof(m_vertexUploadStats));
 
     // overrides;
 #define OVERRIDE(name)  m_##name##_enc = this-> name ; this-> name = &s_##name
@@ -1092,6 +1208,14 @@ GLEncoder::GLEncoder(IOStream *stream, ChecksumCalculator *protocol)
 
 GLEncoder::~GLEncoder()
 {
+    ALOGV("%s: client array uploads: %llu draws, %llu arrays interleaved, "
+          "%llu bytes sent, %llu bytes deduplicated\n", __FUNCTION__,
+          (unsigned long long)m_vertexUploadStats.draws,
+          (unsigned long long)m_vertexUploadStats.arraysInterleaved,
+          (unsigned long long)m_vertexUploadStats.bytesUploaded,
+          (unsigned long long)m_vertexUploadStats.bytesDeduplicated);
+    // Any buffers still cached belong to the share group that is current.
+    releaseVertexUploadCache();
     delete [] m_compressedTextureFormats;
 }
 
@@ -32,6 +32,8 @@ public:
         m_state = state;
     }
     void setSharedGroup(GLSharedGroupPtr shared) {
+        // Cached vertex upload buffers are named in the old share group.
+        if (shared != m_shared) forgetVertexUploadCache();
         m_shared = shared;
         if (m_state && m_shared)
             m_state->setTextureData(m_shared->getTextureData());
@@ -48,6 +50,19 @@ public:
     void override2DTextureTarget(GLenum target);
     void restore2DTextureTarget();
 
+    // Client-array upload counters, see sendVertexData().
+    struct VertexUploadStats {
+        uint64_t draws;              // draws that used client-memory arrays
+        uint64_t arraysInterleaved;  // client arrays folded into a shared upload
+        uint64_t bytesUploaded;
+        uint64_t bytesDeduplicated;  // payload bytes that matched a cached upload
+    };
+    const VertexUploadStats& getVertexUploadStats() const { return m_vertexUploadStats; }
+
+    // Deletes the encoder-owned vertex upload buffers. Call while a context
+    // of the share group they were created in is still current on the host.
+    void releaseVertexUploadCache();
+
 private:
 
     bool    m_initialized;
@@ -58,6 +73,20 @@ private:
     GLint *m_compressedTextureFormats;
     GLint m_num_compressedTextureFormats;
 
+    // Encoder-owned array buffers holding recent interleaved client-array
+    // payloads, reused when a draw sends identical data.
+    struct VertexUploadCacheEntry {
+        GLuint buffer = 0;
+        uint64_t hash = 0;
+        uint64_t lastUse = 0;
+        std::vector<char> data;
+    };
+    static const size_t kVertexUploadCacheSize = 4;
+    VertexUploadCacheEntry m_vertexUploadCache[kVertexUploadCacheSize];
+    uint64_t m_vertexUploadTick;
+    std::vector<char> m_interleavedVertexData;
+    VertexUploadStats m_vertexUploadStats;
+
     GLint *getCompressedTextureFormats();
     // original functions;
     glGetError_client_proc_t    m_glGetError_enc;
@@ -143,6 +172,13 @@ private:
 
     static void s_glFinish(void *self);
     void sendVertexData(unsigned first, unsigned count);
+    void sendVertexAttribOffset(int location, const GLClientState::VertexAttribState& state,
+                                GLsizei stride, uintptr_t offset);
+    // Uploads m_interleavedVertexData (or finds a cached copy) and leaves the
+    // buffer holding it bound to GL_ARRAY_BUFFER. Returns 0 on failure.
+    GLuint uploadInterleavedVertexData();
+    // Drops cache entries without deleting their buffers.
+    void forgetVertexUploadCache();
 
     static void s_glActiveTexture(void* self, GLenum texture);
     static void s_glBindTexture(void* self, GLenum target, GLuint texture);
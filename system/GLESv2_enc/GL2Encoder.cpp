@@ -77,6 +77,8 @@ GL2Encoder::GL2Encoder(IOStream *stream, ChecksumCalculator *protocol)
     m_hasSyncBufferData = false;
     m_initialized = false;
     m_noHostError = false;
+    m_errorRoundTripsAvoided = 0;
+    m_redundantUniformsSkipped = 0;
     m_state = NULL;
     m_error = GL_NO_ERROR;
 
@@ -462,6 +464,9 @@ GL2Encoder::GL2Encoder(IOStream *stream, ChecksumCalculator *protocol)
 
 GL2Encoder::~GL2Encoder()
 {
+    ALOGV("%s: %llu glGetError round trips avoided, %llu redundant uniform updates skipped",
+          __FUNCTION__, (unsigned long long)m_errorRoundTripsAvoided,
+          (unsigned long long)m_redundantUniformsSkipped);
     delete m_compressedTextureFormats;
 }
 
@@ -470,8 +475,11 @@ GLenum GL2Encoder::s_glGetError(void * self)
     GL2Encoder *ctx = (GL2Encoder *)self;
     GLenum err = ctx->getError();
     if(err != GL_NO_ERROR) {
+        // A pending guest error is reported without asking the host. Any
+        // host error stays latched there and is returned by the next call,
+        // as GL allows one error flag to be cleared per glGetError.
         if (!ctx->m_noHostError) {
-            ctx->m_glGetError_enc(ctx); // also clear host error
+            ++ctx->m_errorRoundTripsAvoided;
         }
         ctx->setError(GL_NO_ERROR);
         return err;
@@ -1919,6 +1927,7 @@ void GL2Encoder::s_glLinkProgram(void * self, GLuint program)
     }
 
     ctx->m_glLinkProgram_enc(self, program);
+    ctx->m_shared->clearProgramUniformShadow(program);
 
     GLint linkStatus = 0;
     ctx->m_glGetProgramiv_enc(self, program, GL_LINK_STATUS, &linkStatus);
@@ -2259,18 +2268,48 @@ void GL2Encoder::s_glUseProgram(void *self, GLuint program)
     }
 }
 
+bool GL2Encoder::uniformUnchanged(GLint location, GLsizei count, GLenum baseType,
+                                  GLint columns, GLint rows, GLboolean transpose,
+                                  const void* data) {
+    GLuint program = m_state->currentProgram();
+    if (!program) {
+        // The write goes to the active program of the bound pipeline, which
+        // is not tracked reliably here, so no shadow can be trusted.
+        m_shared->clearAllUniformShadows();
+        return false;
+    }
+    return programUniformUnchanged(program, location, count, baseType, columns, rows,
+                                   transpose, data);
+}
+
+bool GL2Encoder::programUniformUnchanged(GLuint program, GLint location, GLsizei count,
+                                         GLenum baseType, GLint columns, GLint rows,
+                                         GLboolean transpose, const void* data) {
+    uint32_t kind = ProgramData::uniformShadowKind(baseType, columns, rows, transpose);
+    if (!m_shared->updateProgramUniformShadow(program, location, count, kind, data)) {
+        return false;
+    }
+    ++m_redundantUniformsSkipped;
+    return true;
+}
+
 void GL2Encoder::s_glUniform1f(void *self , GLint location, GLfloat x)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 1 /* columns */, 1 /* rows */, location, 1 /* count */, ctx->getErrorPtr());
-    ctx->m_glUniform1f_enc(self, location, x);
+    const GLfloat values[] = {x};
+    if (!ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 1 /* columns */, 1 /* rows */, location, 1 /* count */, ctx->getErrorPtr()) ||
+        !ctx->uniformUnchanged(location, 1, GL_FLOAT, 1, 1, GL_FALSE, values)) {
+        ctx->m_glUniform1f_enc(self, location, x);
+    }
 }
 
 void GL2Encoder::s_glUniform1fv(void *self , GLint location, GLsizei count, const GLfloat* v)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 1 /* columns */, 1 /* rows */, location, count /* count */, ctx->getErrorPtr());
-    ctx->m_glUniform1fv_enc(self, location, count, v);
+    if (!ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 1 /* columns */, 1 /* rows */, location, count /* count */, ctx->getErrorPtr()) ||
+        !ctx->uniformUnchanged(location, count, GL_FLOAT, 1, 1, GL_FALSE, v)) {
+        ctx->m_glUniform1fv_enc(self, location, count, v);
+    }
 }
 
 void GL2Encoder::s_glUniform1i(void *self , GLint location, GLint x)
@@ -2279,9 +2318,11 @@ void GL2Encoder::s_glUniform1i(void *self , GLint location, GLint x)
     GLClientState* state = ctx->m_state;
     GLSharedGroupPtr shared = ctx->m_shared;
 
-    ctx->m_state->validateUniform(false /* is float? */, false /* is unsigned? */, 1 /* columns */, 1 /* rows */, location, 1 /* count */, ctx->getErrorPtr());
-
-    ctx->m_glUniform1i_enc(self, location, x);
+    const GLint values[] = {x};
+    if (!ctx->m_state->validateUniform(false /* is float? */, false /* is unsigned? */, 1 /* columns */, 1 /* rows */, location, 1 /* count */, ctx->getErrorPtr()) ||
+        !ctx->uniformUnchanged(location, 1, GL_INT, 1, 1, GL_FALSE, values)) {
+        ctx->m_glUniform1i_enc(self, location, x);
+    }
 
     GLenum target;
     if (shared->setSamplerUniform(state->currentShaderProgram(), location, x, &target)) {
@@ -2296,113 +2337,151 @@ void GL2Encoder::s_glUniform1i(void *self , GLint location, GLint x)
 void GL2Encoder::s_glUniform1iv(void *self , GLint location, GLsizei count, const GLint* v)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_state->validateUniform(false /* is float? */, false /* is unsigned? */, 1 /* columns */, 1 /* rows */, location, count /* count */, ctx->getErrorPtr());
-    ctx->m_glUniform1iv_enc(self, location, count, v);
+    if (!ctx->m_state->validateUniform(false /* is float? */, false /* is unsigned? */, 1 /* columns */, 1 /* rows */, location, count /* count */, ctx->getErrorPtr()) ||
+        !ctx->uniformUnchanged(location, count, GL_INT, 1, 1, GL_FALSE, v)) {
+        ctx->m_glUniform1iv_enc(self, location, count, v);
+    }
 }
 
 void GL2Encoder::s_glUniform2f(void *self , GLint location, GLfloat x, GLfloat y)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 2 /* columns */, 1 /* rows */, location, 1 /* count */, ctx->getErrorPtr());
-    ctx->m_glUniform2f_enc(self, location, x, y);
+    const GLfloat values[] = {x, y};
+    if (!ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 2 /* columns */, 1 /* rows */, location, 1 /* count */, ctx->getErrorPtr()) ||
+        !ctx->uniformUnchanged(location, 1, GL_FLOAT, 2, 1, GL_FALSE, values)) {
+        ctx->m_glUniform2f_enc(self, location, x, y);
+    }
 }
 
 void GL2Encoder::s_glUniform2fv(void *self , GLint location, GLsizei count, const GLfloat* v)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 2 /* columns */, 1 /* rows */, location, count /* count */, ctx->getErrorPtr());
-    ctx->m_glUniform2fv_enc(self, location, count, v);
+    if (!ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 2 /* columns */, 1 /* rows */, location, count /* count */, ctx->getErrorPtr()) ||
+        !ctx->uniformUnchanged(location, count, GL_FLOAT, 2, 1, GL_FALSE, v)) {
+        ctx->m_glUniform2fv_enc(self, location, count, v);
+    }
 }
 
 void GL2Encoder::s_glUniform2i(void *self , GLint location, GLint x, GLint y)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_state->validateUniform(false /* is float? */, false /* is unsigned? */, 2 /* columns */, 1 /* rows */, location, 1 /* count */, ctx->getErrorPtr());
-    ctx->m_glUniform2i_enc(self, location, x, y);
+    const GLint values[] = {x, y};
+    if (!ctx->m_state->validateUniform(false /* is float? */, false /* is unsigned? */, 2 /* columns */, 1 /* rows */, location, 1 /* count */, ctx->getErrorPtr()) ||
+        !ctx->uniformUnchanged(location, 1, GL_INT, 2, 1, GL_FALSE, values)) {
+        ctx->m_glUniform2i_enc(self, location, x, y);
+    }
 }
 
 void GL2Encoder::s_glUniform2iv(void *self , GLint location, GLsizei count, const GLint* v)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_state->validateUniform(false /* is float? */, false /* is unsigned? */, 2 /* columns */, 1 /* rows */, location, count /* count */, ctx->getErrorPtr());
-    ctx->m_glUniform2iv_enc(self, location, count, v);
+    if (!ctx->m_state->validateUniform(false /* is float? */, false /* is unsigned? */, 2 /* columns */, 1 /* rows */, location, count /* count */, ctx->getErrorPtr()) ||
+        !ctx->uniformUnchanged(location, count, GL_INT, 2, 1, GL_FALSE, v)) {
+        ctx->m_glUniform2iv_enc(self, location, count, v);
+    }
 }
 
 void GL2Encoder::s_glUniform3f(void *self , GLint location, GLfloat x, GLfloat y, GLfloat z)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 3 /* columns */, 1 /* rows */, location, 1 /* count */, ctx->getErrorPtr());
-    ctx->m_glUniform3f_enc(self, location, x, y, z);
+    const GLfloat values[] = {x, y, z};
+    if (!ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 3 /* columns */, 1 /* rows */, location, 1 /* count */, ctx->getErrorPtr()) ||
+        !ctx->uniformUnchanged(location, 1, GL_FLOAT, 3, 1, GL_FALSE, values)) {
+        ctx->m_glUniform3f_enc(self, location, x, y, z);
+    }
 }
 
 void GL2Encoder::s_glUniform3fv(void *self , GLint location, GLsizei count, const GLfloat* v)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 3 /* columns */, 1 /* rows */, location, count /* count */, ctx->getErrorPtr());
-    ctx->m_glUniform3fv_enc(self, location, count, v);
+    if (!ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 3 /* columns */, 1 /* rows */, location, count /* count */, ctx->getErrorPtr()) ||
+        !ctx->uniformUnchanged(location, count, GL_FLOAT, 3, 1, GL_FALSE, v)) {
+        ctx->m_glUniform3fv_enc(self, location, count, v);
+    }
 }
 
 void GL2Encoder::s_glUniform3i(void *self , GLint location, GLint x, GLint y, GLint z)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_state->validateUniform(false /* is float? */, false /* is unsigned? */, 3 /* columns */, 1 /* rows */, location, 1 /* count */, ctx->getErrorPtr());
-    ctx->m_glUniform3i_enc(self, location, x, y, z);
+    const GLint values[] = {x, y, z};
+    if (!ctx->m_state->validateUniform(false /* is float? */, false /* is unsigned? */, 3 /* columns */, 1 /* rows */, location, 1 /* count */, ctx->getErrorPtr()) ||
+        !ctx->uniformUnchanged(location, 1, GL_INT, 3, 1, GL_FALSE, values)) {
+        ctx->m_glUniform3i_enc(self, location, x, y, z);
+    }
 }
 
 void GL2Encoder::s_glUniform3iv(void *self , GLint location, GLsizei count, const GLint* v)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_state->validateUniform(false /* is float? */, false /* is unsigned? */, 3 /* columns */, 1 /* rows */, location, count /* count */, ctx->getErrorPtr());
-    ctx->m_glUniform3iv_enc(self, location, count, v);
+    if (!ctx->m_state->validateUniform(false /* is float? */, false /* is unsigned? */, 3 /* columns */, 1 /* rows */, location, count /* count */, ctx->getErrorPtr()) ||
+        !ctx->uniformUnchanged(location, count, GL_INT, 3, 1, GL_FALSE, v)) {
+        ctx->m_glUniform3iv_enc(self, location, count, v);
+    }
 }
 
 void GL2Encoder::s_glUniform4f(void *self , GLint location, GLfloat x, GLfloat y, GLfloat z, GLfloat w)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 4 /* columns */, 1 /* rows */, location, 1 /* count */, ctx->getErrorPtr());
-    ctx->m_glUniform4f_enc(self, location, x, y, z, w);
+    const GLfloat values[] = {x, y, z, w};
+    if (!ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 4 /* columns */, 1 /* rows */, location, 1 /* count */, ctx->getErrorPtr()) ||
+        !ctx->uniformUnchanged(location, 1, GL_FLOAT, 4, 1, GL_FALSE, values)) {
+        ctx->m_glUniform4f_enc(self, location, x, y, z, w);
+    }
 }
 
 void GL2Encoder::s_glUniform4fv(void *self , GLint location, GLsizei count, const GLfloat* v)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 4 /* columns */, 1 /* rows */, location, count /* count */, ctx->getErrorPtr());
-    ctx->m_glUniform4fv_enc(self, location, count, v);
+    if (!ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 4 /* columns */, 1 /* rows */, location, count /* count */, ctx->getErrorPtr()) ||
+        !ctx->uniformUnchanged(location, count, GL_FLOAT, 4, 1, GL_FALSE, v)) {
+        ctx->m_glUniform4fv_enc(self, location, count, v);
+    }
 }
 
 void GL2Encoder::s_glUniform4i(void *self , GLint location, GLint x, GLint y, GLint z, GLint w)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_state->validateUniform(false /* is float? */, false /* is unsigned? */, 4 /* columns */, 1 /* rows */, location, 1 /* count */, ctx->getErrorPtr());
-    ctx->m_glUniform4i_enc(self, location, x, y, z, w);
+    const GLint values[] = {x, y, z, w};
+    if (!ctx->m_state->validateUniform(false /* is float? */, false /* is unsigned? */, 4 /* columns */, 1 /* rows */, location, 1 /* count */, ctx->getErrorPtr()) ||
+        !ctx->uniformUnchanged(location, 1, GL_INT, 4, 1, GL_FALSE, values)) {
+        ctx->m_glUniform4i_enc(self, location, x, y, z, w);
+    }
 }
 
 void GL2Encoder::s_glUniform4iv(void *self , GLint location, GLsizei count, const GLint* v)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_state->validateUniform(false /* is float? */, false /* is unsigned? */, 4 /* columns */, 1 /* rows */, location, count /* count */, ctx->getErrorPtr());
-    ctx->m_glUniform4iv_enc(self, location, count, v);
+    if (!ctx->m_state->validateUniform(false /* is float? */, false /* is unsigned? */, 4 /* columns */, 1 /* rows */, location, count /* count */, ctx->getErrorPtr()) ||
+        !ctx->uniformUnchanged(location, count, GL_INT, 4, 1, GL_FALSE, v)) {
+        ctx->m_glUniform4iv_enc(self, location, count, v);
+    }
 }
 
 void GL2Encoder::s_glUniformMatrix2fv(void *self , GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 2 /* columns */, 2 /* rows */, location, count /* count */, ctx->getErrorPtr());
-    ctx->m_glUniformMatrix2fv_enc(self, location, count, transpose, value);
+    if (!ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 2 /* columns */, 2 /* rows */, location, count /* count */, ctx->getErrorPtr()) ||
+        !ctx->uniformUnchanged(location, count, GL_FLOAT, 2, 2, transpose, value)) {
+        ctx->m_glUniformMatrix2fv_enc(self, location, count, transpose, value);
+    }
 }
 
 void GL2Encoder::s_glUniformMatrix3fv(void *self , GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 3 /* columns */, 3 /* rows */, location, count /* count */, ctx->getErrorPtr());
-    ctx->m_glUniformMatrix3fv_enc(self, location, count, transpose, value);
+    if (!ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 3 /* columns */, 3 /* rows */, location, count /* count */, ctx->getErrorPtr()) ||
+        !ctx->uniformUnchanged(location, count, GL_FLOAT, 3, 3, transpose, value)) {
+        ctx->m_glUniformMatrix3fv_enc(self, location, count, transpose, value);
+    }
 }
 
 void GL2Encoder::s_glUniformMatrix4fv(void *self , GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 4 /* columns */, 4 /* rows */, location, count /* count */, ctx->getErrorPtr());
-    ctx->m_glUniformMatrix4fv_enc(self, location, count, transpose, value);
+    if (!ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 4 /* columns */, 4 /* rows */, location, count /* count */, ctx->getErrorPtr()) ||
+        !ctx->uniformUnchanged(location, count, GL_FLOAT, 4, 4, transpose, value)) {
+        ctx->m_glUniformMatrix4fv_enc(self, location, count, transpose, value);
+    }
 }
 
 void GL2Encoder::s_glActiveTexture(void* self, GLenum texture)
@@ -3827,8 +3906,11 @@ void GL2Encoder::s_glUniform1ui(void* self, GLint location, GLuint v0) {
     GLClientState* state = ctx->m_state;
     GLSharedGroupPtr shared = ctx->m_shared;
 
-    ctx->m_state->validateUniform(false /* is float? */, true /* is unsigned? */, 1 /* columns */, 1 /* rows */, location, 1 /* count */, ctx->getErrorPtr());
-    ctx->m_glUniform1ui_enc(self, location, v0);
+    const GLuint values[] = {v0};
+    if (!ctx->m_state->validateUniform(false /* is float? */, true /* is unsigned? */, 1 /* columns */, 1 /* rows */, location, 1 /* count */, ctx->getErrorPtr()) ||
+        !ctx->uniformUnchanged(location, 1, GL_UNSIGNED_INT, 1, 1, GL_FALSE, values)) {
+        ctx->m_glUniform1ui_enc(self, location, v0);
+    }
 
     GLenum target;
     if (shared->setSamplerUniform(state->currentShaderProgram(), location, v0, &target)) {
@@ -3842,80 +3924,109 @@ void GL2Encoder::s_glUniform1ui(void* self, GLint location, GLuint v0) {
 
 void GL2Encoder::s_glUniform2ui(void* self, GLint location, GLuint v0, GLuint v1) {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_state->validateUniform(false /* is float? */, true /* is unsigned? */, 2 /* columns */, 1 /* rows */, location, 1 /* count */, ctx->getErrorPtr());
-    ctx->m_glUniform2ui_enc(self, location, v0, v1);
+    const GLuint values[] = {v0, v1};
+    if (!ctx->m_state->validateUniform(false /* is float? */, true /* is unsigned? */, 2 /* columns */, 1 /* rows */, location, 1 /* count */, ctx->getErrorPtr()) ||
+        !ctx->uniformUnchanged(location, 1, GL_UNSIGNED_INT, 2, 1, GL_FALSE, values)) {
+        ctx->m_glUniform2ui_enc(self, location, v0, v1);
+    }
 }
 
 void GL2Encoder::s_glUniform3ui(void* self, GLint location, GLuint v0, GLuint v1, GLuint v2) {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_state->validateUniform(false /* is float? */, true /* is unsigned? */, 3 /* columns */, 1 /* rows */, location, 1 /* count */, ctx->getErrorPtr());
-    ctx->m_glUniform3ui_enc(self, location, v0, v1, v2);
+    const GLuint values[] = {v0, v1, v2};
+    if (!ctx->m_state->validateUniform(false /* is float? */, true /* is unsigned? */, 3 /* columns */, 1 /* rows */, location, 1 /* count */, ctx->getErrorPtr()) ||
+        !ctx->uniformUnchanged(location, 1, GL_UNSIGNED_INT, 3, 1, GL_FALSE, values)) {
+        ctx->m_glUniform3ui_enc(self, location, v0, v1, v2);
+    }
 }
 
 void GL2Encoder::s_glUniform4ui(void* self, GLint location, GLint v0, GLuint v1, GLuint v2, GLuint v3) {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_state->validateUniform(false /* is float? */, true /* is unsigned? */, 4 /* columns */, 1 /* rows */, location, 1 /* count */, ctx->getErrorPtr());
-    ctx->m_glUniform4ui_enc(self, location, v0, v1, v2, v3);
+    const GLuint values[] = {(GLuint)v0, v1, v2, v3};
+    if (!ctx->m_state->validateUniform(false /* is float? */, true /* is unsigned? */, 4 /* columns */, 1 /* rows */, location, 1 /* count */, ctx->getErrorPtr()) ||
+        !ctx->uniformUnchanged(location, 1, GL_UNSIGNED_INT, 4, 1, GL_FALSE, values)) {
+        ctx->m_glUniform4ui_enc(self, location, v0, v1, v2, v3);
+    }
 }
 
 void GL2Encoder::s_glUniform1uiv(void* self, GLint location, GLsizei count, const GLuint *value) {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_state->validateUniform(false /* is float? */, true /* is unsigned? */, 1 /* columns */, 1 /* rows */, location, count /* count */, ctx->getErrorPtr());
-    ctx->m_glUniform1uiv_enc(self, location, count, value);
+    if (!ctx->m_state->validateUniform(false /* is float? */, true /* is unsigned? */, 1 /* columns */, 1 /* rows */, location, count /* count */, ctx->getErrorPtr()) ||
+        !ctx->uniformUnchanged(location, count, GL_UNSIGNED_INT, 1, 1, GL_FALSE, value)) {
+        ctx->m_glUniform1uiv_enc(self, location, count, value);
+    }
 }
 
 void GL2Encoder::s_glUniform2uiv(void* self, GLint location, GLsizei count, const GLuint *value) {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_state->validateUniform(false /* is float? */, true /* is unsigned? */, 2 /* columns */, 1 /* rows */, location, count /* count */, ctx->getErrorPtr());
-    ctx->m_glUniform2uiv_enc(self, location, count, value);
+    if (!ctx->m_state->validateUniform(false /* is float? */, true /* is unsigned? */, 2 /* columns */, 1 /* rows */, location, count /* count */, ctx->getErrorPtr()) ||
+        !ctx->uniformUnchanged(location, count, GL_UNSIGNED_INT, 2, 1, GL_FALSE, value)) {
+        ctx->m_glUniform2uiv_enc(self, location, count, value);
+    }
 }
 
 void GL2Encoder::s_glUniform3uiv(void* self, GLint location, GLsizei count, const GLuint *value) {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_state->validateUniform(false /* is float? */, true /* is unsigned? */, 3 /* columns */, 1 /* rows */, location, count /* count */, ctx->getErrorPtr());
-    ctx->m_glUniform3uiv_enc(self, location, count, value);
+    if (!ctx->m_state->validateUniform(false /* is float? */, true /* is unsigned? */, 3 /* columns */, 1 /* rows */, location, count /* count */, ctx->getErrorPtr()) ||
+        !ctx->uniformUnchanged(location, count, GL_UNSIGNED_INT, 3, 1, GL_FALSE, value)) {
+        ctx->m_glUniform3uiv_enc(self, location, count, value);
+    }
 }
 
 void GL2Encoder::s_glUniform4uiv(void* self, GLint location, GLsizei count, const GLuint *value) {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_state->validateUniform(false /* is float? */, true /* is unsigned? */, 4 /* columns */, 1 /* rows */, location, count /* count */, ctx->getErrorPtr());
-    ctx->m_glUniform4uiv_enc(self, location, count, value);
+    if (!ctx->m_state->validateUniform(false /* is float? */, true /* is unsigned? */, 4 /* columns */, 1 /* rows */, location, count /* count */, ctx->getErrorPtr()) ||
+        !ctx->uniformUnchanged(location, count, GL_UNSIGNED_INT, 4, 1, GL_FALSE, value)) {
+        ctx->m_glUniform4uiv_enc(self, location, count, value);
+    }
 }
 
 void GL2Encoder::s_glUniformMatrix2x3fv(void* self, GLint location, GLsizei count, GLboolean transpose, const GLfloat *value) {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 2 /* columns */, 3 /* rows */, location, count /* count */, ctx->getErrorPtr());
-    ctx->m_glUniformMatrix2x3fv_enc(self, location, count, transpose, value);
+    if (!ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 2 /* columns */, 3 /* rows */, location, count /* count */, ctx->getErrorPtr()) ||
+        !ctx->uniformUnchanged(location, count, GL_FLOAT, 2, 3, transpose, value)) {
+        ctx->m_glUniformMatrix2x3fv_enc(self, location, count, transpose, value);
+    }
 }
 
 void GL2Encoder::s_glUniformMatrix3x2fv(void* self, GLint location, GLsizei count, GLboolean transpose, const GLfloat *value) {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 3 /* columns */, 2 /* rows */, location, count /* count */, ctx->getErrorPtr());
-    ctx->m_glUniformMatrix3x2fv_enc(self, location, count, transpose, value);
+    if (!ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 3 /* columns */, 2 /* rows */, location, count /* count */, ctx->getErrorPtr()) ||
+        !ctx->uniformUnchanged(location, count, GL_FLOAT, 3, 2, transpose, value)) {
+        ctx->m_glUniformMatrix3x2fv_enc(self, location, count, transpose, value);
+    }
 }
 
 void GL2Encoder::s_glUniformMatrix2x4fv(void* self, GLint location, GLsizei count, GLboolean transpose, const GLfloat *value) {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 2 /* columns */, 4 /* rows */, location, count /* count */, ctx->getErrorPtr());
-    ctx->m_glUniformMatrix2x4fv_enc(self, location, count, transpose, value);
+    if (!ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 2 /* columns */, 4 /* rows */, location, count /* count */, ctx->getErrorPtr()) ||
+        !ctx->uniformUnchanged(location, count, GL_FLOAT, 2, 4, transpose, value)) {
+        ctx->m_glUniformMatrix2x4fv_enc(self, location, count, transpose, value);
+    }
 }
 
 void GL2Encoder::s_glUniformMatrix4x2fv(void* self, GLint location, GLsizei count, GLboolean transpose, const GLfloat *value) {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 4 /* columns */, 2 /* rows */, location, count /* count */, ctx->getErrorPtr());
-    ctx->m_glUniformMatrix4x2fv_enc(self, location, count, transpose, value);
+    if (!ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 4 /* columns */, 2 /* rows */, location, count /* count */, ctx->getErrorPtr()) ||
+        !ctx->uniformUnchanged(location, count, GL_FLOAT, 4, 2, transpose, value)) {
+        ctx->m_glUniformMatrix4x2fv_enc(self, location, count, transpose, value);
+    }
 }
 
 void GL2Encoder::s_glUniformMatrix3x4fv(void* self, GLint location, GLsizei count, GLboolean transpose, const GLfloat *value) {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 3 /* columns */, 4 /* rows */, location, count /* count */, ctx->getErrorPtr());
-    ctx->m_glUniformMatrix3x4fv_enc(self, location, count, transpose, value);
+    if (!ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 3 /* columns */, 4 /* rows */, location, count /* count */, ctx->getErrorPtr()) ||
+        !ctx->uniformUnchanged(location, count, GL_FLOAT, 3, 4, transpose, value)) {
+        ctx->m_glUniformMatrix3x4fv_enc(self, location, count, transpose, value);
+    }
 }
 
 void GL2Encoder::s_glUniformMatrix4x3fv(void* self, GLint location, GLsizei count, GLboolean transpose, const GLfloat *value) {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 4 /* columns */, 3 /* rows */, location, count /* count */, ctx->getErrorPtr());
-    ctx->m_glUniformMatrix4x3fv_enc(self, location, count, transpose, value);
+    if (!ctx->m_state->validateUniform(true /* is float? */, false /* is unsigned? */, 4 /* columns */, 3 /* rows */, location, count /* count */, ctx->getErrorPtr()) ||
+        !ctx->uniformUnchanged(location, count, GL_FLOAT, 4, 3, transpose, value)) {
+        ctx->m_glUniformMatrix4x3fv_enc(self, location, count, transpose, value);
+    }
 }
 
 void GL2Encoder::s_glGetUniformuiv(void* self, GLuint program, GLint location, GLuint* params) {
@@ -5459,19 +5570,27 @@ GLuint GL2Encoder::s_glCreateShaderProgramv(void* self, GLenum shaderType, GLsiz
 void GL2Encoder::s_glProgramUniform1f(void* self, GLuint program, GLint location, GLfloat v0)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_glProgramUniform1f_enc(self, program, location, v0);
+    const GLfloat values[] = {v0};
+    if (!ctx->programUniformUnchanged(program, location, 1, GL_FLOAT, 1, 1, GL_FALSE, values)) {
+        ctx->m_glProgramUniform1f_enc(self, program, location, v0);
+    }
 }
 
 void GL2Encoder::s_glProgramUniform1fv(void* self, GLuint program, GLint location, GLsizei count, const GLfloat *value)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_glProgramUniform1fv_enc(self, program, location, count, value);
+    if (!ctx->programUniformUnchanged(program, location, count, GL_FLOAT, 1, 1, GL_FALSE, value)) {
+        ctx->m_glProgramUniform1fv_enc(self, program, location, count, value);
+    }
 }
 
 void GL2Encoder::s_glProgramUniform1i(void* self, GLuint program, GLint location, GLint v0)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_glProgramUniform1i_enc(self, program, location, v0);
+    const GLint values[] = {v0};
+    if (!ctx->programUniformUnchanged(program, location, 1, GL_INT, 1, 1, GL_FALSE, values)) {
+        ctx->m_glProgramUniform1i_enc(self, program, location, v0);
+    }
 
     GLClientState* state = ctx->m_state;
     GLSharedGroupPtr shared = ctx->m_shared;
@@ -5489,13 +5608,18 @@ void GL2Encoder::s_glProgramUniform1i(void* self, GLuint program, GLint location
 void GL2Encoder::s_glProgramUniform1iv(void* self, GLuint program, GLint location, GLsizei count, const GLint *value)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_glProgramUniform1iv_enc(self, program, location, count, value);
+    if (!ctx->programUniformUnchanged(program, location, count, GL_INT, 1, 1, GL_FALSE, value)) {
+        ctx->m_glProgramUniform1iv_enc(self, program, location, count, value);
+    }
 }
 
 void GL2Encoder::s_glProgramUniform1ui(void* self, GLuint program, GLint location, GLuint v0)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_glProgramUniform1ui_enc(self, program, location, v0);
+    const GLuint values[] = {v0};
+    if (!ctx->programUniformUnchanged(program, location, 1, GL_UNSIGNED_INT, 1, 1, GL_FALSE, values)) {
+        ctx->m_glProgramUniform1ui_enc(self, program, location, v0);
+    }
 
     GLClientState* state = ctx->m_state;
     GLSharedGroupPtr shared = ctx->m_shared;
@@ -5513,169 +5637,234 @@ void GL2Encoder::s_glProgramUniform1ui(void* self, GLuint program, GLint locatio
 void GL2Encoder::s_glProgramUniform1uiv(void* self, GLuint program, GLint location, GLsizei count, const GLuint *value)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_glProgramUniform1uiv_enc(self, program, location, count, value);
+    if (!ctx->programUniformUnchanged(program, location, count, GL_UNSIGNED_INT, 1, 1, GL_FALSE, value)) {
+        ctx->m_glProgramUniform1uiv_enc(self, program, location, count, value);
+    }
 }
 
 void GL2Encoder::s_glProgramUniform2f(void* self, GLuint program, GLint location, GLfloat v0, GLfloat v1)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_glProgramUniform2f_enc(self, program, location, v0, v1);
+    const GLfloat values[] = {v0, v1};
+    if (!ctx->programUniformUnchanged(program, location, 1, GL_FLOAT, 2, 1, GL_FALSE, values)) {
+        ctx->m_glProgramUniform2f_enc(self, program, location, v0, v1);
+    }
 }
 
 void GL2Encoder::s_glProgramUniform2fv(void* self, GLuint program, GLint location, GLsizei count, const GLfloat *value)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_glProgramUniform2fv_enc(self, program, location, count, value);
+    if (!ctx->programUniformUnchanged(program, location, count, GL_FLOAT, 2, 1, GL_FALSE, value)) {
+        ctx->m_glProgramUniform2fv_enc(self, program, location, count, value);
+    }
 }
 
 void GL2Encoder::s_glProgramUniform2i(void* self, GLuint program, GLint location, GLint v0, GLint v1)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_glProgramUniform2i_enc(self, program, location, v0, v1);
+    const GLint values[] = {v0, v1};
+    if (!ctx->programUniformUnchanged(program, location, 1, GL_INT, 2, 1, GL_FALSE, values)) {
+        ctx->m_glProgramUniform2i_enc(self, program, location, v0, v1);
+    }
 }
 
 void GL2Encoder::s_glProgramUniform2iv(void* self, GLuint program, GLint location, GLsizei count, const GLint *value)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_glProgramUniform2iv_enc(self, program, location, count, value);
+    if (!ctx->programUniformUnchanged(program, location, count, GL_INT, 2, 1, GL_FALSE, value)) {
+        ctx->m_glProgramUniform2iv_enc(self, program, location, count, value);
+    }
 }
 
 void GL2Encoder::s_glProgramUniform2ui(void* self, GLuint program, GLint location, GLint v0, GLuint v1)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_glProgramUniform2ui_enc(self, program, location, v0, v1);
+    const GLuint values[] = {(GLuint)v0, v1};
+    if (!ctx->programUniformUnchanged(program, location, 1, GL_UNSIGNED_INT, 2, 1, GL_FALSE, values)) {
+        ctx->m_glProgramUniform2ui_enc(self, program, location, v0, v1);
+    }
 }
 
 void GL2Encoder::s_glProgramUniform2uiv(void* self, GLuint program, GLint location, GLsizei count, const GLuint *value)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_glProgramUniform2uiv_enc(self, program, location, count, value);
+    if (!ctx->programUniformUnchanged(program, location, count, GL_UNSIGNED_INT, 2, 1, GL_FALSE, value)) {
+        ctx->m_glProgramUniform2uiv_enc(self, program, location, count, value);
+    }
 }
 
 void GL2Encoder::s_glProgramUniform3f(void* self, GLuint program, GLint location, GLfloat v0, GLfloat v1, GLfloat v2)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_glProgramUniform3f_enc(self, program, location, v0, v1, v2);
+    const GLfloat values[] = {v0, v1, v2};
+    if (!ctx->programUniformUnchanged(program, location, 1, GL_FLOAT, 3, 1, GL_FALSE, values)) {
+        ctx->m_glProgramUniform3f_enc(self, program, location, v0, v1, v2);
+    }
 }
 
 void GL2Encoder::s_glProgramUniform3fv(void* self, GLuint program, GLint location, GLsizei count, const GLfloat *value)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_glProgramUniform3fv_enc(self, program, location, count, value);
+    if (!ctx->programUniformUnchanged(program, location, count, GL_FLOAT, 3, 1, GL_FALSE, value)) {
+        ctx->m_glProgramUniform3fv_enc(self, program, location, count, value);
+    }
 }
 
 void GL2Encoder::s_glProgramUniform3i(void* self, GLuint program, GLint location, GLint v0, GLint v1, GLint v2)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_glProgramUniform3i_enc(self, program, location, v0, v1, v2);
+    const GLint values[] = {v0, v1, v2};
+    if (!ctx->programUniformUnchanged(program, location, 1, GL_INT, 3, 1, GL_FALSE, values)) {
+        ctx->m_glProgramUniform3i_enc(self, program, location, v0, v1, v2);
+    }
 }
 
 void GL2Encoder::s_glProgramUniform3iv(void* self, GLuint program, GLint location, GLsizei count, const GLint *value)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_glProgramUniform3iv_enc(self, program, location, count, value);
+    if (!ctx->programUniformUnchanged(program, location, count, GL_INT, 3, 1, GL_FALSE, value)) {
+        ctx->m_glProgramUniform3iv_enc(self, program, location, count, value);
+    }
 }
 
 void GL2Encoder::s_glProgramUniform3ui(void* self, GLuint program, GLint location, GLint v0, GLint v1, GLuint v2)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_glProgramUniform3ui_enc(self, program, location, v0, v1, v2);
+    const GLuint values[] = {(GLuint)v0, (GLuint)v1, v2};
+    if (!ctx->programUniformUnchanged(program, location, 1, GL_UNSIGNED_INT, 3, 1, GL_FALSE, values)) {
+        ctx->m_glProgramUniform3ui_enc(self, program, location, v0, v1, v2);
+    }
 }
 
 void GL2Encoder::s_glProgramUniform3uiv(void* self, GLuint program, GLint location, GLsizei count, const GLuint *value)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_glProgramUniform3uiv_enc(self, program, location, count, value);
+    if (!ctx->programUniformUnchanged(program, location, count, GL_UNSIGNED_INT, 3, 1, GL_FALSE, value)) {
+        ctx->m_glProgramUniform3uiv_enc(self, program, location, count, value);
+    }
 }
 
 void GL2Encoder::s_glProgramUniform4f(void* self, GLuint program, GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_glProgramUniform4f_enc(self, program, location, v0, v1, v2, v3);
+    const GLfloat values[] = {v0, v1, v2, v3};
+    if (!ctx->programUniformUnchanged(program, location, 1, GL_FLOAT, 4, 1, GL_FALSE, values)) {
+        ctx->m_glProgramUniform4f_enc(self, program, location, v0, v1, v2, v3);
+    }
 }
 
 void GL2Encoder::s_glProgramUniform4fv(void* self, GLuint program, GLint location, GLsizei count, const GLfloat *value)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_glProgramUniform4fv_enc(self, program, location, count, value);
+    if (!ctx->programUniformUnchanged(program, location, count, GL_FLOAT, 4, 1, GL_FALSE, value)) {
+        ctx->m_glProgramUniform4fv_enc(self, program, location, count, value);
+    }
 }
 
 void GL2Encoder::s_glProgramUniform4i(void* self, GLuint program, GLint location, GLint v0, GLint v1, GLint v2, GLint v3)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_glProgramUniform4i_enc(self, program, location, v0, v1, v2, v3);
+    const GLint values[] = {v0, v1, v2, v3};
+    if (!ctx->programUniformUnchanged(program, location, 1, GL_INT, 4, 1, GL_FALSE, values)) {
+        ctx->m_glProgramUniform4i_enc(self, program, location, v0, v1, v2, v3);
+    }
 }
 
 void GL2Encoder::s_glProgramUniform4iv(void* self, GLuint program, GLint location, GLsizei count, const GLint *value)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_glProgramUniform4iv_enc(self, program, location, count, value);
+    if (!ctx->programUniformUnchanged(program, location, count, GL_INT, 4, 1, GL_FALSE, value)) {
+        ctx->m_glProgramUniform4iv_enc(self, program, location, count, value);
+    }
 }
 
 void GL2Encoder::s_glProgramUniform4ui(void* self, GLuint program, GLint location, GLint v0, GLint v1, GLint v2, GLuint v3)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_glProgramUniform4ui_enc(self, program, location, v0, v1, v2, v3);
+    const GLuint values[] = {(GLuint)v0, (GLuint)v1, (GLuint)v2, v3};
+    if (!ctx->programUniformUnchanged(program, location, 1, GL_UNSIGNED_INT, 4, 1, GL_FALSE, values)) {
+        ctx->m_glProgramUniform4ui_enc(self, program, location, v0, v1, v2, v3);
+    }
 }
 
 void GL2Encoder::s_glProgramUniform4uiv(void* self, GLuint program, GLint location, GLsizei count, const GLuint *value)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_glProgramUniform4uiv_enc(self, program, location, count, value);
+    if (!ctx->programUniformUnchanged(program, location, count, GL_UNSIGNED_INT, 4, 1, GL_FALSE, value)) {
+        ctx->m_glProgramUniform4uiv_enc(self, program, location, count, value);
+    }
 }
 
 void GL2Encoder::s_glProgramUniformMatrix2fv(void* self, GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat *value)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_glProgramUniformMatrix2fv_enc(self, program, location, count, transpose, value);
+    if (!ctx->programUniformUnchanged(program, location, count, GL_FLOAT, 2, 2, transpose, value)) {
+        ctx->m_glProgramUniformMatrix2fv_enc(self, program, location, count, transpose, value);
+    }
 }
 
 void GL2Encoder::s_glProgramUniformMatrix2x3fv(void* self, GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat *value)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_glProgramUniformMatrix2x3fv_enc(self, program, location, count, transpose, value);
+    if (!ctx->programUniformUnchanged(program, location, count, GL_FLOAT, 2, 3, transpose, value)) {
+        ctx->m_glProgramUniformMatrix2x3fv_enc(self, program, location, count, transpose, value);
+    }
 }
 
 void GL2Encoder::s_glProgramUniformMatrix2x4fv(void* self, GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat *value)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_glProgramUniformMatrix2x4fv_enc(self, program, location, count, transpose, value);
+    if (!ctx->programUniformUnchanged(program, location, count, GL_FLOAT, 2, 4, transpose, value)) {
+        ctx->m_glProgramUniformMatrix2x4fv_enc(self, program, location, count, transpose, value);
+    }
 }
 
 void GL2Encoder::s_glProgramUniformMatrix3fv(void* self, GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat *value)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_glProgramUniformMatrix3fv_enc(self, program, location, count, transpose, value);
+    if (!ctx->programUniformUnchanged(program, location, count, GL_FLOAT, 3, 3, transpose, value)) {
+        ctx->m_glProgramUniformMatrix3fv_enc(self, program, location, count, transpose, value);
+    }
 }
 
 void GL2Encoder::s_glProgramUniformMatrix3x2fv(void* self, GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat *value)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_glProgramUniformMatrix3x2fv_enc(self, program, location, count, transpose, value);
+    if (!ctx->programUniformUnchanged(program, location, count, GL_FLOAT, 3, 2, transpose, value)) {
+        ctx->m_glProgramUniformMatrix3x2fv_enc(self, program, location, count, transpose, value);
+    }
 }
 
 void GL2Encoder::s_glProgramUniformMatrix3x4fv(void* self, GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat *value)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_glProgramUniformMatrix3x4fv_enc(self, program, location, count, transpose, value);
+    if (!ctx->programUniformUnchanged(program, location, count, GL_FLOAT, 3, 4, transpose, value)) {
+        ctx->m_glProgramUniformMatrix3x4fv_enc(self, program, location, count, transpose, value);
+    }
 }
 
 void GL2Encoder::s_glProgramUniformMatrix4fv(void* self, GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat *value)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_glProgramUniformMatrix4fv_enc(self, program, location, count, transpose, value);
+    if (!ctx->programUniformUnchanged(program, location, count, GL_FLOAT, 4, 4, transpose, value)) {
+        ctx->m_glProgramUniformMatrix4fv_enc(self, program, location, count, transpose, value);
+    }
 }
 
 void GL2Encoder::s_glProgramUniformMatrix4x2fv(void* self, GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat *value)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_glProgramUniformMatrix4x2fv_enc(self, program, location, count, transpose, value);
+    if (!ctx->programUniformUnchanged(program, location, count, GL_FLOAT, 4, 2, transpose, value)) {
+        ctx->m_glProgramUniformMatrix4x2fv_enc(self, program, location, count, transpose, value);
+    }
 }
 
 void GL2Encoder::s_glProgramUniformMatrix4x3fv(void* self, GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat *value)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
-    ctx->m_glProgramUniformMatrix4x3fv_enc(self, program, location, count, transpose, value);
+    if (!ctx->programUniformUnchanged(program, location, count, GL_FLOAT, 4, 3, transpose, value)) {
+        ctx->m_glProgramUniformMatrix4x3fv_enc(self, program, location, count, transpose, value);
+    }
 }
 
 void GL2Encoder::s_glProgramParameteri(void* self, GLuint program, GLenum pname, GLint value) {
@@ -5725,12 +5914,9 @@ void GL2Encoder::s_glBindProgramPipeline(void* self, GLuint pipeline)
         return;
     }
 
-    GLClientState::ProgramPipelineIterator it = state->programPipelineBegin();
-    for (; it != state->programPipelineEnd(); ++it) {
-        if (it->second == pipeline) {
-            ctx->updateHostTexture2DBindingsFromProgramData(it->first);
-        }
-    }
+    state->forEachProgramInPipeline(pipeline, [ctx](GLuint program) {
+        ctx->updateHostTexture2DBindingsFromProgramData(program);
+    });
 }
 
 void GL2Encoder::s_glGetProgramResourceiv(void* self, GLuint program, GLenum programInterface, GLuint index, GLsizei propCount, const GLenum * props, GLsizei bufSize, GLsizei * length, GLint * params) {
@@ -6206,6 +6392,7 @@ void GL2Encoder::s_glProgramBinary(void *self , GLuint program, GLenum binaryFor
     SET_ERROR_IF(~0 == binaryFormat, GL_INVALID_ENUM);
 
     ctx->m_glProgramBinary_enc(self, program, binaryFormat, binary, length);
+    ctx->m_shared->clearProgramUniformShadow(program);
 }
 
 void GL2Encoder::s_glGetSamplerParameterfv(void *self, GLuint sampler, GLenum pname, GLfloat* params) {
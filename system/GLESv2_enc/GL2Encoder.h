@@ -41,6 +41,17 @@ public:
     void setNoHostError(bool noHostError) {
         m_noHostError = noHostError;
     }
+    // glGetError calls answered from a pending guest error without the
+    // host round trip that used to clear the host's error; see
+    // s_glGetError().
+    uint64_t getErrorRoundTripsAvoided() const {
+        return m_errorRoundTripsAvoided;
+    }
+    // glUniform*/glProgramUniform* calls dropped because the program
+    // already held the same values.
+    uint64_t getRedundantUniformsSkipped() const {
+        return m_redundantUniformsSkipped;
+    }
     void setClientState(GLClientState *state) {
         m_state = state;
     }
@@ -119,6 +130,8 @@ private:
     bool    m_hasSyncBufferData;
     bool    m_initialized;
     bool    m_noHostError;
+    uint64_t m_errorRoundTripsAvoided;
+    uint64_t m_redundantUniformsSkipped;
     GLClientState *m_state;
     GLSharedGroupPtr m_shared;
     GLenum  m_error;
@@ -174,6 +187,15 @@ private:
 
     bool updateHostTexture2DBinding(GLenum texUnit, GLenum newTarget);
     void updateHostTexture2DBindingsFromProgramData(GLuint program);
+
+    // Consult and update the per-program uniform shadow kept in the share
+    // group. True means the call would not change anything and is dropped.
+    bool uniformUnchanged(GLint location, GLsizei count, GLenum baseType,
+                          GLint columns, GLint rows, GLboolean transpose,
+                          const void* data);
+    bool programUniformUnchanged(GLuint program, GLint location, GLsizei count,
+                                 GLenum baseType, GLint columns, GLint rows,
+                                 GLboolean transpose, const void* data);
     bool texture2DNeedsOverride(GLenum target) const;
 
     // Utility classes for safe queries that
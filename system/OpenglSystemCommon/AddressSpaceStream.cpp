@@ -360,7 +360,7 @@ size_t AddressSpaceStream::idealAllocSize(size_t len) {
 }
 
 void *AddressSpaceStream::allocBuffer(size_t minSize) {
-    AEMU_SCOPED_TRACE("allocBuffer");
+    AEMU_SCOPED_TRACE_PAYLOAD(Transport, "allocBuffer", minSize);
     ensureType3Finished();
 
     if (!m_readBuf) {
@@ -507,7 +507,7 @@ const unsigned char *AddressSpaceStream::read(void *buf, size_t *inout_len) {
 
 int AddressSpaceStream::writeFully(const void *buf, size_t size)
 {
-    AEMU_SCOPED_TRACE("writeFully");
+    AEMU_SCOPED_TRACE_PAYLOAD(Transport, "writeFully", size);
     ensureType3Finished();
     ensureType1Finished();
 
@@ -572,7 +572,7 @@ int AddressSpaceStream::writeFully(const void *buf, size_t size)
 
 int AddressSpaceStream::writeFullyAsync(const void *buf, size_t size)
 {
-    AEMU_SCOPED_TRACE("writeFullyAsync");
+    AEMU_SCOPED_TRACE_PAYLOAD(Transport, "writeFullyAsync", size);
     ensureType3Finished();
     ensureType1Finished();
 
@@ -695,7 +695,7 @@ ssize_t AddressSpaceStream::speculativeRead(unsigned char* readBuffer, size_t tr
 }
 
 void AddressSpaceStream::notifyAvailable() {
-    AEMU_SCOPED_TRACE("PING");
+    AEMU_SCOPED_TRACE_CATEGORY(Transport, "PING");
     struct address_space_ping request;
     request.metadata = ASG_NOTIFY_AVAILABLE;
     m_ops.ping(m_handle, &request);
@@ -736,7 +736,7 @@ void AddressSpaceStream::ensureConsumerFinishing() {
 }
 
 void AddressSpaceStream::ensureType1Finished() {
-    AEMU_SCOPED_TRACE("ensureType1Finished");
+    AEMU_SCOPED_TRACE_CATEGORY(Transport, "ensureType1Finished");
 
     uint32_t currAvailRead =
         ring_buffer_available_read(m_context.to_host, 0);
@@ -752,7 +752,7 @@ void AddressSpaceStream::ensureType1Finished() {
 }
 
 void AddressSpaceStream::ensureType3Finished() {
-    AEMU_SCOPED_TRACE("ensureType3Finished");
+    AEMU_SCOPED_TRACE_CATEGORY(Transport, "ensureType3Finished");
     uint32_t availReadLarge =
         ring_buffer_available_read(
             m_context.to_host_large_xfer.ring,
@@ -776,7 +776,7 @@ void AddressSpaceStream::ensureType3Finished() {
 
 int AddressSpaceStream::type1Write(uint32_t bufferOffset, size_t size) {
 
-    AEMU_SCOPED_TRACE("type1Write");
+    AEMU_SCOPED_TRACE_PAYLOAD(Transport, "type1Write", size);
 
     ensureType3Finished();
 
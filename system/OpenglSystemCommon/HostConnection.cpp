@@ -370,6 +370,10 @@ HostConnection::HostConnection() :
 
 HostConnection::~HostConnection()
 {
+    // The GLES1 encoder deletes its buffers on destruction; let it do so
+    // while the stream is still alive and before the round-trip below.
+    m_glEnc.reset();
+
     // round-trip to ensure that queued commands have been processed
     // before process pipe closure is detected.
     if (m_rcEnc && !exitUncleanly) {
@@ -55,6 +55,7 @@
 
 #ifdef GFXSTREAM
 #include "android/base/Tracing.h"
+#include "android/base/synchronization/AndroidFenceFdWaiter.h"
 #endif
 #include <cutils/trace.h>
 
@@ -1555,6 +1556,10 @@ static EGLBoolean s_eglReleaseThreadImpl(EGLThreadInfo* tInfo) {
 
     s_destroyPendingSurfacesInContext(context);
 
+    if (context->majorVersion == 1) {
+        hostCon->glEncoder()->releaseVertexUploadCache();
+    }
+
     if (context->deletePending) {
         if (context->rcContext) {
             rcEnc->rcDestroyContext(rcEnc, context->rcContext);
@@ -1932,6 +1937,14 @@ EGLBoolean eglMakeCurrent(EGLDisplay dpy, EGLSurface draw, EGLSurface read, EGLC
     }
 
     DEFINE_AND_VALIDATE_HOST_CONNECTION(EGL_FALSE);
+
+    // The GLES1 encoder's vertex upload buffers belong to the previous
+    // context's share group; delete them while it is still current.
+    if (prevCtx && prevCtx->majorVersion == 1 &&
+        (!context || context->getSharedGroup() != prevCtx->getSharedGroup())) {
+        hostCon->glEncoder()->releaseVertexUploadCache();
+    }
+
     if (rcEnc->hasAsyncFrameCommands()) {
         rcEnc->rcMakeCurrentAsync(rcEnc, ctxHandle, drawHandle, readHandle);
     } else {
@@ -2470,6 +2483,19 @@ EGLint eglClientWaitSyncKHR(EGLDisplay dpy, EGLSyncKHR eglsync, EGLint flags,
     DEFINE_HOST_CONNECTION;
 
     EGLint retval;
+#ifdef GFXSTREAM
+    if (sync->type == EGL_SYNC_NATIVE_FENCE_ANDROID &&
+        sync->android_native_fence_fd >= 0) {
+        // Imported fences only exist as an fd, and exported ones signal their
+        // fd along with the host sync object, so wait on the fd here rather
+        // than in a host thread.
+        if (!android::base::guest::FenceFdWaiter::get()->wait(
+                &sync->android_native_fence_fd, 1, true /* wait all */, timeout)) {
+            return EGL_TIMEOUT_EXPIRED_KHR;
+        }
+        retval = EGL_CONDITION_SATISFIED_KHR;
+    } else
+#endif
     if (rcEnc->hasVirtioGpuNativeSync() || rcEnc->hasNativeSync()) {
         retval = rcEnc->rcClientWaitSyncKHR
             (rcEnc, sync->handle, flags, timeout);
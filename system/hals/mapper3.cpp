@@ -451,7 +451,7 @@ private:  // **** impl ****
             } else {
                 if (rcEnc->featureInfo()->hasReadColorBufferDma) {
                     {
-                        AEMU_SCOPED_TRACE("bindDmaDirectly");
+                        AEMU_SCOPED_TRACE_CATEGORY(Gralloc, "bindDmaDirectly");
                         rcEnc->bindDmaDirectly(bufferBits,
                                 getMmapedPhysAddr(cb.getMmapedOffset()));
                     }
@@ -489,7 +489,7 @@ private:  // **** impl ****
     }
 
     Error3 unlockImpl(void* raw) {
-        AEMU_SCOPED_TRACE("unlockImpl body");
+        AEMU_SCOPED_TRACE_CATEGORY(Gralloc, "unlockImpl body");
         if (!raw) {
             RETURN_ERROR(Error3::BAD_BUFFER);
         }
@@ -513,7 +513,7 @@ private:  // **** impl ****
     }
 
     void unlockHostImpl(cb_handle_30_t& cb, char* const bufferBits) {
-        AEMU_SCOPED_TRACE("unlockHostImpl body");
+        AEMU_SCOPED_TRACE_CATEGORY(Gralloc, "unlockHostImpl body");
         const int bpp = glUtilsPixelBitSize(cb.glFormat, cb.glType) >> 3;
         const uint32_t lockedUsage = cb.lockedUsage;
         const uint32_t rgbSize = cb.width * cb.height * bpp;
@@ -546,12 +546,12 @@ private:  // **** impl ****
                 const HostConnectionSession conn = getHostConnectionSession();
                 ExtendedRCEncoderContext *const rcEnc = conn.getRcEncoder();
                 {
-                    AEMU_SCOPED_TRACE("bindDmaDirectly");
+                    AEMU_SCOPED_TRACE_CATEGORY(Gralloc, "bindDmaDirectly");
                     rcEnc->bindDmaDirectly(bufferBits,
                             getMmapedPhysAddr(cb.getMmapedOffset()));
                 }
                 {
-                    AEMU_SCOPED_TRACE("updateColorBuffer");
+                    AEMU_SCOPED_TRACE_CATEGORY(Gralloc, "updateColorBuffer");
                     rcEnc->rcUpdateColorBufferDMA(rcEnc, cb.hostHandle,
                             0, 0, cb.width, cb.height,
                             cb.glFormat, cb.glType,
@@ -47,7 +47,7 @@ VkResult
 EnumerateInstanceExtensionProperties(const char* /*layer_name*/,
                                      uint32_t* count,
                                      VkExtensionProperties* /*properties*/) {
-    AEMU_SCOPED_TRACE("vkstubhal::EnumerateInstanceExtensionProperties");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "vkstubhal::EnumerateInstanceExtensionProperties");
     *count = 0;
     return VK_SUCCESS;
 }
@@ -55,7 +55,7 @@ EnumerateInstanceExtensionProperties(const char* /*layer_name*/,
 VkResult
 EnumerateInstanceLayerProperties(uint32_t* count,
                                  VkLayerProperties* /*properties*/) {
-    AEMU_SCOPED_TRACE("vkstubhal::EnumerateInstanceLayerProperties");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "vkstubhal::EnumerateInstanceLayerProperties");
     *count = 0;
     return VK_SUCCESS;
 }
@@ -63,7 +63,7 @@ EnumerateInstanceLayerProperties(uint32_t* count,
 VkResult CreateInstance(const VkInstanceCreateInfo* /*create_info*/,
                         const VkAllocationCallbacks* /*allocator*/,
                         VkInstance* instance) {
-    AEMU_SCOPED_TRACE("vkstubhal::CreateInstance");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "vkstubhal::CreateInstance");
     auto dispatch = new hwvulkan_dispatch_t;
     dispatch->magic = HWVULKAN_DISPATCH_MAGIC;
     *instance = reinterpret_cast<VkInstance>(dispatch);
@@ -72,7 +72,7 @@ VkResult CreateInstance(const VkInstanceCreateInfo* /*create_info*/,
 
 void DestroyInstance(VkInstance instance,
                      const VkAllocationCallbacks* /*allocator*/) {
-    AEMU_SCOPED_TRACE("vkstubhal::DestroyInstance");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "vkstubhal::DestroyInstance");
     auto dispatch = reinterpret_cast<hwvulkan_dispatch_t*>(instance);
     ALOG_ASSERT(dispatch->magic == HWVULKAN_DISPATCH_MAGIC,
                 "DestroyInstance: invalid instance handle");
@@ -82,13 +82,13 @@ void DestroyInstance(VkInstance instance,
 VkResult EnumeratePhysicalDevices(VkInstance /*instance*/,
                                   uint32_t* count,
                                   VkPhysicalDevice* /*gpus*/) {
-    AEMU_SCOPED_TRACE("vkstubhal::EnumeratePhysicalDevices");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "vkstubhal::EnumeratePhysicalDevices");
     *count = 0;
     return VK_SUCCESS;
 }
 
 VkResult EnumerateInstanceVersion(uint32_t* pApiVersion) {
-    AEMU_SCOPED_TRACE("vkstubhal::EnumerateInstanceVersion");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "vkstubhal::EnumerateInstanceVersion");
     *pApiVersion = VK_API_VERSION_1_0;
     return VK_SUCCESS;
 }
@@ -97,7 +97,7 @@ VkResult
 EnumeratePhysicalDeviceGroups(VkInstance /*instance*/,
                               uint32_t* count,
                               VkPhysicalDeviceGroupProperties* /*properties*/) {
-    AEMU_SCOPED_TRACE("vkstubhal::EnumeratePhysicalDeviceGroups");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "vkstubhal::EnumeratePhysicalDeviceGroups");
     *count = 0;
     return VK_SUCCESS;
 }
@@ -108,7 +108,7 @@ CreateDebugReportCallbackEXT(VkInstance /*instance*/,
                              const VkAllocationCallbacks* /*pAllocator*/,
                              VkDebugReportCallbackEXT* pCallback)
 {
-    AEMU_SCOPED_TRACE("vkstubhal::CreateDebugReportCallbackEXT");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "vkstubhal::CreateDebugReportCallbackEXT");
     *pCallback = VK_NULL_HANDLE;
     return VK_SUCCESS;
 }
@@ -118,7 +118,7 @@ DestroyDebugReportCallbackEXT(VkInstance /*instance*/,
                               VkDebugReportCallbackEXT /*callback*/,
                               const VkAllocationCallbacks* /*pAllocator*/)
 {
-    AEMU_SCOPED_TRACE("vkstubhal::DestroyDebugReportCallbackEXT");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "vkstubhal::DestroyDebugReportCallbackEXT");
 }
 
 void
@@ -131,7 +131,7 @@ DebugReportMessageEXT(VkInstance /*instance*/,
                       const char* /*pLayerPrefix*/,
                       const char* /*pMessage*/)
 {
-    AEMU_SCOPED_TRACE("vkstubhal::DebugReportMessageEXT");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "vkstubhal::DebugReportMessageEXT");
 }
 
 VkResult
@@ -140,7 +140,7 @@ CreateDebugUtilsMessengerEXT(VkInstance /*instance*/,
                              const VkAllocationCallbacks* /*pAllocator*/,
                              VkDebugUtilsMessengerEXT* pMessenger)
 {
-    AEMU_SCOPED_TRACE("vkstubhal::CreateDebugUtilsMessengerEXT");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "vkstubhal::CreateDebugUtilsMessengerEXT");
     *pMessenger = VK_NULL_HANDLE;
     return VK_SUCCESS;
 }
@@ -150,7 +150,7 @@ DestroyDebugUtilsMessengerEXT(VkInstance /*instance*/,
                               VkDebugUtilsMessengerEXT /*messenger*/,
                               const VkAllocationCallbacks* /*pAllocator*/)
 {
-    AEMU_SCOPED_TRACE("vkstubhal::DestroyDebugUtilsMessengerkEXT");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "vkstubhal::DestroyDebugUtilsMessengerkEXT");
 }
 
 void
@@ -159,7 +159,7 @@ SubmitDebugUtilsMessageEXT(VkInstance /*instance*/,
                            VkDebugUtilsMessageTypeFlagsEXT /*messageTypes*/,
                            const VkDebugUtilsMessengerCallbackDataEXT* /*pCallbackData*/)
 {
-    AEMU_SCOPED_TRACE("vkstubhal::SubmitDebugUtilsMessageEXT");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "vkstubhal::SubmitDebugUtilsMessageEXT");
 }
 
 #ifdef VK_USE_PLATFORM_FUCHSIA
@@ -167,7 +167,7 @@ VkResult
 GetMemoryZirconHandleFUCHSIA(VkDevice /*device*/,
                              const VkMemoryGetZirconHandleInfoFUCHSIA* /*pInfo*/,
                              uint32_t* pHandle) {
-    AEMU_SCOPED_TRACE("vkstubhal::GetMemoryZirconHandleFUCHSIA");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "vkstubhal::GetMemoryZirconHandleFUCHSIA");
     *pHandle = 0;
     return VK_SUCCESS;
 }
@@ -177,7 +177,7 @@ GetMemoryZirconHandlePropertiesFUCHSIA(VkDevice /*device*/,
                                        VkExternalMemoryHandleTypeFlagBits /*handleType*/,
                                        uint32_t /*handle*/,
                                        VkMemoryZirconHandlePropertiesFUCHSIA* /*pProperties*/) {
-    AEMU_SCOPED_TRACE("vkstubhal::GetMemoryZirconHandlePropertiesFUCHSIA");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "vkstubhal::GetMemoryZirconHandlePropertiesFUCHSIA");
     return VK_SUCCESS;
 }
 
@@ -185,7 +185,7 @@ VkResult
 GetSemaphoreZirconHandleFUCHSIA(VkDevice /*device*/,
                                 const VkSemaphoreGetZirconHandleInfoFUCHSIA* /*pInfo*/,
                                 uint32_t* pHandle) {
-    AEMU_SCOPED_TRACE("vkstubhal::GetSemaphoreZirconHandleFUCHSIA");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "vkstubhal::GetSemaphoreZirconHandleFUCHSIA");
     *pHandle = 0;
     return VK_SUCCESS;
 }
@@ -193,7 +193,7 @@ GetSemaphoreZirconHandleFUCHSIA(VkDevice /*device*/,
 VkResult
 ImportSemaphoreZirconHandleFUCHSIA(VkDevice /*device*/,
                                    const VkImportSemaphoreZirconHandleInfoFUCHSIA* /*pInfo*/) {
-    AEMU_SCOPED_TRACE("vkstubhal::ImportSemaphoreZirconHandleFUCHSIA");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "vkstubhal::ImportSemaphoreZirconHandleFUCHSIA");
     return VK_SUCCESS;
 }
 
@@ -202,7 +202,7 @@ VkResult CreateBufferCollectionFUCHSIA(
     const VkBufferCollectionCreateInfoFUCHSIA* /*pInfo*/,
     const VkAllocationCallbacks* /*pAllocator*/,
     VkBufferCollectionFUCHSIA* /*pCollection*/) {
-    AEMU_SCOPED_TRACE("vkstubhal::CreateBufferCollectionFUCHSIA");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "vkstubhal::CreateBufferCollectionFUCHSIA");
     return VK_SUCCESS;
 }
 
@@ -210,14 +210,14 @@ void DestroyBufferCollectionFUCHSIA(
     VkDevice /*device*/,
     VkBufferCollectionFUCHSIA /*collection*/,
     const VkAllocationCallbacks* /*pAllocator*/) {
-    AEMU_SCOPED_TRACE("vkstubhal::DestroyBufferCollectionFUCHSIA");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "vkstubhal::DestroyBufferCollectionFUCHSIA");
 }
 
 VkResult SetBufferCollectionImageConstraintsFUCHSIA(
     VkDevice /*device*/,
     VkBufferCollectionFUCHSIA /*collection*/,
     const VkImageConstraintsInfoFUCHSIA* /*pImageConstraintsInfo*/) {
-    AEMU_SCOPED_TRACE("vkstubhal::SetBufferCollectionImageConstraintsFUCHSIA");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "vkstubhal::SetBufferCollectionImageConstraintsFUCHSIA");
     return VK_SUCCESS;
 }
 
@@ -225,7 +225,7 @@ VkResult SetBufferCollectionBufferConstraintsFUCHSIA(
     VkDevice /*device*/,
     VkBufferCollectionFUCHSIA /*collection*/,
     const VkBufferConstraintsInfoFUCHSIA* /*pBufferConstraintsInfo*/) {
-    AEMU_SCOPED_TRACE("vkstubhal::SetBufferCollectionBufferConstraintsFUCHSIA");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "vkstubhal::SetBufferCollectionBufferConstraintsFUCHSIA");
     return VK_SUCCESS;
 }
 
@@ -233,7 +233,7 @@ VkResult GetBufferCollectionPropertiesFUCHSIA(
     VkDevice /*device*/,
     VkBufferCollectionFUCHSIA /*collection*/,
     VkBufferCollectionPropertiesFUCHSIA* /*pProperties*/) {
-    AEMU_SCOPED_TRACE("vkstubhal::GetBufferCollectionPropertiesFUCHSIA");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "vkstubhal::GetBufferCollectionPropertiesFUCHSIA");
     return VK_SUCCESS;
 }
 
@@ -242,7 +242,7 @@ VkResult CreateBufferCollectionFUCHSIAX(
     const VkBufferCollectionCreateInfoFUCHSIAX* /*pInfo*/,
     const VkAllocationCallbacks* /*pAllocator*/,
     VkBufferCollectionFUCHSIAX* /*pCollection*/) {
-    AEMU_SCOPED_TRACE("vkstubhal::CreateBufferCollectionFUCHSIAX");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "vkstubhal::CreateBufferCollectionFUCHSIAX");
     return VK_SUCCESS;
 }
 
@@ -250,14 +250,14 @@ void DestroyBufferCollectionFUCHSIAX(
     VkDevice /*device*/,
     VkBufferCollectionFUCHSIAX /*collection*/,
     const VkAllocationCallbacks* /*pAllocator*/) {
-    AEMU_SCOPED_TRACE("vkstubhal::DestroyBufferCollectionFUCHSIAX");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "vkstubhal::DestroyBufferCollectionFUCHSIAX");
 }
 
 VkResult SetBufferCollectionConstraintsFUCHSIAX(
     VkDevice /*device*/,
     VkBufferCollectionFUCHSIAX /*collection*/,
     const VkImageCreateInfo* /*pImageInfo*/) {
-    AEMU_SCOPED_TRACE("vkstubhal::SetBufferCollectionConstraintsFUCHSIAX");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "vkstubhal::SetBufferCollectionConstraintsFUCHSIAX");
     return VK_SUCCESS;
 }
 
@@ -265,7 +265,7 @@ VkResult SetBufferCollectionImageConstraintsFUCHSIAX(
     VkDevice /*device*/,
     VkBufferCollectionFUCHSIAX /*collection*/,
     const VkImageConstraintsInfoFUCHSIAX* /*pImageConstraintsInfo*/) {
-    AEMU_SCOPED_TRACE("vkstubhal::SetBufferCollectionImageConstraintsFUCHSIAX");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "vkstubhal::SetBufferCollectionImageConstraintsFUCHSIAX");
     return VK_SUCCESS;
 }
 
@@ -273,7 +273,7 @@ VkResult SetBufferCollectionBufferConstraintsFUCHSIAX(
     VkDevice /*device*/,
     VkBufferCollectionFUCHSIAX /*collection*/,
     const VkBufferConstraintsInfoFUCHSIAX* /*pBufferConstraintsInfo*/) {
-    AEMU_SCOPED_TRACE(
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan,
         "vkstubhal::SetBufferCollectionBufferConstraintsFUCHSIAX");
     return VK_SUCCESS;
 }
@@ -282,7 +282,7 @@ VkResult GetBufferCollectionPropertiesFUCHSIAX(
     VkDevice /*device*/,
     VkBufferCollectionFUCHSIAX /*collection*/,
     VkBufferCollectionPropertiesFUCHSIAX* /*pProperties*/) {
-    AEMU_SCOPED_TRACE("vkstubhal::GetBufferCollectionPropertiesFUCHSIAX");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "vkstubhal::GetBufferCollectionPropertiesFUCHSIAX");
     return VK_SUCCESS;
 }
 
@@ -290,14 +290,14 @@ VkResult GetBufferCollectionProperties2FUCHSIAX(
     VkDevice /*device*/,
     VkBufferCollectionFUCHSIAX /*collection*/,
     VkBufferCollectionProperties2FUCHSIAX* /*pProperties*/) {
-    AEMU_SCOPED_TRACE("vkstubhal::GetBufferCollectionProperties2FUCHSIAX");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "vkstubhal::GetBufferCollectionProperties2FUCHSIAX");
     return VK_SUCCESS;
 }
 #endif
 
 PFN_vkVoidFunction GetInstanceProcAddr(VkInstance instance,
                                        const char* name) {
-    AEMU_SCOPED_TRACE("vkstubhal::GetInstanceProcAddr");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "vkstubhal::GetInstanceProcAddr");
     if (strcmp(name, "vkCreateInstance") == 0)
         return reinterpret_cast<PFN_vkVoidFunction>(CreateInstance);
     if (strcmp(name, "vkDestroyInstance") == 0)
@@ -427,7 +427,7 @@ extern "C" __attribute__((visibility("default"))) hwvulkan_module_t HAL_MODULE_I
 };
 
 int CloseDevice(struct hw_device_t* /*device*/) {
-    AEMU_SCOPED_TRACE("goldfish_vulkan::GetInstanceProcAddr");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "goldfish_vulkan::GetInstanceProcAddr");
     // nothing to do - opening a device doesn't allocate any resources
     return 0;
 }
@@ -468,7 +468,7 @@ VkResult EnumerateInstanceExtensionProperties(
     const char* layer_name,
     uint32_t* count,
     VkExtensionProperties* properties) {
-    AEMU_SCOPED_TRACE("goldfish_vulkan::EnumerateInstanceExtensionProperties");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "goldfish_vulkan::EnumerateInstanceExtensionProperties");
 
     VK_HOST_CONNECTION(VK_ERROR_DEVICE_LOST)
 
@@ -493,7 +493,7 @@ VKAPI_ATTR
 VkResult CreateInstance(const VkInstanceCreateInfo* create_info,
                         const VkAllocationCallbacks* allocator,
                         VkInstance* out_instance) {
-    AEMU_SCOPED_TRACE("goldfish_vulkan::CreateInstance");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "goldfish_vulkan::CreateInstance");
 
     VK_HOST_CONNECTION(VK_ERROR_DEVICE_LOST)
 
@@ -512,7 +512,7 @@ VkResult GetMemoryZirconHandleFUCHSIA(
     VkDevice device,
     const VkMemoryGetZirconHandleInfoFUCHSIA* pInfo,
     uint32_t* pHandle) {
-    AEMU_SCOPED_TRACE("goldfish_vulkan::GetMemoryZirconHandleFUCHSIA");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "goldfish_vulkan::GetMemoryZirconHandleFUCHSIA");
 
     VK_HOST_CONNECTION(VK_ERROR_DEVICE_LOST)
 
@@ -534,7 +534,7 @@ VkResult GetMemoryZirconHandlePropertiesFUCHSIA(
     VkExternalMemoryHandleTypeFlagBits handleType,
     uint32_t handle,
     VkMemoryZirconHandlePropertiesFUCHSIA* pProperties) {
-    AEMU_SCOPED_TRACE("goldfish_vulkan::GetMemoryZirconHandlePropertiesFUCHSIA");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "goldfish_vulkan::GetMemoryZirconHandlePropertiesFUCHSIA");
 
     VK_HOST_CONNECTION(VK_ERROR_DEVICE_LOST)
 
@@ -555,7 +555,7 @@ VkResult GetSemaphoreZirconHandleFUCHSIA(
     VkDevice device,
     const VkSemaphoreGetZirconHandleInfoFUCHSIA* pInfo,
     uint32_t* pHandle) {
-    AEMU_SCOPED_TRACE("goldfish_vulkan::GetSemaphoreZirconHandleFUCHSIA");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "goldfish_vulkan::GetSemaphoreZirconHandleFUCHSIA");
 
     VK_HOST_CONNECTION(VK_ERROR_DEVICE_LOST)
 
@@ -574,7 +574,7 @@ VKAPI_ATTR
 VkResult ImportSemaphoreZirconHandleFUCHSIA(
     VkDevice device,
     const VkImportSemaphoreZirconHandleInfoFUCHSIA* pInfo) {
-    AEMU_SCOPED_TRACE("goldfish_vulkan::ImportSemaphoreZirconHandleFUCHSIA");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "goldfish_vulkan::ImportSemaphoreZirconHandleFUCHSIA");
 
     VK_HOST_CONNECTION(VK_ERROR_DEVICE_LOST)
 
@@ -595,7 +595,7 @@ VkResult CreateBufferCollectionFUCHSIA(
     const VkBufferCollectionCreateInfoFUCHSIA* pInfo,
     const VkAllocationCallbacks* pAllocator,
     VkBufferCollectionFUCHSIA* pCollection) {
-    AEMU_SCOPED_TRACE("goldfish_vulkan::CreateBufferCollectionFUCHSIA");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "goldfish_vulkan::CreateBufferCollectionFUCHSIA");
 
     VK_HOST_CONNECTION(VK_ERROR_DEVICE_LOST)
 
@@ -615,7 +615,7 @@ VKAPI_ATTR
 void DestroyBufferCollectionFUCHSIA(VkDevice device,
                                     VkBufferCollectionFUCHSIA collection,
                                     const VkAllocationCallbacks* pAllocator) {
-    AEMU_SCOPED_TRACE("goldfish_vulkan::DestroyBufferCollectionFUCHSIA");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "goldfish_vulkan::DestroyBufferCollectionFUCHSIA");
 
     VK_HOST_CONNECTION()
 
@@ -634,7 +634,7 @@ VkResult SetBufferCollectionBufferConstraintsFUCHSIA(
     VkDevice device,
     VkBufferCollectionFUCHSIA collection,
     const VkBufferConstraintsInfoFUCHSIA* pBufferConstraintsInfo) {
-    AEMU_SCOPED_TRACE(
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan,
         "goldfish_vulkan::SetBufferCollectionBufferConstraintsFUCHSIA");
 
     VK_HOST_CONNECTION(VK_ERROR_DEVICE_LOST)
@@ -657,7 +657,7 @@ VkResult SetBufferCollectionImageConstraintsFUCHSIA(
     VkDevice device,
     VkBufferCollectionFUCHSIA collection,
     const VkImageConstraintsInfoFUCHSIA* pImageConstraintsInfo) {
-    AEMU_SCOPED_TRACE(
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan,
         "goldfish_vulkan::SetBufferCollectionBufferConstraintsFUCHSIA");
 
     VK_HOST_CONNECTION(VK_ERROR_DEVICE_LOST)
@@ -680,7 +680,7 @@ VkResult GetBufferCollectionPropertiesFUCHSIA(
     VkDevice device,
     VkBufferCollectionFUCHSIA collection,
     VkBufferCollectionPropertiesFUCHSIA* pProperties) {
-    AEMU_SCOPED_TRACE("goldfish_vulkan::GetBufferCollectionPropertiesFUCHSIA");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "goldfish_vulkan::GetBufferCollectionPropertiesFUCHSIA");
 
     VK_HOST_CONNECTION(VK_ERROR_DEVICE_LOST)
 
@@ -702,7 +702,7 @@ VkResult CreateBufferCollectionFUCHSIAX(
     const VkBufferCollectionCreateInfoFUCHSIAX* pInfo,
     const VkAllocationCallbacks* pAllocator,
     VkBufferCollectionFUCHSIAX* pCollection) {
-    AEMU_SCOPED_TRACE("goldfish_vulkan::CreateBufferCollectionFUCHSIAX");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "goldfish_vulkan::CreateBufferCollectionFUCHSIAX");
 
     VK_HOST_CONNECTION(VK_ERROR_DEVICE_LOST)
 
@@ -723,7 +723,7 @@ VKAPI_ATTR
 void DestroyBufferCollectionFUCHSIAX(VkDevice device,
                                      VkBufferCollectionFUCHSIAX collection,
                                      const VkAllocationCallbacks* pAllocator) {
-    AEMU_SCOPED_TRACE("goldfish_vulkan::DestroyBufferCollectionFUCHSIAX");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "goldfish_vulkan::DestroyBufferCollectionFUCHSIAX");
 
     VK_HOST_CONNECTION()
 
@@ -742,7 +742,7 @@ VkResult SetBufferCollectionConstraintsFUCHSIAX(
     VkDevice device,
     VkBufferCollectionFUCHSIAX collection,
     const VkImageCreateInfo* pImageInfo) {
-    AEMU_SCOPED_TRACE(
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan,
         "goldfish_vulkan::SetBufferCollectionConstraintsFUCHSIAX");
 
     VK_HOST_CONNECTION(VK_ERROR_DEVICE_LOST)
@@ -764,7 +764,7 @@ VkResult SetBufferCollectionBufferConstraintsFUCHSIAX(
     VkDevice device,
     VkBufferCollectionFUCHSIAX collection,
     const VkBufferConstraintsInfoFUCHSIAX* pBufferConstraintsInfo) {
-    AEMU_SCOPED_TRACE(
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan,
         "goldfish_vulkan::SetBufferCollectionBufferConstraintsFUCHSIAX");
 
     VK_HOST_CONNECTION(VK_ERROR_DEVICE_LOST)
@@ -787,7 +787,7 @@ VkResult SetBufferCollectionImageConstraintsFUCHSIAX(
     VkDevice device,
     VkBufferCollectionFUCHSIAX collection,
     const VkImageConstraintsInfoFUCHSIAX* pImageConstraintsInfo) {
-    AEMU_SCOPED_TRACE(
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan,
         "goldfish_vulkan::SetBufferCollectionBufferConstraintsFUCHSIAX");
 
     VK_HOST_CONNECTION(VK_ERROR_DEVICE_LOST)
@@ -810,7 +810,7 @@ VkResult GetBufferCollectionPropertiesFUCHSIAX(
     VkDevice device,
     VkBufferCollectionFUCHSIAX collection,
     VkBufferCollectionPropertiesFUCHSIAX* pProperties) {
-    AEMU_SCOPED_TRACE("goldfish_vulkan::GetBufferCollectionPropertiesFUCHSIAX");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "goldfish_vulkan::GetBufferCollectionPropertiesFUCHSIAX");
 
     VK_HOST_CONNECTION(VK_ERROR_DEVICE_LOST)
 
@@ -831,7 +831,7 @@ VkResult GetBufferCollectionProperties2FUCHSIAX(
     VkDevice device,
     VkBufferCollectionFUCHSIAX collection,
     VkBufferCollectionProperties2FUCHSIAX* pProperties) {
-    AEMU_SCOPED_TRACE(
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan,
         "goldfish_vulkan::GetBufferCollectionProperties2FUCHSIAX");
 
     VK_HOST_CONNECTION(VK_ERROR_DEVICE_LOST)
@@ -901,7 +901,7 @@ QueueSignalReleaseImageANDROID(
 }
 
 static PFN_vkVoidFunction GetDeviceProcAddr(VkDevice device, const char* name) {
-    AEMU_SCOPED_TRACE("goldfish_vulkan::GetDeviceProcAddr");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "goldfish_vulkan::GetDeviceProcAddr");
 
     VK_HOST_CONNECTION(nullptr)
 
@@ -975,7 +975,7 @@ static PFN_vkVoidFunction GetDeviceProcAddr(VkDevice device, const char* name) {
 
 VKAPI_ATTR
 PFN_vkVoidFunction GetInstanceProcAddr(VkInstance instance, const char* name) {
-    AEMU_SCOPED_TRACE("goldfish_vulkan::GetInstanceProcAddr");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "goldfish_vulkan::GetInstanceProcAddr");
 
     VK_HOST_CONNECTION(nullptr)
 
@@ -1020,7 +1020,7 @@ hwvulkan_device_t goldfish_vulkan_device = {
 int OpenDevice(const hw_module_t* /*module*/,
                const char* id,
                hw_device_t** device) {
-    AEMU_SCOPED_TRACE("goldfish_vulkan::OpenDevice");
+    AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "goldfish_vulkan::OpenDevice");
 
     if (strcmp(id, HWVULKAN_DEVICE_0) == 0) {
         *device = &goldfish_vulkan_device.common;
@@ -36,6 +36,7 @@ endif
 
 LOCAL_CFLAGS += \
     -DLOG_TAG=\"goldfish_vulkan\" \
+    -DAEMU_TRACE_DEFAULT_CATEGORY=Vulkan \
     -DVK_ANDROID_native_buffer \
     -DVK_EXT_device_memory_report \
     -DVK_GOOGLE_gfxstream \
@@ -48,7 +49,10 @@ LOCAL_CFLAGS += \
 LOCAL_SRC_FILES := AndroidHardwareBuffer.cpp \
     CommandBufferStagingStream.cpp \
     DescriptorSetVirtualization.cpp \
+    DirtyPageTracker.cpp \
     HostVisibleMemoryVirtualization.cpp \
+    PipelineCacheStorage.cpp \
+    QueueSubmitThread.cpp \
     Resources.cpp \
     Validation.cpp \
     VulkanStreamGuest.cpp \
@@ -66,6 +70,8 @@ LOCAL_SRC_FILES := AndroidHardwareBuffer.cpp \
 
 ifeq (true,$(GOLDFISH_OPENGL_BUILD_FOR_HOST))
 LOCAL_CFLAGS += -D__ANDROID_API__=28
+# Timers for vulkan_encoder_benchmark --phases; off until it enables them.
+LOCAL_CFLAGS += -DVK_ENCODER_PHASE_TIMERS
 $(call emugl-export,SHARED_LIBRARIES,libgui)
 else
 $(call emugl-export,SHARED_LIBRARIES,libsync libnativewindow)
@@ -74,3 +80,24 @@ endif
 
 $(call emugl-end-module)
 
+ifeq (true,$(GOLDFISH_OPENGL_BUILD_FOR_HOST))
+$(call emugl-begin-test,vulkan_enc_unittests)
+$(call emugl-import,libvulkan_enc)
+
+LOCAL_C_INCLUDES += \
+    $(HOST_EMUGL_PATH)/host/include \
+    $(HOST_EMUGL_PATH)/host/include/vulkan \
+
+LOCAL_CFLAGS += \
+    -DLOG_TAG=\"goldfish_vulkan\" \
+    -DVK_ANDROID_native_buffer \
+    -DVK_EXT_device_memory_report \
+    -DVK_GOOGLE_gfxstream \
+    -DVK_USE_PLATFORM_ANDROID_KHR \
+    -DVK_NO_PROTOTYPES \
+
+LOCAL_SRC_FILES := \
+    vulkan_enc_unittests.cpp \
+
+$(call emugl-end-module)
+endif
@@ -27,48 +27,89 @@
 #include <unistd.h>
 #include <string.h>
 
-static const size_t kReadSize = 512 * 1024;
-static const size_t kWriteOffset = kReadSize;
+using android::base::guest::AutoLock;
+using android::base::guest::Lock;
 
-CommandBufferStagingStream::CommandBufferStagingStream() :
-    IOStream(1048576), m_buf(nullptr), m_size(1048576), m_writePos(0) { }
+CommandBufferStagingChunkPool::CommandBufferStagingChunkPool(size_t budget) :
+    m_budget(budget) { }
 
-CommandBufferStagingStream::~CommandBufferStagingStream() { flush(); if (m_buf) free(m_buf); }
+CommandBufferStagingChunkPool::~CommandBufferStagingChunkPool() {
+    for (auto chunk : m_free) free(chunk);
+}
 
-size_t CommandBufferStagingStream::idealAllocSize(size_t len) {
-    if (len > 1048576) return len;
-    return 1048576;
+unsigned char* CommandBufferStagingChunkPool::acquire(size_t minSize, size_t* capacityOut) {
+    if (minSize <= kChunkSize) {
+        AutoLock<Lock> lock(m_lock);
+        if (!m_free.empty()) {
+            unsigned char* chunk = m_free.back();
+            m_free.pop_back();
+            *capacityOut = kChunkSize;
+            return chunk;
+        }
+    }
+
+    size_t capacity = minSize < kChunkSize ? kChunkSize : minSize;
+    unsigned char* chunk = (unsigned char*)malloc(capacity);
+    if (!chunk) {
+        ALOGE("FATAL: Failed to allocate a %zu byte staging chunk", capacity);
+        abort();
+    }
+    *capacityOut = capacity;
+    return chunk;
 }
 
-void *CommandBufferStagingStream::allocBuffer(size_t minSize) {
-    size_t allocSize =
-        (1048576 < minSize ? minSize : 1048576);
-
-    // Initial case: blank
-    if (!m_buf) {
-        m_buf = (unsigned char *)malloc(allocSize);
-        m_size = allocSize;
-        return (void*)m_buf;
+void CommandBufferStagingChunkPool::release(unsigned char* chunk, size_t capacity) {
+    if (capacity == kChunkSize) {
+        AutoLock<Lock> lock(m_lock);
+        if ((m_free.size() + 1) * kChunkSize <= m_budget) {
+            m_free.push_back(chunk);
+            return;
+        }
     }
+    free(chunk);
+}
 
-    // Calculate remaining
-    size_t remaining = m_size - m_writePos;
+size_t CommandBufferStagingChunkPool::cachedBytes() {
+    AutoLock<Lock> lock(m_lock);
+    return m_free.size() * kChunkSize;
+}
 
-    if (remaining < allocSize) {
-        size_t newAllocSize = m_size * 2 + allocSize;
-        unsigned char *p = (unsigned char *)realloc(m_buf, newAllocSize);
-        m_buf = p;
-        m_size = newAllocSize;
-        return (void*)(m_buf + m_writePos);
+CommandBufferStagingStream::CommandBufferStagingStream(CommandBufferStagingChunkPool* pool) :
+    IOStream(CommandBufferStagingChunkPool::kChunkSize), m_pool(pool), m_written(0) { }
 
+CommandBufferStagingStream::~CommandBufferStagingStream() { flush(); releaseChunks(); }
+
+// IOStream sizes its next allocation with this; offering the rest of the
+// current chunk lets small commands keep filling it.
+size_t CommandBufferStagingStream::idealAllocSize(size_t len) {
+    if (!m_chunks.empty()) {
+        const Chunk& last = m_chunks.back();
+        size_t remaining = last.capacity - last.used;
+        if (remaining >= len) return remaining;
     }
+    return len < CommandBufferStagingChunkPool::kChunkSize ?
+        CommandBufferStagingChunkPool::kChunkSize : len;
+}
 
-    return (void*)(m_buf + m_writePos);
+void *CommandBufferStagingStream::allocBuffer(size_t minSize) {
+    if (!m_chunks.empty()) {
+        Chunk& last = m_chunks.back();
+        if (last.capacity - last.used >= minSize) {
+            return (void*)(last.data + last.used);
+        }
+    }
+
+    Chunk chunk;
+    chunk.data = m_pool->acquire(minSize, &chunk.capacity);
+    chunk.used = 0;
+    m_chunks.push_back(chunk);
+    return (void*)chunk.data;
 }
 
 int CommandBufferStagingStream::commitBuffer(size_t size)
 {
-    m_writePos += size;
+    m_chunks.back().used += size;
+    m_written += size;
     return 0;
 }
 
@@ -103,12 +144,15 @@ const unsigned char *CommandBufferStagingStream::commitBufferAndReadFully(
     return nullptr;
 }
 
-void CommandBufferStagingStream::getWritten(unsigned char** bufOut, size_t* sizeOut) {
-    *bufOut = m_buf;
-    *sizeOut = m_writePos;
-}
-
 void CommandBufferStagingStream::reset() {
-    m_writePos = 0;
+    releaseChunks();
+    m_written = 0;
     IOStream::rewind();
 }
+
+void CommandBufferStagingStream::releaseChunks() {
+    for (const auto& chunk : m_chunks) {
+        m_pool->release(chunk.data, chunk.capacity);
+    }
+    m_chunks.clear();
+}
@@ -18,9 +18,50 @@
 
 #include "IOStream.h"
 
+#include "android/base/synchronization/AndroidLock.h"
+
+#include <vector>
+
+// Fixed-size chunks of staging memory shared by CommandBufferStagingStreams.
+// Chunks given back by reset streams are kept for reuse as long as the free
+// list stays under |budget| bytes; the rest go back to the system allocator.
+// Chunks bigger than kChunkSize, for single commands that do not fit in one,
+// are never kept.
+class CommandBufferStagingChunkPool {
+public:
+    static constexpr size_t kChunkSize = 256 * 1024;
+    static constexpr size_t kDefaultBudget = 16 * 1024 * 1024;
+
+    explicit CommandBufferStagingChunkPool(size_t budget = kDefaultBudget);
+    ~CommandBufferStagingChunkPool();
+
+    // Returns a chunk of at least |minSize| bytes and stores its capacity in
+    // |capacityOut|.
+    unsigned char* acquire(size_t minSize, size_t* capacityOut);
+    void release(unsigned char* chunk, size_t capacity);
+
+    // Bytes held in the free list.
+    size_t cachedBytes();
+
+private:
+    android::base::guest::Lock m_lock;
+    std::vector<unsigned char*> m_free;
+    const size_t m_budget;
+};
+
+// Records the commands of one command buffer into a list of chunks drawn
+// from a CommandBufferStagingChunkPool. Each IOStream allocation is
+// contiguous, so a command never straddles two chunks; growing the stream
+// never copies what has already been recorded.
 class CommandBufferStagingStream : public IOStream {
 public:
-    explicit CommandBufferStagingStream();
+    struct Chunk {
+        unsigned char* data;
+        size_t capacity;
+        size_t used;
+    };
+
+    explicit CommandBufferStagingStream(CommandBufferStagingChunkPool* pool);
     ~CommandBufferStagingStream();
 
     virtual size_t idealAllocSize(size_t len);
@@ -31,13 +72,21 @@ public:
     virtual int writeFully(const void *buf, size_t len);
     virtual const unsigned char *commitBufferAndReadFully(size_t size, void *buf, size_t len);
 
-    void getWritten(unsigned char** bufOut, size_t* sizeOut);
+    // Total committed bytes across all chunks.
+    size_t writtenSize() const { return m_written; }
+
+    // Committed commands, in recording order. Chunks may be partially used.
+    const std::vector<Chunk>& chunks() const { return m_chunks; }
+
+    // Returns all chunks to the pool.
     void reset();
 
 private:
-    unsigned char* m_buf;
-    size_t m_size;
-    uint32_t m_writePos;
+    void releaseChunks();
+
+    CommandBufferStagingChunkPool* m_pool;
+    std::vector<Chunk> m_chunks;
+    size_t m_written;
 };
 
 #endif
@@ -15,15 +15,43 @@
 #include "DescriptorSetVirtualization.h"
 #include "Resources.h"
 
+#include <algorithm>
+
 namespace goldfish_vk {
 
+bool SentDescriptorWrite::operator==(const SentDescriptorWrite& other) const {
+    return type == other.type &&
+           descriptorType == other.descriptorType &&
+           handles[0] == other.handles[0] &&
+           handles[1] == other.handles[1] &&
+           offset == other.offset &&
+           range == other.range &&
+           imageLayout == other.imageLayout;
+}
+
+DescriptorWrite& DescriptorWriteTable::writeEntry(uint32_t binding, uint32_t arrayElement) {
+    uint32_t index = bindingOffsets[binding] + arrayElement;
+    if (!isPending[index]) {
+        isPending[index] = true;
+        pending.push_back(index);
+    }
+    return writes[index];
+}
+
+void DescriptorWriteTable::clear() {
+    writes.clear();
+    sent.clear();
+    pending.clear();
+    isPending.clear();
+    bindingOffsets.clear();
+}
+
 void clearReifiedDescriptorSet(ReifiedDescriptorSet* set) {
     set->pool = VK_NULL_HANDLE;
     set->setLayout = VK_NULL_HANDLE;
     set->poolId = -1;
     set->allocationPending = false;
     set->allWrites.clear();
-    set->pendingWriteArrayRanges.clear();
 }
 
 void initDescriptorWriteTable(const std::vector<VkDescriptorSetLayoutBinding>& layoutBindings, DescriptorWriteTable& table) {
@@ -42,22 +70,28 @@ void initDescriptorWriteTable(const std::vector<VkDescriptorSetLayoutBinding>& l
             layoutBindings[i].descriptorCount;
     }
 
-    table.resize(countsEachBinding.size());
-
-    for (uint32_t i = 0; i < table.size(); ++i) {
-        table[i].resize(countsEachBinding[i]);
+    table.clear();
+    table.bindingOffsets.resize(countsEachBinding.size() + 1);
 
-        for (uint32_t j = 0; j < countsEachBinding[i]; ++j) {
-            table[i][j].type = DescriptorWriteType::Empty;
-            table[i][j].dstArrayElement = 0;
-        }
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < countsEachBinding.size(); ++i) {
+        table.bindingOffsets[i] = total;
+        total += countsEachBinding[i];
     }
-}
+    table.bindingOffsets[countsEachBinding.size()] = total;
 
-static void initializeReifiedDescriptorSet(VkDescriptorPool pool, VkDescriptorSetLayout setLayout, ReifiedDescriptorSet* set) {
+    DescriptorWrite empty = {};
+    empty.type = DescriptorWriteType::Empty;
+    table.writes.resize(total, empty);
 
-    set->pendingWriteArrayRanges.clear();
+    SentDescriptorWrite nothingSent = {};
+    nothingSent.type = DescriptorWriteType::Empty;
+    table.sent.resize(total, nothingSent);
 
+    table.isPending.resize(total, false);
+}
+
+static void initializeReifiedDescriptorSet(VkDescriptorPool pool, VkDescriptorSetLayout setLayout, ReifiedDescriptorSet* set) {
     const auto& layoutInfo = *(as_goldfish_VkDescriptorSetLayout(setLayout)->layoutInfo);
 
     initDescriptorWriteTable(layoutInfo.bindings, set->allWrites);
@@ -127,7 +161,7 @@ void doEmulatedDescriptorWrite(const VkWriteDescriptorSet* write, ReifiedDescrip
                 ++dstBinding;
                 arrOffset = 0;
             }
-            auto& entry = table[dstBinding][arrOffset];
+            auto& entry = table.writeEntry(dstBinding, arrOffset);
             entry.imageInfo = write->pImageInfo[i];
             entry.type = DescriptorWriteType::ImageInfo;
             entry.descriptorType = descType;
@@ -138,7 +172,7 @@ void doEmulatedDescriptorWrite(const VkWriteDescriptorSet* write, ReifiedDescrip
                 ++dstBinding;
                 arrOffset = 0;
             }
-            auto& entry = table[dstBinding][arrOffset];
+            auto& entry = table.writeEntry(dstBinding, arrOffset);
             entry.bufferInfo = write->pBufferInfo[i];
             entry.type = DescriptorWriteType::BufferInfo;
             entry.descriptorType = descType;
@@ -149,7 +183,7 @@ void doEmulatedDescriptorWrite(const VkWriteDescriptorSet* write, ReifiedDescrip
                 ++dstBinding;
                 arrOffset = 0;
             }
-            auto& entry = table[dstBinding][arrOffset];
+            auto& entry = table.writeEntry(dstBinding, arrOffset);
             entry.bufferView = write->pTexelBufferView[i];
             entry.type = DescriptorWriteType::BufferView;
             entry.descriptorType = descType;
@@ -188,7 +222,7 @@ void doEmulatedDescriptorCopy(const VkCopyDescriptorSet* copy, const ReifiedDesc
             ++currBinding;
             arrOffset = 0;
         }
-        dstTable[currBinding][arrOffset] = toCopy[i];
+        dstTable.writeEntry(currBinding, arrOffset) = toCopy[i];
     }
 }
 
@@ -210,7 +244,7 @@ void doEmulatedDescriptorImageInfoWriteFromTemplate(
             ++currBinding;
             arrOffset = 0;
         }
-        auto& entry = table[currBinding][arrOffset];
+        auto& entry = table.writeEntry(currBinding, arrOffset);
         entry.imageInfo = imageInfos[i];
         entry.type = DescriptorWriteType::ImageInfo;
         entry.descriptorType = descType;
@@ -235,7 +269,7 @@ void doEmulatedDescriptorBufferInfoWriteFromTemplate(
             ++currBinding;
             arrOffset = 0;
         }
-        auto& entry = table[currBinding][dstArrayElement + i];
+        auto& entry = table.writeEntry(currBinding, arrOffset);
         entry.bufferInfo = bufferInfos[i];
         entry.type = DescriptorWriteType::BufferInfo;
         entry.descriptorType = descType;
@@ -260,13 +294,152 @@ void doEmulatedDescriptorBufferViewWriteFromTemplate(
             ++currBinding;
             arrOffset = 0;
         }
-        auto& entry = table[currBinding][dstArrayElement + i];
+        auto& entry = table.writeEntry(currBinding, arrOffset);
         entry.bufferView = bufferViews[i];
         entry.type = DescriptorWriteType::BufferView;
         entry.descriptorType = descType;
     }
 }
 
+// Bytes one descriptor adds to vkQueueCommitDescriptorSetUpdatesGOOGLE,
+// with handles encoded as 64-bit host handles.
+static uint64_t descriptorWireSize(DescriptorWriteType type) {
+    switch (type) {
+        case DescriptorWriteType::ImageInfo:
+            return 2 * sizeof(uint64_t) + sizeof(uint32_t);
+        case DescriptorWriteType::BufferInfo:
+            return sizeof(uint64_t) + 2 * sizeof(VkDeviceSize);
+        case DescriptorWriteType::BufferView:
+            return sizeof(uint64_t);
+        default:
+            return 0;
+    }
+}
+
+static SentDescriptorWrite toSentDescriptorWrite(const DescriptorWrite& write) {
+    SentDescriptorWrite res = {};
+    res.type = write.type;
+    res.descriptorType = write.descriptorType;
+
+    switch (write.type) {
+        case DescriptorWriteType::ImageInfo:
+            res.handles[0] = get_host_u64_VkSampler(write.imageInfo.sampler);
+            res.handles[1] = get_host_u64_VkImageView(write.imageInfo.imageView);
+            res.imageLayout = write.imageInfo.imageLayout;
+            break;
+        case DescriptorWriteType::BufferInfo:
+            res.handles[0] = get_host_u64_VkBuffer(write.bufferInfo.buffer);
+            res.offset = write.bufferInfo.offset;
+            res.range = write.bufferInfo.range;
+            break;
+        case DescriptorWriteType::BufferView:
+            res.handles[0] = get_host_u64_VkBufferView(write.bufferView);
+            break;
+        default:
+            break;
+    }
+
+    return res;
+}
+
+uint32_t collectPendingDescriptorWrites(
+    VkDescriptorSet set,
+    ReifiedDescriptorSet* reified,
+    DescriptorWriteInfoStorage* storage,
+    std::vector<VkWriteDescriptorSet>* writesForHost,
+    DescriptorUpdateStats* stats) {
+
+    DescriptorWriteTable& table = reified->allWrites;
+    if (table.pending.empty()) return 0;
+
+    // Sorted, consecutive array elements of a binding end up next to each
+    // other and bindings are visited in order.
+    std::sort(table.pending.begin(), table.pending.end());
+
+    uint32_t appended = 0;
+    uint32_t binding = 0;
+    uint32_t lastSentIndex = 0;
+
+    for (uint32_t index : table.pending) {
+        table.isPending[index] = false;
+        const DescriptorWrite& write = table.writes[index];
+
+        switch (write.type) {
+            case DescriptorWriteType::Empty:
+                // Copied from a descriptor that was never written.
+                continue;
+            case DescriptorWriteType::InlineUniformBlock:
+            case DescriptorWriteType::AccelerationStructure:
+                // TODO
+                ALOGE("Encountered pending inline uniform block or acceleration structure desc write, abort (NYI)\n");
+                abort();
+            default:
+                break;
+        }
+
+        while (index >= table.bindingOffsets[binding + 1]) ++binding;
+
+        SentDescriptorWrite sent = toSentDescriptorWrite(write);
+        uint64_t wireSize = descriptorWireSize(write.type);
+
+        if (sent == table.sent[index]) {
+            ++stats->descriptorsSkipped;
+            stats->bytesSkipped += wireSize;
+            continue;
+        }
+
+        table.sent[index] = sent;
+        ++stats->descriptorsSent;
+        stats->bytesSent += wireSize;
+
+        // The previous sent element's info was the last one appended to
+        // |storage|, so extending its write keeps the infos contiguous.
+        bool extendsLastWrite =
+            appended &&
+            lastSentIndex + 1 == index &&
+            index > table.bindingOffsets[binding] &&
+            writesForHost->back().descriptorType == write.descriptorType;
+        lastSentIndex = index;
+
+        switch (write.type) {
+            case DescriptorWriteType::ImageInfo:
+                storage->imageInfos.push_back(write.imageInfo);
+                break;
+            case DescriptorWriteType::BufferInfo:
+                storage->bufferInfos.push_back(write.bufferInfo);
+                break;
+            case DescriptorWriteType::BufferView:
+                storage->bufferViews.push_back(write.bufferView);
+                break;
+            default:
+                break;
+        }
+
+        if (extendsLastWrite) {
+            ++writesForHost->back().descriptorCount;
+            continue;
+        }
+
+        VkWriteDescriptorSet forHost = {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, 0 /* TODO: inline uniform block */,
+            set,
+            binding,
+            index - table.bindingOffsets[binding],
+            1,
+            write.descriptorType,
+            write.type == DescriptorWriteType::ImageInfo ? &storage->imageInfos.back() : nullptr,
+            write.type == DescriptorWriteType::BufferInfo ? &storage->bufferInfos.back() : nullptr,
+            write.type == DescriptorWriteType::BufferView ? &storage->bufferViews.back() : nullptr,
+        };
+
+        writesForHost->push_back(forHost);
+        ++appended;
+    }
+
+    table.pending.clear();
+    return appended;
+}
+
 static bool isBindingFeasibleForAlloc(
     const DescriptorPoolAllocationInfo::DescriptorCountInfo& countInfo,
     const VkDescriptorSetLayoutBinding& binding) {
@@ -45,18 +45,65 @@ struct DescriptorWrite {
         VkWriteDescriptorSetInlineUniformBlockEXT inlineUniformBlock;
         VkWriteDescriptorSetAccelerationStructureKHR accelerationStructure;
     };
-
-    std::vector<uint8_t> inlineUniformBlockBuffer;
 };
 
-using DescriptorWriteTable = std::vector<std::vector<DescriptorWrite>>;
+// What the host copy of a descriptor set was last sent for one array
+// element. Handles are stored as host handles, so a guest handle that was
+// destroyed and reused for a different object does not compare equal.
+struct SentDescriptorWrite {
+    DescriptorWriteType type; // Empty if nothing was sent yet.
+    VkDescriptorType descriptorType;
+    uint64_t handles[2];
+    VkDeviceSize offset;
+    VkDeviceSize range;
+    VkImageLayout imageLayout;
+
+    bool operator==(const SentDescriptorWrite& other) const;
+    bool operator!=(const SentDescriptorWrite& other) const { return !(*this == other); }
+};
 
-struct DescriptorWriteArrayRange {
-    uint32_t begin;
+// The array elements of one binding within a DescriptorWriteTable.
+template <class T>
+struct DescriptorWriteBinding {
+    T* data;
     uint32_t count;
+
+    uint32_t size() const { return count; }
+    T& operator[](uint32_t i) const { return data[i]; }
 };
 
-using DescriptorWriteDstArrayRangeTable = std::vector<std::vector<DescriptorWriteArrayRange>>;
+// All descriptors of a set, stored flat: binding b occupies
+// writes[bindingOffsets[b]] to writes[bindingOffsets[b + 1] - 1].
+struct DescriptorWriteTable {
+    std::vector<DescriptorWrite> writes;
+    // Parallel to |writes|.
+    std::vector<SentDescriptorWrite> sent;
+    // Indices into |writes| changed since the last commit, without duplicates.
+    std::vector<uint32_t> pending;
+    std::vector<bool> isPending;
+    std::vector<uint32_t> bindingOffsets;
+
+    // Number of bindings, including unused ones below the highest binding.
+    uint32_t size() const {
+        return bindingOffsets.empty() ? 0 : (uint32_t)bindingOffsets.size() - 1;
+    }
+
+    DescriptorWriteBinding<DescriptorWrite> operator[](uint32_t binding) {
+        return { writes.data() + bindingOffsets[binding],
+                 bindingOffsets[binding + 1] - bindingOffsets[binding] };
+    }
+
+    DescriptorWriteBinding<const DescriptorWrite> operator[](uint32_t binding) const {
+        return { writes.data() + bindingOffsets[binding],
+                 bindingOffsets[binding + 1] - bindingOffsets[binding] };
+    }
+
+    // Returns the entry for |arrayElement| of |binding| to be overwritten,
+    // queueing it for the next commit.
+    DescriptorWrite& writeEntry(uint32_t binding, uint32_t arrayElement);
+
+    void clear();
+};
 
 struct ReifiedDescriptorSet {
     VkDescriptorPool pool;
@@ -67,9 +114,6 @@ struct ReifiedDescriptorSet {
     // Indexed first by binding number
     DescriptorWriteTable allWrites;
 
-    // Indexed first by binding number
-    DescriptorWriteDstArrayRangeTable pendingWriteArrayRanges;
-
     // Indexed by binding number
     std::vector<bool> bindingIsImmutableSampler;
 
@@ -112,6 +156,42 @@ bool isDescriptorTypeBufferView(VkDescriptorType descType);
 bool isDescriptorTypeInlineUniformBlock(VkDescriptorType descType);
 bool isDescriptorTypeAccelerationStructure(VkDescriptorType descType);
 
+// Counts descriptors that were queued for the host, split into the ones
+// sent and the ones dropped because the host already had that value.
+struct DescriptorUpdateStats {
+    uint64_t descriptorsSent = 0;
+    uint64_t descriptorsSkipped = 0;
+    uint64_t bytesSent = 0;
+    uint64_t bytesSkipped = 0;
+};
+
+// Backing storage for the p*Info arrays of VkWriteDescriptorSets built by
+// collectPendingDescriptorWrites(). Must be reserved up front for every
+// pending descriptor, since the writes point into it.
+struct DescriptorWriteInfoStorage {
+    std::vector<VkDescriptorImageInfo> imageInfos;
+    std::vector<VkDescriptorBufferInfo> bufferInfos;
+    std::vector<VkBufferView> bufferViews;
+
+    void reserve(size_t count) {
+        imageInfos.reserve(imageInfos.size() + count);
+        bufferInfos.reserve(bufferInfos.size() + count);
+        bufferViews.reserve(bufferViews.size() + count);
+    }
+};
+
+// Appends to |writesForHost| the pending descriptors of |set| whose value
+// differs from what the host last received, merging consecutive array
+// elements of a binding into one VkWriteDescriptorSet, and clears the
+// pending list. |storage| needs room for allWrites.pending.size() more
+// entries of each kind. Returns the number of writes appended.
+uint32_t collectPendingDescriptorWrites(
+    VkDescriptorSet set,
+    ReifiedDescriptorSet* reified,
+    DescriptorWriteInfoStorage* storage,
+    std::vector<VkWriteDescriptorSet>* writesForHost,
+    DescriptorUpdateStats* stats);
+
 void doEmulatedDescriptorWrite(const VkWriteDescriptorSet* write, ReifiedDescriptorSet* toWrite);
 void doEmulatedDescriptorCopy(const VkCopyDescriptorSet* copy, const ReifiedDescriptorSet* src, ReifiedDescriptorSet* dst);
 
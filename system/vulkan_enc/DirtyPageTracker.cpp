@@ -0,0 +1,343 @@
+// Copyright (C) 2022 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "DirtyPageTracker.h"
+
+#include "android/base/synchronization/AndroidLock.h"
+
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
+
+#include <log/log.h>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using android::base::guest::AutoLock;
+using android::base::guest::Lock;
+
+namespace goldfish_vk {
+
+namespace {
+
+constexpr size_t kMaxRegions = 1024;
+constexpr uint64_t kBitsPerWord = 64;
+
+// The fault handler cannot take a guest::Lock or allocate, so it scans this
+// fixed table. |busy| serializes the handler with takeDirtyRuns(),
+// markDirty() and untrack() on the same region, which keeps "page is
+// writable" and "page's dirty bit is set" equivalent.
+struct Region {
+    std::atomic<uintptr_t> begin;
+    std::atomic<uintptr_t> end;
+    std::atomic<std::atomic<uint64_t>*> dirty;
+    std::atomic<bool> busy;
+};
+
+Region sRegions[kMaxRegions];
+std::atomic<uint64_t> sPageFaults;
+std::atomic<uint64_t> sBytesRequested;
+std::atomic<uint64_t> sBytesFlushed;
+
+// Everything below is only touched outside the fault handler.
+Lock sLock;
+std::unordered_map<uintptr_t, Region*> sRegionsByBase;
+uint64_t sBytesTracked = 0;
+
+void lockRegion(Region& r) {
+    while (r.busy.exchange(true, std::memory_order_acquire)) {
+#if defined(__linux__)
+        sched_yield();
+#endif
+    }
+}
+
+void unlockRegion(Region& r) {
+    r.busy.store(false, std::memory_order_release);
+}
+
+bool isDirty(std::atomic<uint64_t>* dirty, uint64_t page) {
+    return dirty[page / kBitsPerWord].load(std::memory_order_relaxed) &
+           (1ULL << (page % kBitsPerWord));
+}
+
+#if defined(__linux__)
+
+size_t sPageSize = sysconf(_SC_PAGESIZE);
+struct sigaction sPreviousAction;
+
+bool setWritable(uintptr_t begin, uint64_t size, bool writable) {
+    return !mprotect((void*)begin, size,
+                     writable ? PROT_READ | PROT_WRITE : PROT_READ);
+}
+
+bool handleFault(uintptr_t addr) {
+    for (auto& r : sRegions) {
+        uintptr_t begin = r.begin.load(std::memory_order_acquire);
+        if (!begin || addr < begin ||
+            addr >= r.end.load(std::memory_order_relaxed)) {
+            continue;
+        }
+        lockRegion(r);
+        // The region may have been untracked while we were waiting, in which
+        // case it is writable again and retrying the access is all we need.
+        if (r.begin.load(std::memory_order_acquire) == begin) {
+            uint64_t page = (addr - begin) / sPageSize;
+            r.dirty.load(std::memory_order_relaxed)[page / kBitsPerWord].fetch_or(
+                1ULL << (page % kBitsPerWord), std::memory_order_relaxed);
+            setWritable(begin + page * sPageSize, sPageSize, true);
+            sPageFaults.fetch_add(1, std::memory_order_relaxed);
+        }
+        unlockRegion(r);
+        return true;
+    }
+    return false;
+}
+
+void onSigsegv(int sig, siginfo_t* info, void* context) {
+    if (info->si_code == SEGV_ACCERR && handleFault((uintptr_t)info->si_addr)) {
+        return;
+    }
+
+    if (sPreviousAction.sa_flags & SA_SIGINFO) {
+        if (sPreviousAction.sa_sigaction) {
+            sPreviousAction.sa_sigaction(sig, info, context);
+            return;
+        }
+    } else if (sPreviousAction.sa_handler != SIG_DFL &&
+               sPreviousAction.sa_handler != SIG_IGN) {
+        sPreviousAction.sa_handler(sig);
+        return;
+    }
+
+    // Not ours and nobody else wants it: fault again with the default action.
+    signal(SIGSEGV, SIG_DFL);
+}
+
+bool installFaultHandler() {
+    struct sigaction action = {};
+    action.sa_sigaction = onSigsegv;
+    action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGSEGV, &action, &sPreviousAction)) {
+        ALOGE("%s: cannot install SIGSEGV handler, dirty page tracking disabled",
+              __func__);
+        return false;
+    }
+    return true;
+}
+
+#else  // !defined(__linux__)
+
+size_t sPageSize = 4096;
+
+bool setWritable(uintptr_t, uint64_t, bool) { return false; }
+bool installFaultHandler() { return false; }
+
+#endif  // !defined(__linux__)
+
+bool sHandlerInstalled = false;
+
+Region* findRegion(void* base) {
+    auto it = sRegionsByBase.find((uintptr_t)base);
+    return it == sRegionsByBase.end() ? nullptr : it->second;
+}
+
+}  // namespace
+
+DirtyPageTracker::DirtyPageTracker() {
+    sHandlerInstalled = installFaultHandler();
+}
+
+// static
+DirtyPageTracker* DirtyPageTracker::get() {
+    static DirtyPageTracker* sTracker = new DirtyPageTracker;
+    return sTracker;
+}
+
+// static
+size_t DirtyPageTracker::pageSize() {
+    return sPageSize;
+}
+
+bool DirtyPageTracker::track(void* base, uint64_t size) {
+    uintptr_t begin = (uintptr_t)base;
+    if (!sHandlerInstalled || !begin || !size ||
+        begin % sPageSize || size % sPageSize) {
+        return false;
+    }
+
+    AutoLock<Lock> lock(sLock);
+    if (sRegionsByBase.count(begin)) return false;
+
+    auto freeSlot = std::find_if(std::begin(sRegions), std::end(sRegions),
+        [](const Region& r) { return !r.begin.load(std::memory_order_relaxed); });
+    if (freeSlot == std::end(sRegions)) return false;
+
+    Region& r = *freeSlot;
+    uint64_t pages = size / sPageSize;
+    r.end.store(begin + size, std::memory_order_relaxed);
+    r.dirty.store(new std::atomic<uint64_t>[(pages + kBitsPerWord - 1) / kBitsPerWord](),
+                  std::memory_order_relaxed);
+    // Publish before protecting, so a write racing with us finds the region.
+    r.begin.store(begin, std::memory_order_release);
+
+    if (!setWritable(begin, size, false)) {
+        ALOGE("%s: cannot write-protect %p (size 0x%llx)", __func__, base,
+              (unsigned long long)size);
+        r.begin.store(0, std::memory_order_release);
+        delete[] r.dirty.load(std::memory_order_relaxed);
+        return false;
+    }
+
+    sRegionsByBase[begin] = &r;
+    sBytesTracked += size;
+    return true;
+}
+
+void DirtyPageTracker::untrack(void* base) {
+    AutoLock<Lock> lock(sLock);
+    Region* r = findRegion(base);
+    if (!r) return;
+
+    uintptr_t begin = (uintptr_t)base;
+    uint64_t size = r->end.load(std::memory_order_relaxed) - begin;
+
+    lockRegion(*r);
+    r->begin.store(0, std::memory_order_relaxed);
+    setWritable(begin, size, true);
+    unlockRegion(*r);
+
+    delete[] r->dirty.load(std::memory_order_relaxed);
+    sRegionsByBase.erase(begin);
+    sBytesTracked -= size;
+}
+
+bool DirtyPageTracker::isTracked(void* base) {
+    AutoLock<Lock> lock(sLock);
+    return findRegion(base) != nullptr;
+}
+
+void DirtyPageTracker::takeDirtyRuns(void* base, uint64_t offset, uint64_t size,
+                                     std::vector<Run>* runs) {
+    AutoLock<Lock> lock(sLock);
+    Region* r = findRegion(base);
+    if (!r) {
+        if (runs && size) runs->emplace_back(offset, size);
+        return;
+    }
+
+    uintptr_t begin = (uintptr_t)base;
+    uint64_t regionSize = r->end.load(std::memory_order_relaxed) - begin;
+    if (offset >= regionSize) return;
+    size = std::min(size, regionSize - offset);
+    if (!size) return;
+
+    const uint64_t end = offset + size;
+    const uint64_t lastPage = (end - 1) / sPageSize;
+    const size_t firstNewRun = runs ? runs->size() : 0;
+    std::atomic<uint64_t>* dirty = r->dirty.load(std::memory_order_relaxed);
+
+    // Pages to write-protect again are batched into one mprotect() per run.
+    uint64_t protectBegin = 0;
+    uint64_t protectEnd = 0;
+    auto flushProtect = [&]() {
+        if (protectEnd > protectBegin) {
+            setWritable(begin + protectBegin, protectEnd - protectBegin, false);
+        }
+        protectBegin = protectEnd = 0;
+    };
+
+    lockRegion(*r);
+    for (uint64_t page = offset / sPageSize; page <= lastPage; ++page) {
+        if (!(page % kBitsPerWord) &&
+            !dirty[page / kBitsPerWord].load(std::memory_order_relaxed)) {
+            page += kBitsPerWord - 1;
+            continue;
+        }
+        if (!isDirty(dirty, page)) continue;
+
+        uint64_t pageBegin = page * sPageSize;
+        uint64_t pageEnd = pageBegin + sPageSize;
+
+        if (pageBegin >= offset && pageEnd <= end) {
+            dirty[page / kBitsPerWord].fetch_and(~(1ULL << (page % kBitsPerWord)),
+                                                 std::memory_order_relaxed);
+            if (protectEnd != pageBegin) {
+                flushProtect();
+                protectBegin = pageBegin;
+            }
+            protectEnd = pageEnd;
+        }
+
+        if (!runs) continue;
+        uint64_t runBegin = std::max(pageBegin, offset);
+        uint64_t runEnd = std::min(pageEnd, end);
+        if (runs->size() > firstNewRun &&
+            runs->back().first + runs->back().second == runBegin) {
+            runs->back().second += runEnd - runBegin;
+        } else {
+            runs->emplace_back(runBegin, runEnd - runBegin);
+        }
+    }
+    flushProtect();
+    unlockRegion(*r);
+}
+
+void DirtyPageTracker::markDirty(void* base, uint64_t offset, uint64_t size) {
+    AutoLock<Lock> lock(sLock);
+    Region* r = findRegion(base);
+    if (!r) return;
+
+    uintptr_t begin = (uintptr_t)base;
+    uint64_t regionSize = r->end.load(std::memory_order_relaxed) - begin;
+    if (offset >= regionSize || !size) return;
+    size = std::min(size, regionSize - offset);
+
+    const uint64_t firstPage = offset / sPageSize;
+    const uint64_t lastPage = (offset + size - 1) / sPageSize;
+    std::atomic<uint64_t>* dirty = r->dirty.load(std::memory_order_relaxed);
+
+    lockRegion(*r);
+    for (uint64_t page = firstPage; page <= lastPage; ++page) {
+        dirty[page / kBitsPerWord].fetch_or(1ULL << (page % kBitsPerWord),
+                                            std::memory_order_relaxed);
+    }
+    setWritable(begin + firstPage * sPageSize,
+                (lastPage - firstPage + 1) * sPageSize, true);
+    unlockRegion(*r);
+}
+
+void DirtyPageTracker::recordFlush(uint64_t bytesRequested, uint64_t bytesFlushed) {
+    sBytesRequested.fetch_add(bytesRequested, std::memory_order_relaxed);
+    sBytesFlushed.fetch_add(bytesFlushed, std::memory_order_relaxed);
+}
+
+DirtyPageTracker::Stats DirtyPageTracker::stats() {
+    Stats res;
+    {
+        AutoLock<Lock> lock(sLock);
+        res.bytesTracked = sBytesTracked;
+    }
+    res.bytesRequested = sBytesRequested.load(std::memory_order_relaxed);
+    res.bytesFlushed = sBytesFlushed.load(std::memory_order_relaxed);
+    res.pageFaults = sPageFaults.load(std::memory_order_relaxed);
+    return res;
+}
+
+}  // namespace goldfish_vk
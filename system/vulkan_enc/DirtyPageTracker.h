@@ -0,0 +1,84 @@
+// Copyright (C) 2022 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include "android/base/Compiler.h"
+
+#include <utility>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace goldfish_vk {
+
+// DirtyPageTracker records which pages of a guest-side buffer were written
+// since they were last flushed, so vkFlushMappedMemoryRanges on
+// non-direct-mapped memory only has to stream the modified pages to the host.
+//
+// Tracked regions are write-protected with mprotect(). The first write to a
+// page raises SIGSEGV; a process-wide handler marks the page dirty and makes
+// it writable again. Faults outside tracked regions are passed on to the
+// previously installed handler.
+//
+// Writes done by the kernel (e.g. read(2) straight into a tracked buffer)
+// fail with EFAULT instead of faulting, so tracking is opt-in.
+//
+// Only available on Linux and Android; elsewhere track() always fails.
+class DirtyPageTracker {
+public:
+    // A byte range (offset, size) relative to the start of a region.
+    using Run = std::pair<uint64_t, uint64_t>;
+
+    struct Stats {
+        uint64_t bytesTracked = 0;    // Bytes currently write-protected/tracked.
+        uint64_t bytesRequested = 0;  // Bytes the app asked to flush.
+        uint64_t bytesFlushed = 0;    // Bytes actually sent to the host.
+        uint64_t pageFaults = 0;      // First writes to clean pages.
+    };
+
+    static DirtyPageTracker* get();
+    static size_t pageSize();
+
+    // Starts tracking |size| bytes at |base|; both must be page aligned,
+    // and nothing else may live in those pages. All pages start clean.
+    // Returns false if the region cannot be tracked, in which case the
+    // caller should treat it as always dirty.
+    bool track(void* base, uint64_t size);
+    // Stops tracking and makes the region writable again.
+    void untrack(void* base);
+    bool isTracked(void* base);
+
+    // Appends the dirty bytes of [offset, offset + size) to |runs|, merging
+    // adjacent pages and clamping to the range. Pages lying wholly inside
+    // the range are write-protected and marked clean; pages straddling
+    // either end stay dirty, since bytes outside the range were not flushed.
+    // |runs| may be null to only mark the range clean.
+    void takeDirtyRuns(void* base, uint64_t offset, uint64_t size,
+                       std::vector<Run>* runs);
+
+    // Marks every page touching [offset, offset + size) dirty and writable,
+    // e.g. before the encoder reads invalidated data into it through a
+    // kernel interface. Follow with takeDirtyRuns(..., nullptr) once done.
+    void markDirty(void* base, uint64_t offset, uint64_t size);
+
+    void recordFlush(uint64_t bytesRequested, uint64_t bytesFlushed);
+    Stats stats();
+
+private:
+    DirtyPageTracker();
+    DISALLOW_COPY_ASSIGN_AND_MOVE(DirtyPageTracker);
+};
+
+}  // namespace goldfish_vk
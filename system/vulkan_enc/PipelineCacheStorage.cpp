@@ -0,0 +1,143 @@
+// Copyright (C) 2022 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "PipelineCacheStorage.h"
+
+#include <atomic>
+#include <fstream>
+
+#include <log/log.h>
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace goldfish_vk {
+
+namespace {
+
+// VkPipelineCacheHeaderVersionOne: headerSize, headerVersion, vendorID,
+// deviceID, then pipelineCacheUUID.
+constexpr size_t kHeaderSize = 4 * sizeof(uint32_t) + PipelineCacheKey::kUuidSize;
+constexpr uint32_t kHeaderVersionOne = 1;
+
+// Keeps temporary files of concurrent store() calls apart.
+std::atomic<uint32_t> sTmpFileCount { 0 };
+
+uint32_t readU32(const uint8_t* p) {
+    uint32_t res;
+    memcpy(&res, p, sizeof(res));
+    return res;
+}
+
+}  // namespace
+
+PipelineCacheStorage::PipelineCacheStorage(std::string dir) : mDir(std::move(dir)) {}
+
+std::string PipelineCacheStorage::pathFor(const PipelineCacheKey& key) const {
+    char name[64];
+    int len = snprintf(name, sizeof(name), "_%08x_%08x_", key.vendorID, key.deviceID);
+    std::string res = mDir + "/vk_pipeline_cache_" + key.app + std::string(name, len);
+    for (uint8_t b : key.uuid) {
+        snprintf(name, sizeof(name), "%02x", b);
+        res += name;
+    }
+    return res + ".bin";
+}
+
+// static
+std::string PipelineCacheStorage::currentApp() {
+    std::string cmdline;
+    std::ifstream f("/proc/self/cmdline");
+    std::getline(f, cmdline, '\0');
+
+    // Android app processes are named after their package; native ones get
+    // the path of their binary.
+    std::string res = cmdline.substr(cmdline.find_last_of('/') + 1);
+    for (char& c : res) {
+        if (!isalnum((unsigned char)c) && c != '.' && c != '_' && c != '-') c = '_';
+    }
+    if (res.empty() || res == "." || res == "..") {
+        res = "pid" + std::to_string(getpid());
+    }
+    return res;
+}
+
+std::vector<uint8_t> PipelineCacheStorage::load(const PipelineCacheKey& key) const {
+    std::vector<uint8_t> res;
+    if (!enabled()) return res;
+
+    FILE* f = fopen(pathFor(key).c_str(), "rb");
+    if (!f) return res;
+
+    if (!fseek(f, 0, SEEK_END)) {
+        long size = ftell(f);
+        if (size > 0 && !fseek(f, 0, SEEK_SET)) {
+            res.resize(size);
+            if (fread(res.data(), 1, size, f) != (size_t)size) res.clear();
+        }
+    }
+    fclose(f);
+
+    if (!res.empty() && !headerMatches(key, res)) {
+        ALOGD("%s: ignoring pipeline cache from another driver", __func__);
+        res.clear();
+    }
+    return res;
+}
+
+bool PipelineCacheStorage::store(const PipelineCacheKey& key,
+                                 const std::vector<uint8_t>& data) const {
+    if (!enabled() || data.empty()) return false;
+
+    if (mkdir(mDir.c_str(), 0700) && errno != EEXIST) {
+        ALOGE("%s: cannot create %s: %s", __func__, mDir.c_str(), strerror(errno));
+        return false;
+    }
+
+    std::string path = pathFor(key);
+    std::string tmpPath = path + ".tmp." + std::to_string(getpid()) + "." +
+                          std::to_string(sTmpFileCount.fetch_add(1));
+
+    FILE* f = fopen(tmpPath.c_str(), "wb");
+    if (!f) {
+        ALOGE("%s: cannot write %s: %s", __func__, tmpPath.c_str(), strerror(errno));
+        return false;
+    }
+    bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+    ok = !fclose(f) && ok;
+
+    if (!ok || rename(tmpPath.c_str(), path.c_str())) {
+        ALOGE("%s: cannot write %s", __func__, path.c_str());
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+// static
+bool PipelineCacheStorage::headerMatches(const PipelineCacheKey& key,
+                                         const std::vector<uint8_t>& data) {
+    if (data.size() < kHeaderSize) return false;
+    const uint8_t* p = data.data();
+    return readU32(p) >= kHeaderSize && readU32(p) <= data.size() &&
+           readU32(p + 4) == kHeaderVersionOne &&
+           readU32(p + 8) == key.vendorID &&
+           readU32(p + 12) == key.deviceID &&
+           !memcmp(p + 16, key.uuid, PipelineCacheKey::kUuidSize);
+}
+
+}  // namespace goldfish_vk
@@ -0,0 +1,67 @@
+// Copyright (C) 2022 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace goldfish_vk {
+
+// Identifies the app that owns a pipeline cache blob and the host driver
+// that produced it; the driver fields match the
+// VK_PIPELINE_CACHE_HEADER_VERSION_ONE header.
+struct PipelineCacheKey {
+    static constexpr size_t kUuidSize = 16;
+
+    // Only file name characters; see PipelineCacheStorage::currentApp().
+    std::string app;
+    uint32_t vendorID = 0;
+    uint32_t deviceID = 0;
+    uint8_t uuid[kUuidSize] = {};
+};
+
+// PipelineCacheStorage keeps one pipeline cache blob per app and host driver
+// in a directory, so the pipelines an app compiled in a previous run are
+// found in the host's cache again. Apps never read or replace each other's
+// blobs.
+class PipelineCacheStorage {
+public:
+    // An empty |dir| disables the storage.
+    explicit PipelineCacheStorage(std::string dir);
+
+    bool enabled() const { return !mDir.empty(); }
+    std::string pathFor(const PipelineCacheKey& key) const;
+
+    // The name of this process from /proc/self/cmdline, with everything but
+    // [A-Za-z0-9._-] replaced by '_'; "pid<N>" if there is none.
+    static std::string currentApp();
+
+    // Returns the blob stored for |key|, or nothing if there is none or its
+    // header was written by another driver.
+    std::vector<uint8_t> load(const PipelineCacheKey& key) const;
+    // Replaces the blob stored for |key|. Readers see either the old or the
+    // new file, never a partial one.
+    bool store(const PipelineCacheKey& key, const std::vector<uint8_t>& data) const;
+
+    static bool headerMatches(const PipelineCacheKey& key,
+                              const std::vector<uint8_t>& data);
+
+private:
+    const std::string mDir;
+};
+
+}  // namespace goldfish_vk
@@ -0,0 +1,133 @@
+// Copyright (C) 2022 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "QueueSubmitThread.h"
+
+#include <thread>
+
+using android::base::guest::AutoLock;
+using android::base::guest::Lock;
+
+namespace goldfish_vk {
+
+namespace {
+
+// Set on worker threads, so a task that ends up in drain() for its own queue
+// does not wait for itself.
+thread_local QueueSubmitThread* sCurrentSubmitThread = nullptr;
+
+uint32_t roundUpToPowerOf2(uint32_t n) {
+    uint32_t res = 1;
+    while (res < n) res <<= 1;
+    return res;
+}
+
+}  // namespace
+
+QueueSubmitThread::QueueSubmitThread(uint32_t capacity)
+    : mMask(roundUpToPowerOf2(capacity ? capacity : 1) - 1),
+      mSlots(new std::atomic<Task*>[mMask + 1]),
+      mThread([this] { run(); }) {
+    mThread.start();
+}
+
+QueueSubmitThread::~QueueSubmitThread() {
+    // A null task tells the worker to exit once it gets there.
+    while (!push(nullptr)) {
+        wakeWorker();
+        std::this_thread::yield();
+    }
+    wakeWorker();
+    mThread.wait();
+}
+
+void QueueSubmitThread::enqueue(Task task) {
+    mEnqueued.fetch_add(1, std::memory_order_seq_cst);
+
+    Task* toPush = new Task(std::move(task));
+    while (!push(toPush)) {
+        wakeWorker();
+        std::this_thread::yield();
+    }
+    wakeWorker();
+}
+
+void QueueSubmitThread::drain() {
+    if (sCurrentSubmitThread == this) return;
+
+    uint64_t target = mEnqueued.load(std::memory_order_seq_cst);
+    if (mCompleted.load(std::memory_order_seq_cst) >= target) return;
+
+    AutoLock<Lock> lock(mLock);
+    mDrainWaiters.fetch_add(1, std::memory_order_seq_cst);
+    while (mCompleted.load(std::memory_order_seq_cst) < target) {
+        mDrainCv.wait(&mLock);
+    }
+    mDrainWaiters.fetch_sub(1, std::memory_order_relaxed);
+}
+
+bool QueueSubmitThread::idle() const {
+    return mCompleted.load(std::memory_order_seq_cst) ==
+           mEnqueued.load(std::memory_order_seq_cst);
+}
+
+bool QueueSubmitThread::push(Task* task) {
+    uint64_t head = mHead.load(std::memory_order_relaxed);
+    if (head - mTail.load(std::memory_order_acquire) > mMask) return false;
+
+    mSlots[head & mMask].store(task, std::memory_order_relaxed);
+    // Sequentially consistent, so either the worker sees the new head before
+    // it sleeps, or wakeWorker() sees it sleeping.
+    mHead.store(head + 1, std::memory_order_seq_cst);
+    return true;
+}
+
+void QueueSubmitThread::wakeWorker() {
+    if (!mWorkerSleeping.load(std::memory_order_seq_cst)) return;
+    AutoLock<Lock> lock(mLock);
+    mWorkCv.signal();
+}
+
+void QueueSubmitThread::run() {
+    sCurrentSubmitThread = this;
+
+    for (;;) {
+        uint64_t tail = mTail.load(std::memory_order_relaxed);
+
+        if (tail == mHead.load(std::memory_order_seq_cst)) {
+            AutoLock<Lock> lock(mLock);
+            mWorkerSleeping.store(true, std::memory_order_seq_cst);
+            while (tail == mHead.load(std::memory_order_seq_cst)) {
+                mWorkCv.wait(&mLock);
+            }
+            mWorkerSleeping.store(false, std::memory_order_relaxed);
+            continue;
+        }
+
+        Task* task = mSlots[tail & mMask].load(std::memory_order_relaxed);
+        mTail.store(tail + 1, std::memory_order_release);
+
+        if (!task) break;
+
+        (*task)();
+        delete task;
+
+        mCompleted.fetch_add(1, std::memory_order_seq_cst);
+        if (mDrainWaiters.load(std::memory_order_seq_cst)) {
+            AutoLock<Lock> lock(mLock);
+            mDrainCv.broadcast();
+        }
+    }
+}
+
+}  // namespace goldfish_vk
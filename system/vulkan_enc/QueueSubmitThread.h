@@ -0,0 +1,81 @@
+// Copyright (C) 2022 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include "android/base/Compiler.h"
+#include "android/base/synchronization/AndroidConditionVariable.h"
+#include "android/base/synchronization/AndroidLock.h"
+#include "android/base/threads/AndroidFunctorThread.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace goldfish_vk {
+
+// QueueSubmitThread runs the submissions of one VkQueue on a dedicated
+// thread, in the order they were enqueued, so the app's thread does not wait
+// for staging flushes and encoding.
+//
+// Tasks are handed over through a lock-free single-producer ring. Vulkan
+// requires access to a queue to be externally synchronized, so there is only
+// ever one producer at a time. The lock below is only taken when the worker
+// goes to sleep on an empty ring, or when someone waits in drain().
+class QueueSubmitThread {
+public:
+    using Task = std::function<void()>;
+
+    explicit QueueSubmitThread(uint32_t capacity = 256);
+    // Runs the remaining tasks, then joins the thread.
+    ~QueueSubmitThread();
+
+    // Blocks only if |capacity| tasks are already waiting.
+    void enqueue(Task task);
+
+    // Blocks until every task enqueued before the call has finished.
+    // Safe to call from any thread.
+    void drain();
+
+    // True if every task enqueued so far has finished.
+    bool idle() const;
+
+private:
+    bool push(Task* task);
+    void wakeWorker();
+    void run();
+
+    // Ring of |mMask + 1| slots. |mHead| is only advanced by the producer,
+    // |mTail| only by the worker.
+    const uint32_t mMask;
+    std::unique_ptr<std::atomic<Task*>[]> mSlots;
+    std::atomic<uint64_t> mHead { 0 };
+    std::atomic<uint64_t> mTail { 0 };
+
+    std::atomic<uint64_t> mEnqueued { 0 };
+    std::atomic<uint64_t> mCompleted { 0 };
+    std::atomic<bool> mWorkerSleeping { false };
+    std::atomic<uint32_t> mDrainWaiters { 0 };
+
+    android::base::guest::Lock mLock;
+    android::base::guest::ConditionVariable mWorkCv;
+    android::base::guest::ConditionVariable mDrainCv;
+    android::base::guest::FunctorThread mThread;
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(QueueSubmitThread);
+};
+
+}  // namespace goldfish_vk
@@ -18,6 +18,9 @@
 #include "Resources.h"
 #include "CommandBufferStagingStream.h"
 #include "DescriptorSetVirtualization.h"
+#include "DirtyPageTracker.h"
+#include "PipelineCacheStorage.h"
+#include "QueueSubmitThread.h"
 
 #include "android/base/Optional.h"
 #include "android/base/threads/AndroidWorkPool.h"
@@ -126,20 +129,27 @@ VkResult getMemoryAndroidHardwareBufferANDROID(struct AHardwareBuffer **) { retu
 #include "VkEncoder.h"
 
 #include "android/base/AlignedBuf.h"
+#include "android/base/containers/ShardedMap.h"
+#include "android/base/synchronization/AndroidFenceFdWaiter.h"
 #include "android/base/synchronization/AndroidLock.h"
 
 #include "goldfish_address_space.h"
+#include "goldfish_vk_deepcopy_guest.h"
 #include "goldfish_vk_private_defs.h"
 #include "vk_format_info.h"
 #include "vk_struct_id.h"
 #include "vk_util.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <set>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
 
 #include <vndk/hardware_buffer.h>
+#include <cutils/properties.h>
 #include <log/log.h>
 #include <stdlib.h>
 #include <sync/sync.h>
@@ -181,6 +191,7 @@ using android::aligned_buf_alloc;
 using android::aligned_buf_free;
 using android::base::Optional;
 using android::base::guest::AutoLock;
+using android::base::guest::FenceFdWaiter;
 using android::base::guest::RecursiveLock;
 using android::base::guest::Lock;
 using android::base::guest::WorkPool;
@@ -241,6 +252,8 @@ ResourceTracker::ThreadingCallbacks ResourceTracker::threadingCallbacks;
 
 struct StagingInfo {
     Lock mLock;
+    // Recycled across command buffer and command pool resets.
+    CommandBufferStagingChunkPool chunkPool;
     std::vector<CommandBufferStagingStream*> streams;
     std::vector<VkEncoder*> encoders;
 
@@ -266,7 +279,7 @@ struct StagingInfo {
         CommandBufferStagingStream* stream;
         VkEncoder* encoder;
         if (streams.empty()) {
-            stream = new CommandBufferStagingStream;
+            stream = new CommandBufferStagingStream(&chunkPool);
             encoder = new VkEncoder(stream);
         } else {
             stream = streams.back();
@@ -281,6 +294,36 @@ struct StagingInfo {
 
 static StagingInfo sStaging;
 
+// Off by default; see DirtyPageTracker.h for the caveats.
+static bool dirtyPageTrackingFromProperty() {
+    char dirtyPageTrackingProp[PROPERTY_VALUE_MAX];
+    if (property_get("qemu.vk.dirty_page_tracking", dirtyPageTrackingProp, nullptr) > 0) {
+        return atoi(dirtyPageTrackingProp) > 0;
+    }
+    return false;
+}
+
+// Off by default: vkQueueSubmit then returns before the submission is
+// encoded, so its errors are no longer reported to the app.
+static bool asyncQueueSubmitFromProperty() {
+    char asyncQueueSubmitProp[PROPERTY_VALUE_MAX];
+    if (property_get("qemu.vk.async_queue_submit", asyncQueueSubmitProp, nullptr) > 0) {
+        return atoi(asyncQueueSubmitProp) > 0;
+    }
+    return false;
+}
+
+// Directory that keeps an implicit pipeline cache across runs of the app,
+// one file per host driver. Unset by default, since the app must be able to
+// write to it.
+static std::string pipelineCacheDirFromProperty() {
+    char pipelineCacheDirProp[PROPERTY_VALUE_MAX];
+    if (property_get("qemu.vk.pipeline_cache_dir", pipelineCacheDirProp, nullptr) > 0) {
+        return pipelineCacheDirProp;
+    }
+    return "";
+}
+
 class ResourceTracker::Impl {
 public:
     Impl() = default;
@@ -316,6 +359,21 @@ public:
         uint32_t apiVersion;
         std::set<std::string> enabledExtensions;
         std::vector<std::pair<PFN_vkDeviceMemoryReportCallbackEXT, void *>> deviceMemoryReportCallbacks;
+
+        // Used for pipelines created without a cache, and saved with
+        // mPipelineCacheStorage.
+        VkPipelineCache implicitPipelineCache = VK_NULL_HANDLE;
+        // Pipeline creation needs no lock: caches are internally synchronized
+        // unless created with VK_PIPELINE_CACHE_CREATE_EXTERNALLY_SYNCHRONIZED_BIT.
+        // This lock orders saves against each other and against the destroy.
+        std::shared_ptr<Lock> pipelineCacheLock;
+        PipelineCacheKey pipelineCacheKey;
+        size_t pipelineCacheBytesLoaded = 0;
+        uint32_t pipelineCacheChangesSinceSave = 0;
+        uint32_t framesSincePipelineCacheSave = 0;
+        bool pipelineCacheSavePending = false;
+        uint32_t pipelinesCreated = 0;
+        uint64_t pipelineCreateNs = 0;
     };
 
     struct VirtioGpuHostmemResourceInfo {
@@ -330,6 +388,7 @@ public:
         uint32_t memoryTypeIndex = 0;
         bool virtualHostVisibleBacking = false;
         bool directMapped = false;
+        bool dirtyPageTracked = false;
         GoldfishAddressSpaceBlock*
             goldfishAddressSpaceBlock = nullptr;
         VirtioGpuHostmemResourceInfo resInfo;
@@ -456,6 +515,33 @@ public:
 #endif  // VK_USE_PLATFORM_FUCHSIA
     };
 
+// Handle types whose info is read and written together with other tracker
+// state; their tables are guarded by mLock.
+#define GOLDFISH_VK_LIST_LOCKED_INFO_HANDLE_TYPES(f) \
+    f(VkInstance) \
+    f(VkDevice) \
+    f(VkDeviceMemory) \
+    f(VkBuffer) \
+    f(VkImage) \
+    f(VkSemaphore) \
+    f(VkDescriptorUpdateTemplate) \
+    f(VkFence) \
+    __GOLDFISH_VK_LIST_NON_DISPATCHABLE_HANDLE_TYPES_FUCHSIA(f) \
+
+// Handle types whose tables only record which handles are alive. These are
+// created and destroyed at high rates by multithreaded apps (command
+// buffers, descriptor sets, pipelines, views...), so each table locks
+// itself per shard instead of taking mLock.
+#define GOLDFISH_VK_LIST_SHARDED_INFO_HANDLE_TYPES(f) \
+    f(VkCommandBuffer) \
+    f(VkQueue) \
+    f(VkDescriptorPool) \
+    f(VkDescriptorSet) \
+    f(VkDescriptorSetLayout) \
+    f(VkCommandPool) \
+    f(VkSampler) \
+    GOLDFISH_VK_LIST_TRIVIAL_HANDLE_TYPES(f) \
+
 #define HANDLE_REGISTER_IMPL_IMPL(type) \
     std::unordered_map<type, type##_Info> info_##type; \
     void register_##type(type obj) { \
@@ -463,13 +549,19 @@ public:
         info_##type[obj] = type##_Info(); \
     } \
 
+#define HANDLE_REGISTER_SHARDED_IMPL_IMPL(type) \
+    android::base::ShardedMap<type, type##_Info> info_##type; \
+    void register_##type(type obj) { \
+        info_##type.set(obj); \
+    } \
+
 #define HANDLE_UNREGISTER_IMPL_IMPL(type) \
     void unregister_##type(type obj) { \
-        AutoLock<RecursiveLock> lock(mLock); \
         info_##type.erase(obj); \
     } \
 
-    GOLDFISH_VK_LIST_HANDLE_TYPES(HANDLE_REGISTER_IMPL_IMPL)
+    GOLDFISH_VK_LIST_LOCKED_INFO_HANDLE_TYPES(HANDLE_REGISTER_IMPL_IMPL)
+    GOLDFISH_VK_LIST_SHARDED_INFO_HANDLE_TYPES(HANDLE_REGISTER_SHARDED_IMPL_IMPL)
     GOLDFISH_VK_LIST_TRIVIAL_HANDLE_TYPES(HANDLE_UNREGISTER_IMPL_IMPL)
 
     void unregister_VkInstance(VkInstance instance) {
@@ -497,14 +589,12 @@ public:
 
         clearCommandPool(pool);
 
-        AutoLock<RecursiveLock> lock(mLock);
         info_VkCommandPool.erase(pool);
     }
 
     void unregister_VkSampler(VkSampler sampler) {
         if (!sampler) return;
 
-        AutoLock<RecursiveLock> lock(mLock);
         info_VkSampler.erase(sampler);
     }
 
@@ -526,7 +616,6 @@ public:
             delete pendingSets;
         }
 
-        AutoLock<RecursiveLock> lock(mLock);
         info_VkCommandBuffer.erase(commandBuffer);
     }
 
@@ -534,8 +623,8 @@ public:
         struct goldfish_VkQueue* q = as_goldfish_VkQueue(queue);
         if (!q) return;
         if (q->lastUsedEncoder) { q->lastUsedEncoder->decRef(); }
+        if (q->userPtr) { destroyQueueSubmitThread(queue); }
 
-        AutoLock<RecursiveLock> lock(mLock);
         info_VkQueue.erase(queue);
     }
 
@@ -555,6 +644,10 @@ public:
             zx_handle_close(memInfo.vmoHandle);
         }
 
+        if (memInfo.dirtyPageTracked) {
+            DirtyPageTracker::get()->untrack(memInfo.mappedPtr);
+        }
+
         if (memInfo.mappedPtr &&
             !memInfo.virtualHostVisibleBacking &&
             !memInfo.directMapped) {
@@ -685,7 +778,6 @@ public:
     void unregister_VkDescriptorSetLayout(VkDescriptorSetLayout setLayout) {
         if (!setLayout) return;
 
-        AutoLock<RecursiveLock> lock(mLock);
         delete as_goldfish_VkDescriptorSetLayout(setLayout)->layoutInfo;
         info_VkDescriptorSetLayout.erase(setLayout);
     }
@@ -764,10 +856,8 @@ public:
 
         VkDescriptorImageInfo res = inputInfo;
 
-        if (sampler) {
-            auto it = info_VkSampler.find(sampler);
-            bool samplerExists = it != info_VkSampler.end();
-            if (!samplerExists) res.sampler = 0;
+        if (sampler && !info_VkSampler.contains(sampler)) {
+            res.sampler = 0;
         }
 
         return res;
@@ -1703,16 +1793,14 @@ public:
                              uint32_t,
                              uint32_t,
                              VkQueue* pQueue) {
-        AutoLock<RecursiveLock> lock(mLock);
-        info_VkQueue[*pQueue].device = device;
+        info_VkQueue.update(*pQueue, [device](VkQueue_Info& info) { info.device = device; });
     }
 
     void on_vkGetDeviceQueue2(void*,
                               VkDevice device,
                               const VkDeviceQueueInfo2*,
                               VkQueue* pQueue) {
-        AutoLock<RecursiveLock> lock(mLock);
-        info_VkQueue[*pQueue].device = device;
+        info_VkQueue.update(*pQueue, [device](VkQueue_Info& info) { info.device = device; });
     }
 
     VkResult on_vkCreateInstance(
@@ -1761,6 +1849,8 @@ public:
             pCreateInfo->enabledExtensionCount, pCreateInfo->ppEnabledExtensionNames,
             pCreateInfo->pNext);
 
+        createImplicitPipelineCache(enc, *pDevice, props);
+
         return input_result;
     }
 
@@ -1769,6 +1859,11 @@ public:
         VkDevice device,
         const VkAllocationCallbacks*) {
 
+        // Submit threads take mLock, so don't hold it while they finish.
+        for (VkQueue queue : queuesWithSubmitThreads(device)) {
+            destroyQueueSubmitThread(queue);
+        }
+
         AutoLock<RecursiveLock> lock(mLock);
 
         auto it = info_VkDevice.find(device);
@@ -1779,6 +1874,14 @@ public:
 
         VkEncoder* enc = (VkEncoder*)context;
 
+        if (info.pipelinesCreated) {
+            ALOGD("%s: %u pipelines created in %.1f ms (pipeline cache: %s, %zu bytes loaded)",
+                  __func__, info.pipelinesCreated, info.pipelineCreateNs / 1e6,
+                  !mPipelineCacheStorage.enabled() ? "off" :
+                      info.pipelineCacheBytesLoaded ? "warm" : "cold",
+                  info.pipelineCacheBytesLoaded);
+        }
+
         bool freeMemorySyncSupported =
             mFeatureInfo->hasVulkanFreeMemorySync;
         for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; ++i) {
@@ -1788,6 +1891,227 @@ public:
                     enc, device, &block);
             }
         }
+
+        if (mDirtyPageTracking) {
+            DirtyPageTracker::Stats stats = DirtyPageTracker::get()->stats();
+            ALOGD("%s: dirty page tracking: %llu bytes tracked, "
+                  "%llu bytes flushed of %llu requested, %llu page faults",
+                  __func__,
+                  (unsigned long long)stats.bytesTracked,
+                  (unsigned long long)stats.bytesFlushed,
+                  (unsigned long long)stats.bytesRequested,
+                  (unsigned long long)stats.pageFaults);
+        }
+
+        if (mFeatureInfo->hasVulkanBatchedDescriptorSetUpdate) {
+            logDescriptorUpdateStats();
+        }
+
+        logQueueSubmitStats();
+
+        FenceFdWaiter::Stats fdWaitStats = FenceFdWaiter::get()->stats();
+        if (fdWaitStats.waits) {
+            ALOGD("%s: %llu blocking sync fd waits (%llu timed out), "
+                  "wake-up latency avg %.1f us, max %.1f us",
+                  __func__, (unsigned long long)fdWaitStats.waits,
+                  (unsigned long long)fdWaitStats.timeouts,
+                  fdWaitStats.totalWakeupNs / 1000.0 /
+                      std::max<uint64_t>(1, fdWaitStats.waits - fdWaitStats.timeouts),
+                  fdWaitStats.maxWakeupNs / 1000.0);
+        }
+    }
+
+    void createImplicitPipelineCache(VkEncoder* enc, VkDevice device,
+                                     const VkPhysicalDeviceProperties& props) {
+        if (!mPipelineCacheStorage.enabled()) return;
+
+        static_assert(VK_UUID_SIZE == PipelineCacheKey::kUuidSize,
+                      "pipeline cache UUID size mismatch");
+        PipelineCacheKey key;
+        key.app = PipelineCacheStorage::currentApp();
+        key.vendorID = props.vendorID;
+        key.deviceID = props.deviceID;
+        memcpy(key.uuid, props.pipelineCacheUUID, VK_UUID_SIZE);
+
+        std::vector<uint8_t> data = mPipelineCacheStorage.load(key);
+
+        VkPipelineCacheCreateInfo createInfo = {
+            VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO, nullptr, 0,
+            data.size(), data.data(),
+        };
+        VkPipelineCache cache = VK_NULL_HANDLE;
+        if (enc->vkCreatePipelineCache(device, &createInfo, nullptr, &cache,
+                                       false /* no lock */) != VK_SUCCESS) {
+            ALOGE("%s: cannot create the implicit pipeline cache", __func__);
+            return;
+        }
+
+        AutoLock<RecursiveLock> lock(mLock);
+        auto it = info_VkDevice.find(device);
+        if (it == info_VkDevice.end()) return;
+        it->second.implicitPipelineCache = cache;
+        it->second.pipelineCacheLock = std::make_shared<Lock>();
+        it->second.pipelineCacheKey = key;
+        it->second.pipelineCacheBytesLoaded = data.size();
+    }
+
+    // Saves and destroys the implicit cache of |device|. Called before
+    // vkDestroyDevice takes the encoder lock, so the file I/O does not hold
+    // it up.
+    void destroyImplicitPipelineCache(VkEncoder* enc, VkDevice device) {
+        saveImplicitPipelineCache(enc, device);
+
+        VkPipelineCache cache = VK_NULL_HANDLE;
+        std::shared_ptr<Lock> cacheLock;
+        {
+            AutoLock<RecursiveLock> lock(mLock);
+            auto it = info_VkDevice.find(device);
+            if (it == info_VkDevice.end()) return;
+            std::swap(cache, it->second.implicitPipelineCache);
+            cacheLock = it->second.pipelineCacheLock;
+        }
+        if (!cache) return;
+
+        AutoLock<Lock> cacheAutoLock(*cacheLock);
+        enc->vkDestroyPipelineCache(device, cache, nullptr, true /* do lock */);
+    }
+
+    // Writes the implicit cache of |device| back if anything was added to it
+    // since the last time.
+    void saveImplicitPipelineCache(VkEncoder* enc, VkDevice device) {
+        std::shared_ptr<Lock> cacheLock;
+        {
+            AutoLock<RecursiveLock> lock(mLock);
+            auto it = info_VkDevice.find(device);
+            if (it == info_VkDevice.end()) return;
+            cacheLock = it->second.pipelineCacheLock;
+        }
+
+        // Taken before the handle is looked up, so a save from mWorkPool
+        // cannot use a cache that destroyImplicitPipelineCache has freed, and
+        // held through the store so saves reach the file in order.
+        AutoLock<Lock> cacheAutoLock(*cacheLock);
+        VkPipelineCache cache;
+        PipelineCacheKey key;
+        {
+            AutoLock<RecursiveLock> lock(mLock);
+            auto it = info_VkDevice.find(device);
+            if (it == info_VkDevice.end()) return;
+            auto& info = it->second;
+            info.pipelineCacheSavePending = false;
+            if (!info.implicitPipelineCache || !info.pipelineCacheChangesSinceSave) return;
+            cache = info.implicitPipelineCache;
+            key = info.pipelineCacheKey;
+            info.pipelineCacheChangesSinceSave = 0;
+            info.framesSincePipelineCacheSave = 0;
+        }
+
+        size_t size = 0;
+        if (enc->vkGetPipelineCacheData(device, cache, &size, nullptr,
+                                        true /* do lock */) != VK_SUCCESS ||
+            !size) {
+            return;
+        }
+        std::vector<uint8_t> data(size);
+        if (enc->vkGetPipelineCacheData(device, cache, &size, data.data(),
+                                        true /* do lock */) != VK_SUCCESS) {
+            return;
+        }
+        data.resize(size);
+        mPipelineCacheStorage.store(key, data);
+    }
+
+    // Saves the implicit cache now and then, as apps are often killed
+    // without destroying their device. The save runs on mWorkPool with that
+    // thread's encoder, so the present thread neither waits for the host to
+    // return the cache data nor for the file to be written.
+    void onPipelineCacheFrameEnd(VkQueue queue) {
+        static constexpr uint32_t kFramesPerSave = 300;
+
+        if (!mPipelineCacheStorage.enabled()) return;
+
+        VkDevice device = VK_NULL_HANDLE;
+        info_VkQueue.find(queue, [&device](VkQueue_Info& info) { device = info.device; });
+        {
+            AutoLock<RecursiveLock> lock(mLock);
+            auto it = info_VkDevice.find(device);
+            if (it == info_VkDevice.end()) return;
+            auto& info = it->second;
+            if (!info.pipelineCacheChangesSinceSave || info.pipelineCacheSavePending ||
+                ++info.framesSincePipelineCacheSave < kFramesPerSave) {
+                return;
+            }
+            info.pipelineCacheSavePending = true;
+        }
+        mWorkPool.schedule({[this, device] {
+            saveImplicitPipelineCache(ResourceTracker::getThreadLocalEncoder(), device);
+        }});
+    }
+
+    VkPipelineCache getPipelineCacheForCreate(VkDevice device, VkPipelineCache pipelineCache) {
+        if (pipelineCache || !mPipelineCacheStorage.enabled()) return pipelineCache;
+
+        AutoLock<RecursiveLock> lock(mLock);
+        auto it = info_VkDevice.find(device);
+        if (it == info_VkDevice.end()) return pipelineCache;
+        return it->second.implicitPipelineCache;
+    }
+
+    void recordPipelineCreation(VkDevice device, bool usedImplicitCache,
+                                uint32_t count, uint64_t ns) {
+        AutoLock<RecursiveLock> lock(mLock);
+        auto it = info_VkDevice.find(device);
+        if (it == info_VkDevice.end()) return;
+        auto& info = it->second;
+        info.pipelinesCreated += count;
+        info.pipelineCreateNs += ns;
+        if (usedImplicitCache) info.pipelineCacheChangesSinceSave += count;
+    }
+
+    VkResult on_vkCreateGraphicsPipelines(
+        void* context,
+        VkResult,
+        VkDevice device,
+        VkPipelineCache pipelineCache,
+        uint32_t createInfoCount,
+        const VkGraphicsPipelineCreateInfo* pCreateInfos,
+        const VkAllocationCallbacks* pAllocator,
+        VkPipeline* pPipelines) {
+        VkEncoder* enc = (VkEncoder*)context;
+        auto start = std::chrono::steady_clock::now();
+
+        VkPipelineCache cache = getPipelineCacheForCreate(device, pipelineCache);
+        VkResult res = enc->vkCreateGraphicsPipelines(
+            device, cache, createInfoCount, pCreateInfos, pAllocator, pPipelines,
+            true /* do lock */);
+
+        recordPipelineCreation(device, cache != pipelineCache, createInfoCount,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count());
+        return res;
+    }
+
+    VkResult on_vkCreateComputePipelines(
+        void* context,
+        VkResult,
+        VkDevice device,
+        VkPipelineCache pipelineCache,
+        uint32_t createInfoCount,
+        const VkComputePipelineCreateInfo* pCreateInfos,
+        const VkAllocationCallbacks* pAllocator,
+        VkPipeline* pPipelines) {
+        VkEncoder* enc = (VkEncoder*)context;
+        auto start = std::chrono::steady_clock::now();
+
+        VkPipelineCache cache = getPipelineCacheForCreate(device, pipelineCache);
+        VkResult res = enc->vkCreateComputePipelines(
+            device, cache, createInfoCount, pCreateInfos, pAllocator, pPipelines,
+            true /* do lock */);
+
+        recordPipelineCreation(device, cache != pipelineCache, createInfoCount,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count());
+        return res;
     }
 
     VkResult on_vkGetAndroidHardwareBufferPropertiesANDROID(
@@ -1980,6 +2304,9 @@ public:
         if (!pInfo) return VK_ERROR_INITIALIZATION_FAILED;
         if (!pInfo->semaphore) return VK_ERROR_INITIALIZATION_FAILED;
 
+        // Pending submits may still wait on or signal the semaphore.
+        drainQueueSubmitThreads(device);
+
         AutoLock<RecursiveLock> lock(mLock);
 
         auto deviceIt = info_VkDevice.find(device);
@@ -2020,6 +2347,9 @@ public:
         if (!pInfo) return VK_ERROR_INITIALIZATION_FAILED;
         if (!pInfo->semaphore) return VK_ERROR_INITIALIZATION_FAILED;
 
+        // Pending submits may still wait on or signal the semaphore.
+        drainQueueSubmitThreads(device);
+
         AutoLock<RecursiveLock> lock(mLock);
 
         auto deviceIt = info_VkDevice.find(device);
@@ -4490,7 +4820,20 @@ public:
             VkDeviceSize mappedSize =
                 getNonCoherentExtendedSize(device,
                     finalAllocInfo.allocationSize);
-            uint8_t* mappedPtr = (uint8_t*)aligned_buf_alloc(4096, mappedSize);
+            uint8_t* mappedPtr = nullptr;
+            bool dirtyPageTracked = false;
+            if (mDirtyPageTracking) {
+                // Whole pages, so no other allocation shares the pages that
+                // get write-protected.
+                VkDeviceSize pageSize = DirtyPageTracker::pageSize();
+                VkDeviceSize trackedSize =
+                    (mappedSize + pageSize - 1) / pageSize * pageSize;
+                mappedPtr = (uint8_t*)aligned_buf_alloc(pageSize, trackedSize);
+                dirtyPageTracked =
+                    DirtyPageTracker::get()->track(mappedPtr, trackedSize);
+            } else {
+                mappedPtr = (uint8_t*)aligned_buf_alloc(4096, mappedSize);
+            }
             D("host visible alloc (non-direct): "
               "size 0x%llx host ptr %p mapped size 0x%llx",
               (unsigned long long)finalAllocInfo.allocationSize, mappedPtr,
@@ -4500,6 +4843,10 @@ public:
                 finalAllocInfo.allocationSize,
                 mappedSize, mappedPtr,
                 finalAllocInfo.memoryTypeIndex);
+            if (dirtyPageTracked) {
+                AutoLock<RecursiveLock> lock(mLock);
+                info_VkDeviceMemory[*pMemory].dirtyPageTracked = true;
+            }
             _RETURN_SCUCCESS_WITH_DEVICE_MEMORY_REPORT;
         }
 
@@ -4711,6 +5058,123 @@ public:
         // no-op
     }
 
+    // Returns the guest buffer and clamped byte range that |range| covers if
+    // its memory is dirty page tracked.
+    bool getDirtyPageTrackedRange(const VkMappedMemoryRange& range,
+                                  uint8_t** ptr,
+                                  VkDeviceSize* offset,
+                                  VkDeviceSize* size) {
+        AutoLock<RecursiveLock> lock(mLock);
+        auto it = info_VkDeviceMemory.find(range.memory);
+        if (it == info_VkDeviceMemory.end()) return false;
+        const auto& info = it->second;
+        if (!info.dirtyPageTracked || range.offset >= info.allocationSize) {
+            return false;
+        }
+
+        *ptr = info.mappedPtr;
+        *offset = range.offset;
+        *size = range.size == VK_WHOLE_SIZE
+            ? info.allocationSize - range.offset
+            : std::min(range.size, info.allocationSize - range.offset);
+        return true;
+    }
+
+    // Replaces each tracked range with the runs of pages written since they
+    // were last flushed, so only those are streamed to the host.
+    VkResult on_vkFlushMappedMemoryRanges(
+        void* context,
+        VkResult,
+        VkDevice device,
+        uint32_t memoryRangeCount,
+        const VkMappedMemoryRange* pMemoryRanges) {
+
+        VkEncoder* enc = (VkEncoder*)context;
+
+        if (!mDirtyPageTracking || usingDirectMapping()) {
+            return enc->vkFlushMappedMemoryRanges(
+                device, memoryRangeCount, pMemoryRanges, true /* do lock */);
+        }
+
+        DirtyPageTracker* tracker = DirtyPageTracker::get();
+        std::vector<VkMappedMemoryRange> dirtyRanges;
+        std::vector<DirtyPageTracker::Run> runs;
+        uint64_t bytesRequested = 0;
+        uint64_t bytesFlushed = 0;
+
+        for (uint32_t i = 0; i < memoryRangeCount; ++i) {
+            const VkMappedMemoryRange& range = pMemoryRanges[i];
+            uint8_t* ptr;
+            VkDeviceSize offset;
+            VkDeviceSize size;
+            if (!getDirtyPageTrackedRange(range, &ptr, &offset, &size)) {
+                dirtyRanges.push_back(range);
+                continue;
+            }
+
+            runs.clear();
+            tracker->takeDirtyRuns(ptr, offset, size, &runs);
+            bytesRequested += size;
+            for (const auto& run : runs) {
+                VkMappedMemoryRange dirtyRange = range;
+                dirtyRange.offset = run.first;
+                dirtyRange.size = run.second;
+                dirtyRanges.push_back(dirtyRange);
+                bytesFlushed += run.second;
+            }
+        }
+
+        tracker->recordFlush(bytesRequested, bytesFlushed);
+
+        if (dirtyRanges.empty()) return VK_SUCCESS;
+
+        return enc->vkFlushMappedMemoryRanges(
+            device, (uint32_t)dirtyRanges.size(), dirtyRanges.data(),
+            true /* do lock */);
+    }
+
+    VkResult on_vkInvalidateMappedMemoryRanges(
+        void* context,
+        VkResult,
+        VkDevice device,
+        uint32_t memoryRangeCount,
+        const VkMappedMemoryRange* pMemoryRanges) {
+
+        VkEncoder* enc = (VkEncoder*)context;
+
+        if (!mDirtyPageTracking || usingDirectMapping()) {
+            return enc->vkInvalidateMappedMemoryRanges(
+                device, memoryRangeCount, pMemoryRanges, true /* do lock */);
+        }
+
+        // The host's data may be read straight into the buffer by the kernel,
+        // which cannot take write faults, so unprotect the ranges first.
+        // Afterwards they match the host again and are clean.
+        DirtyPageTracker* tracker = DirtyPageTracker::get();
+        for (uint32_t i = 0; i < memoryRangeCount; ++i) {
+            uint8_t* ptr;
+            VkDeviceSize offset;
+            VkDeviceSize size;
+            if (getDirtyPageTrackedRange(pMemoryRanges[i], &ptr, &offset, &size)) {
+                tracker->markDirty(ptr, offset, size);
+            }
+        }
+
+        VkResult res = enc->vkInvalidateMappedMemoryRanges(
+            device, memoryRangeCount, pMemoryRanges, true /* do lock */);
+
+        for (uint32_t i = 0; i < memoryRangeCount; ++i) {
+            uint8_t* ptr;
+            VkDeviceSize offset;
+            VkDeviceSize size;
+            if (getDirtyPageTrackedRange(pMemoryRanges[i], &ptr, &offset, &size)) {
+                tracker->takeDirtyRuns(ptr, offset, size, nullptr);
+            }
+        }
+
+        return res;
+    }
+
     uint32_t transformNonExternalResourceMemoryTypeBitsForGuest(
         uint32_t hostBits) {
         uint32_t res = 0;
@@ -5351,6 +5815,8 @@ public:
             return VK_ERROR_OUT_OF_HOST_MEMORY;
         }
 
+        drainQueueSubmitThreads(device);
+
         AutoLock<RecursiveLock> lock(mLock);
         auto it = info_VkFence.find(pImportFenceFdInfo->fence);
         if (it == info_VkFence.end()) {
@@ -5410,6 +5876,7 @@ public:
             return VK_ERROR_OUT_OF_HOST_MEMORY;
         }
 
+        drainQueueSubmitThreads(device);
         VkResult currentFenceStatus = enc->vkGetFenceStatus(device, pGetFdInfo->fence, true /* do lock */);
 
         if (VK_SUCCESS == currentFenceStatus) { // Fence already signaled
@@ -5515,6 +5982,7 @@ public:
         uint64_t timeout) {
 
         VkEncoder* enc = (VkEncoder*)context;
+        drainQueueSubmitThreads(device);
 
 #ifdef VK_USE_PLATFORM_ANDROID_KHR
         std::vector<VkFence> fencesExternal;
@@ -5538,52 +6006,56 @@ public:
         lock.unlock();
 
         if (fencesExternal.empty()) {
-            // No need for work pool, just wait with host driver.
+            // Just wait with host driver.
             return enc->vkWaitForFences(
                 device, fenceCount, pFences, waitAll, timeout, true /* do lock */);
-        } else {
-            // Depending on wait any or wait all,
-            // schedule a wait group with waitAny/waitAll
-            std::vector<WorkPool::Task> tasks;
-
-            ALOGV("%s: scheduling ext waits\n", __func__);
+        }
 
-            for (auto fd : fencesExternalWaitFds) {
-                ALOGV("%s: wait on %d\n", __func__, fd);
-                tasks.push_back([fd] {
-                    sync_wait(fd, 3000);
-                    ALOGV("done waiting on fd %d\n", fd);
-                });
-            }
+        FenceFdWaiter* fdWaiter = FenceFdWaiter::get();
 
-            if (!fencesNonExternal.empty()) {
-                tasks.push_back([this,
-                                 fencesNonExternal /* copy of vector */,
-                                 device, waitAll, timeout] {
-                    auto hostConn = ResourceTracker::threadingCallbacks.hostConnectionGetFunc();
-                    auto vkEncoder = ResourceTracker::threadingCallbacks.vkEncoderGetFunc(hostConn);
-                    ALOGV("%s: vkWaitForFences to host\n", __func__);
-                    vkEncoder->vkWaitForFences(device, fencesNonExternal.size(), fencesNonExternal.data(), waitAll, timeout, true /* do lock */);
-                });
-            }
+        if (fencesNonExternal.empty()) {
+            return fdWaiter->wait(fencesExternalWaitFds.data(), fencesExternalWaitFds.size(),
+                                  waitAll, timeout) ? VK_SUCCESS : VK_TIMEOUT;
+        }
 
-            auto waitGroupHandle = mWorkPool.schedule(tasks);
+        auto start = std::chrono::steady_clock::now();
+        auto remainingNs = [start, timeout]() -> uint64_t {
+            if (timeout == UINT64_MAX) return timeout;
+            uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+            return elapsed < timeout ? timeout - elapsed : 0;
+        };
 
-            // Convert timeout to microseconds from nanoseconds
-            bool waitRes = false;
-            if (waitAll) {
-                waitRes = mWorkPool.waitAll(waitGroupHandle, timeout / 1000);
-            } else {
-                waitRes = mWorkPool.waitAny(waitGroupHandle, timeout / 1000);
+        if (waitAll) {
+            // Both sets have to signal, so wait for one after the other.
+            if (!fdWaiter->wait(fencesExternalWaitFds.data(), fencesExternalWaitFds.size(),
+                                true /* wait all */, timeout)) {
+                return VK_TIMEOUT;
             }
-
-            if (waitRes) {
-                ALOGV("%s: VK_SUCCESS\n", __func__);
+            return enc->vkWaitForFences(
+                device, fencesNonExternal.size(), fencesNonExternal.data(), VK_TRUE,
+                remainingNs(), true /* do lock */);
+        }
+
+        // Waiting for any fence on the host and any sync fd at once would
+        // need a thread blocked in the host wait, so alternate between
+        // polling the host and short waits on the fds instead.
+        static constexpr uint64_t kMinSliceNs = 100000;
+        static constexpr uint64_t kMaxSliceNs = 4000000;
+        uint64_t sliceNs = kMinSliceNs;
+        for (;;) {
+            VkResult res = enc->vkWaitForFences(
+                device, fencesNonExternal.size(), fencesNonExternal.data(), VK_FALSE,
+                0, true /* do lock */);
+            if (res != VK_TIMEOUT) return res;
+
+            uint64_t remaining = remainingNs();
+            if (fdWaiter->wait(fencesExternalWaitFds.data(), fencesExternalWaitFds.size(),
+                               false /* wait any */, std::min(sliceNs, remaining))) {
                 return VK_SUCCESS;
-            } else {
-                ALOGV("%s: VK_TIMEOUT\n", __func__);
-                return VK_TIMEOUT;
             }
+            if (sliceNs >= remaining) return VK_TIMEOUT;
+            sliceNs = std::min(sliceNs * 2, kMaxSliceNs);
         }
 #else
         return enc->vkWaitForFences(
@@ -5701,7 +6173,7 @@ public:
             AutoLock<RecursiveLock> lock(mLock);
 
             // Pool was destroyed
-            if (info_VkDescriptorPool.find(descriptorPool) == info_VkDescriptorPool.end()) {
+            if (!info_VkDescriptorPool.contains(descriptorPool)) {
                 return VK_SUCCESS;
             }
 
@@ -5723,8 +6195,7 @@ public:
                         continue;
                     }
 
-                    auto it = info_VkDescriptorSet.find(pDescriptorSets[i]);
-                    if (it == info_VkDescriptorSet.end())
+                    if (!info_VkDescriptorSet.contains(pDescriptorSets[i]))
                         continue;
 
                     existingDescriptorSets.push_back(pDescriptorSets[i]);
@@ -6315,6 +6786,10 @@ public:
         bool getSyncFd =
             pGetFdInfo->handleType & VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT;
 
+        // The submit that signals the semaphore creates its sync fd, and may
+        // still be queued on a submit thread.
+        drainQueueSubmitThreads(device);
+
         if (getSyncFd) {
             AutoLock<RecursiveLock> lock(mLock);
             auto it = info_VkSemaphore.find(pGetFdInfo->semaphore);
@@ -6352,6 +6827,9 @@ public:
             return input_result;
         }
 
+        // Queued submits waiting on the semaphore must see its old payload.
+        drainQueueSubmitThreads(device);
+
         if (pImportSemaphoreFdInfo->handleType &
             VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT) {
             VkImportSemaphoreFdInfoKHR tmpInfo = *pImportSemaphoreFdInfo;
@@ -6426,6 +6904,32 @@ public:
         }
     }
 
+    void recordDescriptorUpdateStats(const DescriptorUpdateStats& stats) {
+        mDescriptorBytesSent += stats.bytesSent;
+        mDescriptorBytesSkipped += stats.bytesSkipped;
+    }
+
+    // Reports descriptor bytes per frame since the last report. Only called
+    // on device teardown, so that production logcat stays quiet.
+    void logDescriptorUpdateStats() {
+        uint64_t sent = mDescriptorBytesSent.exchange(0);
+        uint64_t skipped = mDescriptorBytesSkipped.exchange(0);
+        uint64_t frames = std::max<uint64_t>(mDescriptorStatsFrames.exchange(0), 1);
+
+        if (!sent && !skipped) return;
+
+        ALOGD("%s: descriptor updates over %llu frames: %llu bytes/frame sent, "
+              "%llu bytes/frame skipped as unchanged",
+              __func__,
+              (unsigned long long)frames,
+              (unsigned long long)(sent / frames),
+              (unsigned long long)(skipped / frames));
+    }
+
+    void onDescriptorStatsFrameEnd() {
+        mDescriptorStatsFrames.fetch_add(1, std::memory_order_relaxed);
+    }
+
     void commitDescriptorSetUpdates(void* context, VkQueue queue, const std::unordered_set<VkDescriptorSet>& sets) {
         VkEncoder* enc = (VkEncoder*)context;
 
@@ -6437,6 +6941,15 @@ public:
         std::vector<uint32_t> pendingAllocations;
         std::vector<uint32_t> writeStartingIndices;
         std::vector<VkWriteDescriptorSet> writesForHost;
+        DescriptorWriteInfoStorage infoStorage;
+        DescriptorUpdateStats stats;
+
+        // writesForHost points into infoStorage, so it must not reallocate.
+        size_t pendingCount = 0;
+        for (auto set : sets) {
+            pendingCount += as_goldfish_VkDescriptorSet(set)->reified->allWrites.pending.size();
+        }
+        infoStorage.reserve(pendingCount);
 
         uint32_t poolIndex = 0;
         uint32_t currentWriteIndex = 0;
@@ -6461,69 +6974,12 @@ public:
             pendingAllocations.push_back(reified->allocationPending ? 1 : 0);
             writeStartingIndices.push_back(currentWriteIndex);
 
-            auto& writes = reified->allWrites;
-
-            for (size_t i = 0; i < writes.size(); ++i) {
-                uint32_t binding = i;
-
-                for (size_t j = 0; j < writes[i].size(); ++j) {
-                    auto& write = writes[i][j];
-
-                    if (write.type == DescriptorWriteType::Empty) continue;
-
-                    uint32_t dstArrayElement = 0;
-
-                    VkDescriptorImageInfo* imageInfo = nullptr;
-                    VkDescriptorBufferInfo* bufferInfo = nullptr;
-                    VkBufferView* bufferView = nullptr;
-
-                    switch (write.type) {
-                        case DescriptorWriteType::Empty:
-                            break;
-                        case DescriptorWriteType::ImageInfo:
-                            dstArrayElement = j;
-                            imageInfo = &write.imageInfo;
-                            break;
-                        case DescriptorWriteType::BufferInfo:
-                            dstArrayElement = j;
-                            bufferInfo = &write.bufferInfo;
-                            break;
-                        case DescriptorWriteType::BufferView:
-                            dstArrayElement = j;
-                            bufferView = &write.bufferView;
-                            break;
-                        case DescriptorWriteType::InlineUniformBlock:
-                        case DescriptorWriteType::AccelerationStructure:
-                            // TODO
-                            ALOGE("Encountered pending inline uniform block or acceleration structure desc write, abort (NYI)\n");
-                            abort();
-                        default:
-                            break;
-
-                    }
-
-                    // TODO: Combine multiple writes into one VkWriteDescriptorSet.
-                    VkWriteDescriptorSet forHost = {
-                        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, 0 /* TODO: inline uniform block */,
-                        set,
-                        binding,
-                        dstArrayElement,
-                        1,
-                        write.descriptorType,
-                        imageInfo,
-                        bufferInfo,
-                        bufferView,
-                    };
-
-                    writesForHost.push_back(forHost);
-                    ++currentWriteIndex;
-
-                    // Set it back to empty.
-                    write.type = DescriptorWriteType::Empty;
-                }
-            }
+            currentWriteIndex += collectPendingDescriptorWrites(
+                set, reified, &infoStorage, &writesForHost, &stats);
         }
 
+        recordDescriptorUpdateStats(stats);
+
         // Skip out if there's nothing to VkWriteDescriptorSet home about.
         if (writesForHost.empty()) {
             return;
@@ -6569,19 +7025,17 @@ public:
             // There's no pending commands here, skip. (case 1)
             if (!cb->privateStream) continue;
 
-            unsigned char* writtenPtr = 0;
-            size_t written = 0;
-            ((CommandBufferStagingStream*)cb->privateStream)->getWritten(&writtenPtr, &written);
+            CommandBufferStagingStream* staging = (CommandBufferStagingStream*)cb->privateStream;
 
             // There's no pending commands here, skip. (case 2, stream created but no new recordings)
-            if (!written) continue;
+            if (!staging->writtenSize()) continue;
 
             // There are pending commands to flush.
             VkEncoder* enc = (VkEncoder*)context;
-            enc->vkQueueFlushCommandsGOOGLE(queue, cmdbuf, written, (const void*)writtenPtr, true /* do lock */);
+            enc->vkQueueFlushCommandsFromStagingGOOGLE(queue, cmdbuf, staging, true /* do lock */);
 
             // Reset this stream.
-            ((CommandBufferStagingStream*)cb->privateStream)->reset();
+            staging->reset();
         }
     }
 
@@ -6626,11 +7080,84 @@ public:
         }
     }
 
+    static bool submitsHaveSemaphores(uint32_t submitCount, const VkSubmitInfo* pSubmits) {
+        for (uint32_t i = 0; i < submitCount; ++i) {
+            if (pSubmits[i].waitSemaphoreCount || pSubmits[i].signalSemaphoreCount) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static bool submitsWaitOnSemaphores(uint32_t submitCount, const VkSubmitInfo* pSubmits) {
+        for (uint32_t i = 0; i < submitCount; ++i) {
+            if (pSubmits[i].waitSemaphoreCount) return true;
+        }
+        return false;
+    }
+
+    // A copy of vkQueueSubmit's arguments that outlives the call, for the
+    // queue's submit thread.
+    struct PendingQueueSubmit {
+        BumpPool pool;
+        std::vector<VkSubmitInfo> submits;
+
+        ~PendingQueueSubmit() { pool.freeAll(); }
+    };
+
     VkResult on_vkQueueSubmit(
         void* context, VkResult input_result,
         VkQueue queue, uint32_t submitCount, const VkSubmitInfo* pSubmits, VkFence fence) {
-        AEMU_SCOPED_TRACE("on_vkQueueSubmit");
+        AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "on_vkQueueSubmit");
+
+        auto start = std::chrono::steady_clock::now();
+        VkResult res = VK_SUCCESS;
+
+        QueueSubmitThread* submitThread = getOrCreateQueueSubmitThread(queue);
+
+        // Each queue has its own submit thread, so a signal queued on another
+        // queue of the device may not have reached the host yet. Binary
+        // semaphores require the signal to be submitted before the wait.
+        if (submitsWaitOnSemaphores(submitCount, pSubmits)) {
+            drainOtherQueueSubmitThreads(queue);
+        }
+
+        if (submitThread) {
+            auto pending = std::make_shared<PendingQueueSubmit>();
+            pending->submits.resize(submitCount);
+            for (uint32_t i = 0; i < submitCount; ++i) {
+                deepcopy_VkSubmitInfo(&pending->pool, VK_STRUCTURE_TYPE_MAX_ENUM,
+                                      pSubmits + i, &pending->submits[i]);
+            }
+
+            // Errors past this point can only be logged; the app was told
+            // VK_SUCCESS already.
+            submitThread->enqueue([this, queue, fence, pending]() {
+                VkEncoder* enc = ResourceTracker::getThreadLocalEncoder();
+                if (!(ResourceTracker::streamFeatureBits &
+                      VULKAN_STREAM_FEATURE_QUEUE_SUBMIT_WITH_COMMANDS_BIT)) {
+                    syncEncodersForQueue(queue, enc);
+                }
+                VkResult submitRes = doQueueSubmit(
+                    enc, VK_SUCCESS, queue, (uint32_t)pending->submits.size(),
+                    pending->submits.data(), fence);
+                if (submitRes != VK_SUCCESS) {
+                    ALOGE("%s: asynchronous vkQueueSubmit failed: %d", __func__,
+                          submitRes);
+                }
+            });
+        } else {
+            res = doQueueSubmit(context, input_result, queue, submitCount, pSubmits, fence);
+        }
+
+        recordQueueSubmitLatency(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+        return res;
+    }
 
+    VkResult doQueueSubmit(
+        void* context, VkResult input_result,
+        VkQueue queue, uint32_t submitCount, const VkSubmitInfo* pSubmits, VkFence fence) {
         flushStagingStreams(context, queue, submitCount, pSubmits);
 
         std::vector<VkSemaphore> pre_signal_semaphores;
@@ -6641,57 +7168,60 @@ public:
 
         VkEncoder* enc = (VkEncoder*)context;
 
-        AutoLock<RecursiveLock> lock(mLock);
+        // Only semaphores backed by external events or sync fds need the
+        // tracker state; submits without semaphores skip mLock here.
+        if (submitsHaveSemaphores(submitCount, pSubmits)) {
+            AutoLock<RecursiveLock> lock(mLock);
 
-        for (uint32_t i = 0; i < submitCount; ++i) {
-            for (uint32_t j = 0; j < pSubmits[i].waitSemaphoreCount; ++j) {
-                auto it = info_VkSemaphore.find(pSubmits[i].pWaitSemaphores[j]);
-                if (it != info_VkSemaphore.end()) {
-                    auto& semInfo = it->second;
+            for (uint32_t i = 0; i < submitCount; ++i) {
+                for (uint32_t j = 0; j < pSubmits[i].waitSemaphoreCount; ++j) {
+                    auto it = info_VkSemaphore.find(pSubmits[i].pWaitSemaphores[j]);
+                    if (it != info_VkSemaphore.end()) {
+                        auto& semInfo = it->second;
 #ifdef VK_USE_PLATFORM_FUCHSIA
-                    if (semInfo.eventHandle) {
-                        pre_signal_events.push_back(semInfo.eventHandle);
-                        pre_signal_semaphores.push_back(pSubmits[i].pWaitSemaphores[j]);
-                    }
+                        if (semInfo.eventHandle) {
+                            pre_signal_events.push_back(semInfo.eventHandle);
+                            pre_signal_semaphores.push_back(pSubmits[i].pWaitSemaphores[j]);
+                        }
 #endif
 #ifdef VK_USE_PLATFORM_ANDROID_KHR
-                    if (semInfo.syncFd >= 0) {
-                        pre_signal_sync_fds.push_back(semInfo.syncFd);
-                        pre_signal_semaphores.push_back(pSubmits[i].pWaitSemaphores[j]);
-                    }
+                        if (semInfo.syncFd >= 0) {
+                            pre_signal_sync_fds.push_back(semInfo.syncFd);
+                            pre_signal_semaphores.push_back(pSubmits[i].pWaitSemaphores[j]);
+                        }
 #endif
+                    }
                 }
-            }
-            for (uint32_t j = 0; j < pSubmits[i].signalSemaphoreCount; ++j) {
-                auto it = info_VkSemaphore.find(pSubmits[i].pSignalSemaphores[j]);
-                if (it != info_VkSemaphore.end()) {
-                    auto& semInfo = it->second;
+                for (uint32_t j = 0; j < pSubmits[i].signalSemaphoreCount; ++j) {
+                    auto it = info_VkSemaphore.find(pSubmits[i].pSignalSemaphores[j]);
+                    if (it != info_VkSemaphore.end()) {
+                        auto& semInfo = it->second;
 #ifdef VK_USE_PLATFORM_FUCHSIA
-                    if (semInfo.eventHandle) {
-                        post_wait_events.push_back(
-                            {semInfo.eventHandle, semInfo.eventKoid});
+                        if (semInfo.eventHandle) {
+                            post_wait_events.push_back(
+                                {semInfo.eventHandle, semInfo.eventKoid});
 #ifndef FUCHSIA_NO_TRACE
-                        if (semInfo.eventKoid != ZX_KOID_INVALID) {
-                            // TODO(fxbug.dev/66098): Remove the "semaphore"
-                            // FLOW_END events once it is removed from clients
-                            // (for example, gfx Engine).
-                            TRACE_FLOW_END("gfx", "semaphore",
-                                           semInfo.eventKoid);
-                            TRACE_FLOW_BEGIN("gfx", "goldfish_post_wait_event",
-                                             semInfo.eventKoid);
-                        }
+                            if (semInfo.eventKoid != ZX_KOID_INVALID) {
+                                // TODO(fxbug.dev/66098): Remove the "semaphore"
+                                // FLOW_END events once it is removed from clients
+                                // (for example, gfx Engine).
+                                TRACE_FLOW_END("gfx", "semaphore",
+                                               semInfo.eventKoid);
+                                TRACE_FLOW_BEGIN("gfx", "goldfish_post_wait_event",
+                                                 semInfo.eventKoid);
+                            }
 #endif
-                    }
+                        }
 #endif
 #ifdef VK_USE_PLATFORM_ANDROID_KHR
-                    if (semInfo.syncFd >= 0) {
-                        post_wait_sync_fds.push_back(semInfo.syncFd);
-                    }
+                        if (semInfo.syncFd >= 0) {
+                            post_wait_sync_fds.push_back(semInfo.syncFd);
+                        }
 #endif
+                    }
                 }
             }
         }
-        lock.unlock();
 
         if (pre_signal_semaphores.empty()) {
             if (supportsAsyncQueueSubmit()) {
@@ -6719,14 +7249,17 @@ public:
             }
 #endif
 #ifdef VK_USE_PLATFORM_ANDROID_KHR
-            for (auto fd : pre_signal_sync_fds) {
-                preSignalTasks.push_back([fd] {
-                    sync_wait(fd, 3000);
-                });
+            // Same 3 second limit as sync_wait(fd, 3000) used to have.
+            if (!FenceFdWaiter::get()->wait(
+                    pre_signal_sync_fds.data(), pre_signal_sync_fds.size(),
+                    true /* wait all */, 3000000000ULL)) {
+                ALOGW("%s: timed out waiting for sync fds", __func__);
             }
 #endif
-            auto waitGroupHandle = mWorkPool.schedule(preSignalTasks);
-            mWorkPool.waitAll(waitGroupHandle);
+            if (!preSignalTasks.empty()) {
+                auto waitGroupHandle = mWorkPool.schedule(preSignalTasks);
+                mWorkPool.waitAll(waitGroupHandle);
+            }
 
             VkSubmitInfo submit_info = {
                 .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
@@ -6752,11 +7285,11 @@ public:
             }
         }
 
-        lock.lock();
         int externalFenceFdToSignal = -1;
 
 #ifdef VK_USE_PLATFORM_ANDROID_KHR
         if (fence != VK_NULL_HANDLE) {
+            AutoLock<RecursiveLock> lock(mLock);
             auto it = info_VkFence.find(fence);
             if (it != info_VkFence.end()) {
                 const auto& info = it->second;
@@ -6779,7 +7312,7 @@ public:
                 auto vkEncoder = ResourceTracker::threadingCallbacks.vkEncoderGetFunc(hostConn);
                 auto waitIdleRes = vkEncoder->vkQueueWaitIdle(queue, true /* do lock */);
 #ifdef VK_USE_PLATFORM_FUCHSIA
-                AEMU_SCOPED_TRACE("on_vkQueueSubmit::SignalSemaphores");
+                AEMU_SCOPED_TRACE_CATEGORY(Vulkan, "on_vkQueueSubmit::SignalSemaphores");
                 (void)externalFenceFdToSignal;
                 for (auto& [event, koid] : post_wait_events) {
 #ifndef FUCHSIA_NO_TRACE
@@ -6803,6 +7336,7 @@ public:
 #endif
             });
             auto queueAsyncWaitHandle = mWorkPool.schedule(tasks);
+            AutoLock<RecursiveLock> lock(mLock);
             auto& queueWorkItems = mQueueSensitiveWorkPoolItems[queue];
             queueWorkItems.push_back(queueAsyncWaitHandle);
         }
@@ -6870,7 +7404,7 @@ public:
     void unwrap_vkAcquireImageANDROID_nativeFenceFd(int fd, int*) {
 #ifdef VK_USE_PLATFORM_ANDROID_KHR
         if (fd != -1) {
-            AEMU_SCOPED_TRACE("waitNativeFenceInAcquire");
+            AEMU_SCOPED_TRACE_CATEGORY(Sync, "waitNativeFenceInAcquire");
             // Implicit Synchronization
             sync_wait(fd, 3000);
             // From libvulkan's swapchain.cpp:
@@ -7474,6 +8008,130 @@ public:
         return 0;
     }
 
+    // Returns the submit thread of |queue|, starting one on first use if
+    // asynchronous submission is enabled. Vulkan requires queue access to be
+    // externally synchronized, so |q->userPtr| needs no lock.
+    QueueSubmitThread* getOrCreateQueueSubmitThread(VkQueue queue) {
+        struct goldfish_VkQueue* q = as_goldfish_VkQueue(queue);
+        if (!q) return nullptr;
+        if (q->userPtr) return (QueueSubmitThread*)q->userPtr;
+        if (!mAsyncQueueSubmit || !supportsAsyncQueueSubmit()) return nullptr;
+
+        VkDevice device = VK_NULL_HANDLE;
+        info_VkQueue.find(queue, [&device](VkQueue_Info& info) { device = info.device; });
+        if (device == VK_NULL_HANDLE) return nullptr;
+
+        QueueSubmitThread* submitThread = new QueueSubmitThread;
+        q->userPtr = submitThread;
+
+        AutoLock<RecursiveLock> lock(mLock);
+        mQueueSubmitThreadDevices[queue] = device;
+        return submitThread;
+    }
+
+    void drainQueueSubmitThread(VkQueue queue, VkEncoder* currentEncoder) {
+        struct goldfish_VkQueue* q = as_goldfish_VkQueue(queue);
+        if (!q || !q->userPtr) return;
+        ((QueueSubmitThread*)q->userPtr)->drain();
+
+        if (!(ResourceTracker::streamFeatureBits &
+              VULKAN_STREAM_FEATURE_QUEUE_SUBMIT_WITH_COMMANDS_BIT)) {
+            syncEncodersForQueue(queue, currentEncoder);
+        }
+    }
+
+    // Called before anything that waits on the host for queue work of
+    // |device|: the submissions it waits for may not have been sent yet.
+    void drainQueueSubmitThreads(VkDevice device) {
+        if (!mAsyncQueueSubmit) return;
+
+        std::vector<QueueSubmitThread*> submitThreads;
+        {
+            AutoLock<RecursiveLock> lock(mLock);
+            for (const auto& it : mQueueSubmitThreadDevices) {
+                if (it.second != device) continue;
+                submitThreads.push_back(
+                    (QueueSubmitThread*)as_goldfish_VkQueue(it.first)->userPtr);
+            }
+        }
+
+        // Submit tasks take mLock themselves, so wait without holding it.
+        for (auto submitThread : submitThreads) {
+            submitThread->drain();
+        }
+    }
+
+    // Drains the submit threads of the other queues of |queue|'s device.
+    // Must not be called with mLock held.
+    void drainOtherQueueSubmitThreads(VkQueue queue) {
+        if (!mAsyncQueueSubmit) return;
+
+        VkDevice device = VK_NULL_HANDLE;
+        info_VkQueue.find(queue, [&device](VkQueue_Info& info) { device = info.device; });
+        if (device == VK_NULL_HANDLE) return;
+
+        std::vector<QueueSubmitThread*> submitThreads;
+        {
+            AutoLock<RecursiveLock> lock(mLock);
+            for (const auto& it : mQueueSubmitThreadDevices) {
+                if (it.first == queue || it.second != device) continue;
+                auto submitThread = (QueueSubmitThread*)as_goldfish_VkQueue(it.first)->userPtr;
+                if (!submitThread->idle()) submitThreads.push_back(submitThread);
+            }
+        }
+
+        for (auto submitThread : submitThreads) {
+            submitThread->drain();
+        }
+    }
+
+    std::vector<VkQueue> queuesWithSubmitThreads(VkDevice device) {
+        std::vector<VkQueue> res;
+        AutoLock<RecursiveLock> lock(mLock);
+        for (const auto& it : mQueueSubmitThreadDevices) {
+            if (it.second == device) res.push_back(it.first);
+        }
+        return res;
+    }
+
+    // Finishes the pending submissions of |queue| and stops its thread.
+    // Must not be called with mLock held.
+    void destroyQueueSubmitThread(VkQueue queue) {
+        struct goldfish_VkQueue* q = as_goldfish_VkQueue(queue);
+        if (!q || !q->userPtr) return;
+
+        {
+            AutoLock<RecursiveLock> lock(mLock);
+            mQueueSubmitThreadDevices.erase(queue);
+        }
+
+        delete (QueueSubmitThread*)q->userPtr;
+        q->userPtr = nullptr;
+    }
+
+    void recordQueueSubmitLatency(uint64_t ns) {
+        mQueueSubmitCount.fetch_add(1, std::memory_order_relaxed);
+        mQueueSubmitTotalNs.fetch_add(ns, std::memory_order_relaxed);
+        uint64_t maxNs = mQueueSubmitMaxNs.load(std::memory_order_relaxed);
+        while (ns > maxNs &&
+               !mQueueSubmitMaxNs.compare_exchange_weak(maxNs, ns, std::memory_order_relaxed)) {
+        }
+    }
+
+    // Time vkQueueSubmit took as seen by the app, with or without the
+    // submit threads.
+    void logQueueSubmitStats() {
+        uint64_t count = mQueueSubmitCount.exchange(0, std::memory_order_relaxed);
+        uint64_t totalNs = mQueueSubmitTotalNs.exchange(0, std::memory_order_relaxed);
+        uint64_t maxNs = mQueueSubmitMaxNs.exchange(0, std::memory_order_relaxed);
+        if (!count) return;
+
+        ALOGD("%s: %llu vkQueueSubmit calls (%s), avg %.1f us, max %.1f us",
+              __func__, (unsigned long long)count,
+              mAsyncQueueSubmit ? "async" : "sync",
+              totalNs / 1000.0 / count, maxNs / 1000.0);
+    }
+
     VkResult on_vkBeginCommandBuffer(
         void* context, VkResult input_result,
         VkCommandBuffer commandBuffer,
@@ -7744,6 +8402,16 @@ public:
 #ifdef VK_USE_PLATFORM_ANDROID_KHR
         VkEncoder* enc = (VkEncoder*)context;
 
+        // Like vkQueueSubmit, the waits need their signals on the host.
+        if (waitSemaphoreCount) {
+            drainOtherQueueSubmitThreads(queue);
+        }
+
+        if (mFeatureInfo->hasVulkanBatchedDescriptorSetUpdate) {
+            onDescriptorStatsFrameEnd();
+        }
+        onPipelineCacheFrameEnd(queue);
+
         if (!mFeatureInfo->hasVulkanAsyncQsri) {
             return enc->vkQueueSignalReleaseImageANDROID(queue, waitSemaphoreCount, pWaitSemaphores, image, pNativeFenceFd, true /* lock */);
         }
@@ -7890,6 +8558,22 @@ private:
     HostVisibleMemoryVirtualizationInfo mHostVisibleMemoryVirtInfo;
     std::unique_ptr<EmulatorFeatureInfo> mFeatureInfo;
     std::unique_ptr<GoldfishAddressSpaceBlockProvider> mGoldfishAddressSpaceBlockProvider;
+    bool mDirtyPageTracking = dirtyPageTrackingFromProperty();
+
+    // Submit threads are owned through goldfish_VkQueue::userPtr; this maps
+    // the queues that have one to their device (guarded by mLock).
+    bool mAsyncQueueSubmit = asyncQueueSubmitFromProperty();
+    std::unordered_map<VkQueue, VkDevice> mQueueSubmitThreadDevices;
+    PipelineCacheStorage mPipelineCacheStorage { pipelineCacheDirFromProperty() };
+    std::atomic<uint64_t> mQueueSubmitCount { 0 };
+    std::atomic<uint64_t> mQueueSubmitTotalNs { 0 };
+    std::atomic<uint64_t> mQueueSubmitMaxNs { 0 };
+
+    // Descriptor bytes committed to the host since the last report, and the
+    // number of frames presented over that time.
+    std::atomic<uint64_t> mDescriptorBytesSent { 0 };
+    std::atomic<uint64_t> mDescriptorBytesSkipped { 0 };
+    std::atomic<uint64_t> mDescriptorStatsFrames { 0 };
 
     std::vector<VkExtensionProperties> mHostInstanceExtensions;
     std::vector<VkExtensionProperties> mHostDeviceExtensions;
@@ -8024,20 +8708,30 @@ ALWAYS_INLINE VkEncoder* ResourceTracker::getCommandBufferEncoder(VkCommandBuffe
     if (!cb->privateEncoder) {
         sStaging.popStaging((CommandBufferStagingStream**)&cb->privateStream, &cb->privateEncoder);
     }
-    uint8_t* writtenPtr; size_t written;
-    ((CommandBufferStagingStream*)cb->privateStream)->getWritten(&writtenPtr, &written);
     return cb->privateEncoder;
 }
 
 // static
 ALWAYS_INLINE VkEncoder* ResourceTracker::getQueueEncoder(VkQueue queue) {
     auto enc = ResourceTracker::getThreadLocalEncoder();
-    if (!(ResourceTracker::streamFeatureBits & VULKAN_STREAM_FEATURE_QUEUE_SUBMIT_WITH_COMMANDS_BIT)) {
+    if (as_goldfish_VkQueue(queue)->userPtr) {
+        // Queue commands other than vkQueueSubmit go after the queued submits.
+        ResourceTracker::get()->drainQueueSubmitThread(queue, enc);
+    } else if (!(ResourceTracker::streamFeatureBits & VULKAN_STREAM_FEATURE_QUEUE_SUBMIT_WITH_COMMANDS_BIT)) {
         ResourceTracker::get()->syncEncodersForQueue(queue, enc);
     }
     return enc;
 }
 
+// static
+ALWAYS_INLINE VkEncoder* ResourceTracker::getQueueSubmitEncoder(VkQueue queue) {
+    // The submit thread hands the queue over to its own encoder.
+    if (as_goldfish_VkQueue(queue)->userPtr) {
+        return ResourceTracker::getThreadLocalEncoder();
+    }
+    return getQueueEncoder(queue);
+}
+
 // static
 ALWAYS_INLINE VkEncoder* ResourceTracker::getThreadLocalEncoder() {
     auto hostConn = ResourceTracker::threadingCallbacks.hostConnectionGetFunc();
@@ -8184,6 +8878,34 @@ void ResourceTracker::on_vkDestroyDevice_pre(
     mImpl->on_vkDestroyDevice_pre(context, device, pAllocator);
 }
 
+VkResult ResourceTracker::on_vkCreateGraphicsPipelines(
+    void* context,
+    VkResult input_result,
+    VkDevice device,
+    VkPipelineCache pipelineCache,
+    uint32_t createInfoCount,
+    const VkGraphicsPipelineCreateInfo* pCreateInfos,
+    const VkAllocationCallbacks* pAllocator,
+    VkPipeline* pPipelines) {
+    return mImpl->on_vkCreateGraphicsPipelines(
+        context, input_result, device, pipelineCache, createInfoCount,
+        pCreateInfos, pAllocator, pPipelines);
+}
+
+VkResult ResourceTracker::on_vkCreateComputePipelines(
+    void* context,
+    VkResult input_result,
+    VkDevice device,
+    VkPipelineCache pipelineCache,
+    uint32_t createInfoCount,
+    const VkComputePipelineCreateInfo* pCreateInfos,
+    const VkAllocationCallbacks* pAllocator,
+    VkPipeline* pPipelines) {
+    return mImpl->on_vkCreateComputePipelines(
+        context, input_result, device, pipelineCache, createInfoCount,
+        pCreateInfos, pAllocator, pPipelines);
+}
+
 VkResult ResourceTracker::on_vkAllocateMemory(
     void* context,
     VkResult input_result,
@@ -8224,6 +8946,24 @@ void ResourceTracker::on_vkUnmapMemory(
     mImpl->on_vkUnmapMemory(context, device, memory);
 }
 
+VkResult ResourceTracker::on_vkFlushMappedMemoryRanges(
+    void* context, VkResult input_result,
+    VkDevice device,
+    uint32_t memoryRangeCount,
+    const VkMappedMemoryRange* pMemoryRanges) {
+    return mImpl->on_vkFlushMappedMemoryRanges(
+        context, input_result, device, memoryRangeCount, pMemoryRanges);
+}
+
+VkResult ResourceTracker::on_vkInvalidateMappedMemoryRanges(
+    void* context, VkResult input_result,
+    VkDevice device,
+    uint32_t memoryRangeCount,
+    const VkMappedMemoryRange* pMemoryRanges) {
+    return mImpl->on_vkInvalidateMappedMemoryRanges(
+        context, input_result, device, memoryRangeCount, pMemoryRanges);
+}
+
 VkResult ResourceTracker::on_vkCreateImage(
     void* context, VkResult input_result,
     VkDevice device, const VkImageCreateInfo *pCreateInfo,
@@ -8886,6 +9626,22 @@ uint32_t ResourceTracker::syncEncodersForQueue(VkQueue queue, VkEncoder* current
     return mImpl->syncEncodersForQueue(queue, current);
 }
 
+void ResourceTracker::drainQueueSubmitThread(VkQueue queue, VkEncoder* current) {
+    mImpl->drainQueueSubmitThread(queue, current);
+}
+
+void ResourceTracker::drainQueueSubmitThreads(VkDevice device) {
+    mImpl->drainQueueSubmitThreads(device);
+}
+
+void ResourceTracker::drainOtherQueueSubmitThreads(VkQueue queue) {
+    mImpl->drainOtherQueueSubmitThreads(queue);
+}
+
+void ResourceTracker::destroyImplicitPipelineCache(VkEncoder* enc, VkDevice device) {
+    mImpl->destroyImplicitPipelineCache(enc, device);
+}
+
 
 VkResult ResourceTracker::on_vkBeginCommandBuffer(
     void* context, VkResult input_result,
@@ -134,6 +134,27 @@ public:
         void* context,
         VkDevice device,
         const VkAllocationCallbacks* pAllocator);
+    // Called by vkDestroyDevice before it takes the encoder lock.
+    void destroyImplicitPipelineCache(VkEncoder* enc, VkDevice device);
+
+    VkResult on_vkCreateGraphicsPipelines(
+        void* context,
+        VkResult input_result,
+        VkDevice device,
+        VkPipelineCache pipelineCache,
+        uint32_t createInfoCount,
+        const VkGraphicsPipelineCreateInfo* pCreateInfos,
+        const VkAllocationCallbacks* pAllocator,
+        VkPipeline* pPipelines);
+    VkResult on_vkCreateComputePipelines(
+        void* context,
+        VkResult input_result,
+        VkDevice device,
+        VkPipelineCache pipelineCache,
+        uint32_t createInfoCount,
+        const VkComputePipelineCreateInfo* pCreateInfos,
+        const VkAllocationCallbacks* pAllocator,
+        VkPipeline* pPipelines);
 
     VkResult on_vkAllocateMemory(
         void* context,
@@ -163,6 +184,17 @@ public:
         VkDevice device,
         VkDeviceMemory memory);
 
+    VkResult on_vkFlushMappedMemoryRanges(
+        void* context, VkResult input_result,
+        VkDevice device,
+        uint32_t memoryRangeCount,
+        const VkMappedMemoryRange* pMemoryRanges);
+    VkResult on_vkInvalidateMappedMemoryRanges(
+        void* context, VkResult input_result,
+        VkDevice device,
+        uint32_t memoryRangeCount,
+        const VkMappedMemoryRange* pMemoryRanges);
+
     VkResult on_vkCreateImage(
         void* context, VkResult input_result,
         VkDevice device, const VkImageCreateInfo *pCreateInfo,
@@ -561,6 +593,13 @@ public:
     uint32_t syncEncodersForCommandBuffer(VkCommandBuffer commandBuffer, VkEncoder* current);
     uint32_t syncEncodersForQueue(VkQueue queue, VkEncoder* current);
 
+    // With asynchronous queue submission, waits until the submissions queued
+    // for |queue|, for every queue of |device|, or for every queue of
+    // |queue|'s device but |queue| itself, have been encoded.
+    void drainQueueSubmitThread(VkQueue queue, VkEncoder* current);
+    void drainQueueSubmitThreads(VkDevice device);
+    void drainOtherQueueSubmitThreads(VkQueue queue);
+
     VkResult on_vkBeginCommandBuffer(
         void* context, VkResult input_result,
         VkCommandBuffer commandBuffer,
@@ -646,6 +685,7 @@ public:
 
     static VkEncoder* getCommandBufferEncoder(VkCommandBuffer commandBuffer);
     static VkEncoder* getQueueEncoder(VkQueue queue);
+    static VkEncoder* getQueueSubmitEncoder(VkQueue queue);
     static VkEncoder* getThreadLocalEncoder();
 
     static void setSeqnoPtr(uint32_t* seqnoptr);
@@ -24,6 +24,8 @@
 
 #include "VkEncoder.h"
 
+#include "CommandBufferStagingStream.h"
+
 
 #include "IOStream.h"
 #include "Resources.h"
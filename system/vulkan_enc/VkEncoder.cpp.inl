@@ -1,9 +1,23 @@
 static ResourceTracker* sResourceTracker = nullptr;
 static uint32_t sFeatureBits = 0;
 
+using android::base::guest::AdaptiveLock;
+
+// qemu.vk.encoder_lock selects how a thread waits for an encoder that another
+// thread is using: "adaptive" (default) spins briefly and then sleeps,
+// "spin" spins forever, "sleep" sleeps right away.
+static AdaptiveLock::Mode encoderLockModeFromProperty() {
+    char lockProp[PROPERTY_VALUE_MAX];
+    if (property_get("qemu.vk.encoder_lock", lockProp, nullptr) > 0) {
+        return AdaptiveLock::modeFromString(lockProp);
+    }
+    return AdaptiveLock::Mode::Adaptive;
+}
+
 class VkEncoder::Impl {
 public:
-    Impl(IOStream* stream) : m_stream(stream), m_logEncodes(false) {
+    Impl(IOStream* stream)
+        : m_stream(stream), m_logEncodes(false), mLock(encoderLockModeFromProperty()) {
         if (!sResourceTracker) sResourceTracker = ResourceTracker::get();
         m_stream.incStreamRef();
         const char* emuVkLogEncodesPropName = "qemu.vk.log";
@@ -15,6 +29,15 @@ public:
     }
 
     ~Impl() {
+        if (m_logEncodes) {
+            AdaptiveLock::Stats stats = mLock.stats();
+            ALOGD("encoder lock: %llu acquisitions, %llu contended, "
+                  "%llu acquired while spinning, %llu sleeps",
+                  (unsigned long long)stats.acquisitions,
+                  (unsigned long long)stats.contended,
+                  (unsigned long long)stats.spinAcquired,
+                  (unsigned long long)stats.sleeps);
+        }
         m_stream.decStreamRef();
     }
 
@@ -35,13 +58,31 @@ public:
         unlock();
     }
 
-    // can be recursive
+    // Not recursive.
     void lock() {
-        while (mLock.test_and_set(std::memory_order_acquire));
+#ifdef VK_ENCODER_PHASE_TIMERS
+        // Ends after the lock is taken, so mLockNs is only written under it.
+        PhaseTimer timer(&mLockNs);
+#endif
+        mLock.lock();
     }
 
     void unlock() {
-        mLock.clear(std::memory_order_release);
+        mLock.unlock();
+    }
+
+    AdaptiveLock::Stats lockStats() const { return mLock.stats(); }
+
+    VkEncoder::PhaseTimes phaseTimes() const {
+        VkEncoder::PhaseTimes times;
+        times.lockNs = mLockNs;
+        times.streamNs = m_stream.streamNs();
+        return times;
+    }
+
+    void resetPhaseTimes() {
+        mLockNs = 0;
+        m_stream.resetStreamNs();
     }
 
 private:
@@ -51,7 +92,8 @@ private:
 
     Validation m_validation;
     bool m_logEncodes;
-    std::atomic_flag mLock = ATOMIC_FLAG_INIT;
+    AdaptiveLock mLock;
+    uint64_t mLockNs = 0;
 };
 
 VkEncoder::~VkEncoder() { }
@@ -81,6 +123,74 @@ void VkEncoder::unlock() {
     mImpl->unlock();
 }
 
+VkEncoder::LockStats VkEncoder::getLockStats() const {
+    AdaptiveLock::Stats stats = mImpl->lockStats();
+    LockStats result;
+    result.acquisitions = stats.acquisitions;
+    result.contended = stats.contended;
+    result.spinAcquired = stats.spinAcquired;
+    result.sleeps = stats.sleeps;
+    return result;
+}
+
+bool VkEncoder::setPhaseTimersEnabled(bool enabled) {
+#ifdef VK_ENCODER_PHASE_TIMERS
+    PhaseTimer::sEnabled.store(enabled, std::memory_order_relaxed);
+    return true;
+#else
+    (void)enabled;
+    return false;
+#endif
+}
+
+VkEncoder::PhaseTimes VkEncoder::getPhaseTimes() const {
+    return mImpl->phaseTimes();
+}
+
+void VkEncoder::resetPhaseTimes() {
+    mImpl->resetPhaseTimes();
+}
+
+// Same packet as vkQueueFlushCommandsGOOGLE; the host sees one contiguous
+// payload either way.
+void VkEncoder::vkQueueFlushCommandsFromStagingGOOGLE(VkQueue queue,
+                                                      VkCommandBuffer commandBuffer,
+                                                      CommandBufferStagingStream* staging,
+                                                      uint32_t doLock) {
+    // Only used with VulkanQueueSubmitWithCommands, which does not lock.
+    (void)doLock;
+
+    auto stream = mImpl->stream();
+    auto pool = mImpl->pool();
+    VkDeviceSize dataSize = staging->writtenSize();
+    bool queueSubmitWithCommandsEnabled = sFeatureBits & VULKAN_STREAM_FEATURE_QUEUE_SUBMIT_WITH_COMMANDS_BIT;
+    uint32_t headerSize = 4 + 4 + (queueSubmitWithCommandsEnabled ? 4 : 0) + 8 + 8 + sizeof(VkDeviceSize);
+    uint32_t packetSize = headerSize + dataSize;
+    uint8_t* streamPtr = stream->reserve(headerSize);
+    uint32_t opcode = OP_vkQueueFlushCommandsGOOGLE;
+    uint32_t seqno = ResourceTracker::nextSeqno();
+    uint64_t hostQueue = get_host_u64_VkQueue(queue);
+    uint64_t hostCommandBuffer = get_host_u64_VkCommandBuffer(commandBuffer);
+    memcpy(streamPtr, &opcode, sizeof(uint32_t)); streamPtr += sizeof(uint32_t);
+    memcpy(streamPtr, &packetSize, sizeof(uint32_t)); streamPtr += sizeof(uint32_t);
+    if (queueSubmitWithCommandsEnabled) { memcpy(streamPtr, &seqno, sizeof(uint32_t)); streamPtr += sizeof(uint32_t); }
+    memcpy(streamPtr, &hostQueue, 8); streamPtr += 8;
+    memcpy(streamPtr, &hostCommandBuffer, 8); streamPtr += 8;
+    memcpy(streamPtr, &dataSize, sizeof(VkDeviceSize)); streamPtr += sizeof(VkDeviceSize);
+
+    AEMU_SCOPED_TRACE_PAYLOAD(Transport, "vkQueueFlush large xfer", dataSize);
+    stream->flush();
+    for (const auto& chunk : staging->chunks()) {
+        if (chunk.used) stream->writeLarge(chunk.data, chunk.used);
+    }
+
+    ++encodeCount;
+    if (0 == encodeCount % POOL_CLEAR_INTERVAL) {
+        pool->freeAll();
+        stream->clearPool();
+    }
+}
+
 void VkEncoder::incRef() {
     __atomic_add_fetch(&refCount, 1, __ATOMIC_SEQ_CST);
 }
@@ -29,6 +29,7 @@
 
 #include "goldfish_vk_private_defs.h"
 #include <memory>
+class CommandBufferStagingStream;
 class IOStream;
 
 
@@ -1,6 +1,32 @@
     void flush();
     void lock();
     void unlock();
+    // Contention counters of the encoder lock, for profiling.
+    struct LockStats {
+        uint64_t acquisitions = 0;
+        uint64_t contended = 0;
+        uint64_t spinAcquired = 0;
+        uint64_t sleeps = 0;
+    };
+    LockStats getLockStats() const;
+    // Time spent waiting for the encoder lock and in the stream, for
+    // vulkan_encoder_benchmark --phases. Zero unless vulkan_enc is built with
+    // VK_ENCODER_PHASE_TIMERS and the timers are enabled.
+    struct PhaseTimes {
+        uint64_t lockNs = 0;
+        uint64_t streamNs = 0;
+    };
+    // Enables the timers of all encoders. Returns false if vulkan_enc was
+    // built without VK_ENCODER_PHASE_TIMERS.
+    static bool setPhaseTimersEnabled(bool enabled);
+    PhaseTimes getPhaseTimes() const;
+    void resetPhaseTimes();
+    // vkQueueFlushCommandsGOOGLE with the commands recorded in |staging|,
+    // sent chunk by chunk rather than from one contiguous buffer.
+    void vkQueueFlushCommandsFromStagingGOOGLE(VkQueue queue,
+                                               VkCommandBuffer commandBuffer,
+                                               CommandBufferStagingStream* staging,
+                                               uint32_t doLock);
     void incRef();
     bool decRef();
     uint32_t refCount = 1;
@@ -15,6 +15,13 @@
 
 namespace goldfish_vk {
 
+#ifdef VK_ENCODER_PHASE_TIMERS
+std::atomic<bool> PhaseTimer::sEnabled(false);
+#define STREAM_PHASE_TIMER() PhaseTimer phaseTimer(&mStreamNs)
+#else
+#define STREAM_PHASE_TIMER()
+#endif
+
 VulkanStreamGuest::VulkanStreamGuest(IOStream *stream): mStream(stream) {
     unsetHandleMapping();
     mFeatureBits = ResourceTracker::get()->getStreamFeatures();
@@ -99,6 +106,7 @@ void VulkanStreamGuest::loadStringArrayInPlaceWithStreamPtr(char*** forOutput, u
 
 
 ssize_t VulkanStreamGuest::read(void *buffer, size_t size) {
+    STREAM_PHASE_TIMER();
     if (!mStream->readback(buffer, size)) {
         ALOGE("FATAL: Could not read back %zu bytes", size);
         abort();
@@ -107,12 +115,14 @@ ssize_t VulkanStreamGuest::read(void *buffer, size_t size) {
 }
 
 ssize_t VulkanStreamGuest::write(const void *buffer, size_t size) {
+    STREAM_PHASE_TIMER();
     uint8_t* streamBuf = (uint8_t*)mStream->alloc(size);
     memcpy(streamBuf, buffer, size);
     return size;
 }
 
 void VulkanStreamGuest::writeLarge(const void* buffer, size_t size) {
+    STREAM_PHASE_TIMER();
     mStream->writeFullyAsync(buffer, size);
 }
 
@@ -133,7 +143,8 @@ VulkanHandleMapping* VulkanStreamGuest::handleMapping() const {
 }
 
 void VulkanStreamGuest::flush() {
-    AEMU_SCOPED_TRACE("VulkanStreamGuest device write");
+    AEMU_SCOPED_TRACE_CATEGORY(Transport, "VulkanStreamGuest device write");
+    STREAM_PHASE_TIMER();
     mStream->flush();
 }
 
@@ -150,6 +161,7 @@ bool VulkanStreamGuest::decStreamRef() {
 }
 
 uint8_t* VulkanStreamGuest::reserve(size_t size) {
+    STREAM_PHASE_TIMER();
     return (uint8_t*)mStream->alloc(size);
 }
 
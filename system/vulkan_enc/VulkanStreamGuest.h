@@ -24,18 +24,49 @@
 #include "ResourceTracker.h"
 
 #include "android/base/BumpPool.h"
+// The lock VkEncoder holds around its stream. VkEncoder.cpp is generated and
+// reaches it through this header.
+#include "android/base/synchronization/AndroidAdaptiveLock.h"
 #include "android/base/Tracing.h"
 
+#include <atomic>
 #include <vector>
 #include <memory>
 
 #include <log/log.h>
 #include <inttypes.h>
+#include <time.h>
 
 class IOStream;
 
 namespace goldfish_vk {
 
+#ifdef VK_ENCODER_PHASE_TIMERS
+// Adds the time until the end of its scope to |*ns| while phase timers are
+// enabled. Only vulkan_encoder_benchmark --phases turns them on.
+class PhaseTimer {
+public:
+    explicit PhaseTimer(uint64_t* ns)
+        : mNs(sEnabled.load(std::memory_order_relaxed) ? ns : nullptr),
+          mStart(mNs ? now() : 0) {}
+    ~PhaseTimer() {
+        if (mNs) *mNs += now() - mStart;
+    }
+
+    static std::atomic<bool> sEnabled;
+
+private:
+    static uint64_t now() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return uint64_t(ts.tv_sec) * 1000000000ULL + uint64_t(ts.tv_nsec);
+    }
+
+    uint64_t* mNs;
+    uint64_t mStart;
+};
+#endif
+
 class VulkanStreamGuest : public android::base::Stream {
 public:
     VulkanStreamGuest(IOStream* stream);
@@ -76,6 +107,11 @@ public:
     bool decStreamRef();
 
     uint8_t* reserve(size_t size);
+
+    // Time spent in the IOStream since the last reset. Only counted with
+    // VK_ENCODER_PHASE_TIMERS.
+    uint64_t streamNs() const { return mStreamNs; }
+    void resetStreamNs() { mStreamNs = 0; }
 private:
     android::base::BumpPool mPool;
     std::vector<uint8_t> mWriteBuffer;
@@ -83,6 +119,7 @@ private:
     DefaultHandleMapping mDefaultHandleMapping;
     VulkanHandleMapping* mCurrentHandleMapping;
     uint32_t mFeatureBits = 0;
+    uint64_t mStreamNs = 0;
 };
 
 class VulkanCountingStream : public VulkanStreamGuest {
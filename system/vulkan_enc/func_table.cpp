@@ -175,6 +175,7 @@ static void entry_vkDestroyDevice(
 {
     AEMU_SCOPED_TRACE("vkDestroyDevice");
     auto vkEnc = ResourceTracker::getThreadLocalEncoder();
+    ResourceTracker::get()->destroyImplicitPipelineCache(vkEnc, device);
     vkEnc->vkDestroyDevice(device, pAllocator, true /* do lock */);
 }
 static VkResult entry_vkEnumerateInstanceExtensionProperties(
@@ -240,7 +241,7 @@ static VkResult entry_vkQueueSubmit(
     VkFence fence)
 {
     AEMU_SCOPED_TRACE("vkQueueSubmit");
-    auto vkEnc = ResourceTracker::getQueueEncoder(queue);
+    auto vkEnc = ResourceTracker::getQueueSubmitEncoder(queue);
     VkResult vkQueueSubmit_VkResult_return = (VkResult)0;
     auto resources = ResourceTracker::get();
     vkQueueSubmit_VkResult_return = resources->on_vkQueueSubmit(vkEnc, VK_SUCCESS, queue, submitCount, pSubmits, fence);
@@ -261,6 +262,7 @@ static VkResult entry_vkDeviceWaitIdle(
 {
     AEMU_SCOPED_TRACE("vkDeviceWaitIdle");
     auto vkEnc = ResourceTracker::getThreadLocalEncoder();
+    ResourceTracker::get()->drainQueueSubmitThreads(device);
     VkResult vkDeviceWaitIdle_VkResult_return = (VkResult)0;
     vkDeviceWaitIdle_VkResult_return = vkEnc->vkDeviceWaitIdle(device, true /* do lock */);
     return vkDeviceWaitIdle_VkResult_return;
@@ -318,7 +320,8 @@ static VkResult entry_vkFlushMappedMemoryRanges(
     AEMU_SCOPED_TRACE("vkFlushMappedMemoryRanges");
     auto vkEnc = ResourceTracker::getThreadLocalEncoder();
     VkResult vkFlushMappedMemoryRanges_VkResult_return = (VkResult)0;
-    vkFlushMappedMemoryRanges_VkResult_return = vkEnc->vkFlushMappedMemoryRanges(device, memoryRangeCount, pMemoryRanges, true /* do lock */);
+    auto resources = ResourceTracker::get();
+    vkFlushMappedMemoryRanges_VkResult_return = resources->on_vkFlushMappedMemoryRanges(vkEnc, VK_SUCCESS, device, memoryRangeCount, pMemoryRanges);
     return vkFlushMappedMemoryRanges_VkResult_return;
 }
 static VkResult entry_vkInvalidateMappedMemoryRanges(
@@ -329,7 +332,8 @@ static VkResult entry_vkInvalidateMappedMemoryRanges(
     AEMU_SCOPED_TRACE("vkInvalidateMappedMemoryRanges");
     auto vkEnc = ResourceTracker::getThreadLocalEncoder();
     VkResult vkInvalidateMappedMemoryRanges_VkResult_return = (VkResult)0;
-    vkInvalidateMappedMemoryRanges_VkResult_return = vkEnc->vkInvalidateMappedMemoryRanges(device, memoryRangeCount, pMemoryRanges, true /* do lock */);
+    auto resources = ResourceTracker::get();
+    vkInvalidateMappedMemoryRanges_VkResult_return = resources->on_vkInvalidateMappedMemoryRanges(vkEnc, VK_SUCCESS, device, memoryRangeCount, pMemoryRanges);
     return vkInvalidateMappedMemoryRanges_VkResult_return;
 }
 static void entry_vkGetDeviceMemoryCommitment(
@@ -419,6 +423,12 @@ static VkResult entry_vkQueueBindSparse(
 {
     AEMU_SCOPED_TRACE("vkQueueBindSparse");
     auto vkEnc = ResourceTracker::getQueueEncoder(queue);
+    for (uint32_t i = 0; i < bindInfoCount; ++i) {
+        if (pBindInfo[i].waitSemaphoreCount) {
+            ResourceTracker::get()->drainOtherQueueSubmitThreads(queue);
+            break;
+        }
+    }
     VkResult vkQueueBindSparse_VkResult_return = (VkResult)0;
     vkQueueBindSparse_VkResult_return = vkEnc->vkQueueBindSparse(queue, bindInfoCount, pBindInfo, fence, true /* do lock */);
     return vkQueueBindSparse_VkResult_return;
@@ -463,6 +473,7 @@ static VkResult entry_vkGetFenceStatus(
 {
     AEMU_SCOPED_TRACE("vkGetFenceStatus");
     auto vkEnc = ResourceTracker::getThreadLocalEncoder();
+    ResourceTracker::get()->drainQueueSubmitThreads(device);
     VkResult vkGetFenceStatus_VkResult_return = (VkResult)0;
     vkGetFenceStatus_VkResult_return = vkEnc->vkGetFenceStatus(device, fence, true /* do lock */);
     return vkGetFenceStatus_VkResult_return;
@@ -531,6 +542,7 @@ static VkResult entry_vkGetEventStatus(
 {
     AEMU_SCOPED_TRACE("vkGetEventStatus");
     auto vkEnc = ResourceTracker::getThreadLocalEncoder();
+    ResourceTracker::get()->drainQueueSubmitThreads(device);
     VkResult vkGetEventStatus_VkResult_return = (VkResult)0;
     vkGetEventStatus_VkResult_return = vkEnc->vkGetEventStatus(device, event, true /* do lock */);
     return vkGetEventStatus_VkResult_return;
@@ -588,6 +600,7 @@ static VkResult entry_vkGetQueryPoolResults(
 {
     AEMU_SCOPED_TRACE("vkGetQueryPoolResults");
     auto vkEnc = ResourceTracker::getThreadLocalEncoder();
+    ResourceTracker::get()->drainQueueSubmitThreads(device);
     VkResult vkGetQueryPoolResults_VkResult_return = (VkResult)0;
     vkGetQueryPoolResults_VkResult_return = vkEnc->vkGetQueryPoolResults(device, queryPool, firstQuery, queryCount, dataSize, pData, stride, flags, true /* do lock */);
     return vkGetQueryPoolResults_VkResult_return;
@@ -768,7 +781,8 @@ static VkResult entry_vkCreateGraphicsPipelines(
     AEMU_SCOPED_TRACE("vkCreateGraphicsPipelines");
     auto vkEnc = ResourceTracker::getThreadLocalEncoder();
     VkResult vkCreateGraphicsPipelines_VkResult_return = (VkResult)0;
-    vkCreateGraphicsPipelines_VkResult_return = vkEnc->vkCreateGraphicsPipelines(device, pipelineCache, createInfoCount, pCreateInfos, pAllocator, pPipelines, true /* do lock */);
+    auto resources = ResourceTracker::get();
+    vkCreateGraphicsPipelines_VkResult_return = resources->on_vkCreateGraphicsPipelines(vkEnc, VK_SUCCESS, device, pipelineCache, createInfoCount, pCreateInfos, pAllocator, pPipelines);
     return vkCreateGraphicsPipelines_VkResult_return;
 }
 static VkResult entry_vkCreateComputePipelines(
@@ -782,7 +796,8 @@ static VkResult entry_vkCreateComputePipelines(
     AEMU_SCOPED_TRACE("vkCreateComputePipelines");
     auto vkEnc = ResourceTracker::getThreadLocalEncoder();
     VkResult vkCreateComputePipelines_VkResult_return = (VkResult)0;
-    vkCreateComputePipelines_VkResult_return = vkEnc->vkCreateComputePipelines(device, pipelineCache, createInfoCount, pCreateInfos, pAllocator, pPipelines, true /* do lock */);
+    auto resources = ResourceTracker::get();
+    vkCreateComputePipelines_VkResult_return = resources->on_vkCreateComputePipelines(vkEnc, VK_SUCCESS, device, pipelineCache, createInfoCount, pCreateInfos, pAllocator, pPipelines);
     return vkCreateComputePipelines_VkResult_return;
 }
 static void entry_vkDestroyPipeline(
@@ -2155,6 +2170,7 @@ static VkResult entry_vkGetSemaphoreCounterValue(
 {
     AEMU_SCOPED_TRACE("vkGetSemaphoreCounterValue");
     auto vkEnc = ResourceTracker::getThreadLocalEncoder();
+    ResourceTracker::get()->drainQueueSubmitThreads(device);
     VkResult vkGetSemaphoreCounterValue_VkResult_return = (VkResult)0;
     vkGetSemaphoreCounterValue_VkResult_return = vkEnc->vkGetSemaphoreCounterValue(device, semaphore, pValue, true /* do lock */);
     return vkGetSemaphoreCounterValue_VkResult_return;
@@ -2171,6 +2187,7 @@ static VkResult dynCheck_entry_vkGetSemaphoreCounterValue(
     }
     AEMU_SCOPED_TRACE("vkGetSemaphoreCounterValue");
     auto vkEnc = ResourceTracker::getThreadLocalEncoder();
+    ResourceTracker::get()->drainQueueSubmitThreads(device);
     VkResult vkGetSemaphoreCounterValue_VkResult_return = (VkResult)0;
     vkGetSemaphoreCounterValue_VkResult_return = vkEnc->vkGetSemaphoreCounterValue(device, semaphore, pValue, true /* do lock */);
     return vkGetSemaphoreCounterValue_VkResult_return;
@@ -2182,6 +2199,7 @@ static VkResult entry_vkWaitSemaphores(
 {
     AEMU_SCOPED_TRACE("vkWaitSemaphores");
     auto vkEnc = ResourceTracker::getThreadLocalEncoder();
+    ResourceTracker::get()->drainQueueSubmitThreads(device);
     VkResult vkWaitSemaphores_VkResult_return = (VkResult)0;
     vkWaitSemaphores_VkResult_return = vkEnc->vkWaitSemaphores(device, pWaitInfo, timeout, true /* do lock */);
     return vkWaitSemaphores_VkResult_return;
@@ -2198,6 +2216,7 @@ static VkResult dynCheck_entry_vkWaitSemaphores(
     }
     AEMU_SCOPED_TRACE("vkWaitSemaphores");
     auto vkEnc = ResourceTracker::getThreadLocalEncoder();
+    ResourceTracker::get()->drainQueueSubmitThreads(device);
     VkResult vkWaitSemaphores_VkResult_return = (VkResult)0;
     vkWaitSemaphores_VkResult_return = vkEnc->vkWaitSemaphores(device, pWaitInfo, timeout, true /* do lock */);
     return vkWaitSemaphores_VkResult_return;
@@ -3965,6 +3984,7 @@ static VkResult entry_vkGetSemaphoreCounterValueKHR(
 {
     AEMU_SCOPED_TRACE("vkGetSemaphoreCounterValueKHR");
     auto vkEnc = ResourceTracker::getThreadLocalEncoder();
+    ResourceTracker::get()->drainQueueSubmitThreads(device);
     VkResult vkGetSemaphoreCounterValueKHR_VkResult_return = (VkResult)0;
     vkGetSemaphoreCounterValueKHR_VkResult_return = vkEnc->vkGetSemaphoreCounterValueKHR(device, semaphore, pValue, true /* do lock */);
     return vkGetSemaphoreCounterValueKHR_VkResult_return;
@@ -3981,6 +4001,7 @@ static VkResult dynCheck_entry_vkGetSemaphoreCounterValueKHR(
     }
     AEMU_SCOPED_TRACE("vkGetSemaphoreCounterValueKHR");
     auto vkEnc = ResourceTracker::getThreadLocalEncoder();
+    ResourceTracker::get()->drainQueueSubmitThreads(device);
     VkResult vkGetSemaphoreCounterValueKHR_VkResult_return = (VkResult)0;
     vkGetSemaphoreCounterValueKHR_VkResult_return = vkEnc->vkGetSemaphoreCounterValueKHR(device, semaphore, pValue, true /* do lock */);
     return vkGetSemaphoreCounterValueKHR_VkResult_return;
@@ -3992,6 +4013,7 @@ static VkResult entry_vkWaitSemaphoresKHR(
 {
     AEMU_SCOPED_TRACE("vkWaitSemaphoresKHR");
     auto vkEnc = ResourceTracker::getThreadLocalEncoder();
+    ResourceTracker::get()->drainQueueSubmitThreads(device);
     VkResult vkWaitSemaphoresKHR_VkResult_return = (VkResult)0;
     vkWaitSemaphoresKHR_VkResult_return = vkEnc->vkWaitSemaphoresKHR(device, pWaitInfo, timeout, true /* do lock */);
     return vkWaitSemaphoresKHR_VkResult_return;
@@ -4008,6 +4030,7 @@ static VkResult dynCheck_entry_vkWaitSemaphoresKHR(
     }
     AEMU_SCOPED_TRACE("vkWaitSemaphoresKHR");
     auto vkEnc = ResourceTracker::getThreadLocalEncoder();
+    ResourceTracker::get()->drainQueueSubmitThreads(device);
     VkResult vkWaitSemaphoresKHR_VkResult_return = (VkResult)0;
     vkWaitSemaphoresKHR_VkResult_return = vkEnc->vkWaitSemaphoresKHR(device, pWaitInfo, timeout, true /* do lock */);
     return vkWaitSemaphoresKHR_VkResult_return;
@@ -45,7 +45,7 @@ memcpy(*streamPtrPtr, (uint64_t*)&cgen_var_1408, 1 * 8);
 memcpy(*streamPtrPtr, (VkDeviceSize*)&local_dataSize, sizeof(VkDeviceSize));
 *streamPtrPtr += sizeof(VkDeviceSize);
 
-AEMU_SCOPED_TRACE("vkQueueFlush large xfer");
+AEMU_SCOPED_TRACE_PAYLOAD(Transport, "vkQueueFlush large xfer", dataSize);
 stream->flush();
 stream->writeLarge(local_pData, dataSize);
 
@@ -14,13 +14,23 @@
 // limitations under the License.
 #include <gtest/gtest.h>
 
+#include "CommandBufferStagingStream.h"
+#include "DirtyPageTracker.h"
+#include "PipelineCacheStorage.h"
+#include "QueueSubmitThread.h"
+
 #include "android/base/synchronization/AndroidConditionVariable.h"
 #include "android/base/synchronization/AndroidLock.h"
 #include "android/base/threads/AndroidWorkPool.h"
 
 #include <atomic>
+#include <random>
+#include <thread>
 #include <vector>
 
+#include <sys/mman.h>
+#include <unistd.h>
+
 namespace android {
 namespace base {
 namespace guest {
@@ -283,6 +293,381 @@ TEST(WorkPool, NestedWaitAll) {
     EXPECT_EQ(1, y);
 }
 
+// Writes |count| packets of |size| bytes, each filled with its index, the
+// way the encoder does: one alloc() per packet.
+static void writePackets(CommandBufferStagingStream* stream, size_t count, size_t size) {
+    for (size_t i = 0; i < count; ++i) {
+        unsigned char* ptr = stream->alloc(size);
+        ASSERT_NE(nullptr, ptr);
+        memset(ptr, (int)(i & 0xff), size);
+    }
+    stream->flush();
+}
+
+// Tests that packets fill chunks in order without straddling them.
+TEST(CommandBufferStagingStream, Chunks) {
+    constexpr size_t kChunkSize = CommandBufferStagingChunkPool::kChunkSize;
+    constexpr size_t kPacketSize = 1000;
+    constexpr size_t kPackets = 3 * kChunkSize / kPacketSize + 1;
+
+    CommandBufferStagingChunkPool pool;
+    CommandBufferStagingStream* stream = new CommandBufferStagingStream(&pool);
+    writePackets(stream, kPackets, kPacketSize);
+
+    EXPECT_EQ(kPackets * kPacketSize, stream->writtenSize());
+    constexpr size_t kPacketsPerChunk = kChunkSize / kPacketSize;
+    EXPECT_EQ((kPackets + kPacketsPerChunk - 1) / kPacketsPerChunk, stream->chunks().size());
+    size_t packet = 0;
+    for (const auto& chunk : stream->chunks()) {
+        EXPECT_EQ(kChunkSize, chunk.capacity);
+        EXPECT_EQ(0u, chunk.used % kPacketSize);
+        for (size_t offset = 0; offset < chunk.used; offset += kPacketSize, ++packet) {
+            EXPECT_EQ((unsigned char)(packet & 0xff), chunk.data[offset]);
+            EXPECT_EQ((unsigned char)(packet & 0xff), chunk.data[offset + kPacketSize - 1]);
+        }
+    }
+    EXPECT_EQ(kPackets, packet);
+
+    stream->decRef();
+}
+
+// Tests that reset() recycles chunks and that the pool respects its budget.
+TEST(CommandBufferStagingStream, Recycle) {
+    constexpr size_t kChunkSize = CommandBufferStagingChunkPool::kChunkSize;
+
+    CommandBufferStagingChunkPool pool(2 * kChunkSize);
+    CommandBufferStagingStream* stream = new CommandBufferStagingStream(&pool);
+
+    writePackets(stream, 4, kChunkSize);
+    EXPECT_EQ(4u, stream->chunks().size());
+    stream->reset();
+    EXPECT_EQ(0u, stream->writtenSize());
+    EXPECT_TRUE(stream->chunks().empty());
+    EXPECT_EQ(2 * kChunkSize, pool.cachedBytes());
+
+    writePackets(stream, 1, 16);
+    EXPECT_EQ(kChunkSize, pool.cachedBytes());
+    EXPECT_EQ(16u, stream->writtenSize());
+    stream->reset();
+    EXPECT_EQ(2 * kChunkSize, pool.cachedBytes());
+
+    // Oversized packets get a dedicated chunk that is not kept.
+    writePackets(stream, 1, 3 * kChunkSize);
+    ASSERT_EQ(1u, stream->chunks().size());
+    EXPECT_EQ(3 * kChunkSize, stream->chunks()[0].capacity);
+    stream->reset();
+    EXPECT_EQ(2 * kChunkSize, pool.cachedBytes());
+
+    stream->decRef();
+}
+
+
+using goldfish_vk::DirtyPageTracker;
+
+// Maps |pages| fresh pages, so nothing else shares them with the test.
+static uint8_t* mapPages(size_t pages) {
+    void* ptr = mmap(nullptr, pages * DirtyPageTracker::pageSize(),
+                     PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return ptr == MAP_FAILED ? nullptr : (uint8_t*)ptr;
+}
+
+// Tests that only written pages are reported, once per write.
+TEST(DirtyPageTracker, Basic) {
+    const size_t kPage = DirtyPageTracker::pageSize();
+    const size_t kPages = 8;
+    DirtyPageTracker* tracker = DirtyPageTracker::get();
+    uint8_t* mem = mapPages(kPages);
+    ASSERT_NE(nullptr, mem);
+    ASSERT_TRUE(tracker->track(mem, kPages * kPage));
+    EXPECT_TRUE(tracker->isTracked(mem));
+
+    std::vector<DirtyPageTracker::Run> runs;
+    tracker->takeDirtyRuns(mem, 0, kPages * kPage, &runs);
+    EXPECT_TRUE(runs.empty());
+
+    uint64_t faults = tracker->stats().pageFaults;
+    mem[kPage + 1] = 1;
+    mem[kPage + 2] = 2;
+    mem[5 * kPage] = 5;
+    EXPECT_EQ(faults + 2, tracker->stats().pageFaults);
+
+    tracker->takeDirtyRuns(mem, 0, kPages * kPage, &runs);
+    ASSERT_EQ(2u, runs.size());
+    EXPECT_EQ(DirtyPageTracker::Run(kPage, kPage), runs[0]);
+    EXPECT_EQ(DirtyPageTracker::Run(5 * kPage, kPage), runs[1]);
+    EXPECT_EQ(1, mem[kPage + 1]);
+    EXPECT_EQ(5, mem[5 * kPage]);
+
+    runs.clear();
+    tracker->takeDirtyRuns(mem, 0, kPages * kPage, &runs);
+    EXPECT_TRUE(runs.empty());
+
+    mem[kPage] = 3;
+    tracker->takeDirtyRuns(mem, 0, kPages * kPage, &runs);
+    ASSERT_EQ(1u, runs.size());
+    EXPECT_EQ(DirtyPageTracker::Run(kPage, kPage), runs[0]);
+
+    tracker->untrack(mem);
+    EXPECT_FALSE(tracker->isTracked(mem));
+    mem[0] = 1;
+    runs.clear();
+    tracker->takeDirtyRuns(mem, 0, 16, &runs);
+    ASSERT_EQ(1u, runs.size());
+    EXPECT_EQ(DirtyPageTracker::Run(0, 16), runs[0]);
+
+    munmap(mem, kPages * kPage);
+}
+
+// Tests that adjacent pages merge and that pages straddling a range's ends
+// stay dirty for the next flush.
+TEST(DirtyPageTracker, PartialRanges) {
+    const size_t kPage = DirtyPageTracker::pageSize();
+    const size_t kPages = 8;
+    DirtyPageTracker* tracker = DirtyPageTracker::get();
+    uint8_t* mem = mapPages(kPages);
+    ASSERT_NE(nullptr, mem);
+    ASSERT_TRUE(tracker->track(mem, kPages * kPage));
+
+    memset(mem + 2 * kPage, 0xab, 3 * kPage);
+
+    std::vector<DirtyPageTracker::Run> runs;
+    tracker->takeDirtyRuns(mem, 2 * kPage + 100, kPage, &runs);
+    ASSERT_EQ(1u, runs.size());
+    EXPECT_EQ(DirtyPageTracker::Run(2 * kPage + 100, kPage), runs[0]);
+
+    runs.clear();
+    tracker->takeDirtyRuns(mem, 0, kPages * kPage, &runs);
+    ASSERT_EQ(1u, runs.size());
+    EXPECT_EQ(DirtyPageTracker::Run(2 * kPage, 3 * kPage), runs[0]);
+
+    // Ranges are clamped to the region.
+    mem[7 * kPage] = 1;
+    runs.clear();
+    tracker->takeDirtyRuns(mem, 6 * kPage, 16 * kPage, &runs);
+    ASSERT_EQ(1u, runs.size());
+    EXPECT_EQ(DirtyPageTracker::Run(7 * kPage, kPage), runs[0]);
+
+    tracker->untrack(mem);
+    munmap(mem, kPages * kPage);
+}
+
+// Tests that markDirty() lets the pages be written without faulting and
+// that they can be marked clean again afterwards.
+TEST(DirtyPageTracker, MarkDirty) {
+    const size_t kPage = DirtyPageTracker::pageSize();
+    const size_t kPages = 4;
+    DirtyPageTracker* tracker = DirtyPageTracker::get();
+    uint8_t* mem = mapPages(kPages);
+    ASSERT_NE(nullptr, mem);
+    ASSERT_TRUE(tracker->track(mem, kPages * kPage));
+
+    uint64_t faults = tracker->stats().pageFaults;
+    tracker->markDirty(mem, kPage, 2 * kPage);
+    memset(mem + kPage, 1, 2 * kPage);
+    EXPECT_EQ(faults, tracker->stats().pageFaults);
+
+    tracker->takeDirtyRuns(mem, kPage, 2 * kPage, nullptr);
+    std::vector<DirtyPageTracker::Run> runs;
+    tracker->takeDirtyRuns(mem, 0, kPages * kPage, &runs);
+    EXPECT_TRUE(runs.empty());
+
+    mem[kPage] = 2;
+    EXPECT_EQ(faults + 1, tracker->stats().pageFaults);
+
+    tracker->untrack(mem);
+    munmap(mem, kPages * kPage);
+}
+
+// Tests that faults from many threads on the same pages are all recorded.
+TEST(DirtyPageTracker, Concurrent) {
+    const size_t kPage = DirtyPageTracker::pageSize();
+    const size_t kPages = 64;
+    const int kThreads = 4;
+    const int kRounds = 100;
+    DirtyPageTracker* tracker = DirtyPageTracker::get();
+    uint8_t* mem = mapPages(kPages);
+    ASSERT_NE(nullptr, mem);
+    ASSERT_TRUE(tracker->track(mem, kPages * kPage));
+
+    for (int round = 0; round < kRounds; ++round) {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; ++t) {
+            threads.emplace_back([mem, kPage, kPages, t, round]() {
+                for (size_t page = t; page < kPages; page += 2) {
+                    mem[page * kPage + t] = (uint8_t)round;
+                }
+            });
+        }
+        for (auto& thread : threads) thread.join();
+
+        std::vector<DirtyPageTracker::Run> runs;
+        tracker->takeDirtyRuns(mem, 0, kPages * kPage, &runs);
+        ASSERT_EQ(1u, runs.size());
+        EXPECT_EQ(DirtyPageTracker::Run(0, kPages * kPage), runs[0]);
+    }
+
+    tracker->untrack(mem);
+    munmap(mem, kPages * kPage);
+}
+
+using goldfish_vk::QueueSubmitThread;
+
+// Tests that tasks run in order and drain() waits for all of them.
+TEST(QueueSubmitThread, Order) {
+    const int kTasks = 1000;
+    std::vector<int> order;
+    QueueSubmitThread thread(16);
+
+    for (int i = 0; i < kTasks; ++i) {
+        thread.enqueue([&order, i] { order.push_back(i); });
+    }
+    thread.drain();
+    EXPECT_TRUE(thread.idle());
+
+    ASSERT_EQ((size_t)kTasks, order.size());
+    for (int i = 0; i < kTasks; ++i) {
+        EXPECT_EQ(i, order[i]);
+    }
+}
+
+// Tests that enqueue() does not wait for tasks to run, and that drain()
+// only returns once the running task is done.
+TEST(QueueSubmitThread, Drain) {
+    Lock lock;
+    ConditionVariable cv;
+    bool release = false;
+    std::atomic<bool> done { false };
+    QueueSubmitThread thread;
+
+    thread.enqueue([&] {
+        AutoLock<Lock> autoLock(lock);
+        while (!release) cv.wait(&lock);
+        done = true;
+    });
+    EXPECT_FALSE(thread.idle());
+
+    std::thread releaser([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        AutoLock<Lock> autoLock(lock);
+        release = true;
+        cv.signal();
+    });
+
+    thread.drain();
+    EXPECT_TRUE(done);
+    EXPECT_TRUE(thread.idle());
+    releaser.join();
+
+    // Nothing pending.
+    thread.drain();
+}
+
+// Tests that a task draining its own thread does not deadlock.
+TEST(QueueSubmitThread, DrainFromTask) {
+    QueueSubmitThread thread;
+    bool ran = false;
+    thread.enqueue([&] {
+        thread.drain();
+        ran = true;
+    });
+    thread.drain();
+    EXPECT_TRUE(ran);
+}
+
+// Tests draining from other threads while one thread keeps enqueueing,
+// and that destruction runs whatever is still queued.
+TEST(QueueSubmitThread, ConcurrentDrain) {
+    const int kTasks = 10000;
+    const int kDrainers = 4;
+    std::atomic<int> count { 0 };
+    std::atomic<bool> stop { false };
+
+    {
+        QueueSubmitThread thread(8);
+        std::vector<std::thread> drainers;
+        for (int i = 0; i < kDrainers; ++i) {
+            drainers.emplace_back([&] {
+                while (!stop) {
+                    thread.drain();
+                    std::this_thread::sleep_for(std::chrono::microseconds(100));
+                }
+            });
+        }
+
+        for (int i = 0; i < kTasks; ++i) {
+            thread.enqueue([&count] { ++count; });
+            if (i % 1000 == 0) {
+                thread.drain();
+                EXPECT_EQ(i + 1, count.load());
+            }
+        }
+
+        stop = true;
+        for (auto& drainer : drainers) drainer.join();
+    }
+
+    EXPECT_EQ(kTasks, count.load());
+}
+
+using goldfish_vk::PipelineCacheKey;
+using goldfish_vk::PipelineCacheStorage;
+
+static std::vector<uint8_t> makePipelineCacheBlob(const PipelineCacheKey& key, size_t payload) {
+    std::vector<uint8_t> blob(32 + payload, 0x5a);
+    const uint32_t header[4] = { 32, 1, key.vendorID, key.deviceID };
+    memcpy(blob.data(), header, sizeof(header));
+    memcpy(blob.data() + sizeof(header), key.uuid, sizeof(key.uuid));
+    return blob;
+}
+
+// Tests that blobs are stored per app and driver and that blobs from another
+// driver are not handed back.
+TEST(PipelineCacheStorage, Basic) {
+    char dirTemplate[] = "/tmp/vk_pipeline_cache_XXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(dirTemplate));
+    PipelineCacheStorage storage(dirTemplate);
+    EXPECT_TRUE(storage.enabled());
+    EXPECT_FALSE(PipelineCacheStorage("").enabled());
+
+    PipelineCacheKey key;
+    key.app = PipelineCacheStorage::currentApp();
+    EXPECT_FALSE(key.app.empty());
+    EXPECT_EQ(std::string::npos, key.app.find('/'));
+    key.vendorID = 0x10de;
+    key.deviceID = 0x1234;
+    for (uint8_t i = 0; i < PipelineCacheKey::kUuidSize; ++i) key.uuid[i] = i;
+    PipelineCacheKey otherKey = key;
+    otherKey.uuid[0] = 0xff;
+    EXPECT_NE(storage.pathFor(key), storage.pathFor(otherKey));
+    PipelineCacheKey otherAppKey = key;
+    otherAppKey.app = "com.example.other";
+    EXPECT_NE(storage.pathFor(key), storage.pathFor(otherAppKey));
+
+    EXPECT_TRUE(storage.load(key).empty());
+
+    std::vector<uint8_t> blob = makePipelineCacheBlob(key, 1000);
+    EXPECT_TRUE(PipelineCacheStorage::headerMatches(key, blob));
+    EXPECT_FALSE(PipelineCacheStorage::headerMatches(otherKey, blob));
+    ASSERT_TRUE(storage.store(key, blob));
+    EXPECT_EQ(blob, storage.load(key));
+    EXPECT_TRUE(storage.load(otherKey).empty());
+
+    // A blob stored under the wrong key is dropped on load.
+    ASSERT_TRUE(storage.store(otherKey, blob));
+    EXPECT_TRUE(storage.load(otherKey).empty());
+
+    // Another app on the same driver does not see this app's blob.
+    EXPECT_TRUE(storage.load(otherAppKey).empty());
+
+    std::vector<uint8_t> newBlob = makePipelineCacheBlob(key, 10);
+    ASSERT_TRUE(storage.store(key, newBlob));
+    EXPECT_EQ(newBlob, storage.load(key));
+
+    unlink(storage.pathFor(key).c_str());
+    unlink(storage.pathFor(otherKey).c_str());
+    rmdir(dirTemplate);
+}
+
 } // namespace android
 } // namespace base
 } // namespace guest
@@ -0,0 +1,12 @@
+LOCAL_PATH := $(call my-dir)
+
+### android-emu base library microbenchmarks #####################
+$(call emugl-begin-executable,android_emu_benchmark)
+$(call emugl-import,libandroidemu)
+
+LOCAL_SRC_FILES := \
+    AndroidEmuBenchmark.cpp \
+
+LOCAL_CFLAGS += -DLOG_TAG=\"android_emu_benchmark\"
+
+$(call emugl-end-module)
@@ -0,0 +1,361 @@
+// Copyright (C) 2022 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Microbenchmarks for the android-emu base library.
+//
+// Usage: android_emu_benchmark [--filter=<substring>] [--min-time-ms=<ms>] [--csv]
+//
+// The lock/<mode>/<threads>t rows hammer an AdaptiveLock, as the Vulkan
+// encoder uses it, from several threads with encode-sized critical sections
+// and report wall and CPU time per acquisition, so the waiting strategies
+// can be compared under contention and oversubscription.
+//
+// The tables/<table>/<threads>t rows create, look up and destroy handle
+// infos from several threads, as ResourceTracker does for vkCreate*,
+// vkCmd* and vkDestroy*, in a ShardedMap and in one lock-guarded
+// std::unordered_map like the tables it replaced.
+
+#include "android/base/containers/ShardedMap.h"
+#include "android/base/synchronization/AndroidAdaptiveLock.h"
+#include "android/base/synchronization/AndroidLock.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+using android::base::guest::AdaptiveLock;
+
+namespace {
+
+uint64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000ULL + uint64_t(ts.tv_nsec);
+}
+
+uint64_t processCpuNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000ULL + uint64_t(ts.tv_nsec);
+}
+
+struct Options {
+    std::string filter;
+    uint64_t minTimeMs = 200;
+    bool csv = false;
+};
+
+struct LockBenchmark {
+    std::string name;
+    AdaptiveLock::Mode mode;
+    uint32_t threads;
+};
+
+struct LockResult {
+    uint64_t acquisitions;
+    double nsPerAcquisition;
+    double cpuNsPerAcquisition;
+    uint64_t contended;
+    uint64_t sleeps;
+};
+
+std::vector<LockBenchmark> makeLockBenchmarks() {
+    std::vector<LockBenchmark> benchmarks;
+    const uint32_t cpus = std::max(1u, std::thread::hardware_concurrency());
+    const struct {
+        const char* name;
+        AdaptiveLock::Mode mode;
+    } modes[] = {
+        {"adaptive", AdaptiveLock::Mode::Adaptive},
+        {"spin", AdaptiveLock::Mode::Spin},
+        {"sleep", AdaptiveLock::Mode::Sleep},
+    };
+    // The last count oversubscribes the machine, like a guest with more
+    // rendering threads than vCPUs.
+    for (auto mode : modes) {
+        for (uint32_t threads : {1u, 2u, 4u, std::max(8u, cpus * 2)}) {
+            benchmarks.push_back({std::string("lock/") + mode.name + "/" +
+                                      std::to_string(threads) + "t",
+                                  mode.mode, threads});
+        }
+    }
+    return benchmarks;
+}
+
+LockResult runLockBenchmark(const LockBenchmark& benchmark, const Options& options) {
+    AdaptiveLock lock(benchmark.mode);
+    std::atomic<bool> stop(false);
+    // Stands in for the encoder's stream buffer.
+    unsigned char shared[256] = {};
+
+    const uint64_t start = nowNs();
+    const uint64_t cpuStart = processCpuNs();
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < benchmark.threads; ++t) {
+        threads.emplace_back([&lock, &stop, &shared, t] {
+            unsigned char command[sizeof(shared)];
+            memset(command, (int)t, sizeof(command));
+            while (!stop.load(std::memory_order_relaxed)) {
+                lock.lock();
+                memcpy(shared, command, sizeof(command));
+                lock.unlock();
+                // Building the next command's parameters happens unlocked.
+                for (size_t i = 0; i < sizeof(command); i += 16) command[i]++;
+            }
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(options.minTimeMs));
+    stop.store(true, std::memory_order_relaxed);
+    for (auto& thread : threads) thread.join();
+    const uint64_t elapsed = nowNs() - start;
+    const uint64_t cpu = processCpuNs() - cpuStart;
+
+    AdaptiveLock::Stats stats = lock.stats();
+    const double acquisitions = stats.acquisitions ? (double)stats.acquisitions : 1.0;
+    return {
+        stats.acquisitions,
+        (double)elapsed / acquisitions,
+        (double)cpu / acquisitions,
+        stats.contended,
+        stats.sleeps,
+    };
+}
+
+// Stands in for the per-handle info ResourceTracker keeps, e.g. a sampler's.
+struct HandleInfo {
+    uint64_t device;
+    uint32_t flags;
+    uint32_t padding[5];
+};
+
+// Handles are guest pointers: aligned and close together.
+using Handle = uint64_t;
+
+// The table layouts ResourceTracker has used for handle infos.
+class HandleTable {
+public:
+    virtual ~HandleTable() = default;
+    virtual void add(Handle handle, const HandleInfo& info) = 0;
+    // Returns info.device, or 0 if |handle| is not in the table.
+    virtual uint64_t lookUp(Handle handle) = 0;
+    virtual void remove(Handle handle) = 0;
+};
+
+class ShardedHandleTable : public HandleTable {
+public:
+    void add(Handle handle, const HandleInfo& info) override { mMap.set(handle, info); }
+    uint64_t lookUp(Handle handle) override {
+        uint64_t device = 0;
+        mMap.find(handle, [&device](HandleInfo& info) { device = info.device; });
+        return device;
+    }
+    void remove(Handle handle) override { mMap.erase(handle); }
+
+private:
+    android::base::ShardedMap<Handle, HandleInfo> mMap;
+};
+
+class LockedHandleTable : public HandleTable {
+public:
+    void add(Handle handle, const HandleInfo& info) override {
+        AutoLock<Lock> lock(mLock);
+        mMap[handle] = info;
+    }
+    uint64_t lookUp(Handle handle) override {
+        AutoLock<Lock> lock(mLock);
+        auto it = mMap.find(handle);
+        return it == mMap.end() ? 0 : it->second.device;
+    }
+    void remove(Handle handle) override {
+        AutoLock<Lock> lock(mLock);
+        mMap.erase(handle);
+    }
+
+private:
+    using Lock = android::base::guest::Lock;
+    template <class T> using AutoLock = android::base::guest::AutoLock<T>;
+
+    Lock mLock;
+    std::unordered_map<Handle, HandleInfo> mMap;
+};
+
+struct TableBenchmark {
+    std::string name;
+    std::function<std::unique_ptr<HandleTable>()> makeTable;
+    uint32_t threads;
+};
+
+struct TableResult {
+    uint64_t operations;
+    double nsPerOperation;
+    double cpuNsPerOperation;
+};
+
+std::vector<TableBenchmark> makeTableBenchmarks() {
+    const struct {
+        const char* name;
+        std::function<std::unique_ptr<HandleTable>()> makeTable;
+    } tables[] = {
+        {"sharded_map", [] { return std::unique_ptr<HandleTable>(new ShardedHandleTable); }},
+        {"locked_map", [] { return std::unique_ptr<HandleTable>(new LockedHandleTable); }},
+    };
+    std::vector<TableBenchmark> benchmarks;
+    const uint32_t cpus = std::max(1u, std::thread::hardware_concurrency());
+    for (const auto& table : tables) {
+        for (uint32_t threads : {1u, 4u, std::max(8u, cpus * 2)}) {
+            benchmarks.push_back({std::string("tables/") + table.name + "/" +
+                                      std::to_string(threads) + "t",
+                                  table.makeTable, threads});
+        }
+    }
+    return benchmarks;
+}
+
+TableResult runTableBenchmark(const TableBenchmark& benchmark, const Options& options) {
+    std::unique_ptr<HandleTable> table = benchmark.makeTable();
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> operations(0);
+
+    const uint64_t start = nowNs();
+    const uint64_t cpuStart = processCpuNs();
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < benchmark.threads; ++t) {
+        threads.emplace_back([&, t] {
+            Handle next = 0x7f0000000000ULL + ((uint64_t)t << 28);
+            uint64_t ops = 0;
+            uint64_t sink = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                // Create a batch, use each handle a few times, destroy it.
+                Handle handles[16];
+                for (Handle& handle : handles) {
+                    handle = next;
+                    next += 16 * 9;
+                    table->add(handle, HandleInfo{handle, 0, {}});
+                }
+                for (int use = 0; use < 4; ++use) {
+                    for (Handle handle : handles) sink += table->lookUp(handle);
+                }
+                for (Handle handle : handles) table->remove(handle);
+                ops += 6 * (sizeof(handles) / sizeof(handles[0]));
+            }
+            // Keeps the lookups from being optimized away.
+            if (sink == 42) printf(" ");
+            operations.fetch_add(ops, std::memory_order_relaxed);
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(options.minTimeMs));
+    stop.store(true, std::memory_order_relaxed);
+    for (auto& thread : threads) thread.join();
+    const uint64_t elapsed = nowNs() - start;
+    const uint64_t cpu = processCpuNs() - cpuStart;
+
+    const uint64_t ops = operations.load(std::memory_order_relaxed);
+    const double divisor = ops ? (double)ops : 1.0;
+    return {ops, (double)elapsed / divisor, (double)cpu / divisor};
+}
+
+bool parseOptions(int argc, char** argv, Options* options) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (!strncmp(arg, "--filter=", 9)) {
+            options->filter = arg + 9;
+        } else if (!strncmp(arg, "--min-time-ms=", 14)) {
+            options->minTimeMs = strtoull(arg + 14, nullptr, 10);
+        } else if (!strcmp(arg, "--csv")) {
+            options->csv = true;
+        } else {
+            fprintf(stderr,
+                    "usage: %s [--filter=<substring>] [--min-time-ms=<ms>] [--csv]\n",
+                    argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, &options)) return 2;
+
+    bool printedLockHeader = false;
+    for (const LockBenchmark& benchmark : makeLockBenchmarks()) {
+        if (!options.filter.empty() && benchmark.name.find(options.filter) == std::string::npos) {
+            continue;
+        }
+        if (!printedLockHeader) {
+            if (options.csv) {
+                printf("lock,acquisitions,ns_per_acquisition,cpu_ns_per_acquisition,"
+                       "contended,sleeps\n");
+            } else {
+                printf("%-36s %12s %10s %12s %12s %12s\n", "lock", "acquisitions", "ns/acq",
+                       "cpu ns/acq", "contended", "sleeps");
+            }
+            printedLockHeader = true;
+        }
+        LockResult result = runLockBenchmark(benchmark, options);
+        if (options.csv) {
+            printf("%s,%llu,%.2f,%.2f,%llu,%llu\n", benchmark.name.c_str(),
+                   (unsigned long long)result.acquisitions, result.nsPerAcquisition,
+                   result.cpuNsPerAcquisition, (unsigned long long)result.contended,
+                   (unsigned long long)result.sleeps);
+        } else {
+            printf("%-36s %12llu %10.2f %12.2f %12llu %12llu\n", benchmark.name.c_str(),
+                   (unsigned long long)result.acquisitions, result.nsPerAcquisition,
+                   result.cpuNsPerAcquisition, (unsigned long long)result.contended,
+                   (unsigned long long)result.sleeps);
+        }
+    }
+
+    bool printedTableHeader = false;
+    for (const TableBenchmark& benchmark : makeTableBenchmarks()) {
+        if (!options.filter.empty() && benchmark.name.find(options.filter) == std::string::npos) {
+            continue;
+        }
+        if (!printedTableHeader) {
+            if (options.csv) {
+                printf("\ntables,operations,ns_per_operation,cpu_ns_per_operation\n");
+            } else {
+                printf("\n%-36s %12s %10s %12s\n", "tables", "operations", "ns/op",
+                       "cpu ns/op");
+            }
+            printedTableHeader = true;
+        }
+        TableResult result = runTableBenchmark(benchmark, options);
+        if (options.csv) {
+            printf("%s,%llu,%.2f,%.2f\n", benchmark.name.c_str(),
+                   (unsigned long long)result.operations, result.nsPerOperation,
+                   result.cpuNsPerOperation);
+        } else {
+            printf("%-36s %12llu %10.2f %12.2f\n", benchmark.name.c_str(),
+                   (unsigned long long)result.operations, result.nsPerOperation,
+                   result.cpuNsPerOperation);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,12 @@
+LOCAL_PATH := $(call my-dir)
+
+### Encoder microbenchmarks ######################################
+$(call emugl-begin-executable,encoder_benchmark)
+$(call emugl-import,libOpenglSystemCommon libGLESv1_enc libGLESv2_enc lib_renderControl_enc)
+
+LOCAL_SRC_FILES := \
+    EncoderBenchmark.cpp \
+
+LOCAL_CFLAGS += -DLOG_TAG=\"encoder_benchmark\"
+
+$(call emugl-end-module)
@@ -0,0 +1,656 @@
+// Copyright (C) 2022 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Microbenchmarks for the guest-side GLES and renderControl encoders.
+//
+// The encoders run against a stream that discards everything written to it
+// and answers host readbacks with zeros (GL_NO_ERROR) unless a reply was
+// queued, so the numbers measure guest-side encoding only: validation, client
+// state tracking and marshaling. For each command mix we report ns/call, bytes/call and host
+// round trips/call.
+//
+// Usage: encoder_benchmark [--filter=<substring>] [--min-time-ms=<ms>]
+//                          [--csv] [--check]
+//
+// --check exits non-zero if a mix performs more host round trips per
+// iteration than expected. Timings vary between machines, but bytes and
+// round trips are deterministic, so --check is suitable for CI.
+//
+// The names/<container>/<count> rows look up random live GL object names
+// the way GLSharedGroup and GLClientState do, in SlotTable and in the
+// std::map and std::unordered_map it replaced.
+
+#include "ChecksumCalculator.h"
+#include "GL2Encoder.h"
+#include "GLEncoder.h"
+#include "GLClientState.h"
+#include "GLSharedGroup.h"
+#include "HostConnection.h"
+#include "IOStream.h"
+#include "android/base/containers/SlotTable.h"
+
+#include <GLES/gl.h>
+#include <GLES3/gl31.h>
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+namespace {
+
+// Discards all commands, counting bytes and host round trips. Readbacks are
+// filled 32 bits at a time from the queued replies, then with zeros. A round
+// trip is any readback that follows a write; a reply that arrives in several
+// reads counts once.
+class CountingStream : public IOStream {
+public:
+    static constexpr size_t kBufferSize = 1 << 20;
+
+    CountingStream() : IOStream(kBufferSize), m_buf(kBufferSize) {}
+
+    void* allocBuffer(size_t minSize) override {
+        if (m_buf.size() < minSize) m_buf.resize(minSize);
+        return m_buf.data();
+    }
+
+    int commitBuffer(size_t size) override {
+        m_bytesWritten += size;
+        m_wroteSinceRead = true;
+        return (int)size;
+    }
+
+    const unsigned char* readFully(void* buf, size_t len) override {
+        if (m_wroteSinceRead) {
+            ++m_roundTrips;
+            m_wroteSinceRead = false;
+        }
+        fillReply(buf, len);
+        return (const unsigned char*)buf;
+    }
+
+    const unsigned char* commitBufferAndReadFully(size_t size, void* buf, size_t len) override {
+        commitBuffer(size);
+        return readFully(buf, len);
+    }
+
+    const unsigned char* read(void* buf, size_t* inout_len) override {
+        return readFully(buf, *inout_len);
+    }
+
+    int writeFully(const void*, size_t len) override {
+        m_bytesWritten += len;
+        m_wroteSinceRead = true;
+        return 0;
+    }
+
+    void queueReply(uint32_t value) { m_replies.push_back(value); }
+
+    uint64_t bytesWritten() const { return m_bytesWritten; }
+    uint64_t roundTrips() const { return m_roundTrips; }
+
+private:
+    void fillReply(void* buf, size_t len) {
+        if (!buf) return;
+        unsigned char* out = (unsigned char*)buf;
+        while (len >= sizeof(uint32_t)) {
+            uint32_t value = 0;
+            if (!m_replies.empty()) {
+                value = m_replies.front();
+                m_replies.pop_front();
+            }
+            memcpy(out, &value, sizeof(value));
+            out += sizeof(value);
+            len -= sizeof(value);
+        }
+        memset(out, 0, len);
+    }
+
+    std::vector<unsigned char> m_buf;
+    uint64_t m_bytesWritten = 0;
+    uint64_t m_roundTrips = 0;
+    bool m_wroteSinceRead = false;
+    std::deque<uint32_t> m_replies;
+};
+
+uint64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000ULL + uint64_t(ts.tv_nsec);
+}
+
+struct Options {
+    std::string filter;
+    uint64_t minTimeMs = 200;
+    bool csv = false;
+    bool check = false;
+};
+
+struct Mix {
+    const char* name;
+    CountingStream* stream;
+    // Encoder calls made by one invocation of |body|.
+    uint32_t callsPerIteration;
+    // Round trips one invocation of |body| is allowed to make.
+    uint32_t expectedRoundTrips;
+    std::function<void()> body;
+};
+
+struct Result {
+    uint64_t iterations;
+    double nsPerCall;
+    double bytesPerCall;
+    double roundTripsPerIteration;
+};
+
+Result runMix(const Mix& mix, const Options& options) {
+    CountingStream* stream = mix.stream;
+    // Warm up caches and any lazily grown encoder state.
+    for (int i = 0; i < 100; ++i) mix.body();
+    stream->flush();
+
+    const uint64_t bytesBefore = stream->bytesWritten();
+    const uint64_t roundTripsBefore = stream->roundTrips();
+    const uint64_t minTimeNs = options.minTimeMs * 1000000ULL;
+
+    uint64_t iterations = 0;
+    uint64_t batch = 64;
+    const uint64_t start = nowNs();
+    uint64_t elapsed = 0;
+    while (elapsed < minTimeNs) {
+        for (uint64_t i = 0; i < batch; ++i) mix.body();
+        iterations += batch;
+        elapsed = nowNs() - start;
+        if (batch < (1 << 16)) batch *= 2;
+    }
+    stream->flush();
+    elapsed = nowNs() - start;
+
+    const double calls = double(iterations) * mix.callsPerIteration;
+    Result result;
+    result.iterations = iterations;
+    result.nsPerCall = double(elapsed) / calls;
+    result.bytesPerCall = double(stream->bytesWritten() - bytesBefore) / calls;
+    result.roundTripsPerIteration =
+        double(stream->roundTrips() - roundTripsBefore) / double(iterations);
+    return result;
+}
+
+HostDriverCaps benchmarkCaps() {
+    HostDriverCaps caps = {};
+    caps.max_vertex_attribs = 16;
+    caps.max_combined_texture_image_units = 32;
+    caps.max_color_attachments = 8;
+    caps.max_texture_size = 16384;
+    caps.max_texture_size_cube_map = 16384;
+    caps.max_renderbuffer_size = 16384;
+    caps.max_draw_buffers = 8;
+    caps.ubo_offset_alignment = 256;
+    caps.max_uniform_buffer_bindings = 24;
+    caps.max_transform_feedback_separate_attribs = 4;
+    caps.max_texture_size_3d = 2048;
+    caps.max_array_texture_layers = 2048;
+    caps.max_atomic_counter_buffer_bindings = 1;
+    caps.max_shader_storage_buffer_bindings = 8;
+    caps.max_vertex_attrib_bindings = 16;
+    caps.max_vertex_attrib_stride = 2048;
+    caps.ssbo_offset_alignment = 256;
+    return caps;
+}
+
+// A GLES 3.1 context as egl.cpp would set it up on first makeCurrent.
+struct GLES2Fixture {
+    GLES2Fixture(CountingStream* stream, ChecksumCalculator* checksum)
+        : stream(stream),
+          encoder(stream, checksum),
+          state(3, 1),
+          shared(new GLSharedGroup()) {
+        encoder.setNoHostError(true);
+        encoder.setVersion(3, 1, 3, 1);
+        encoder.setClientState(&state);
+        state.initFromCaps(benchmarkCaps());
+        encoder.setClientStateMakeCurrent(&state, 3, 1, 3, 1);
+        encoder.setSharedGroup(shared);
+        encoder.setInitialized();
+
+        // The encoder caches these after the first query.
+        primeLimit(GL_MAX_TEXTURE_SIZE, 16384);
+        primeLimit(GL_MAX_CUBE_MAP_TEXTURE_SIZE, 16384);
+    }
+
+    // Limit queries are bracketed by host glGetError calls.
+    void primeLimit(GLenum param, GLint value) {
+        stream->queueReply(GL_NO_ERROR);
+        stream->queueReply(value);
+        stream->queueReply(GL_NO_ERROR);
+        GLint result;
+        encoder.glGetIntegerv(&encoder, param, &result);
+    }
+
+    GLuint genBuffer() {
+        GLuint buffer = 0;
+        stream->queueReply(nextName++);
+        encoder.glGenBuffers(&encoder, 1, &buffer);
+        return buffer;
+    }
+
+    GLuint genTexture() {
+        GLuint texture = 0;
+        stream->queueReply(nextName++);
+        encoder.glGenTextures(&encoder, 1, &texture);
+        return texture;
+    }
+
+    // Creates a linked program with the given active uniforms without going
+    // through glLinkProgram, whose host queries the null stream cannot answer
+    // meaningfully.
+    struct Uniform {
+        const char* name;
+        GLint size;
+        GLenum type;
+    };
+    GLuint createProgram(const std::vector<Uniform>& uniforms) {
+        stream->queueReply(nextName++);
+        GLuint program = encoder.glCreateProgram(&encoder);
+        shared->initProgramData(program, uniforms.size(), 0);
+        GLint location = 0;
+        for (size_t i = 0; i < uniforms.size(); ++i) {
+            shared->setProgramIndexInfo(program, i, location, uniforms[i].size,
+                                        uniforms[i].type, uniforms[i].name);
+            location += uniforms[i].size;
+        }
+        shared->setProgramLinkStatus(program, GL_TRUE);
+        return program;
+    }
+
+    CountingStream* stream;
+    GL2Encoder encoder;
+    GLClientState state;
+    GLSharedGroupPtr shared;
+    uint32_t nextName = 1;
+};
+
+struct GLES1Fixture {
+    GLES1Fixture(CountingStream* stream, ChecksumCalculator* checksum)
+        : stream(stream),
+          encoder(stream, checksum),
+          state(1, 0),
+          shared(new GLSharedGroup()) {
+        HostDriverCaps caps = {};
+        caps.max_vertex_attribs = 16;
+        caps.max_combined_texture_image_units = 8;
+        caps.max_color_attachments = 8;
+        caps.max_texture_size = 4096;
+        caps.max_texture_size_cube_map = 2048;
+        caps.max_renderbuffer_size = 4096;
+        state.initFromCaps(caps);
+        encoder.setClientState(&state);
+        encoder.setSharedGroup(shared);
+        encoder.setInitialized();
+
+        // Names for the buffers the encoder allocates to cache client-array
+        // uploads.
+        for (uint32_t name = 1; name <= 4; ++name) stream->queueReply(name);
+    }
+
+    CountingStream* stream;
+    GLEncoder encoder;
+    GLClientState state;
+    GLSharedGroupPtr shared;
+};
+
+std::vector<Mix> makeGLES2Mixes(GLES2Fixture* f) {
+    std::vector<Mix> mixes;
+    GL2Encoder* gl = &f->encoder;
+
+    // Per-object constants for a typical forward-shaded draw.
+    GLuint uniformProgram = f->createProgram({
+        {"u_mvp", 1, GL_FLOAT_MAT4},
+        {"u_bones[0]", 16, GL_FLOAT_VEC4},
+        {"u_tint", 1, GL_FLOAT_VEC4},
+        {"u_time", 1, GL_FLOAT},
+        {"u_texture", 1, GL_SAMPLER_2D},
+    });
+    static const GLfloat kMatrix[16] = {
+        1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1,
+    };
+    static GLfloat bones[16 * 4];
+    mixes.push_back({"gles2/uniform-heavy", f->stream, 5, 0, [gl, uniformProgram] {
+        gl->glUseProgram(gl, uniformProgram);
+        gl->glUniformMatrix4fv(gl, 0, 1, GL_FALSE, kMatrix);
+        gl->glUniform4fv(gl, 1, 16, bones);
+        gl->glUniform4f(gl, 17, 1.0f, 0.5f, 0.25f, 1.0f);
+        gl->glUniform1f(gl, 18, 0.5f);
+    }});
+    // Same program, but the per-frame values change every iteration so none
+    // of the updates can be skipped as redundant.
+    mixes.push_back({"gles2/uniform-animated", f->stream, 4, 0, [gl, uniformProgram] {
+        static GLfloat time = 0.0f;
+        static GLfloat matrix[16] = {
+            1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1,
+        };
+        time += 1.0f;
+        matrix[12] = time;
+        gl->glUseProgram(gl, uniformProgram);
+        gl->glUniformMatrix4fv(gl, 0, 1, GL_FALSE, matrix);
+        gl->glUniform4f(gl, 17, 1.0f, 0.5f, 0.25f, 1.0f);
+        gl->glUniform1f(gl, 18, time);
+    }});
+
+    // Many small draws from a VBO, rebinding state in between.
+    GLuint vbo = f->genBuffer();
+    GLuint ibo = f->genBuffer();
+    std::vector<GLfloat> vertices(1024 * 8, 0.5f);
+    std::vector<GLushort> indices(3072);
+    for (size_t i = 0; i < indices.size(); ++i) indices[i] = (GLushort)(i % 1024);
+    gl->glBindBuffer(gl, GL_ARRAY_BUFFER, vbo);
+    gl->glBufferData(gl, GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat),
+                     vertices.data(), GL_STATIC_DRAW);
+    gl->glBindBuffer(gl, GL_ELEMENT_ARRAY_BUFFER, ibo);
+    gl->glBufferData(gl, GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort),
+                     indices.data(), GL_STATIC_DRAW);
+    mixes.push_back({"gles2/draw-heavy", f->stream, 8, 0, [gl, vbo, ibo, uniformProgram] {
+        gl->glUseProgram(gl, uniformProgram);
+        gl->glBindBuffer(gl, GL_ARRAY_BUFFER, vbo);
+        gl->glEnableVertexAttribArray(gl, 0);
+        gl->glVertexAttribPointer(gl, 0, 3, GL_FLOAT, GL_FALSE, 32, (void*)0);
+        gl->glEnableVertexAttribArray(gl, 1);
+        gl->glVertexAttribPointer(gl, 1, 2, GL_FLOAT, GL_FALSE, 32, (void*)12);
+        gl->glDrawArrays(gl, GL_TRIANGLES, 0, 96);
+        gl->glBindBuffer(gl, GL_ELEMENT_ARRAY_BUFFER, ibo);
+    }});
+    mixes.push_back({"gles2/draw-elements-vbo", f->stream, 1, 0, [gl] {
+        gl->glDrawElements(gl, GL_TRIANGLES, 96, GL_UNSIGNED_SHORT, (void*)0);
+    }});
+
+    // Debug-style error checking after every draw, with host errors enabled:
+    // with no guest error pending, every glGetError asks the host.
+    mixes.push_back({"gles2/get-error-checked", f->stream, 16, 8, [gl] {
+        gl->setNoHostError(false);
+        for (int i = 0; i < 8; ++i) {
+            gl->glDrawArrays(gl, GL_TRIANGLES, 0, 96);
+            gl->glGetError(gl);
+        }
+        gl->setNoHostError(true);
+    }});
+
+    // Streaming texture uploads: a 64x64 RGBA tile per call.
+    GLuint texture = f->genTexture();
+    gl->glBindTexture(gl, GL_TEXTURE_2D, texture);
+    gl->glTexImage2D(gl, GL_TEXTURE_2D, 0, GL_RGBA, 256, 256, 0, GL_RGBA,
+                     GL_UNSIGNED_BYTE, nullptr);
+    static std::vector<unsigned char> tile(64 * 64 * 4, 0x7f);
+    mixes.push_back({"gles2/texture-upload", f->stream, 2, 0, [gl, texture] {
+        gl->glBindTexture(gl, GL_TEXTURE_2D, texture);
+        gl->glTexSubImage2D(gl, GL_TEXTURE_2D, 0, 64, 64, 64, 64, GL_RGBA,
+                            GL_UNSIGNED_BYTE, tile.data());
+    }});
+
+    // Client-side vertex and index arrays: the encoder has to scan the
+    // indices for their range and ship the referenced vertices.
+    static std::vector<GLfloat> clientVertices(256 * 4, 0.25f);
+    static std::vector<GLushort> clientIndices(384);
+    for (size_t i = 0; i < clientIndices.size(); ++i) {
+        clientIndices[i] = (GLushort)((i * 7) % 256);
+    }
+    mixes.push_back({"gles2/draw-elements-client-indices", f->stream, 4, 0, [gl] {
+        gl->glBindBuffer(gl, GL_ARRAY_BUFFER, 0);
+        gl->glBindBuffer(gl, GL_ELEMENT_ARRAY_BUFFER, 0);
+        gl->glVertexAttribPointer(gl, 0, 4, GL_FLOAT, GL_FALSE, 0, clientVertices.data());
+        gl->glDrawElements(gl, GL_TRIANGLES, clientIndices.size(), GL_UNSIGNED_SHORT,
+                           clientIndices.data());
+    }});
+    return mixes;
+}
+
+std::vector<Mix> makeGLES1Mixes(GLES1Fixture* f) {
+    std::vector<Mix> mixes;
+    GLEncoder* gl = &f->encoder;
+
+    static std::vector<GLfloat> positions(256 * 3, 0.5f);
+    static std::vector<GLfloat> texcoords(256 * 2, 0.25f);
+    static std::vector<GLubyte> colors(256 * 4, 0xff);
+    static std::vector<GLushort> indices(384);
+    for (size_t i = 0; i < indices.size(); ++i) indices[i] = (GLushort)((i * 5) % 256);
+
+    gl->glEnable(gl, GL_TEXTURE_2D);
+    gl->glEnableClientState(gl, GL_VERTEX_ARRAY);
+    gl->glEnableClientState(gl, GL_TEXTURE_COORD_ARRAY);
+    gl->glEnableClientState(gl, GL_COLOR_ARRAY);
+    mixes.push_back({"gles1/draw-arrays-client", f->stream, 4, 0, [gl] {
+        gl->glVertexPointer(gl, 3, GL_FLOAT, 0, positions.data());
+        gl->glTexCoordPointer(gl, 2, GL_FLOAT, 0, texcoords.data());
+        gl->glColorPointer(gl, 4, GL_UNSIGNED_BYTE, 0, colors.data());
+        gl->glDrawArrays(gl, GL_TRIANGLES, 0, 255);
+    }});
+    mixes.push_back({"gles1/draw-elements-client-indices", f->stream, 1, 0, [gl] {
+        gl->glDrawElements(gl, GL_TRIANGLES, indices.size(), GL_UNSIGNED_SHORT,
+                           indices.data());
+    }});
+    return mixes;
+}
+
+std::vector<Mix> makeRenderControlMixes(CountingStream* stream, ExtendedRCEncoderContext* rc) {
+    std::vector<Mix> mixes;
+
+    // What the guest sends per frame when posting through the composer.
+    static std::vector<unsigned char> composeInfo(512, 0);
+    mixes.push_back({"rc/frame-post", stream, 4, 0, [rc] {
+        rc->rcMakeCurrentAsync(rc, 1, 2, 2);
+        rc->rcSetWindowColorBuffer(rc, 2, 3);
+        rc->rcComposeAsync(rc, composeInfo.size(), composeInfo.data());
+        rc->rcFlushWindowColorBufferAsyncWithFrameNumber(rc, 2, 1);
+    }});
+
+    // Fence creation is a round trip by design.
+    static EGLint attribs[] = {EGL_NONE, EGL_NONE};
+    mixes.push_back({"rc/create-sync", stream, 2, 1, [rc] {
+        uint64_t sync = 0, syncThread = 0;
+        rc->rcCreateSyncKHR(rc, 0x3144 /* EGL_SYNC_NATIVE_FENCE_ANDROID */, attribs,
+                            sizeof(attribs), 1, &sync, &syncThread);
+        rc->rcDestroySyncKHRAsync(rc, sync);
+    }});
+    return mixes;
+}
+
+struct NameLookupBenchmark {
+    std::string name;
+    uint32_t names;
+    // Looks up every name in |keys|, returning a checksum.
+    std::function<uint64_t(const std::vector<uint32_t>& keys)> lookup;
+};
+
+// Stands in for BufferData and friends: a few fields read per lookup.
+struct NameInfo {
+    uint32_t size;
+    uint32_t usage;
+    uint64_t padding[4];
+};
+
+template <class Table>
+uint64_t lookUpNames(Table* table, const std::vector<uint32_t>& keys) {
+    uint64_t sum = 0;
+    for (uint32_t key : keys) {
+        auto it = table->find(key);
+        if (it != table->end()) sum += it->second.size;
+    }
+    return sum;
+}
+
+std::vector<NameLookupBenchmark> makeNameLookupBenchmarks() {
+    using NameSlotTable = android::base::SlotTable<uint32_t, NameInfo>;
+
+    std::vector<NameLookupBenchmark> benchmarks;
+    for (uint32_t names : {64u, 4096u}) {
+        // GL names are handed out from 1 upwards.
+        auto slotTable = std::make_shared<NameSlotTable>();
+        auto map = std::make_shared<std::map<uint32_t, NameInfo>>();
+        auto hashMap = std::make_shared<std::unordered_map<uint32_t, NameInfo>>();
+        for (uint32_t name = 1; name <= names; ++name) {
+            NameInfo info = {name, 0, {}};
+            slotTable->emplace(name, info);
+            (*map)[name] = info;
+            (*hashMap)[name] = info;
+        }
+
+        const std::string suffix = "/" + std::to_string(names);
+        benchmarks.push_back({"names/slot_table" + suffix, names,
+                              [slotTable](const std::vector<uint32_t>& keys) {
+                                  uint64_t sum = 0;
+                                  for (uint32_t key : keys) {
+                                      if (const NameInfo* info = slotTable->get(key)) {
+                                          sum += info->size;
+                                      }
+                                  }
+                                  return sum;
+                              }});
+        benchmarks.push_back({"names/map" + suffix, names,
+                              [map](const std::vector<uint32_t>& keys) {
+                                  return lookUpNames(map.get(), keys);
+                              }});
+        benchmarks.push_back({"names/unordered_map" + suffix, names,
+                              [hashMap](const std::vector<uint32_t>& keys) {
+                                  return lookUpNames(hashMap.get(), keys);
+                              }});
+    }
+    return benchmarks;
+}
+
+// Returns ns per lookup.
+double runNameLookupBenchmark(const NameLookupBenchmark& benchmark, const Options& options,
+                              uint64_t* lookups) {
+    std::mt19937 rng(1);
+    std::vector<uint32_t> keys(4096);
+    for (auto& key : keys) key = 1 + rng() % benchmark.names;
+
+    uint64_t sink = benchmark.lookup(keys);
+    const uint64_t minTimeNs = options.minTimeMs * 1000000ULL;
+    const uint64_t start = nowNs();
+    uint64_t elapsed = 0;
+    *lookups = 0;
+    while (elapsed < minTimeNs) {
+        sink += benchmark.lookup(keys);
+        *lookups += keys.size();
+        elapsed = nowNs() - start;
+    }
+    // Keeps the lookups from being optimized away.
+    if (sink == 42) printf(" ");
+    return (double)elapsed / (double)*lookups;
+}
+
+bool parseOptions(int argc, char** argv, Options* options) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (!strncmp(arg, "--filter=", 9)) {
+            options->filter = arg + 9;
+        } else if (!strncmp(arg, "--min-time-ms=", 14)) {
+            options->minTimeMs = strtoull(arg + 14, nullptr, 10);
+        } else if (!strcmp(arg, "--csv")) {
+            options->csv = true;
+        } else if (!strcmp(arg, "--check")) {
+            options->check = true;
+        } else {
+            fprintf(stderr,
+                    "usage: %s [--filter=<substring>] [--min-time-ms=<ms>] "
+                    "[--csv] [--check]\n", argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, &options)) return 2;
+
+    // Each encoder gets its own stream so queued replies cannot be consumed
+    // by another encoder's mix. Streams are refcounted and outlive main().
+    ChecksumCalculator checksum;
+    GLES2Fixture gles2(new CountingStream(), &checksum);
+    GLES1Fixture gles1(new CountingStream(), &checksum);
+    CountingStream* rcStream = new CountingStream();
+    ExtendedRCEncoderContext rc(rcStream, &checksum);
+
+    std::vector<Mix> mixes = makeGLES2Mixes(&gles2);
+    for (auto& mix : makeGLES1Mixes(&gles1)) mixes.push_back(mix);
+    for (auto& mix : makeRenderControlMixes(rcStream, &rc)) mixes.push_back(mix);
+
+    if (options.csv) {
+        printf("mix,iterations,ns_per_call,bytes_per_call,round_trips_per_iteration\n");
+    } else {
+        printf("%-36s %12s %10s %12s %12s\n", "mix", "iterations", "ns/call",
+               "bytes/call", "rtt/iter");
+    }
+
+    int failures = 0;
+    for (const Mix& mix : mixes) {
+        if (!options.filter.empty() &&
+            std::string(mix.name).find(options.filter) == std::string::npos) {
+            continue;
+        }
+        Result result = runMix(mix, options);
+        if (options.csv) {
+            printf("%s,%llu,%.2f,%.2f,%.3f\n", mix.name,
+                   (unsigned long long)result.iterations, result.nsPerCall,
+                   result.bytesPerCall, result.roundTripsPerIteration);
+        } else {
+            printf("%-36s %12llu %10.2f %12.2f %12.3f\n", mix.name,
+                   (unsigned long long)result.iterations, result.nsPerCall,
+                   result.bytesPerCall, result.roundTripsPerIteration);
+        }
+        if (options.check && result.roundTripsPerIteration > mix.expectedRoundTrips) {
+            fprintf(stderr, "%s: %.3f host round trips per iteration, expected at most %u\n",
+                    mix.name, result.roundTripsPerIteration, mix.expectedRoundTrips);
+            ++failures;
+        }
+    }
+
+    bool printedNamesHeader = false;
+    for (const NameLookupBenchmark& benchmark : makeNameLookupBenchmarks()) {
+        if (!options.filter.empty() && benchmark.name.find(options.filter) == std::string::npos) {
+            continue;
+        }
+        if (!printedNamesHeader) {
+            if (options.csv) {
+                printf("\nnames,lookups,ns_per_lookup\n");
+            } else {
+                printf("\n%-36s %12s %10s\n", "names", "lookups", "ns/lookup");
+            }
+            printedNamesHeader = true;
+        }
+        uint64_t lookups;
+        double nsPerLookup = runNameLookupBenchmark(benchmark, options, &lookups);
+        if (options.csv) {
+            printf("%s,%llu,%.2f\n", benchmark.name.c_str(), (unsigned long long)lookups,
+                   nsPerLookup);
+        } else {
+            printf("%-36s %12llu %10.2f\n", benchmark.name.c_str(),
+                   (unsigned long long)lookups, nsPerLookup);
+        }
+    }
+
+    return failures ? 1 : 0;
+}
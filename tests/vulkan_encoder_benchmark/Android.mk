@@ -0,0 +1,22 @@
+LOCAL_PATH := $(call my-dir)
+
+### Vulkan encoder microbenchmarks ###############################
+$(call emugl-begin-executable,vulkan_encoder_benchmark)
+$(call emugl-import,libOpenglSystemCommon libvulkan_enc)
+
+LOCAL_C_INCLUDES += \
+    $(HOST_EMUGL_PATH)/host/include \
+    $(HOST_EMUGL_PATH)/host/include/vulkan \
+
+LOCAL_SRC_FILES := \
+    VulkanEncoderBenchmark.cpp \
+
+LOCAL_CFLAGS += \
+    -DLOG_TAG=\"vulkan_encoder_benchmark\" \
+    -DVK_ANDROID_native_buffer \
+    -DVK_EXT_device_memory_report \
+    -DVK_GOOGLE_gfxstream \
+    -DVK_USE_PLATFORM_ANDROID_KHR \
+    -DVK_NO_PROTOTYPES \
+
+$(call emugl-end-module)
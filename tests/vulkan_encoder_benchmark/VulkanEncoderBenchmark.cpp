@@ -0,0 +1,1017 @@
+// Copyright (C) 2022 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Microbenchmarks for the guest-side Vulkan encoder.
+//
+// VkEncoder runs against a stream that discards everything written to it and
+// answers host readbacks with zeros, so the numbers measure guest-side
+// encoding only: deepcopy, transform, handle unwrapping and marshaling.
+// Handles are guest wrappers around made-up host handles.
+//
+// Usage: vulkan_encoder_benchmark [--filter=<substring>] [--min-time-ms=<ms>]
+//                                 [--csv] [--phases]
+//
+// --phases also splits the time of each mix into waiting for the encoder
+// lock, time in the stream (packet buffer allocation, flushes and readbacks)
+// and encode, which is everything else: counting, deepcopy, transform,
+// handle unwrapping and marshaling in the generated encoder. The split comes
+// from timers inside VkEncoder and VulkanStreamGuest, which vulkan_enc only
+// compiles in with VK_ENCODER_PHASE_TIMERS; its host build sets that and
+// leaves the timers off until --phases turns them on.
+//
+// The handles/<type>/<threads>t rows create and destroy guest handles from
+// several threads through ResourceTracker's create and destroy mappings, as
+// VkEncoder does for vkCreate* and vkDestroy*. VkBuffer's table is still
+// guarded by ResourceTracker's global lock; VkSampler's and VkImageView's are
+// ShardedMaps. android_emu_benchmark's tables/ rows compare the two table
+// layouts on their own.
+//
+// The suballoc/<trace>/<allocator> rows replay allocation traces shaped like
+// host-visible Vulkan memory use against SubAllocator (TLSF) and the
+// address_space.h best-fit allocator it replaced, reporting time per
+// alloc/free, allocations that found no space, and fragmentation of the free
+// space once the trace reaches steady state.
+
+#include "IOStream.h"
+#include "ResourceTracker.h"
+#include "Resources.h"
+#include "VkEncoder.h"
+#include "VulkanHandleMapping.h"
+
+#include "android/base/AndroidSubAllocator.h"
+#include "android/base/address_space.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+using goldfish_vk::ResourceTracker;
+using goldfish_vk::VkEncoder;
+using goldfish_vk::VulkanHandleMapping;
+
+namespace {
+
+// Discards all commands, counting bytes. Readbacks are filled with zeros.
+class CountingStream : public IOStream {
+public:
+    static constexpr size_t kBufferSize = 1 << 20;
+
+    CountingStream() : IOStream(kBufferSize), m_buf(kBufferSize) {}
+
+    void* allocBuffer(size_t minSize) override {
+        if (m_buf.size() < minSize) m_buf.resize(minSize);
+        return m_buf.data();
+    }
+
+    int commitBuffer(size_t size) override {
+        m_bytesWritten += size;
+        return (int)size;
+    }
+
+    const unsigned char* readFully(void* buf, size_t len) override {
+        if (buf) memset(buf, 0, len);
+        return (const unsigned char*)buf;
+    }
+
+    const unsigned char* commitBufferAndReadFully(size_t size, void* buf, size_t len) override {
+        commitBuffer(size);
+        return readFully(buf, len);
+    }
+
+    const unsigned char* read(void* buf, size_t* inout_len) override {
+        return readFully(buf, *inout_len);
+    }
+
+    int writeFully(const void* buf, size_t len) override {
+        m_bytesWritten += len;
+        return 0;
+    }
+
+    uint64_t bytesWritten() const { return m_bytesWritten; }
+
+private:
+    std::vector<unsigned char> m_buf;
+    uint64_t m_bytesWritten = 0;
+};
+
+uint64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000ULL + uint64_t(ts.tv_nsec);
+}
+
+uint64_t processCpuNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000ULL + uint64_t(ts.tv_nsec);
+}
+
+struct Options {
+    std::string filter;
+    uint64_t minTimeMs = 200;
+    bool csv = false;
+    bool phases = false;
+};
+
+// |body| makes one encoder call, or a fixed sequence of |commands| calls.
+struct Mix {
+    const char* name;
+    std::function<void(VkEncoder*)> body;
+    uint32_t commands;
+};
+
+struct Result {
+    uint64_t iterations;
+    double nsPerCall;
+    double bytesPerCall;
+};
+
+// Calls |body| in doubling batches until |minTimeMs| have passed, then
+// |finish| once. |elapsedNs| covers both.
+uint64_t timeLoop(const std::function<void()>& body, const std::function<void()>& finish,
+                  uint64_t minTimeMs, uint64_t* elapsedNs) {
+    const uint64_t minTimeNs = minTimeMs * 1000000ULL;
+
+    uint64_t iterations = 0;
+    uint64_t batch = 64;
+    const uint64_t start = nowNs();
+    uint64_t elapsed = 0;
+    while (elapsed < minTimeNs) {
+        for (uint64_t i = 0; i < batch; ++i) body();
+        iterations += batch;
+        elapsed = nowNs() - start;
+        if (batch < (1 << 16)) batch *= 2;
+    }
+    finish();
+    *elapsedNs = nowNs() - start;
+    return iterations;
+}
+
+Result runMix(const Mix& mix, VkEncoder* encoder, CountingStream* stream,
+              const Options& options) {
+    // Warm up caches, the encoder's pools and the packet buffer.
+    for (int i = 0; i < 100; ++i) mix.body(encoder);
+    stream->flush();
+
+    const uint64_t bytesBefore = stream->bytesWritten();
+    uint64_t elapsed;
+    uint64_t iterations = timeLoop([&mix, encoder] { mix.body(encoder); },
+                                   [stream] { stream->flush(); }, options.minTimeMs, &elapsed);
+
+    Result result;
+    result.iterations = iterations;
+    result.nsPerCall = double(elapsed) / double(iterations);
+    result.bytesPerCall = double(stream->bytesWritten() - bytesBefore) / double(iterations);
+    return result;
+}
+
+// ns per call of a mix with the encoder's phase timers on.
+struct PhaseResult {
+    double total;
+    double lock;
+    double stream;
+};
+
+PhaseResult runPhases(const Mix& mix, VkEncoder* encoder, CountingStream* stream,
+                      const Options& options) {
+    for (int i = 0; i < 100; ++i) mix.body(encoder);
+    stream->flush();
+
+    encoder->resetPhaseTimes();
+    uint64_t elapsed;
+    uint64_t iterations = timeLoop([&mix, encoder] { mix.body(encoder); },
+                                   [stream] { stream->flush(); }, options.minTimeMs, &elapsed);
+    const VkEncoder::PhaseTimes times = encoder->getPhaseTimes();
+
+    PhaseResult result;
+    result.total = double(elapsed) / double(iterations);
+    result.lock = double(times.lockNs) / double(iterations);
+    result.stream = double(times.streamNs) / double(iterations);
+    return result;
+}
+
+// Guest handles and create infos shaped like a typical game's: a vertex and
+// fragment shader with specialization constants, two vertex bindings, two
+// color attachments, and descriptor sets holding a few uniform buffers and
+// many combined image samplers. A bindless-style texture array stands in for
+// engines that write large descriptor arrays at once. A frame is one render
+// pass of draws that each rebind a descriptor set and push constants.
+struct Fixture {
+    Fixture() {
+        device = new_from_host_VkDevice((VkDevice)0x1000);
+        commandBuffer = new_from_host_VkCommandBuffer((VkCommandBuffer)0x1800);
+        pipelineCache = new_from_host_u64_VkPipelineCache(0x2000);
+        pipelineLayout = new_from_host_u64_VkPipelineLayout(0x3000);
+        renderPass = new_from_host_u64_VkRenderPass(0x4000);
+        for (uint32_t i = 0; i < kShaderCount; ++i) {
+            shaders[i] = new_from_host_u64_VkShaderModule(0x5000 + i);
+        }
+        for (uint32_t i = 0; i < kSetCount; ++i) {
+            sets[i] = new_from_host_u64_VkDescriptorSet(0x6000 + i);
+        }
+        for (uint32_t i = 0; i < kImageCount; ++i) {
+            imageInfos[i].sampler = new_from_host_u64_VkSampler(0x7000 + i);
+            imageInfos[i].imageView = new_from_host_u64_VkImageView(0x8000 + i);
+            imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        }
+        for (uint32_t i = 0; i < kTextureArraySize; ++i) {
+            textureArrayInfos[i].sampler = imageInfos[0].sampler;
+            textureArrayInfos[i].imageView = new_from_host_u64_VkImageView(0xa000 + i);
+            textureArrayInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        }
+        stagingBuffer = new_from_host_u64_VkBuffer(0xb000);
+        uploadImage = new_from_host_u64_VkImage(0xc000);
+        framebuffer = new_from_host_u64_VkFramebuffer(0xd000);
+        for (uint32_t i = 0; i < kFramePipelineCount; ++i) {
+            framePipelines[i] = new_from_host_u64_VkPipeline(0xe000 + i);
+        }
+        for (uint32_t i = 0; i < kBufferCount; ++i) {
+            bufferInfos[i].buffer = new_from_host_u64_VkBuffer(0x9000 + i);
+            bufferInfos[i].offset = 256 * i;
+            bufferInfos[i].range = 256;
+        }
+        initPipeline();
+        initDescriptorWrites();
+        initUpload();
+        initFrame();
+    }
+
+    void initPipeline() {
+        for (uint32_t i = 0; i < 4; ++i) {
+            specializationEntries[i] = {i, i * 4, 4};
+            specializationData[i] = i;
+        }
+        specialization = {4, specializationEntries, sizeof(specializationData),
+                          specializationData};
+        for (uint32_t i = 0; i < kShaderCount; ++i) {
+            stages[i] = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+            stages[i].stage = i ? VK_SHADER_STAGE_FRAGMENT_BIT : VK_SHADER_STAGE_VERTEX_BIT;
+            stages[i].module = shaders[i];
+            stages[i].pName = "main";
+            stages[i].pSpecializationInfo = &specialization;
+        }
+
+        vertexBindings[0] = {0, 32, VK_VERTEX_INPUT_RATE_VERTEX};
+        vertexBindings[1] = {1, 16, VK_VERTEX_INPUT_RATE_INSTANCE};
+        vertexAttributes[0] = {0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0};
+        vertexAttributes[1] = {1, 0, VK_FORMAT_R32G32B32_SFLOAT, 12};
+        vertexAttributes[2] = {2, 0, VK_FORMAT_R32G32_SFLOAT, 24};
+        vertexAttributes[3] = {3, 1, VK_FORMAT_R32G32B32A32_SFLOAT, 0};
+        vertexInput = {VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
+        vertexInput.vertexBindingDescriptionCount = 2;
+        vertexInput.pVertexBindingDescriptions = vertexBindings;
+        vertexInput.vertexAttributeDescriptionCount = 4;
+        vertexInput.pVertexAttributeDescriptions = vertexAttributes;
+
+        inputAssembly = {VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO};
+        inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+        viewport = {VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO};
+        viewport.viewportCount = 1;
+        viewport.scissorCount = 1;
+
+        rasterization = {VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO};
+        rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+        rasterization.cullMode = VK_CULL_MODE_BACK_BIT;
+        rasterization.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+        rasterization.lineWidth = 1.0f;
+
+        multisample = {VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO};
+        multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+        depthStencil = {VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO};
+        depthStencil.depthTestEnable = VK_TRUE;
+        depthStencil.depthWriteEnable = VK_TRUE;
+        depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+        for (auto& attachment : blendAttachments) {
+            attachment = {};
+            attachment.blendEnable = VK_TRUE;
+            attachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+            attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+            attachment.colorBlendOp = VK_BLEND_OP_ADD;
+            attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+            attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+            attachment.alphaBlendOp = VK_BLEND_OP_ADD;
+            attachment.colorWriteMask = 0xf;
+        }
+        colorBlend = {VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO};
+        colorBlend.attachmentCount = 2;
+        colorBlend.pAttachments = blendAttachments;
+
+        dynamicStates[0] = VK_DYNAMIC_STATE_VIEWPORT;
+        dynamicStates[1] = VK_DYNAMIC_STATE_SCISSOR;
+        dynamicState = {VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO};
+        dynamicState.dynamicStateCount = 2;
+        dynamicState.pDynamicStates = dynamicStates;
+
+        pipelineInfo = {VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
+        pipelineInfo.stageCount = kShaderCount;
+        pipelineInfo.pStages = stages;
+        pipelineInfo.pVertexInputState = &vertexInput;
+        pipelineInfo.pInputAssemblyState = &inputAssembly;
+        pipelineInfo.pViewportState = &viewport;
+        pipelineInfo.pRasterizationState = &rasterization;
+        pipelineInfo.pMultisampleState = &multisample;
+        pipelineInfo.pDepthStencilState = &depthStencil;
+        pipelineInfo.pColorBlendState = &colorBlend;
+        pipelineInfo.pDynamicState = &dynamicState;
+        pipelineInfo.layout = pipelineLayout;
+        pipelineInfo.renderPass = renderPass;
+        pipelineInfo.basePipelineIndex = -1;
+
+        for (auto& info : pipelineBatch) info = pipelineInfo;
+    }
+
+    // Per set: two uniform buffers, then eight samplers in two writes.
+    void initDescriptorWrites() {
+        uint32_t count = 0;
+        for (uint32_t set = 0; set < kSetCount; ++set) {
+            VkWriteDescriptorSet write = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+            write.dstSet = sets[set];
+            write.dstBinding = 0;
+            write.descriptorCount = 2;
+            write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            write.pBufferInfo = &bufferInfos[2 * set];
+            writes[count++] = write;
+            for (uint32_t half = 0; half < 2; ++half) {
+                write = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+                write.dstSet = sets[set];
+                write.dstBinding = 1;
+                write.dstArrayElement = 4 * half;
+                write.descriptorCount = 4;
+                write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                write.pImageInfo = &imageInfos[4 * half];
+                writes[count++] = write;
+            }
+        }
+
+        textureArrayWrite = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        textureArrayWrite.dstSet = sets[0];
+        textureArrayWrite.dstBinding = 2;
+        textureArrayWrite.descriptorCount = kTextureArraySize;
+        textureArrayWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        textureArrayWrite.pImageInfo = textureArrayInfos;
+    }
+
+    // A texture upload with its mip chain: transition, copy, transition.
+    void initUpload() {
+        for (uint32_t i = 0; i < 2; ++i) {
+            uploadBarriers[i] = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+            uploadBarriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            uploadBarriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            uploadBarriers[i].image = uploadImage;
+            uploadBarriers[i].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, kMipCount, 0, 1};
+        }
+        uploadBarriers[0].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        uploadBarriers[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        uploadBarriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        uploadBarriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        uploadBarriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        uploadBarriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        uploadBarriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        VkDeviceSize offset = 0;
+        for (uint32_t mip = 0; mip < kMipCount; ++mip) {
+            uint32_t size = 1024 >> mip;
+            uploadRegions[mip] = {};
+            uploadRegions[mip].bufferOffset = offset;
+            uploadRegions[mip].imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip, 0, 1};
+            uploadRegions[mip].imageExtent = {size, size, 1};
+            offset += VkDeviceSize(size) * size * 4;
+        }
+    }
+
+    void initFrame() {
+        clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+        clearValues[1].color = {{0.0f, 0.0f, 0.0f, 0.0f}};
+        clearValues[2].depthStencil = {1.0f, 0};
+        renderPassBegin = {VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
+        renderPassBegin.renderPass = renderPass;
+        renderPassBegin.framebuffer = framebuffer;
+        renderPassBegin.renderArea = {{0, 0}, {1920, 1080}};
+        renderPassBegin.clearValueCount = 3;
+        renderPassBegin.pClearValues = clearValues;
+        frameViewport = {0.0f, 0.0f, 1920.0f, 1080.0f, 0.0f, 1.0f};
+        frameScissor = {{0, 0}, {1920, 1080}};
+        for (uint32_t i = 0; i < 16; ++i) pushConstantData[i] = float(i);
+    }
+
+    void recordUpload(VkEncoder* encoder) {
+        encoder->vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                      VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                                      nullptr, 1, &uploadBarriers[0], 1 /* do lock */);
+        encoder->vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, uploadImage,
+                                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, kMipCount,
+                                        uploadRegions, 1 /* do lock */);
+        encoder->vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                      VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0,
+                                      nullptr, 1, &uploadBarriers[1], 1 /* do lock */);
+    }
+
+
+    // Descriptor updates, then a render pass with kFrameDraws draws. Each
+    // draw rebinds the per-draw set at a new dynamic offset and pushes a
+    // matrix; the pipeline changes every kDrawsPerPipeline draws.
+    void recordFrame(VkEncoder* encoder) {
+        updateDescriptorSets(encoder);
+        encoder->vkCmdBeginRenderPass(commandBuffer, &renderPassBegin,
+                                      VK_SUBPASS_CONTENTS_INLINE, 1 /* do lock */);
+        encoder->vkCmdSetViewport(commandBuffer, 0, 1, &frameViewport, 1 /* do lock */);
+        encoder->vkCmdSetScissor(commandBuffer, 0, 1, &frameScissor, 1 /* do lock */);
+        for (uint32_t draw = 0; draw < kFrameDraws; ++draw) {
+            if (draw % kDrawsPerPipeline == 0) {
+                VkPipeline pipeline =
+                    framePipelines[(draw / kDrawsPerPipeline) % kFramePipelineCount];
+                encoder->vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                           pipeline, 1 /* do lock */);
+            }
+            uint32_t dynamicOffset = (draw % 64) * 256;
+            encoder->vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                             pipelineLayout, 1, 1, &sets[1], 1,
+                                             &dynamicOffset, 1 /* do lock */);
+            encoder->vkCmdPushConstants(commandBuffer, pipelineLayout,
+                                        VK_SHADER_STAGE_VERTEX_BIT, 0,
+                                        sizeof(pushConstantData), pushConstantData,
+                                        1 /* do lock */);
+            encoder->vkCmdDraw(commandBuffer, 36, 1, 0, 0, 1 /* do lock */);
+        }
+        encoder->vkCmdEndRenderPass(commandBuffer, 1 /* do lock */);
+    }
+
+
+    // Pipelines are returned by the null host as handle 0; unwrap and free
+    // the guest wrappers the encoder made for them.
+    void createGraphicsPipeline(VkEncoder* encoder) {
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        encoder->vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr,
+                                           &pipeline, 1 /* do lock */);
+        if (pipeline) {
+            ResourceTracker::get()->unregister_VkPipeline(pipeline);
+            delete_goldfish_VkPipeline(pipeline);
+        }
+    }
+
+
+    // A pipeline warmup batch: its deep copies are well past the encoder
+    // pool's first chunk.
+    void createGraphicsPipelineBatch(VkEncoder* encoder) {
+        VkPipeline pipelines[kPipelineBatchSize] = {};
+        encoder->vkCreateGraphicsPipelines(device, pipelineCache, kPipelineBatchSize,
+                                           pipelineBatch, nullptr, pipelines,
+                                           1 /* do lock */);
+        for (VkPipeline pipeline : pipelines) {
+            if (!pipeline) continue;
+            ResourceTracker::get()->unregister_VkPipeline(pipeline);
+            delete_goldfish_VkPipeline(pipeline);
+        }
+    }
+
+
+    void updateDescriptorSets(VkEncoder* encoder) {
+        encoder->vkUpdateDescriptorSets(device, kWriteCount, writes, 0, nullptr,
+                                        1 /* do lock */);
+    }
+
+
+    void updateTextureArray(VkEncoder* encoder) {
+        encoder->vkUpdateDescriptorSets(device, 1, &textureArrayWrite, 0, nullptr,
+                                        1 /* do lock */);
+    }
+
+
+    // What a draw loop does between draws: rebind all sets with dynamic
+    // offsets.
+    void bindDescriptorSets(VkEncoder* encoder) {
+        encoder->vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                         pipelineLayout, 0, kSetCount, sets,
+                                         kSetCount, dynamicOffsets, 1 /* do lock */);
+    }
+
+
+    static constexpr uint32_t kShaderCount = 2;
+    static constexpr uint32_t kSetCount = 4;
+    static constexpr uint32_t kImageCount = 8;
+    static constexpr uint32_t kBufferCount = 2 * kSetCount;
+    static constexpr uint32_t kWriteCount = 3 * kSetCount;
+    static constexpr uint32_t kTextureArraySize = 256;
+    static constexpr uint32_t kMipCount = 11;
+    static constexpr uint32_t kPipelineBatchSize = 32;
+    static constexpr uint32_t kFrameDraws = 2000;
+    static constexpr uint32_t kDrawsPerPipeline = 100;
+    static constexpr uint32_t kFramePipelineCount = 4;
+    // Descriptor updates, begin, viewport, scissor, pipeline binds, three
+    // commands per draw, end.
+    static constexpr uint32_t kFrameCommands =
+        1 + 3 + kFrameDraws / kDrawsPerPipeline + 3 * kFrameDraws + 1;
+
+    VkDevice device;
+    VkCommandBuffer commandBuffer;
+    VkPipelineCache pipelineCache;
+    VkPipelineLayout pipelineLayout;
+    VkRenderPass renderPass;
+    VkShaderModule shaders[kShaderCount];
+    VkDescriptorSet sets[kSetCount];
+
+    VkSpecializationMapEntry specializationEntries[4];
+    uint32_t specializationData[4];
+    VkSpecializationInfo specialization;
+    VkPipelineShaderStageCreateInfo stages[kShaderCount];
+    VkVertexInputBindingDescription vertexBindings[2];
+    VkVertexInputAttributeDescription vertexAttributes[4];
+    VkPipelineVertexInputStateCreateInfo vertexInput;
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly;
+    VkPipelineViewportStateCreateInfo viewport;
+    VkPipelineRasterizationStateCreateInfo rasterization;
+    VkPipelineMultisampleStateCreateInfo multisample;
+    VkPipelineDepthStencilStateCreateInfo depthStencil;
+    VkPipelineColorBlendAttachmentState blendAttachments[2];
+    VkPipelineColorBlendStateCreateInfo colorBlend;
+    VkDynamicState dynamicStates[2];
+    VkPipelineDynamicStateCreateInfo dynamicState;
+    VkGraphicsPipelineCreateInfo pipelineInfo;
+    VkGraphicsPipelineCreateInfo pipelineBatch[kPipelineBatchSize];
+
+    VkDescriptorImageInfo imageInfos[kImageCount];
+    VkDescriptorBufferInfo bufferInfos[kBufferCount];
+    VkWriteDescriptorSet writes[kWriteCount];
+    uint32_t dynamicOffsets[kSetCount] = {};
+
+    VkDescriptorImageInfo textureArrayInfos[kTextureArraySize];
+    VkWriteDescriptorSet textureArrayWrite;
+
+    VkBuffer stagingBuffer;
+    VkImage uploadImage;
+    VkImageMemoryBarrier uploadBarriers[2];
+    VkBufferImageCopy uploadRegions[kMipCount];
+
+    VkFramebuffer framebuffer;
+    VkPipeline framePipelines[kFramePipelineCount];
+    VkClearValue clearValues[3];
+    VkRenderPassBeginInfo renderPassBegin;
+    VkViewport frameViewport;
+    VkRect2D frameScissor;
+    float pushConstantData[16];
+};
+
+std::vector<Mix> makeMixes(Fixture* fixture) {
+    return {
+        {"create-graphics-pipelines",
+         [fixture](VkEncoder* encoder) { fixture->createGraphicsPipeline(encoder); }, 1},
+        {"create-graphics-pipelines-batch",
+         [fixture](VkEncoder* encoder) { fixture->createGraphicsPipelineBatch(encoder); }, 1},
+        {"update-descriptor-sets",
+         [fixture](VkEncoder* encoder) { fixture->updateDescriptorSets(encoder); }, 1},
+        {"update-texture-array",
+         [fixture](VkEncoder* encoder) { fixture->updateTextureArray(encoder); }, 1},
+        {"bind-descriptor-sets",
+         [fixture](VkEncoder* encoder) { fixture->bindDescriptorSets(encoder); }, 1},
+        {"record-texture-upload",
+         [fixture](VkEncoder* encoder) { fixture->recordUpload(encoder); }, 3},
+        {"record-frame",
+         [fixture](VkEncoder* encoder) { fixture->recordFrame(encoder); },
+         Fixture::kFrameCommands},
+    };
+}
+
+// Creates a batch of handles of one type from made-up host handles, starting
+// at |*nextHost|, then destroys them, both through ResourceTracker's
+// mappings. Returns the number of handles created plus destroyed.
+using HandleChurn = std::function<uint64_t(uint64_t* nextHost)>;
+
+template <class T>
+HandleChurn makeHandleChurn(void (VulkanHandleMapping::*create)(const uint64_t*, T*, size_t),
+                            void (VulkanHandleMapping::*destroy)(T*, size_t)) {
+    return [create, destroy](uint64_t* nextHost) -> uint64_t {
+        T handles[16];
+        for (T& handle : handles) {
+            // Host handles look like heap pointers: aligned and close together.
+            const uint64_t host = *nextHost;
+            *nextHost += 16 * 9;
+            (ResourceTracker::get()->createMapping()->*create)(&host, &handle, 1);
+        }
+        for (T& handle : handles) {
+            (ResourceTracker::get()->destroyMapping()->*destroy)(&handle, 1);
+        }
+        return 2 * (sizeof(handles) / sizeof(handles[0]));
+    };
+}
+
+#define HANDLE_CHURN(type) \
+    makeHandleChurn<type>(&VulkanHandleMapping::mapHandles_u64_##type, \
+                          &VulkanHandleMapping::mapHandles_##type)
+
+struct HandleBenchmark {
+    std::string name;
+    HandleChurn churn;
+    uint32_t threads;
+};
+
+struct HandleResult {
+    uint64_t operations;
+    double nsPerOperation;
+    double cpuNsPerOperation;
+};
+
+std::vector<HandleBenchmark> makeHandleBenchmarks() {
+    const struct {
+        const char* type;
+        HandleChurn churn;
+    } types[] = {
+        {"VkBuffer", HANDLE_CHURN(VkBuffer)},
+        {"VkSampler", HANDLE_CHURN(VkSampler)},
+        {"VkImageView", HANDLE_CHURN(VkImageView)},
+    };
+    std::vector<HandleBenchmark> benchmarks;
+    const uint32_t cpus = std::max(1u, std::thread::hardware_concurrency());
+    for (const auto& type : types) {
+        for (uint32_t threads : {1u, 4u, std::max(8u, cpus * 2)}) {
+            benchmarks.push_back({std::string("handles/") + type.type + "/" +
+                                      std::to_string(threads) + "t",
+                                  type.churn, threads});
+        }
+    }
+    return benchmarks;
+}
+
+HandleResult runHandleBenchmark(const HandleBenchmark& benchmark, const Options& options) {
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> operations(0);
+
+    const uint64_t start = nowNs();
+    const uint64_t cpuStart = processCpuNs();
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < benchmark.threads; ++t) {
+        threads.emplace_back([&, t] {
+            uint64_t nextHost = 0x7f0000000000ULL + ((uint64_t)t << 28);
+            uint64_t ops = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                ops += benchmark.churn(&nextHost);
+            }
+            operations.fetch_add(ops, std::memory_order_relaxed);
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(options.minTimeMs));
+    stop.store(true, std::memory_order_relaxed);
+    for (auto& thread : threads) thread.join();
+    const uint64_t elapsed = nowNs() - start;
+    const uint64_t cpu = processCpuNs() - cpuStart;
+
+    const uint64_t ops = operations.load(std::memory_order_relaxed);
+    const double divisor = ops ? (double)ops : 1.0;
+    return {ops, (double)elapsed / divisor, (double)cpu / divisor};
+}
+
+// One step of an allocation trace: allocate |size| bytes into |slot|, or
+// free |slot| if |size| is 0.
+struct AllocOp {
+    uint32_t slot;
+    uint64_t size;
+};
+
+struct SubAllocTrace {
+    const char* name;
+    uint64_t heapSize;
+    uint64_t pageSize;
+    uint32_t slots;
+    // Ops up to |steadyOps| fill the heap and churn it; the rest free
+    // everything still live, so the trace can be replayed back to back.
+    size_t steadyOps;
+    std::vector<AllocOp> ops;
+};
+
+// Keeps about half of |slots| live, replacing random ones, with sizes drawn
+// from |sizeFor|.
+SubAllocTrace makeSubAllocTrace(const char* name, uint64_t heapSize, uint64_t pageSize,
+                                uint32_t slots, size_t churn,
+                                const std::function<uint64_t(std::mt19937_64&)>& sizeFor) {
+    SubAllocTrace trace = {name, heapSize, pageSize, slots, 0, {}};
+    std::mt19937_64 rng(0x5eed);
+    std::vector<bool> live(slots);
+    for (size_t i = 0; i < churn; ++i) {
+        uint32_t slot = (uint32_t)(rng() % slots);
+        trace.ops.push_back({slot, live[slot] ? 0 : sizeFor(rng)});
+        live[slot] = !live[slot];
+    }
+    trace.steadyOps = trace.ops.size();
+    for (uint32_t slot = 0; slot < slots; ++slot) {
+        if (live[slot]) trace.ops.push_back({slot, 0});
+    }
+    return trace;
+}
+
+// Log-uniform in [min, max).
+uint64_t logUniform(std::mt19937_64& rng, uint64_t min, uint64_t max) {
+    std::uniform_real_distribution<double> dist(log2((double)min), log2((double)max));
+    return (uint64_t)exp2(dist(rng));
+}
+
+const std::vector<SubAllocTrace>& subAllocTraces() {
+    static const std::vector<SubAllocTrace> traces = {
+        // HostVisibleMemoryVirtualization's real setup: 512 MiB blocks in
+        // 64 KiB pages. Mostly uniform and staging buffers, some textures.
+        makeSubAllocTrace("vulkan", 512ULL << 20, 64 << 10, 1200, 200000,
+                          [](std::mt19937_64& rng) -> uint64_t {
+                              uint32_t kind = rng() % 100;
+                              if (kind < 70) return logUniform(rng, 256, 64 << 10);
+                              if (kind < 95) return logUniform(rng, 64 << 10, 1 << 20);
+                              return logUniform(rng, 1 << 20, 16 << 20);
+                          }),
+        // Same heap with 4 KiB pages and thousands of small buffers live, so
+        // there are many more blocks to search.
+        makeSubAllocTrace("small", 512ULL << 20, 4 << 10, 8000, 200000,
+                          [](std::mt19937_64& rng) -> uint64_t {
+                              return logUniform(rng, 256, 256 << 10);
+                          }),
+    };
+    return traces;
+}
+
+// The allocator SubAllocator was built on before it switched to TLSF.
+class AddressSpaceHeap {
+public:
+    static constexpr uint64_t kFailed = ANDROID_EMU_ADDRESS_SPACE_BAD_OFFSET;
+
+    AddressSpaceHeap(uint64_t heapSize, uint64_t pageSize) : mPageSize(pageSize) {
+        address_space_allocator_init(&mAllocator, heapSize, 32);
+    }
+    ~AddressSpaceHeap() { address_space_allocator_destroy_nocleanup(&mAllocator); }
+
+    uint64_t alloc(uint64_t size) {
+        return address_space_allocator_allocate(
+            &mAllocator, mPageSize * ((size + mPageSize - 1) / mPageSize));
+    }
+    void free(uint64_t offset) { address_space_allocator_deallocate(&mAllocator, offset); }
+
+    double fragmentation() const {
+        uint64_t freeBytes = 0;
+        uint64_t largest = 0;
+        for (int i = 0; i < mAllocator.size; ++i) {
+            if (!mAllocator.blocks[i].available) continue;
+            freeBytes += mAllocator.blocks[i].size;
+            largest = std::max<uint64_t>(largest, mAllocator.blocks[i].size);
+        }
+        return freeBytes ? 1.0 - (double)largest / (double)freeBytes : 0.0;
+    }
+
+private:
+    uint64_t mPageSize;
+    address_space_allocator mAllocator;
+};
+
+class TlsfHeap {
+public:
+    static constexpr uint64_t kFailed = ~0ULL;
+
+    // SubAllocator never touches the buffer, so any aligned address will do.
+    TlsfHeap(uint64_t heapSize, uint64_t pageSize)
+        : mBase((char*)(uintptr_t)(1ULL << 40)), mAllocator(mBase, heapSize, pageSize) {}
+
+    uint64_t alloc(uint64_t size) {
+        void* ptr = mAllocator.alloc(size);
+        return ptr ? (uint64_t)((char*)ptr - mBase) : kFailed;
+    }
+    void free(uint64_t offset) { mAllocator.free(mBase + offset); }
+
+    double fragmentation() const { return mAllocator.getStats().fragmentation(); }
+
+private:
+    char* mBase;
+    android::base::guest::SubAllocator mAllocator;
+};
+
+struct SubAllocBenchmark {
+    std::string name;
+    const SubAllocTrace* trace;
+    bool tlsf;
+};
+
+struct SubAllocResult {
+    uint64_t operations;
+    double nsPerOperation;
+    uint64_t failedAllocs;
+    double fragmentation;
+};
+
+std::vector<SubAllocBenchmark> makeSubAllocBenchmarks() {
+    std::vector<SubAllocBenchmark> benchmarks;
+    for (const SubAllocTrace& trace : subAllocTraces()) {
+        for (bool tlsf : {false, true}) {
+            benchmarks.push_back({std::string("suballoc/") + trace.name + "/" +
+                                      (tlsf ? "tlsf" : "address_space"),
+                                  &trace, tlsf});
+        }
+    }
+    return benchmarks;
+}
+
+// Replays |ops| from |trace| once, returning how many allocations failed.
+template <class Heap>
+uint64_t replaySubAllocTrace(const SubAllocTrace& trace, size_t ops, Heap* heap,
+                             std::vector<uint64_t>* offsets) {
+    uint64_t failed = 0;
+    for (size_t i = 0; i < ops; ++i) {
+        const AllocOp& op = trace.ops[i];
+        uint64_t& offset = (*offsets)[op.slot];
+        if (op.size) {
+            offset = heap->alloc(op.size);
+            if (offset == Heap::kFailed) ++failed;
+        } else if (offset != Heap::kFailed) {
+            heap->free(offset);
+        }
+    }
+    return failed;
+}
+
+template <class Heap>
+SubAllocResult runSubAllocTrace(const SubAllocTrace& trace, const Options& options) {
+    Heap heap(trace.heapSize, trace.pageSize);
+    std::vector<uint64_t> offsets(trace.slots, Heap::kFailed);
+
+    SubAllocResult result = {};
+    result.failedAllocs = replaySubAllocTrace(trace, trace.steadyOps, &heap, &offsets);
+    result.fragmentation = heap.fragmentation();
+    for (size_t i = trace.steadyOps; i < trace.ops.size(); ++i) {
+        uint64_t offset = offsets[trace.ops[i].slot];
+        if (offset != Heap::kFailed) heap.free(offset);
+    }
+
+    const uint64_t minTimeNs = options.minTimeMs * 1000000ULL;
+    const uint64_t start = nowNs();
+    uint64_t elapsed = 0;
+    while (elapsed < minTimeNs) {
+        replaySubAllocTrace(trace, trace.ops.size(), &heap, &offsets);
+        result.operations += trace.ops.size();
+        elapsed = nowNs() - start;
+    }
+    result.nsPerOperation = (double)elapsed / (double)result.operations;
+    return result;
+}
+
+SubAllocResult runSubAllocBenchmark(const SubAllocBenchmark& benchmark,
+                                    const Options& options) {
+    return benchmark.tlsf ? runSubAllocTrace<TlsfHeap>(*benchmark.trace, options)
+                          : runSubAllocTrace<AddressSpaceHeap>(*benchmark.trace, options);
+}
+
+bool parseOptions(int argc, char** argv, Options* options) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (!strncmp(arg, "--filter=", 9)) {
+            options->filter = arg + 9;
+        } else if (!strncmp(arg, "--min-time-ms=", 14)) {
+            options->minTimeMs = strtoull(arg + 14, nullptr, 10);
+        } else if (!strcmp(arg, "--csv")) {
+            options->csv = true;
+        } else if (!strcmp(arg, "--phases")) {
+            options->phases = true;
+        } else {
+            fprintf(stderr,
+                    "usage: %s [--filter=<substring>] [--min-time-ms=<ms>] "
+                    "[--csv] [--phases]\n", argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, &options)) return 2;
+
+    // Streams are refcounted by the encoders and outlive main().
+    CountingStream* stream = new CountingStream();
+    VkEncoder* encoder = new VkEncoder(stream);
+
+    Fixture fixture;
+
+    if (options.csv) {
+        printf("mix,iterations,ns_per_call,ns_per_command,bytes_per_call\n");
+    } else {
+        printf("%-48s %12s %10s %10s %12s\n", "mix", "iterations", "ns/call", "ns/cmd",
+               "bytes/call");
+    }
+
+    // Mixes that ran, for --phases.
+    std::vector<const Mix*> ran;
+    const std::vector<Mix> mixes = makeMixes(&fixture);
+
+    for (const Mix& mix : mixes) {
+        if (!options.filter.empty() && strstr(mix.name, options.filter.c_str()) == nullptr) {
+            continue;
+        }
+        Result result = runMix(mix, encoder, stream, options);
+        ran.push_back(&mix);
+        if (options.csv) {
+            printf("%s,%llu,%.2f,%.2f,%.2f\n", mix.name,
+                   (unsigned long long)result.iterations, result.nsPerCall,
+                   result.nsPerCall / mix.commands, result.bytesPerCall);
+        } else {
+            printf("%-48s %12llu %10.2f %10.2f %12.2f\n", mix.name,
+                   (unsigned long long)result.iterations, result.nsPerCall,
+                   result.nsPerCall / mix.commands, result.bytesPerCall);
+        }
+    }
+
+    if (options.phases && !ran.empty()) {
+        if (!VkEncoder::setPhaseTimersEnabled(true)) {
+            fprintf(stderr, "--phases: vulkan_enc was built without VK_ENCODER_PHASE_TIMERS\n");
+            return 1;
+        }
+        // The timers add to the totals, so they are measured again here.
+        if (options.csv) {
+            printf("\nmix,total_ns,lock_ns,stream_ns,encode_ns\n");
+        } else {
+            printf("\n%-36s %10s %10s %10s %10s\n", "ns/call", "total", "lock", "stream",
+                   "encode");
+        }
+        for (const Mix* mix : ran) {
+            PhaseResult result = runPhases(*mix, encoder, stream, options);
+            double encode = result.total - result.lock - result.stream;
+            if (encode < 0) encode = 0;
+            printf(options.csv ? "%s,%.2f,%.2f,%.2f,%.2f\n"
+                               : "%-36s %10.2f %10.2f %10.2f %10.2f\n",
+                   mix->name, result.total, result.lock, result.stream, encode);
+        }
+        VkEncoder::setPhaseTimersEnabled(false);
+    }
+
+    bool printedHandleHeader = false;
+    for (const HandleBenchmark& benchmark : makeHandleBenchmarks()) {
+        if (!options.filter.empty() && benchmark.name.find(options.filter) == std::string::npos) {
+            continue;
+        }
+        if (!printedHandleHeader) {
+            if (options.csv) {
+                printf("\nhandles,operations,ns_per_operation,cpu_ns_per_operation\n");
+            } else {
+                printf("\n%-48s %12s %10s %12s\n", "handles", "operations", "ns/op",
+                       "cpu ns/op");
+            }
+            printedHandleHeader = true;
+        }
+        HandleResult result = runHandleBenchmark(benchmark, options);
+        if (options.csv) {
+            printf("%s,%llu,%.2f,%.2f\n", benchmark.name.c_str(),
+                   (unsigned long long)result.operations, result.nsPerOperation,
+                   result.cpuNsPerOperation);
+        } else {
+            printf("%-48s %12llu %10.2f %12.2f\n", benchmark.name.c_str(),
+                   (unsigned long long)result.operations, result.nsPerOperation,
+                   result.cpuNsPerOperation);
+        }
+    }
+
+    bool printedSubAllocHeader = false;
+    for (const SubAllocBenchmark& benchmark : makeSubAllocBenchmarks()) {
+        if (!options.filter.empty() && benchmark.name.find(options.filter) == std::string::npos) {
+            continue;
+        }
+        if (!printedSubAllocHeader) {
+            if (options.csv) {
+                printf("\nsuballoc,operations,ns_per_operation,failed_allocs,fragmentation\n");
+            } else {
+                printf("\n%-48s %12s %10s %12s %12s\n", "suballoc", "operations", "ns/op",
+                       "failed", "frag");
+            }
+            printedSubAllocHeader = true;
+        }
+        SubAllocResult result = runSubAllocBenchmark(benchmark, options);
+        if (options.csv) {
+            printf("%s,%llu,%.2f,%llu,%.3f\n", benchmark.name.c_str(),
+                   (unsigned long long)result.operations, result.nsPerOperation,
+                   (unsigned long long)result.failedAllocs, result.fragmentation);
+        } else {
+            printf("%-48s %12llu %10.2f %12llu %12.3f\n", benchmark.name.c_str(),
+                   (unsigned long long)result.operations, result.nsPerOperation,
+                   (unsigned long long)result.failedAllocs, result.fragmentation);
+        }
+    }
+
+    return 0;
+}